@@ -52,3 +52,44 @@
 #ifndef PONCA_HAS_BUILTIN_CLZ
 #define PONCA_HAS_BUILTIN_CLZ 0
 #endif
+
+// Hint the processor to load the cache line containing ADDR, ignored when unsupported
+#ifdef __has_builtin
+#if __has_builtin(__builtin_prefetch)
+#define PONCA_HAS_BUILTIN_PREFETCH 1
+#endif
+#endif
+
+#ifndef PONCA_HAS_BUILTIN_PREFETCH
+#define PONCA_HAS_BUILTIN_PREFETCH 0
+#endif
+
+#if PONCA_HAS_BUILTIN_PREFETCH
+#define PONCA_PREFETCH(ADDR) __builtin_prefetch(ADDR)
+#else
+#define PONCA_PREFETCH(ADDR) PONCA_UNUSED(ADDR)
+#endif
+
+// Runtime dispatch of the kernels: several versions of a kernel are compiled for different instruction sets, and the
+// best one for the running CPU is selected from cpuid (see Ponca/src/Common/cpuDispatch.h). Binaries then use
+// AVX2/AVX-512 when available without requiring `-march=native`. Supported by GCC and Clang on x86 targets, can be
+// disabled by defining PONCA_NO_MULTIVERSIONING. Other compilers only build the default version.
+#if !defined(PONCA_NO_MULTIVERSIONING) && defined(__GNUC__) && !defined(__CUDACC__) \
+    && (defined(__x86_64__) || defined(__i386__))
+#define PONCA_HAS_MULTIVERSIONING 1
+#define PONCA_TARGET_AVX2   __attribute__((target("avx2,fma")))
+#define PONCA_TARGET_AVX512 __attribute__((target("avx512f,avx512vl,avx512dq,avx2,fma")))
+#else
+#define PONCA_HAS_MULTIVERSIONING 0
+#define PONCA_TARGET_AVX2
+#define PONCA_TARGET_AVX512
+#endif
+
+// Force the inlining of a function, so that it is compiled with the instruction set of its caller
+#if defined(__GNUC__)
+#define PONCA_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define PONCA_FORCE_INLINE __forceinline
+#else
+#define PONCA_FORCE_INLINE inline
+#endif
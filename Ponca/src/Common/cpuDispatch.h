@@ -0,0 +1,101 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./Macro.h"
+
+#include <algorithm>
+
+namespace Ponca {
+
+/*!
+ * \brief Instruction sets of the kernels selected at runtime
+ *
+ * \see cpuSimdLevel
+ */
+enum class SimdLevel
+{
+    Default = 0, ///< Instruction set given at compile time
+    AVX2    = 1, ///< AVX2 and FMA
+    AVX512  = 2  ///< AVX-512 F, VL and DQ
+};
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /// Highest SimdLevel supported by the running CPU, read from cpuid
+    inline SimdLevel detectSimdLevel()
+    {
+#if PONCA_HAS_MULTIVERSIONING
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+            __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("fma"))
+            return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return SimdLevel::AVX2;
+#endif
+        return SimdLevel::Default;
+    }
+}
+#endif
+
+/*!
+ * \brief Instruction set used by the kernels dispatched at runtime
+ *
+ * Detected once from cpuid. Always SimdLevel::Default when PONCA_HAS_MULTIVERSIONING is 0, i.e. with compilers other
+ * than GCC and Clang, on targets other than x86, or when PONCA_NO_MULTIVERSIONING is defined.
+ */
+inline SimdLevel cpuSimdLevel()
+{
+    static const SimdLevel level = internal::detectSimdLevel();
+    return level;
+}
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /*!
+     * \brief Versions of a kernel compiled for each SimdLevel, selected at runtime from a table of function pointers
+     *
+     * `Kernel` provides a static function `run`, marked PONCA_FORCE_INLINE. It is inlined in each of the versions
+     * below, so its loops are compiled, and vectorized, for the instruction set of the version. The version matching
+     * cpuSimdLevel is selected at the first call, and the next calls go through the same function pointer.
+     *
+     * Kernels should process blocks of values, so that the indirect call is amortized.
+     */
+    template <typename Kernel>
+    struct SimdDispatch
+    {
+        template <typename... Args>
+        static void runDefault(Args... args) { Kernel::run(args...); }
+
+        template <typename... Args>
+        PONCA_TARGET_AVX2 static void runAVX2(Args... args) { Kernel::run(args...); }
+
+        template <typename... Args>
+        PONCA_TARGET_AVX512 static void runAVX512(Args... args) { Kernel::run(args...); }
+
+        /// Version compiled for `level`, or for the highest level supported by the CPU if it is lower
+        template <typename... Args>
+        static auto version(SimdLevel level) -> void (*)(Args...)
+        {
+            using Function = void (*)(Args...);
+            static const Function table[] = { &runDefault<Args...>, &runAVX2<Args...>, &runAVX512<Args...> };
+            return table[int(std::min(level, cpuSimdLevel()))];
+        }
+
+        /// Run the version selected for the CPU
+        template <typename... Args>
+        static inline void run(Args... args)
+        {
+            static const auto function = version<Args...>(cpuSimdLevel());
+            function(args...);
+        }
+    };
+}
+#endif
+} // namespace Ponca
@@ -9,6 +9,9 @@
 #include "defines.h"
 #include "enums.h"
 #include "primitive.h"
+#ifdef PONCA_CPU_ARCH
+#include "neighborCache.h"
+#endif
 
 #include PONCA_MULTIARCH_INCLUDE_STD(iterator)
 
@@ -79,6 +82,17 @@ namespace internal
     PONCA_MULTIARCH inline                                                                            \
     FIT_RESULT compute(const Container& c){                                                           \
         return Self::compute(std::begin(c), std::end(c));                                             \
+    }                                                                                                 \
+    /*! \brief Convenience function to iterate once over a subset of samples in a PointContainer */   \
+    /*! The first pass records the neighbors with a non-zero weight in a buffer owned by the  */      \
+    /*! calling thread, replayed by the next passes (see #NEED_OTHER_PASS): e.g. the kd-tree  */      \
+    /*! traversal of a `range_neighbors` query is not repeated by multi-pass fits.            */      \
+    /*! \param cache Data recorded by the first pass, see NeighborCache */                            \
+    /*! \see #computeWithIds(IndexRange ids, const PointContainer& points) */                         \
+    template <typename IndexRange, typename PointContainer>                                           \
+    inline FIT_RESULT computeWithIds(IndexRange ids, const PointContainer& points,                    \
+                                     NeighborCache cache){                                            \
+        return internal::computeWithNeighborCache(*this, ids, points, cache);                         \
     }
 #else
 #   define WRITE_BASKET_SINGLE_HOST_FUNCTIONS
@@ -177,6 +191,26 @@ namespace internal
         }
         return false;
     }
+
+    /// \copydoc Basket::removeNeighbor
+    PONCA_MULTIARCH inline bool removeNeighbor(const DataPoint &_nei) {
+        // compute weight
+        auto wres = Base::m_w.w(_nei.pos(), _nei);
+        typename Base::ScalarArray dw;
+
+        if (wres.first > Scalar(0.)) {
+            Base::removeLocalNeighbor(wres.first, wres.second, _nei, dw);
+            return true;
+        }
+        return false;
+    }
+
+    /// \copydoc Basket::addWeightedNeighbor
+    PONCA_MULTIARCH inline void addWeightedNeighbor(Scalar w, const typename Base::VectorType &localQ,
+                                                    const DataPoint &_nei) {
+        typename Base::ScalarArray dw;
+        Base::addLocalNeighbor(w, localQ, _nei, dw);
+    }
 };
 
 /*!
@@ -239,6 +273,32 @@ namespace internal
             }
             return false;
         }
+
+        /// \brief Remove a neighbor previously added to the fit, subtracting its contribution
+        ///
+        /// The weighting function and evaluation position must be the ones used to add the neighbor, in the current
+        /// pass: the fit is then the fit of the remaining neighbors, up to rounding errors.
+        /// \see IncrementalFit to update a fit as neighbors enter and leave the neighborhood
+        /// \return false if param nei is not a valid neighbor (weight = 0), and was thus not added to the fit
+        PONCA_MULTIARCH inline bool removeNeighbor(const DataPoint &_nei) {
+            // compute weight
+            auto wres = Base::m_w.w(_nei.pos(), _nei);
+
+            if (wres.first > Scalar(0.)) {
+                Base::removeLocalNeighbor(wres.first, wres.second, _nei);
+                return true;
+            }
+            return false;
+        }
+
+        /// \brief Add a neighbor with its weight and local position, as computed by the weighting function
+        ///
+        /// Used to replay neighbors recorded during a previous pass, without evaluating the weighting function again.
+        /// \see computeWithIds(IndexRange,const PointContainer&,NeighborCache)
+        PONCA_MULTIARCH inline void addWeightedNeighbor(Scalar w, const typename Base::VectorType &localQ,
+                                                        const DataPoint &_nei) {
+            Base::addLocalNeighbor(w, localQ, _nei);
+        }
     }; // class Basket
 
 } //namespace Ponca
@@ -71,6 +71,8 @@ namespace Ponca
     public:
         PONCA_EXPLICIT_CAST_OPERATORS(CovarianceFitBase,covarianceFit)
         PONCA_FITTING_DECLARE_INIT_ADD_FINALIZE
+        PONCA_FITTING_DECLARE_REMOVENEIGHBOR
+        PONCA_FITTING_DECLARE_MERGE(CovarianceFitBase)
 
         /*! \brief Implements \cite Pauly:2002:PSSimplification surface variation.
             It computes the ratio \f$ d \frac{\lambda_0}{\sum_i \lambda_i} \f$ with \c d the dimension of the ambient space.
@@ -111,6 +113,8 @@ namespace Ponca
     public:
         PONCA_EXPLICIT_CAST_OPERATORS_DER(CovarianceFitDer,covarianceFitDer)
         PONCA_FITTING_DECLARE_INIT_ADDDER_FINALIZE
+        PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+        PONCA_FITTING_DECLARE_MERGE(CovarianceFitDer)
     }; //class CovarianceFitDer
 
 #include "covarianceFit.hpp"
@@ -29,6 +29,24 @@ CovarianceFitBase<DataPoint, _WFunctor, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template < class DataPoint, class _WFunctor, typename T>
+void
+CovarianceFitBase<DataPoint, _WFunctor, T>::removeLocalNeighbor(Scalar w,
+                                                                const VectorType &localQ,
+                                                                const DataPoint &attributes)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes);
+    m_cov -= w * localQ * localQ.transpose();
+}
+
+template < class DataPoint, class _WFunctor, typename T>
+void
+CovarianceFitBase<DataPoint, _WFunctor, T>::merge(const CovarianceFitBase& other)
+{
+    Base::merge(other);
+    m_cov += other.m_cov;
+}
+
 
 template < class DataPoint, class _WFunctor, typename T>
 FIT_RESULT
@@ -92,6 +110,27 @@ CovarianceFitDer<DataPoint, _WFunctor, DiffType, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+CovarianceFitDer<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                         const VectorType &localQ,
+                                                                         const DataPoint &attributes,
+                                                                         ScalarArray &dw)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes, dw);
+    for(int k=0; k<Base::NbDerivatives; ++k)
+        m_dCov[k] -= dw[k] * localQ * localQ.transpose();
+}
+
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+CovarianceFitDer<DataPoint, _WFunctor, DiffType, T>::merge(const CovarianceFitDer& other)
+{
+    Base::merge(other);
+    for(int k=0; k<Base::NbDerivatives; ++k)
+        m_dCov[k] += other.m_dCov[k];
+}
+
 
 template < class DataPoint, class _WFunctor, int DiffType, typename T>
 FIT_RESULT
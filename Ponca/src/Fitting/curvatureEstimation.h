@@ -100,6 +100,8 @@ protected:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS_DER(NormalCovarianceCurvatureEstimator, normalCovarianceCurvatureEstimator)
     PONCA_FITTING_DECLARE_INIT_ADDDER_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+    PONCA_FITTING_DECLARE_MERGE(NormalCovarianceCurvatureEstimator)
 };
 
 
@@ -115,8 +117,6 @@ public:
  * \note This procedure requires two passes, the first one for plane fitting
  * and local frame estimation, and the second one for covariance analysis.
  * \warning This class is valid only in 3D.
- *
- * \warning Not it test suite, to be added !
  */
 template < class DataPoint, class _WFunctor, int DiffType, typename T>
 class ProjectedNormalCovarianceCurvatureEstimator : public T
@@ -155,6 +155,7 @@ public:
 protected:
     Vector2 m_cog;      /*!< \brief Gravity center */
     Mat22 m_cov;        /*!< \brief Covariance matrix */
+    Scalar m_sumW;      /*!< \brief Sum of the weights of the second pass */
     Solver m_solver;    /*!< \brief Solver used to analyse the covariance matrix */
     PASS m_pass;        /*!< \brief Current pass */
     Mat32 m_tframe;     /*!< \brief Tangent frame */
@@ -162,6 +163,8 @@ protected:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS_DER(ProjectedNormalCovarianceCurvatureEstimator, projectedNormalCovarianceCurvature)
     PONCA_FITTING_DECLARE_INIT_ADDDER_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+    PONCA_FITTING_DECLARE_MERGE(ProjectedNormalCovarianceCurvatureEstimator)
 };
 
 #include "curvatureEstimation.hpp"
@@ -128,6 +128,27 @@ NormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::addLocalN
     return false;
 }
 
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+NormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                                           const VectorType &localQ,
+                                                                                           const DataPoint &attributes,
+                                                                                           ScalarArray &dw)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes, dw);
+    m_cov -= w * attributes.normal() * attributes.normal().transpose();
+    m_cog -= attributes.normal();
+}
+
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+NormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::merge(const NormalCovarianceCurvatureEstimator& other)
+{
+    Base::merge(other);
+    m_cov += other.m_cov;
+    m_cog += other.m_cog;
+}
+
 template < class DataPoint, class _WFunctor, int DiffType, typename T>
 FIT_RESULT
 NormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::finalize ()
@@ -189,6 +210,7 @@ ProjectedNormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::
 
     m_cog = Vector2::Zero();
     m_cov = Mat22::Zero();
+    m_sumW = Scalar(0);
     m_pass = FIRST_PASS;
     m_tframe = Mat32::Zero();
 }
@@ -208,13 +230,52 @@ ProjectedNormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::
         VectorType n = attributes.normal();
         Vector2 proj = m_tframe.transpose() * n;
 
-        m_cov += proj * proj.transpose();
+        m_cov += w * proj * proj.transpose();
         m_cog += w * proj;
+        m_sumW += w;
         return true;
     }
     return false;
 }
 
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+ProjectedNormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                                                    const VectorType &localQ,
+                                                                                                    const DataPoint &attributes,
+                                                                                                    ScalarArray &dw)
+{
+    // Remove from the accumulation of the current pass, see addLocalNeighbor
+    if(m_pass == FIRST_PASS)
+    {
+        Base::removeLocalNeighbor(w, localQ, attributes, dw);
+    }
+    else if(m_pass == SECOND_PASS)
+    {
+        const Vector2 proj = m_tframe.transpose() * attributes.normal();
+        m_cov -= w * proj * proj.transpose();
+        m_cog -= w * proj;
+        m_sumW -= w;
+    }
+}
+
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+ProjectedNormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::merge(const ProjectedNormalCovarianceCurvatureEstimator& other)
+{
+    // Merge the accumulation of the current pass, see addLocalNeighbor
+    if(m_pass == FIRST_PASS)
+    {
+        Base::merge(other);
+    }
+    else if(m_pass == SECOND_PASS)
+    {
+        m_cov += other.m_cov;
+        m_cog += other.m_cog;
+        m_sumW += other.m_sumW;
+    }
+}
+
 template < class DataPoint, class _WFunctor, int DiffType, typename T>
 FIT_RESULT
 ProjectedNormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::finalize ()
@@ -239,6 +300,7 @@ ProjectedNormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::
             m_tframe.col(1)[i0] = n[i1]*n[i1] + n[i2]*n[i2];
             m_tframe.col(1)[i1] = -n[i1]*n[i0];
             m_tframe.col(1)[i2] = -n[i2]*n[i0];
+            m_tframe.colwise().normalize();
 
             // go to second pass
             m_pass = SECOND_PASS;
@@ -252,33 +314,34 @@ ProjectedNormalCovarianceCurvatureEstimator<DataPoint, _WFunctor, DiffType, T>::
     else if(m_pass == SECOND_PASS)
     {
         // center of gravity (mean)
-        m_cog /= Base::getWeightSum();
+        m_cog /= m_sumW;
 
         // Center the covariance on the centroid
-        m_cov = m_cov/Base::getWeightSum() - m_cog * m_cog.transpose();
+        m_cov = m_cov/m_sumW - m_cog * m_cog.transpose();
 
         m_solver.computeDirect(m_cov);
 
-        Base::m_kmin = m_solver.eigenvalues()(0);
-        Base::m_kmax = m_solver.eigenvalues()(1);
+        Scalar kmin = m_solver.eigenvalues()(0);
+        Scalar kmax = m_solver.eigenvalues()(1);
 
         // transform from local plane coordinates to world coordinates
-        Base::m_v1 = m_tframe * m_solver.eigenvectors().col(0);
-        Base::m_v2 = m_tframe * m_solver.eigenvectors().col(1);
+        VectorType vmin = m_tframe * m_solver.eigenvectors().col(0);
+        VectorType vmax = m_tframe * m_solver.eigenvectors().col(1);
 
         //TODO(thib) which epsilon value should be chosen ?
 //        Scalar epsilon = Eigen::NumTraits<Scalar>::dummy_precision();
         Scalar epsilon = Scalar(1e-3);
-        if(Base::m_kmin<epsilon && Base::m_kmax<epsilon)
+        if(kmin<epsilon && kmax<epsilon)
         {
-            Base::m_kmin = Scalar(0);
-            Base::m_kmax = Scalar(0);
+            kmin = Scalar(0);
+            kmax = Scalar(0);
 
             // set principal directions from fitted plane
-            Base::m_v2 = m_tframe.col(0);
-            Base::m_v1 = m_tframe.col(1);
+            vmax = m_tframe.col(0);
+            vmin = m_tframe.col(1);
         }
 
+        Base::setCurvatureValues(kmin, kmax, vmin, vmax);
         return STABLE;
     }
     return UNDEFINED;
@@ -73,6 +73,12 @@ using VectorArray = typename Base::VectorArray;     /*!< \brief Alias to vector
 /*! Add a neighbor to perform the fit \return false if param nei is not a valid neighbour (weight = 0) */
 #define PONCA_FITTING_APIDOC_FINALIZE \
 /*! Finalize the procedure \return Fitting Status \warning Must be called be for any use of the fitting output */
+#define PONCA_FITTING_APIDOC_REMOVENEIGHBOR \
+/*! Remove a neighbor added to the fit in the current pass, subtracting its contribution. \warning The neighbor must be removed with the weight and local position used to add it */
+#define PONCA_FITTING_APIDOC_REMOVENEIGHBOR_DER \
+/*! Remove a neighbor added to the fit in the current pass, subtracting its contribution. \warning The neighbor must be removed with the weight and local position used to add it */
+#define PONCA_FITTING_APIDOC_MERGE \
+/*! Add the neighbors accumulated by another fit of the same pass, as if they were added to this fit. \warning Both fits must have been initialized with the same weighting function and evaluation position, and must not be finalized */
 
 // FIT API DECLARATION
 
@@ -103,6 +109,22 @@ addLocalNeighbor(Scalar w, const VectorType &localQ, const DataPoint &attributes
 PONCA_FITTING_APIDOC_FINALIZE                                                                                      \
 PONCA_MULTIARCH inline FIT_RESULT finalize();
 
+/// Declare Concept::ComputationalObjectConcept::removeLocalNeighbor
+#define PONCA_FITTING_DECLARE_REMOVENEIGHBOR                                                                       \
+PONCA_FITTING_APIDOC_REMOVENEIGHBOR                                                                                \
+PONCA_MULTIARCH inline void removeLocalNeighbor(Scalar w, const VectorType &localQ, const DataPoint &attributes);
+
+/// Declare Concept::ComputationalDerivativesConcept::removeLocalNeighbor
+#define PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER                                                                   \
+PONCA_FITTING_APIDOC_REMOVENEIGHBOR_DER                                                                            \
+PONCA_MULTIARCH inline void                                                                                        \
+removeLocalNeighbor(Scalar w, const VectorType &localQ, const DataPoint &attributes, ScalarArray &dw);
+
+/// Declare Concept::ComputationalObjectConcept::merge
+#define PONCA_FITTING_DECLARE_MERGE(CLASSNAME)                                                                     \
+PONCA_FITTING_APIDOC_MERGE                                                                                         \
+PONCA_MULTIARCH inline void merge(const CLASSNAME& other);
+
 #define PONCA_FITTING_DECLARE_INIT_ADD_FINALIZE                                                                    \
 PONCA_FITTING_DECLARE_INIT                                                                                         \
 PONCA_FITTING_DECLARE_ADDNEIGHBOR                                                                                  \
@@ -37,4 +37,13 @@ FitSpaceDer = 0x02,                          /*!< \brief Flag indicating a space
 FitScaleSpaceDer = FitScaleDer | FitSpaceDer /*!< \brief Flag indicating a scale-space differentiation. */
 };
 
+/// Neighbors recorded by the first pass of Basket::computeWithIds, and replayed by the next passes
+/// \see internal::NeighborCacheBuffer
+enum NeighborCache : unsigned char
+{
+NO_CACHE      = 0, /*!< \brief Every pass traverses the range of indices. */
+CACHE_INDICES = 1, /*!< \brief The indices of the neighbors with a non-zero weight are recorded. */
+CACHE_WEIGHTS = 2  /*!< \brief The weights and local positions of the neighbors are recorded with their indices. */
+};
+
 } //namespace Ponca
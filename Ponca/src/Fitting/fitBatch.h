@@ -0,0 +1,222 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./defines.h"
+#include "./enums.h"
+#include "./multiScaleFit.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace Ponca
+{
+
+/*!
+    \brief Output of FitBatch: state of each fit, as returned by finalize
+*/
+struct FitStateOutput
+{
+    FIT_RESULT* data {nullptr}; ///< One value per evaluation position
+
+    template <typename Fit>
+    inline void write(const Fit& fit, const typename Fit::VectorType& /*pos*/, int i, int /*n*/) const
+    {
+        data[i] = fit.getCurrentState();
+    }
+};
+
+/*!
+    \brief Output of FitBatch: potential of the fitted primitive at the evaluation position
+
+    Requires a primitive providing `potential(q)`, e.g. Plane or AlgebraicSphere.
+*/
+template <typename Scalar>
+struct FitPotentialOutput
+{
+    Scalar* data {nullptr}; ///< One value per evaluation position, NaN where the fit is not ready
+
+    template <typename Fit>
+    inline void write(const Fit& fit, const typename Fit::VectorType& pos, int i, int /*n*/) const
+    {
+        data[i] = fit.isReady() ? Scalar(fit.potential(pos)) : std::numeric_limits<Scalar>::quiet_NaN();
+    }
+};
+
+/*!
+    \brief Output of FitBatch: normalized gradient of the fitted primitive at the evaluation position
+
+    Requires a primitive providing `primitiveGradient(q)`, e.g. Plane or AlgebraicSphere.
+*/
+template <typename Scalar>
+struct FitNormalOutput
+{
+    /// `Dim` values per evaluation position, stored by coordinate: the coordinate `d` of the position `i` is
+    /// `data[d * n + i]`, with `n` the number of positions. NaN where the fit is not ready
+    Scalar* data {nullptr};
+
+    template <typename Fit>
+    inline void write(const Fit& fit, const typename Fit::VectorType& pos, int i, int n) const
+    {
+        const typename Fit::VectorType normal = fit.isReady() ? fit.primitiveGradient(pos).normalized()
+                : Fit::VectorType::Constant(std::numeric_limits<typename Fit::Scalar>::quiet_NaN());
+        for (int d = 0; d < int(normal.size()); ++d)
+            data[std::size_t(d) * n + i] = Scalar(normal[d]);
+    }
+};
+
+/*!
+    \brief Output of FitBatch: principal curvatures, e.g. computed by CurvatureEstimatorBase
+
+    Each pointer can be null to skip the corresponding value.
+*/
+template <typename Scalar>
+struct FitCurvatureOutput
+{
+    Scalar* kmin {nullptr}; ///< One value per evaluation position, NaN where the fit is not ready
+    Scalar* kmax {nullptr}; ///< One value per evaluation position, NaN where the fit is not ready
+
+    template <typename Fit>
+    inline void write(const Fit& fit, const typename Fit::VectorType& /*pos*/, int i, int /*n*/) const
+    {
+        const bool ready = fit.isReady();
+        if (kmin) kmin[i] = ready ? Scalar(fit.kmin()) : std::numeric_limits<Scalar>::quiet_NaN();
+        if (kmax) kmax[i] = ready ? Scalar(fit.kmax()) : std::numeric_limits<Scalar>::quiet_NaN();
+    }
+};
+
+/*!
+    \brief Output of FitBatch given by a functor, called as `f(fit, i)` for the position `i`
+
+    Used for the values that have no predefined output, e.g. the GLS parameters:
+    \code
+    std::vector<Scalar> tau(n), kappa(n);
+    batch.compute(tree, positions, t, makeFitOutput([&](const Fit& fit, int i) {
+        tau[i] = fit.tau(); kappa[i] = fit.kappa();
+    }));
+    \endcode
+*/
+template <typename Functor>
+struct FitCustomOutput
+{
+    Functor f;
+
+    template <typename Fit>
+    inline void write(const Fit& fit, const typename Fit::VectorType& /*pos*/, int i, int /*n*/) const
+    {
+        f(fit, i);
+    }
+};
+
+/// \brief Convenience function to build a FitCustomOutput
+template <typename Functor>
+inline FitCustomOutput<Functor> makeFitOutput(Functor f) { return {f}; }
+
+/*!
+    \brief Fit a Basket at many evaluation positions in parallel
+
+    For each evaluation position `p`, FitBatch runs the usual sequence
+    \code
+    fit.setWeightFunc(WFunctor(t));
+    fit.init(p);
+    fit.computeWithIds(tree.range_neighbors(p, t), tree.points());
+    \endcode
+    on a copy of the prototype Basket owned by the calling thread, and writes the selected outputs (see FitStateOutput,
+    FitPotentialOutput, FitNormalOutput, FitCurvatureOutput and FitCustomOutput) at the index of the position in
+    preallocated arrays.
+
+    Each result only depends on its evaluation position, and the neighbors of a range query are always visited in the
+    same order: results do not depend on the number of threads nor on the scheduling.
+
+    \tparam Fit Basket or BasketDiff type
+    \warning CPU only. Positions are processed in parallel when OpenMP is enabled.
+*/
+template <typename Fit>
+class FitBatch
+{
+public:
+    using DataPoint  = typename Fit::DataPoint;
+    using Scalar     = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+    using WFunctor   = typename Fit::WFunctor;
+
+    /// \brief Callback reporting the number of processed positions, and the total number of positions
+    using ProgressCallback = std::function<void(int, int)>;
+
+    /// \brief Number of positions processed by a thread before taking new ones, and between two progress reports
+    static constexpr int CHUNK_SIZE = 256;
+
+    /// \brief Batch copying a value-initialized Basket
+    inline FitBatch() : m_prototype() {}
+
+    /// \param prototype Basket copied by each thread, e.g. to set parameters of the fit before the computation
+    inline explicit FitBatch(const Fit& prototype) : m_prototype(prototype) {}
+
+    /// \brief Set the function called after each chunk of positions
+    ///
+    /// Calls are serialized, from any thread, with an increasing number of processed positions. The last call reports
+    /// all the positions.
+    inline void setProgressCallback(ProgressCallback callback) { m_progress = std::move(callback); }
+
+    /*!
+        \brief Fit the Basket at each evaluation position, with the neighbors of the position in a kd-tree
+
+        \param tree Spatial structure providing `points()` and `range_neighbors(VectorType, Scalar)`, e.g. KdTree
+        \param positions Container of VectorType, the evaluation positions
+        \param t Scale of the weighting function, also used as the radius of the range queries
+        \param outputs Values to write for each position
+        \return The number of positions where the fit is stable
+     */
+    template <typename Tree, typename PositionContainer, typename... Outputs>
+    inline int compute(const Tree& tree, const PositionContainer& positions, Scalar t,
+                       const Outputs&... outputs) const;
+
+    /*!
+        \brief Fit the Basket at each sample of a kd-tree, with the neighbors given by
+        KdTreeBase::for_each_range_neighbors
+
+        Same as #compute with the positions of the samples, but the neighbors of the samples of a leaf are computed
+        together, which is faster when the evaluation positions are the points of the tree. The neighbors of each
+        sample are the point itself and its range neighbors, in an order that differs from the one of `range_neighbors`:
+        the results are the ones of #compute up to rounding errors, and still do not depend on the number of threads.
+
+        Outputs are indexed by point: the value of the sample associated with the point `i` is written at the index
+        `i`, with `n = tree.points().size()`. The values of the points that are not samples are not written.
+
+        \param tree KdTreeBase
+        \param t Scale of the weighting function, also used as the radius of the range queries
+        \param outputs Values to write for each sample
+        \return The number of samples where the fit is stable
+     */
+    template <typename Tree, typename... Outputs>
+    inline int computeAtSamples(const Tree& tree, Scalar t, const Outputs&... outputs) const;
+
+    /*!
+        \brief Fit the Basket at each evaluation position and at several scales, see MultiScaleFit
+
+        Each thread runs a single range query per position, at the largest scale. The outputs are stored by scale: the
+        value of the position `i` at the scale `s` is written at the index `s * n + i`, with `n` the number of positions,
+        as if `scales.size() * n` positions were processed (e.g. `data[d * (scales.size() * n) + s * n + i]` for
+        FitNormalOutput).
+
+        \param scales Container of strictly positive scales, sorted by increasing value
+        \return The number of stable fits, for all the positions and scales
+     */
+    template <typename Tree, typename PositionContainer, typename ScaleContainer, typename... Outputs>
+    inline int computeMultiScale(const Tree& tree, const PositionContainer& positions, const ScaleContainer& scales,
+                                 const Outputs&... outputs) const;
+
+private:
+    Fit m_prototype;
+    ProgressCallback m_progress;
+};
+
+#include "fitBatch.hpp"
+
+} //namespace Ponca
@@ -0,0 +1,130 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+template <typename Fit>
+template <typename Tree, typename PositionContainer, typename... Outputs>
+int
+FitBatch<Fit>::compute(const Tree& tree, const PositionContainer& positions, Scalar t,
+                       const Outputs&... outputs) const
+{
+    const int n = int(positions.size());
+    const int chunkCount = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int stableCount = 0;
+    int processed = 0;
+
+#pragma omp parallel reduction(+: stableCount)
+    {
+        // Per-thread Basket, reinitialized for each position
+        Fit fit = m_prototype;
+
+#pragma omp for schedule(dynamic)
+        for (int c = 0; c < chunkCount; ++c)
+        {
+            const int first = c * CHUNK_SIZE, last = std::min(n, first + CHUNK_SIZE);
+            for (int i = first; i < last; ++i)
+            {
+                const VectorType& pos = positions[i];
+                fit.setWeightFunc(WFunctor(t));
+                fit.init(pos);
+                if (fit.computeWithIds(tree.range_neighbors(pos, t), tree.points()) == STABLE)
+                    ++stableCount;
+                (outputs.write(fit, pos, i, n), ...);
+            }
+
+            if (m_progress)
+            {
+#pragma omp critical(PoncaFitBatchProgress)
+                {
+                    processed += last - first;
+                    m_progress(processed, n);
+                }
+            }
+        }
+    }
+    return stableCount;
+}
+
+template <typename Fit>
+template <typename Tree, typename... Outputs>
+int
+FitBatch<Fit>::computeAtSamples(const Tree& tree, Scalar t, const Outputs&... outputs) const
+{
+    const auto& points = tree.points();
+    const int n = int(points.size());
+    int stableCount = 0;
+    int processed = 0;
+
+    // Called concurrently for the samples of different leaves
+    tree.for_each_range_neighbors(t, [&](int point_index, const std::vector<typename Tree::IndexType>& neighbors) {
+        thread_local std::vector<int> ids;
+        ids.assign(1, point_index);
+        ids.insert(ids.end(), neighbors.begin(), neighbors.end());
+
+        const VectorType& pos = points[point_index].pos();
+        Fit fit = m_prototype;
+        fit.setWeightFunc(WFunctor(t));
+        fit.init(pos);
+        if (fit.computeWithIds(ids, points) == STABLE)
+        {
+#pragma omp atomic
+            ++stableCount;
+        }
+        (outputs.write(fit, pos, point_index, n), ...);
+
+        if (m_progress)
+        {
+#pragma omp critical(PoncaFitBatchProgress)
+            {
+                ++processed;
+                if (processed % CHUNK_SIZE == 0 || processed == tree.sample_count())
+                    m_progress(processed, tree.sample_count());
+            }
+        }
+    });
+    return stableCount;
+}
+
+template <typename Fit>
+template <typename Tree, typename PositionContainer, typename ScaleContainer, typename... Outputs>
+int
+FitBatch<Fit>::computeMultiScale(const Tree& tree, const PositionContainer& positions, const ScaleContainer& scales,
+                                 const Outputs&... outputs) const
+{
+    const int n = int(positions.size());
+    const int scaleCount = int(scales.size());
+    const int chunkCount = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int stableCount = 0;
+    int processed = 0;
+
+#pragma omp parallel reduction(+: stableCount)
+    {
+        // Per-thread fits and neighbors buffer, reused for each position
+        MultiScaleFit<Fit> fits(m_prototype);
+
+#pragma omp for schedule(dynamic)
+        for (int c = 0; c < chunkCount; ++c)
+        {
+            const int first = c * CHUNK_SIZE, last = std::min(n, first + CHUNK_SIZE);
+            for (int i = first; i < last; ++i)
+            {
+                const VectorType& pos = positions[i];
+                stableCount += fits.compute(tree, pos, scales);
+                for (int s = 0; s < scaleCount; ++s)
+                    (outputs.write(fits[s], pos, s * n + i, scaleCount * n), ...);
+            }
+
+            if (m_progress)
+            {
+#pragma omp critical(PoncaFitBatchProgress)
+                {
+                    processed += last - first;
+                    m_progress(processed, n);
+                }
+            }
+        }
+    }
+    return stableCount;
+}
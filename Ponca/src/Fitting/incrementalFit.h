@@ -0,0 +1,136 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./defines.h"
+#include "./enums.h"
+#include "../Common/Assert.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Ponca
+{
+
+/*!
+    \brief Update a Basket incrementally as neighbors enter and leave its neighborhood
+
+    When the neighborhood changes little between two evaluations, e.g. a sliding window along an organized scan,
+    IncrementalFit adds the entering neighbors to the sums of the fit and subtracts the leaving ones (see
+    Basket::removeNeighbor), instead of refitting the whole neighborhood: an update costs O(changes) instead of
+    O(neighbors), plus the cost of `finalize`.
+
+    \code
+    IncrementalFit<Fit> inc;
+    inc.setWeightFunc(WFunctor(t));
+    inc.init(basisCenter);
+    inc.computeWithIds(window, points);              // first window
+    for (...)
+    {
+        inc.update(entering, leaving, points);       // next window
+        if (inc.fit().isStable()) { ... }
+    }
+    \endcode
+
+    Subtractions accumulate rounding errors. The sums are thus recomputed from the current neighbors every
+    #recomputePeriod() removals, and when the neighborhood becomes empty.
+
+    Multi-pass fits (see #NEED_OTHER_PASS) are updated on their first pass only: the next passes visit all the current
+    neighbors when finalizing.
+
+    \tparam Fit Basket or BasketDiff type
+    \warning The weights of the neighbors must not change while they are in the neighborhood: the weighting function
+    and the basis center are fixed by #setWeightFunc and #init. For a neighborhood following a moving evaluation
+    position, select the neighbors with the window (e.g. using a ConstantWeightKernel with a scale covering the
+    windows), and call #init again to move the basis center when the window gets far from it.
+    \warning CPU only
+*/
+template <typename Fit>
+class IncrementalFit
+{
+public:
+    using DataPoint  = typename Fit::DataPoint;
+    using Scalar     = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+    using WFunctor   = typename Fit::WFunctor;
+
+    /// \brief Default number of removals between two full recomputations of the sums
+    static constexpr int DEFAULT_RECOMPUTE_PERIOD = 1024;
+
+    /// \brief Fit copying a value-initialized Basket, whose weighting function is set by #setWeightFunc
+    inline IncrementalFit() : m_prototype(), m_sums(), m_fit(), m_recomputePeriod(DEFAULT_RECOMPUTE_PERIOD) {}
+
+    /// \param prototype Basket copied for each computation, e.g. to set parameters of the fit
+    /// \param recomputePeriod Number of removals between two full recomputations of the sums
+    inline explicit IncrementalFit(const Fit& prototype, int recomputePeriod = DEFAULT_RECOMPUTE_PERIOD)
+        : m_prototype(prototype), m_sums(prototype), m_fit(prototype), m_recomputePeriod(recomputePeriod) {}
+
+    /// \brief Set the weighting function used by the next call to #init
+    inline void setWeightFunc(const WFunctor& w) { m_prototype.setWeightFunc(w); }
+
+    /// \brief Set the basis center and remove all the neighbors
+    inline void init(const VectorType& basisCenter);
+
+    /*!
+        \brief Replace the neighbors, and fit them from scratch
+
+        \param ids Indices of the neighbors, without duplicates
+        \param points Container of DataPoint, used by this call and the next updates
+        \return The state of the fit
+     */
+    template <typename IndexRange, typename PointContainer>
+    inline FIT_RESULT computeWithIds(const IndexRange& ids, const PointContainer& points);
+
+    /*!
+        \brief Update the fit from the neighbors entering and leaving the neighborhood
+
+        Recomputes the sums from scratch when #recomputePeriod() removals have been done since the last computation.
+
+        \param entering Indices of the new neighbors, not already in the neighborhood
+        \param leaving Indices of the neighbors to remove, currently in the neighborhood
+        \param points Container of DataPoint, the same as in the previous calls
+        \return The state of the fit
+     */
+    template <typename EnteringRange, typename LeavingRange, typename PointContainer>
+    inline FIT_RESULT update(const EnteringRange& entering, const LeavingRange& leaving, const PointContainer& points);
+
+    /// \brief Recompute the sums from the current neighbors, discarding the accumulated rounding errors
+    template <typename PointContainer>
+    inline FIT_RESULT recompute(const PointContainer& points);
+
+    /// \brief Finalized fit of the current neighborhood
+    inline const Fit& fit() const { return m_fit; }
+
+    /// \brief Indices of the current neighbors, in an unspecified order
+    inline const std::vector<int>& neighbors() const { return m_ids; }
+
+    /// \brief Number of removals since the sums were last computed from scratch
+    inline int removalsSinceRecompute() const { return m_removals; }
+
+    /// \brief Number of removals between two full recomputations of the sums
+    inline int recomputePeriod() const { return m_recomputePeriod; }
+    /// \brief Set the number of removals between two full recomputations of the sums
+    inline void setRecomputePeriod(int period) { PONCA_DEBUG_ASSERT(period > 0); m_recomputePeriod = period; }
+
+private:
+    /// \brief Finalize a copy of the sums, which remain ready for the next updates
+    template <typename PointContainer>
+    inline FIT_RESULT finalize(const PointContainer& points);
+
+    Fit m_prototype;                        ///< Basket with the weighting function, copied by each recomputation
+    Fit m_sums;                             ///< Sums of the first pass, updated incrementally
+    Fit m_fit;                              ///< Finalized copy of m_sums
+    VectorType m_basisCenter {VectorType::Zero()};
+    std::vector<int> m_ids;                 ///< Current neighbors
+    std::unordered_map<int, int> m_slots;   ///< Position of each neighbor in m_ids
+    int m_removals {0};                     ///< Removals since the last recomputation
+    int m_recomputePeriod;
+};
+
+#include "incrementalFit.hpp"
+
+} //namespace Ponca
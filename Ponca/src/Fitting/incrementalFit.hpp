@@ -0,0 +1,100 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+template <typename Fit>
+void
+IncrementalFit<Fit>::init(const VectorType& basisCenter)
+{
+    m_basisCenter = basisCenter;
+    m_sums = m_prototype;
+    m_sums.init(m_basisCenter);
+    m_fit = m_sums;
+    m_ids.clear();
+    m_slots.clear();
+    m_removals = 0;
+}
+
+template <typename Fit>
+template <typename IndexRange, typename PointContainer>
+FIT_RESULT
+IncrementalFit<Fit>::computeWithIds(const IndexRange& ids, const PointContainer& points)
+{
+    m_ids.clear();
+    m_slots.clear();
+    for (const auto& i : ids)
+    {
+        PONCA_DEBUG_ASSERT(m_slots.find(int(i)) == m_slots.end());
+        m_slots.emplace(int(i), int(m_ids.size()));
+        m_ids.push_back(int(i));
+    }
+    return recompute(points);
+}
+
+template <typename Fit>
+template <typename EnteringRange, typename LeavingRange, typename PointContainer>
+FIT_RESULT
+IncrementalFit<Fit>::update(const EnteringRange& entering, const LeavingRange& leaving, const PointContainer& points)
+{
+    for (const auto& i : leaving)
+    {
+        const auto it = m_slots.find(int(i));
+        PONCA_DEBUG_ASSERT(it != m_slots.end());
+        m_sums.removeNeighbor(points[i]);
+
+        // Swap with the last neighbor to remove in constant time
+        const int slot = it->second;
+        m_slots.erase(it);
+        if (slot != int(m_ids.size()) - 1)
+        {
+            m_ids[slot] = m_ids.back();
+            m_slots[m_ids[slot]] = slot;
+        }
+        m_ids.pop_back();
+        ++m_removals;
+    }
+    for (const auto& i : entering)
+    {
+        PONCA_DEBUG_ASSERT(m_slots.find(int(i)) == m_slots.end());
+        m_slots.emplace(int(i), int(m_ids.size()));
+        m_ids.push_back(int(i));
+        m_sums.addNeighbor(points[i]);
+    }
+
+    // Numerical drift safeguard
+    if (m_removals >= m_recomputePeriod || (m_removals > 0 && m_ids.empty()))
+        return recompute(points);
+    return finalize(points);
+}
+
+template <typename Fit>
+template <typename PointContainer>
+FIT_RESULT
+IncrementalFit<Fit>::recompute(const PointContainer& points)
+{
+    m_sums = m_prototype;
+    m_sums.init(m_basisCenter);
+    for (const int i : m_ids)
+        m_sums.addNeighbor(points[i]);
+    m_removals = 0;
+    return finalize(points);
+}
+
+template <typename Fit>
+template <typename PointContainer>
+FIT_RESULT
+IncrementalFit<Fit>::finalize(const PointContainer& points)
+{
+    m_fit = m_sums;
+    FIT_RESULT res = m_fit.finalize();
+    while (res == NEED_OTHER_PASS)
+    {
+        m_fit.startNewPass();
+        for (const int i : m_ids)
+            m_fit.addNeighbor(points[i]);
+        res = m_fit.finalize();
+    }
+    return res;
+}
@@ -32,6 +32,8 @@ namespace Ponca {
         PONCA_EXPLICIT_CAST_OPERATORS(MeanPosition,meanPosition)
         PONCA_FITTING_DECLARE_INIT
         PONCA_FITTING_DECLARE_ADDNEIGHBOR
+        PONCA_FITTING_DECLARE_REMOVENEIGHBOR
+        PONCA_FITTING_DECLARE_MERGE(MeanPosition)
 
         /// \brief Barycenter of the input points expressed in the global frame
         ///
@@ -87,6 +89,8 @@ namespace Ponca {
         PONCA_EXPLICIT_CAST_OPERATORS(MeanNormal,meanNormal)
         PONCA_FITTING_DECLARE_INIT
         PONCA_FITTING_DECLARE_ADDNEIGHBOR
+        PONCA_FITTING_DECLARE_REMOVENEIGHBOR
+        PONCA_FITTING_DECLARE_MERGE(MeanNormal)
 
         /// \brief Mean of the normals of the input points
         ///
@@ -117,6 +121,8 @@ namespace Ponca {
         PONCA_EXPLICIT_CAST_OPERATORS_DER(MeanPositionDer,meanPositionDer)
         PONCA_FITTING_DECLARE_INIT
         PONCA_FITTING_DECLARE_ADDNEIGHBOR_DER
+        PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+        PONCA_FITTING_DECLARE_MERGE(MeanPositionDer)
 
         /// \brief Compute derivatives of the barycenter (in local frame).
         /// \see MeanPosition::barycenterLocal()
@@ -165,6 +171,8 @@ namespace Ponca {
         PONCA_EXPLICIT_CAST_OPERATORS_DER(MeanNormalDer,meanNormalDer)
         PONCA_FITTING_DECLARE_INIT
         PONCA_FITTING_DECLARE_ADDNEIGHBOR_DER
+        PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+        PONCA_FITTING_DECLARE_MERGE(MeanNormalDer)
 
     /// \brief Compute the derivative of the mean normal vector of the input points. 
     /// 
@@ -26,6 +26,24 @@ MeanPosition<DataPoint, _WFunctor, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template<class DataPoint, class _WFunctor, typename T>
+void
+MeanPosition<DataPoint, _WFunctor, T>::removeLocalNeighbor(Scalar w,
+                                                           const VectorType &localQ,
+                                                           const DataPoint &attributes)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes);
+    m_sumP -= w * localQ;
+}
+
+template<class DataPoint, class _WFunctor, typename T>
+void
+MeanPosition<DataPoint, _WFunctor, T>::merge(const MeanPosition& other)
+{
+    Base::merge(other);
+    m_sumP += other.m_sumP;
+}
+
 template < class DataPoint, class _WFunctor, typename T>
 void
 MeanNormal<DataPoint, _WFunctor, T>::init(const VectorType& _evalPos)
@@ -47,6 +65,24 @@ MeanNormal<DataPoint, _WFunctor, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template<class DataPoint, class _WFunctor, typename T>
+void
+MeanNormal<DataPoint, _WFunctor, T>::removeLocalNeighbor(Scalar w,
+                                                         const VectorType &localQ,
+                                                         const DataPoint &attributes)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes);
+    m_sumN -= w * attributes.normal();
+}
+
+template<class DataPoint, class _WFunctor, typename T>
+void
+MeanNormal<DataPoint, _WFunctor, T>::merge(const MeanNormal& other)
+{
+    Base::merge(other);
+    m_sumN += other.m_sumN;
+}
+
 template<class DataPoint, class _WFunctor, int DiffType, typename T>
 void
 MeanPositionDer<DataPoint, _WFunctor, DiffType, T>::init(const VectorType &_evalPos) {
@@ -69,6 +105,25 @@ MeanPositionDer<DataPoint, _WFunctor, DiffType, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template<class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+MeanPositionDer<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                        const VectorType &localQ,
+                                                                        const DataPoint &attributes,
+                                                                        ScalarArray &dw)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes, dw);
+    m_dSumP -= localQ * dw;
+}
+
+template<class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+MeanPositionDer<DataPoint, _WFunctor, DiffType, T>::merge(const MeanPositionDer& other)
+{
+    Base::merge(other);
+    m_dSumP += other.m_dSumP;
+}
+
 
 template<class DataPoint, class _WFunctor, int DiffType, typename T>
 void
@@ -90,3 +145,22 @@ MeanNormalDer<DataPoint, _WFunctor, DiffType, T>::addLocalNeighbor(Scalar w,
 
     return false;
 }
+
+template<class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+MeanNormalDer<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                      const VectorType &localQ,
+                                                                      const DataPoint &attributes,
+                                                                      ScalarArray &dw)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes, dw);
+    m_dSumN -= attributes.normal() * dw;
+}
+
+template<class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+MeanNormalDer<DataPoint, _WFunctor, DiffType, T>::merge(const MeanNormalDer& other)
+{
+    Base::merge(other);
+    m_dSumN += other.m_dSumN;
+}
@@ -92,6 +92,8 @@ public:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS_DER(MlsSphereFitDer,mlsSphereFitDer)
     PONCA_FITTING_DECLARE_INIT_ADDDER_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+    PONCA_FITTING_DECLARE_MERGE(MlsSphereFitDer)
 
     //! \brief Returns the derivatives of the scalar field at the evaluation point
     //! \see method `#isSigned` of the fit to check if the sign is reliable
@@ -61,6 +61,53 @@ MlsSphereFitDer<DataPoint, _WFunctor, DiffType, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+MlsSphereFitDer<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                        const VectorType &localQ,
+                                                                        const DataPoint &attributes,
+                                                                        ScalarArray &dw)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes, dw);
+
+    // weight derivatives, as in addLocalNeighbor
+    Matrix d2w = Matrix::Zero();
+
+    if (Base::isScaleDer())
+        d2w(0,0) = Base::m_w.scaled2w(attributes.pos(), attributes);
+
+    if (Base::isSpaceDer())
+        d2w.template bottomRightCorner<Dim,Dim>() = Base::m_w.spaced2w(attributes.pos(), attributes);
+
+    if (Base::isScaleDer() && Base::isSpaceDer())
+    {
+        d2w.template bottomLeftCorner<Dim,1>() = Base::m_w.scaleSpaced2w(attributes.pos(),attributes);
+        d2w.template topRightCorner<1,Dim>() = d2w.template bottomLeftCorner<Dim,1>().transpose();
+    }
+
+    m_d2SumDotPN -= d2w * attributes.normal().dot(localQ);
+    m_d2SumDotPP -= d2w * localQ.squaredNorm();
+    m_d2SumW     -= d2w;
+
+    for(int i=0; i<Dim; ++i)
+    {
+        m_d2SumP.template block<DerDim,DerDim>(0,i*DerDim) -= d2w * localQ[i];
+        m_d2SumN.template block<DerDim,DerDim>(0,i*DerDim) -= d2w * attributes.normal()[i];
+    }
+}
+
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+MlsSphereFitDer<DataPoint, _WFunctor, DiffType, T>::merge(const MlsSphereFitDer& other)
+{
+    Base::merge(other);
+    m_d2SumDotPN += other.m_d2SumDotPN;
+    m_d2SumDotPP += other.m_d2SumDotPP;
+    m_d2SumW     += other.m_d2SumW;
+    m_d2SumP     += other.m_d2SumP;
+    m_d2SumN     += other.m_d2SumN;
+}
+
 template < class DataPoint, class _WFunctor, int DiffType, typename T>
 FIT_RESULT
 MlsSphereFitDer<DataPoint, _WFunctor, DiffType, T>::finalize()
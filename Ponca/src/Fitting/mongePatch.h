@@ -44,6 +44,8 @@ protected:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS(MongePatch,mongePatch)
     PONCA_FITTING_DECLARE_INIT_ADD_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR
+    PONCA_FITTING_DECLARE_MERGE(MongePatch)
 
     //! \brief Returns an estimate of the mean curvature
     PONCA_MULTIARCH inline Scalar kMean() const;
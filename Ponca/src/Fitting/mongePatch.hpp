@@ -41,6 +41,47 @@ MongePatch<DataPoint, _WFunctor, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template < class DataPoint, class _WFunctor, typename T>
+void
+MongePatch<DataPoint, _WFunctor, T>::removeLocalNeighbor(Scalar w,
+                                                         const VectorType &localQ,
+                                                         const DataPoint &attributes)
+{
+    // Remove from the accumulation of the current pass, see addLocalNeighbor
+    if(! m_planeIsReady)
+    {
+        Base::removeLocalNeighbor(w, localQ, attributes);
+    }
+    else
+    {
+        const VectorType local = Base::worldToTangentPlane(attributes.pos());
+        const Scalar& h = *(local.data());
+        const Scalar& u = *(local.data()+1);
+        const Scalar& v = *(local.data()+2);
+
+        Eigen::Matrix<Scalar, 6, 1 > p;
+        p << u*u, v*v, u*v, u, v, 1;
+        m_A -= w*p*p.transpose();
+        m_b -= w*h*p;
+    }
+}
+
+template < class DataPoint, class _WFunctor, typename T>
+void
+MongePatch<DataPoint, _WFunctor, T>::merge(const MongePatch& other)
+{
+    // Merge the accumulation of the current pass, see addLocalNeighbor
+    if(! m_planeIsReady)
+    {
+        Base::merge(other);
+    }
+    else
+    {
+        m_A += other.m_A;
+        m_b += other.m_b;
+    }
+}
+
 template < class DataPoint, class _WFunctor, typename T>
 FIT_RESULT
 MongePatch<DataPoint, _WFunctor, T>::finalize ()
@@ -0,0 +1,102 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./defines.h"
+#include "./enums.h"
+#include "../Common/Assert.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace Ponca
+{
+
+/*!
+    \brief Fit a Basket at several scales from a single neighborhood query
+
+    Instead of running one range query and one fit per scale, MultiScaleFit queries the neighbors of the evaluation
+    position once, at the largest scale \f$ t_{max} \f$, and sorts them by distance. Each scale \f$ t \f$ then visits
+    the sorted neighbors until their distance exceeds \f$ t \f$: the neighbors that have a zero weight at the smaller
+    scales are never given to the fit. Multiple passes (see #NEED_OTHER_PASS) replay the same sorted neighbors.
+
+    \code
+    std::vector<Scalar> scales {0.1, 0.2, 0.4, 0.8};     // increasing
+    MultiScaleFit<Fit> msf;
+    msf.compute(tree, p, scales);
+    for (int s = 0; s < msf.size(); ++s)
+        if (msf[s].isStable()) std::cout << msf[s].kappa() << std::endl;
+    \endcode
+
+    The neighbors buffer and the fits are reused by the next calls: a MultiScaleFit per thread avoids allocations when
+    processing many positions (see FitBatch::computeMultiScale).
+
+    Results are the same as fitting each scale independently, up to the rounding errors due to the order of the
+    neighbors.
+
+    \tparam Fit Basket or BasketDiff type, using a weighting function that is zero beyond its scale, e.g.
+    DistWeightFunc
+    \warning CPU only
+*/
+template <typename Fit>
+class MultiScaleFit
+{
+public:
+    using DataPoint  = typename Fit::DataPoint;
+    using Scalar     = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+    using WFunctor   = typename Fit::WFunctor;
+
+    /// \brief Fits copying a value-initialized Basket
+    inline MultiScaleFit() : m_prototype() {}
+
+    /// \param prototype Basket copied for each scale, e.g. to set parameters of the fit before the computation
+    inline explicit MultiScaleFit(const Fit& prototype) : m_prototype(prototype) {}
+
+    /*!
+        \brief Fit the Basket at each scale, with the neighbors of `pos` in a kd-tree
+
+        \param tree Spatial structure providing `points()` and `range_neighbors(VectorType, Scalar)`, e.g. KdTree
+        \param pos Evaluation position
+        \param scales Container of strictly positive scales, sorted by increasing value
+        \return The number of scales where the fit is stable
+     */
+    template <typename Tree, typename ScaleContainer>
+    inline int compute(const Tree& tree, const VectorType& pos, const ScaleContainer& scales);
+
+    /*!
+        \brief Fit the Basket at each scale, with neighbors given as indices in a point container
+
+        \param ids Indices of the neighbors of `pos` within the largest scale, in any order
+        \param points Container of DataPoint
+        \param pos Evaluation position
+        \param scales Container of strictly positive scales, sorted by increasing value
+        \return The number of scales where the fit is stable
+     */
+    template <typename IndexRange, typename PointContainer, typename ScaleContainer>
+    inline int computeWithIds(IndexRange ids, const PointContainer& points, const VectorType& pos,
+                              const ScaleContainer& scales);
+
+    /// \brief Number of scales of the last computation
+    inline int size() const { return m_size; }
+    /// \brief Fit at the scale `s` of the last computation
+    inline const Fit& operator[](int s) const { return m_fits[s]; }
+
+    /// \brief Number of neighbors within the largest scale, found by the last computation
+    inline int neighborCount() const { return int(m_neighbors.size()); }
+
+private:
+    Fit m_prototype;
+    std::vector<Fit> m_fits;                          ///< One fit per scale, reused by the next computations
+    int m_size {0};                                   ///< Number of scales of the last computation
+    std::vector<std::pair<Scalar, int>> m_neighbors;  ///< Distance and index of the neighbors, sorted by distance
+};
+
+#include "multiScaleFit.hpp"
+
+} //namespace Ponca
@@ -0,0 +1,57 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+template <typename Fit>
+template <typename Tree, typename ScaleContainer>
+int
+MultiScaleFit<Fit>::compute(const Tree& tree, const VectorType& pos, const ScaleContainer& scales)
+{
+    const Scalar tmax = scales.size() == 0 ? Scalar(0) : *(std::end(scales) - 1);
+    return computeWithIds(tree.range_neighbors(pos, tmax), tree.points(), pos, scales);
+}
+
+template <typename Fit>
+template <typename IndexRange, typename PointContainer, typename ScaleContainer>
+int
+MultiScaleFit<Fit>::computeWithIds(IndexRange ids, const PointContainer& points, const VectorType& pos,
+                                   const ScaleContainer& scales)
+{
+    PONCA_DEBUG_ASSERT(std::is_sorted(std::begin(scales), std::end(scales)));
+
+    // Single traversal of the neighborhood at the largest scale, sorted by distance
+    m_neighbors.clear();
+    for (const auto& i : ids)
+        m_neighbors.emplace_back((points[i].pos() - pos).norm(), int(i));
+    std::sort(m_neighbors.begin(), m_neighbors.end());
+
+    m_size = int(scales.size());
+    if (int(m_fits.size()) < m_size)
+        m_fits.resize(m_size, m_prototype);
+
+    int stableCount = 0;
+    int s = 0;
+    for (const Scalar t : scales)
+    {
+        PONCA_DEBUG_ASSERT(t > Scalar(0));
+        Fit& fit = m_fits[s++];
+        fit = m_prototype;
+        fit.setWeightFunc(WFunctor(t));
+        fit.init(pos);
+
+        // Neighbors further than t have a zero weight, and are not visited
+        const auto last = std::upper_bound(m_neighbors.begin(), m_neighbors.end(), t,
+                                           [](Scalar d, const std::pair<Scalar, int>& n) { return d < n.first; });
+        FIT_RESULT res = UNDEFINED;
+        do {
+            fit.startNewPass();
+            for (auto it = m_neighbors.begin(); it != last; ++it)
+                fit.addNeighbor(points[it->second]);
+            res = fit.finalize();
+        } while (res == NEED_OTHER_PASS);
+        if (res == STABLE) ++stableCount;
+    }
+    return stableCount;
+}
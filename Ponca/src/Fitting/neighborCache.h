@@ -0,0 +1,227 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./enums.h"
+#include "../Common/Assert.h"
+#include "../Common/cpuDispatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace Ponca
+{
+template <class DataPoint, class WeightKernel> class DistWeightFunc;
+
+namespace internal
+{
+
+/*!
+ * \brief Neighbors recorded by the first pass of Basket::computeWithIds, replayed by the next passes
+ *
+ * Stores the indices of the neighbors with a non-zero weight and, with #CACHE_WEIGHTS, their weights and positions
+ * in the local basis. Buffers are owned by the calling thread and reused by the next computations: once they reached
+ * the size of the largest neighborhood, recording does not allocate anymore.
+ *
+ * A buffer can only be used by one computation at a time: nested computations take another buffer from the pool.
+ *
+ * \see NeighborCache
+ */
+template <typename DataPoint>
+class NeighborCacheBuffer
+{
+public:
+    using Scalar     = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+
+    /// \brief Buffer owned by the calling thread and not in use
+    static inline NeighborCacheBuffer& thread_buffer()
+    {
+        thread_local std::vector<std::unique_ptr<NeighborCacheBuffer>> pool;
+        for (const auto& buffer : pool)
+            if (!buffer->m_busy) return *buffer;
+        pool.push_back(std::make_unique<NeighborCacheBuffer>());
+        return *pool.back();
+    }
+
+    /// \brief Mark the buffer as used by a computation, and remove the neighbors of the previous one
+    inline void acquire()
+    {
+        PONCA_DEBUG_ASSERT(!m_busy);
+        m_busy = true;
+        ids.clear();
+        weights.clear();
+        localQs.clear();
+    }
+
+    /// \brief Make the buffer available to the next computations
+    inline void release() { m_busy = false; }
+
+    std::vector<int> ids;            ///< Indices of the neighbors with a non-zero weight
+    std::vector<Scalar> weights;     ///< Weights of the neighbors (#CACHE_WEIGHTS only)
+    std::vector<VectorType> localQs; ///< Positions of the neighbors in the local basis (#CACHE_WEIGHTS only)
+
+private:
+    bool m_busy {false};
+};
+
+/// Kernel of neighbor_weights
+template <typename WeightFunc, typename PointContainer>
+struct NeighborWeightsKernel
+{
+    using Scalar     = typename WeightFunc::Scalar;
+    using VectorType = typename WeightFunc::VectorType;
+
+    PONCA_FORCE_INLINE static void run(const WeightFunc* w, const PointContainer* points, const int* ids,
+                                       std::size_t count, Scalar* weights, VectorType* localQs)
+    {
+        for (std::size_t m = 0; m < count; ++m)
+        {
+            const auto& nei = (*points)[ids[m]];
+            const auto res  = w->w(nei.pos(), nei);
+            weights[m] = res.first;
+            localQs[m] = res.second;
+        }
+    }
+};
+
+/// \brief Kernel of neighbor_weights for DistWeightFunc
+///
+/// The positions of a block of neighbors are copied to a structure of arrays, so that the local positions and the
+/// distances are computed by vector instructions. The weighting function is not called, since the Eigen packets it is
+/// made of cannot be vectorized across neighbors.
+template <typename DataPoint, typename WeightKernel, typename PointContainer>
+struct NeighborWeightsKernel<DistWeightFunc<DataPoint, WeightKernel>, PointContainer>
+{
+    using WeightFunc = DistWeightFunc<DataPoint, WeightKernel>;
+    using Scalar     = typename WeightFunc::Scalar;
+    using VectorType = typename WeightFunc::VectorType;
+
+    static constexpr int Dim = DataPoint::Dim;
+    static constexpr std::size_t BLOCK_SIZE = 16;
+
+    PONCA_FORCE_INLINE static void run(const WeightFunc* w, const PointContainer* points, const int* ids,
+                                       std::size_t count, Scalar* weights, VectorType* localQs)
+    {
+        const Scalar t = w->evalScale();
+        const VectorType& center = w->basisCenter();
+        const WeightKernel& wk = w->weightKernel();
+
+        Scalar q[Dim * BLOCK_SIZE];
+        Scalar d[BLOCK_SIZE];
+        for (std::size_t b = 0; b < count; b += BLOCK_SIZE)
+        {
+            const std::size_t block = std::min(BLOCK_SIZE, count - b);
+            for (std::size_t m = 0; m < block; ++m)
+            {
+                const VectorType& p = (*points)[ids[b + m]].pos();
+                for (int k = 0; k < Dim; ++k)
+                    q[k * BLOCK_SIZE + m] = p[k] - center[k];
+            }
+            for (std::size_t m = 0; m < block; ++m)
+                d[m] = Scalar(0);
+            for (int k = 0; k < Dim; ++k)
+                for (std::size_t m = 0; m < block; ++m)
+                    d[m] += q[k * BLOCK_SIZE + m] * q[k * BLOCK_SIZE + m];
+            // Same expression as DistWeightFunc::w
+            for (std::size_t m = 0; m < block; ++m)
+            {
+                const Scalar n = std::sqrt(d[m]);
+                weights[b + m] = (n <= t) ? wk.f(n / t) : Scalar(0.);
+            }
+            for (std::size_t m = 0; m < block; ++m)
+                for (int k = 0; k < Dim; ++k)
+                    localQs[b + m][k] = q[k * BLOCK_SIZE + m];
+        }
+    }
+};
+
+/// \brief Evaluate the weights and local positions of the neighbors `points[ids[m]]`, for `m` in `[0, count)`
+///
+/// Versions for AVX2 and AVX-512 are selected at runtime when available (see SimdDispatch).
+template <typename WeightFunc, typename PointContainer>
+inline void neighbor_weights(const WeightFunc& w, const PointContainer& points, const int* ids, std::size_t count,
+                             typename WeightFunc::Scalar* weights, typename WeightFunc::VectorType* localQs)
+{
+    SimdDispatch<NeighborWeightsKernel<WeightFunc, PointContainer>>::run(&w, &points, ids, count, weights, localQs);
+}
+
+/// \brief Implementation of Basket::computeWithIds(IndexRange,const PointContainer&,NeighborCache)
+template <typename Fit, typename IndexRange, typename PointContainer>
+inline FIT_RESULT computeWithNeighborCache(Fit& fit, const IndexRange& ids, const PointContainer& points,
+                                           NeighborCache cache)
+{
+    using Buffer = NeighborCacheBuffer<typename Fit::DataPoint>;
+    using Scalar = typename Fit::Scalar;
+
+    if (cache == NO_CACHE)
+        return fit.computeWithIds(ids, points);
+
+    // Released when leaving the function, including by an exception
+    struct Lease {
+        Buffer& b;
+        ~Lease() { b.release(); }
+    } lease {Buffer::thread_buffer()};
+    Buffer& buffer = lease.b;
+    buffer.acquire();
+
+    // First pass: traverse the range, and record the neighbors with a non-zero weight
+    fit.startNewPass();
+    if (cache == CACHE_WEIGHTS)
+    {
+        // The weights of the whole range are evaluated at once, by the kernel dispatched at runtime
+        for (const auto& i : ids)
+            buffer.ids.push_back(int(i));
+        const std::size_t n = buffer.ids.size();
+        buffer.weights.resize(n);
+        buffer.localQs.resize(n);
+        neighbor_weights(fit.getWeightFunc(), points, buffer.ids.data(), n,
+                         buffer.weights.data(), buffer.localQs.data());
+
+        std::size_t kept = 0;
+        for (std::size_t k = 0; k < n; ++k)
+        {
+            if (!(buffer.weights[k] > Scalar(0.))) continue;
+            fit.addWeightedNeighbor(buffer.weights[k], buffer.localQs[k], points[buffer.ids[k]]);
+            buffer.ids[kept]     = buffer.ids[k];
+            buffer.weights[kept] = buffer.weights[k];
+            buffer.localQs[kept] = buffer.localQs[k];
+            ++kept;
+        }
+        buffer.ids.resize(kept);
+        buffer.weights.resize(kept);
+        buffer.localQs.resize(kept);
+    }
+    else
+    {
+        for (const auto& i : ids)
+            if (fit.addNeighbor(points[i]))
+                buffer.ids.push_back(int(i));
+    }
+    FIT_RESULT res = fit.finalize();
+
+    // Next passes: replay the recorded neighbors
+    while (res == NEED_OTHER_PASS)
+    {
+        fit.startNewPass();
+        const int n = int(buffer.ids.size());
+        if (cache == CACHE_WEIGHTS)
+            for (int k = 0; k < n; ++k)
+                fit.addWeightedNeighbor(buffer.weights[k], buffer.localQs[k], points[buffer.ids[k]]);
+        else
+            for (int k = 0; k < n; ++k)
+                fit.addNeighbor(points[buffer.ids[k]]);
+        res = fit.finalize();
+    }
+    return res;
+}
+
+} // namespace internal
+} // namespace Ponca
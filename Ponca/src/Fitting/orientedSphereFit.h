@@ -43,6 +43,8 @@ protected:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS(OrientedSphereFitImpl,orientedSphereFit)
     PONCA_FITTING_DECLARE_INIT_ADD_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR
+    PONCA_FITTING_DECLARE_MERGE(OrientedSphereFitImpl)
     PONCA_FITTING_IS_SIGNED(true)
 }; //class OrientedSphereFitImpl
 
@@ -91,6 +93,8 @@ public:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS_DER(OrientedSphereDerImpl,orientedSphereDer)
     PONCA_FITTING_DECLARE_INIT_ADDDER_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+    PONCA_FITTING_DECLARE_MERGE(OrientedSphereDerImpl)
 
     /*! \brief Returns the derivatives of the scalar field at the evaluation point */
     PONCA_MULTIARCH inline ScalarArray dPotential() const;
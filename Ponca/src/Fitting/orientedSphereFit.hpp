@@ -31,6 +31,26 @@ OrientedSphereFitImpl<DataPoint, _WFunctor, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template<class DataPoint, class _WFunctor, typename T>
+void
+OrientedSphereFitImpl<DataPoint, _WFunctor, T>::removeLocalNeighbor(Scalar w,
+                                                                    const VectorType &localQ,
+                                                                    const DataPoint &attributes)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes);
+    m_sumDotPN -= w * attributes.normal().dot(localQ);
+    m_sumDotPP -= w * localQ.squaredNorm();
+}
+
+template<class DataPoint, class _WFunctor, typename T>
+void
+OrientedSphereFitImpl<DataPoint, _WFunctor, T>::merge(const OrientedSphereFitImpl& other)
+{
+    Base::merge(other);
+    m_sumDotPN += other.m_sumDotPN;
+    m_sumDotPP += other.m_sumDotPP;
+}
+
 
 template < class DataPoint, class _WFunctor, typename T>
 FIT_RESULT
@@ -117,6 +137,29 @@ OrientedSphereDerImpl<DataPoint, _WFunctor, DiffType, T>::addLocalNeighbor(Scala
     return false;
 }
 
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+OrientedSphereDerImpl<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                              const VectorType &localQ,
+                                                                              const DataPoint &attributes,
+                                                                              ScalarArray &dw)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes, dw);
+    m_dSumN     -= attributes.normal() * dw;
+    m_dSumDotPN -= dw * attributes.normal().dot(localQ);
+    m_dSumDotPP -= dw * localQ.squaredNorm();
+}
+
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+OrientedSphereDerImpl<DataPoint, _WFunctor, DiffType, T>::merge(const OrientedSphereDerImpl& other)
+{
+    Base::merge(other);
+    m_dSumN     += other.m_dSumN;
+    m_dSumDotPN += other.m_dSumDotPN;
+    m_dSumDotPP += other.m_dSumDotPP;
+}
+
 
 template < class DataPoint, class _WFunctor, int DiffType, typename T>
 FIT_RESULT
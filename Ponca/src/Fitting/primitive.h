@@ -117,6 +117,18 @@ public:
         return true;
     }
 
+    PONCA_FITTING_APIDOC_REMOVENEIGHBOR
+    PONCA_MULTIARCH inline void removeLocalNeighbor(Scalar w, const VectorType &, const DataPoint &) {
+        m_sumW -= w;
+        --(m_nbNeighbors);
+    }
+
+    PONCA_FITTING_APIDOC_MERGE
+    PONCA_MULTIARCH inline void merge(const PrimitiveBase& other) {
+        m_sumW += other.m_sumW;
+        m_nbNeighbors += other.m_nbNeighbors;
+    }
+
     PONCA_FITTING_APIDOC_FINALIZE
     PONCA_MULTIARCH inline FIT_RESULT finalize(){
         // handle specific configurations
@@ -214,6 +226,28 @@ public:
         return false;
     }
 
+    PONCA_FITTING_APIDOC_REMOVENEIGHBOR_DER
+    PONCA_MULTIARCH inline void removeLocalNeighbor(Scalar w,
+                                                    const VectorType &localQ,
+                                                    const DataPoint &attributes,
+                                                    ScalarArray &dw)
+    {
+        Base::removeLocalNeighbor(w, localQ, attributes);
+        int spaceId = (Type & FitScaleDer) ? 1 : 0;
+        // compute weight, as in addLocalNeighbor
+        if (Type & FitScaleDer)
+            dw[0] = Base::m_w.scaledw(attributes.pos(), attributes);
+
+        if (Type & FitSpaceDer)
+            dw.template segment<int(DataPoint::Dim)>(spaceId) = -Base::m_w.spacedw(attributes.pos(), attributes).transpose();
+
+        m_dSumW -= dw;
+    }
+
+    PONCA_FITTING_APIDOC_MERGE
+    PONCA_MULTIARCH inline void merge(const PrimitiveDer& other)
+    { Base::merge(other); m_dSumW += other.m_dSumW; }
+
     /**************************************************************************/
     /* Use results                                                            */
     /**************************************************************************/
@@ -78,6 +78,8 @@ protected:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS(SphereFitImpl,sphereFit)
     PONCA_FITTING_DECLARE_INIT_ADD_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR
+    PONCA_FITTING_DECLARE_MERGE(SphereFitImpl)
     PONCA_FITTING_IS_SIGNED(false)
 
     PONCA_MULTIARCH inline const Solver& solver() const { return m_solver; }
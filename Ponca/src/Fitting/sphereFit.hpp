@@ -35,6 +35,32 @@ SphereFitImpl<DataPoint, _WFunctor, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template < class DataPoint, class _WFunctor, typename T>
+void
+SphereFitImpl<DataPoint, _WFunctor, T>::removeLocalNeighbor(Scalar w,
+                                                            const VectorType &localQ,
+                                                            const DataPoint &attributes)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes);
+    VectorA a;
+#ifdef __CUDACC__
+    a(0) = 1;
+    a.template segment<DataPoint::Dim>(1) = localQ;
+    a(DataPoint::Dim+1) = localQ.squaredNorm();
+#else
+    a << 1, localQ, localQ.squaredNorm();
+#endif
+    m_matA -= w * a * a.transpose();
+}
+
+template < class DataPoint, class _WFunctor, typename T>
+void
+SphereFitImpl<DataPoint, _WFunctor, T>::merge(const SphereFitImpl& other)
+{
+    Base::merge(other);
+    m_matA += other.m_matA;
+}
+
 
 template < class DataPoint, class _WFunctor, typename T>
 FIT_RESULT
@@ -64,6 +64,8 @@ public:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS(UnorientedSphereFitImpl,unorientedSphereFit)
     PONCA_FITTING_DECLARE_INIT_ADD_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR
+    PONCA_FITTING_DECLARE_MERGE(UnorientedSphereFitImpl)
     PONCA_FITTING_IS_SIGNED(false)
 
 }; // class UnorientedSphereFitImpl
@@ -111,6 +113,8 @@ public:
 public:
     PONCA_EXPLICIT_CAST_OPERATORS_DER(UnorientedSphereDerImpl,unorientedSphereDer)
     PONCA_FITTING_DECLARE_INIT_ADDDER_FINALIZE
+    PONCA_FITTING_DECLARE_REMOVENEIGHBOR_DER
+    PONCA_FITTING_DECLARE_MERGE(UnorientedSphereDerImpl)
 
     PONCA_MULTIARCH inline ScalarArray dPotential() const;
     PONCA_MULTIARCH inline VectorArray dNormal() const;
@@ -36,6 +36,29 @@ UnorientedSphereFitImpl<DataPoint, _WFunctor, T>::addLocalNeighbor(Scalar w,
     return false;
 }
 
+template<class DataPoint, class _WFunctor, typename T>
+void
+UnorientedSphereFitImpl<DataPoint, _WFunctor, T>::removeLocalNeighbor(Scalar w,
+                                                                      const VectorType &localQ,
+                                                                      const DataPoint &attributes)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes);
+    VectorB basis;
+    basis << attributes.normal(), attributes.normal().dot(localQ);
+
+    m_matA     -= w * basis * basis.transpose();
+    m_sumDotPP -= w * localQ.squaredNorm();
+}
+
+template<class DataPoint, class _WFunctor, typename T>
+void
+UnorientedSphereFitImpl<DataPoint, _WFunctor, T>::merge(const UnorientedSphereFitImpl& other)
+{
+    Base::merge(other);
+    m_matA     += other.m_matA;
+    m_sumDotPP += other.m_sumDotPP;
+}
+
 template < class DataPoint, class _WFunctor, typename T>
 FIT_RESULT
 UnorientedSphereFitImpl<DataPoint, _WFunctor, T>::finalize ()
@@ -120,6 +143,33 @@ UnorientedSphereDerImpl<DataPoint, _WFunctor, DiffType, T>::addLocalNeighbor(
     return false;
 }
 
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+UnorientedSphereDerImpl<DataPoint, _WFunctor, DiffType, T>::removeLocalNeighbor(Scalar w,
+                                                                                const VectorType &localQ,
+                                                                                const DataPoint &attributes,
+                                                                                ScalarArray &dw)
+{
+    Base::removeLocalNeighbor(w, localQ, attributes, dw);
+    VectorB basis;
+    basis << attributes.normal(), attributes.normal().dot(localQ);
+    const MatrixBB prod = basis * basis.transpose();
+
+    m_dSumDotPP -= dw * localQ.squaredNorm();
+    for(int dim = 0; dim < Base::NbDerivatives; ++dim)
+        m_dmatA[dim] -= dw[dim] * prod;
+}
+
+template < class DataPoint, class _WFunctor, int DiffType, typename T>
+void
+UnorientedSphereDerImpl<DataPoint, _WFunctor, DiffType, T>::merge(const UnorientedSphereDerImpl& other)
+{
+    Base::merge(other);
+    m_dSumDotPP += other.m_dSumDotPP;
+    for(int dim = 0; dim < Base::NbDerivatives; ++dim)
+        m_dmatA[dim] += other.m_dmatA[dim];
+}
+
 template < class DataPoint, class _WFunctor, int DiffType, typename T>
 FIT_RESULT
 UnorientedSphereDerImpl<DataPoint, _WFunctor, DiffType, T>::finalize()
@@ -201,6 +201,9 @@ public:
     /*! \brief Access to the evaluation position set during the initialization */
     PONCA_MULTIARCH inline const VectorType & evalPos() const { return m_p; }
 
+    /*! \brief Access to the 1D function applied to the distances */
+    PONCA_MULTIARCH inline const WeightKernel& weightKernel() const { return m_wk; }
+
 protected:
     Scalar       m_t;  /*!< \brief Evaluation scale */
     WeightKernel m_wk; /*!< \brief 1D function applied to weight queries */
@@ -0,0 +1,100 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "../../../Common/Macro.h"
+#include "../../../Common/cpuDispatch.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace Ponca {
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /// Kernel of squared_distances_soa
+    template <int Dim, typename Scalar>
+    struct SquaredDistancesSoaKernel
+    {
+        PONCA_FORCE_INLINE static void run(const Scalar* coords, std::size_t stride, std::size_t count,
+                                           const Scalar* query, Scalar* out)
+        {
+            for (std::size_t m = 0; m < count; ++m)
+                out[m] = Scalar(0);
+            for (int d = 0; d < Dim; ++d)
+            {
+                const Scalar* c = coords + std::size_t(d) * stride;
+                const Scalar q = query[d];
+                for (std::size_t m = 0; m < count; ++m)
+                {
+                    const Scalar t = c[m] - q;
+                    out[m] += t * t;
+                }
+            }
+        }
+    };
+
+    /// \brief Squared distances between `query` and a block of candidates stored as one coordinate array per dimension
+    ///
+    /// The coordinate `d` of the candidate `m` is `coords[d * stride + m]`. The loops have no dependency between
+    /// candidates, so that they are vectorized by the compiler. Versions for AVX2 and AVX-512 are selected at runtime
+    /// when available (see SimdDispatch).
+    ///
+    /// \param count Number of candidates of the block
+    /// \param out Squared distances, of size `count`
+    template <int Dim, typename Scalar>
+    inline void squared_distances_soa(const Scalar* coords, std::size_t stride, std::size_t count,
+                                      const Scalar* query, Scalar* out)
+    {
+        SimdDispatch<SquaredDistancesSoaKernel<Dim, Scalar>>::run(coords, stride, count, query, out);
+    }
+
+    /// Kernel of squared_distances_gather
+    template <typename DataPoint, typename IndexType>
+    struct SquaredDistancesGatherKernel
+    {
+        using Scalar = typename DataPoint::Scalar;
+        static constexpr int Dim = DataPoint::Dim;
+        /// Number of candidates copied at once in the structure of arrays
+        static constexpr std::size_t BLOCK_SIZE = 16;
+
+        PONCA_FORCE_INLINE static void run(const DataPoint* points, const IndexType* indices, std::size_t count,
+                                           const Scalar* query, Scalar* out)
+        {
+            // The coordinates are first copied in a structure of arrays: the loads of the points are not contiguous,
+            // but the distances are then computed with vector instructions
+            Scalar coords[Dim * BLOCK_SIZE];
+            for (std::size_t b = 0; b < count; b += BLOCK_SIZE)
+            {
+                const std::size_t block = std::min(BLOCK_SIZE, count - b);
+                for (std::size_t m = 0; m < block; ++m)
+                {
+                    const auto& p = points[indices[b + m]].pos();
+                    for (int d = 0; d < Dim; ++d)
+                        coords[std::size_t(d) * BLOCK_SIZE + m] = p[d];
+                }
+                SquaredDistancesSoaKernel<Dim, Scalar>::run(coords, BLOCK_SIZE, block, query, out + b);
+            }
+        }
+    };
+
+    /// \brief Squared distances between `query` and the points `points[indices[m]]`, for `m` in `[0, count)`
+    ///
+    /// Used by the leaf scans of the kd-tree queries, one block of samples at a time. Versions for AVX2 and AVX-512
+    /// are selected at runtime when available (see SimdDispatch).
+    ///
+    /// \param out Squared distances, of size `count`
+    template <typename DataPoint, typename IndexType>
+    inline void squared_distances_gather(const DataPoint* points, const IndexType* indices, std::size_t count,
+                                         const typename DataPoint::Scalar* query, typename DataPoint::Scalar* out)
+    {
+        SimdDispatch<SquaredDistancesGatherKernel<DataPoint, IndexType>>::run(points, indices, count, query, out);
+    }
+}
+#endif
+} // namespace Ponca
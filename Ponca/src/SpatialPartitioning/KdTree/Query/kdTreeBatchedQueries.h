@@ -0,0 +1,274 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "../../indexSquaredDistance.h"
+#include "../../../Common/Containers/limitedPriorityQueue.h"
+#include "../../../Common/Containers/stack.h"
+#include "../../../Common/Macro.h"
+#include "./kdTreeQuery.h"
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace Ponca {
+template <typename Traits> class KdTreeBase;
+
+/*!
+ * \brief Batched kd-tree queries, interleaving the traversals of several queries to hide memory latency
+ *
+ * A single query stalls each time it loads a node or the points of a leaf that are not in cache. This class keeps
+ * `GroupSize` queries in flight and advances them in round-robin. Each step expands one node (or scans one leaf) of a
+ * query, and prefetches the memory needed by its next step before switching to the next query. The loads of the
+ * different queries then overlap, which is mostly useful for trees that do not fit in the last-level cache.
+ *
+ * Each query performs the same traversal as the standard queries, so the results are identical, in the same order.
+ * Leaf scans use the same reduced precision filter (see KdTreeBase::set_reduced_precision) and record the same query
+ * statistics (see KdTreeCountQueryStatsPolicy) as KdTreeQuery.
+ *
+ * \tparam GroupSize Number of queries in flight, typically 8 to 16
+ * \see KdTreeBase::batch_k_nearest_neighbors, KdTreeBase::batch_range_neighbors
+ */
+template <typename Traits, int GroupSize = 8>
+class KdTreeBatchedQuery : public KdTreeQuery<Traits>
+{
+public:
+    using Base = KdTreeQuery<Traits>;
+    using DataPoint  = typename Traits::DataPoint;
+    using IndexType  = typename Traits::IndexType;
+    using Scalar     = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+
+    static_assert(GroupSize > 0, "At least one query must be in flight");
+
+    explicit inline KdTreeBatchedQuery(const KdTreeBase<Traits>* kdtree) : Base(kdtree) {}
+
+    /// \brief Compute the k-nearest neighbors of each input
+    ///
+    /// \param inputs Random access container of point indices or of positions
+    /// \param f Functor called as `f(i, neighbors)` when the search of `inputs[i]` is complete, where `neighbors` is
+    /// a `std::vector<IndexType>` sorted by increasing distance
+    template <typename InputContainer, typename NeighborFunctor>
+    inline void k_nearest_neighbors(const InputContainer& inputs, IndexType k, NeighborFunctor f)
+    {
+        std::array<KNearestOutput, GroupSize> outputs;
+        for (auto& o : outputs) o.queue.reserve(k);
+        run(inputs, outputs, f);
+    }
+
+    /// \brief Compute the neighbors of each input in the ball of radius `r`
+    ///
+    /// \param inputs Random access container of point indices or of positions
+    /// \param f Functor called as `f(i, neighbors)` when the search of `inputs[i]` is complete, where `neighbors` is
+    /// a `std::vector<IndexType>` in traversal order
+    template <typename InputContainer, typename NeighborFunctor>
+    inline void range_neighbors(const InputContainer& inputs, Scalar r, NeighborFunctor f)
+    {
+        std::array<RangeOutput, GroupSize> outputs;
+        for (auto& o : outputs) o.squared_radius = r * r;
+        run(inputs, outputs, f);
+    }
+
+protected:
+    using ReducedPrecisionFilter = typename Base::ReducedPrecisionFilter;
+
+    /// Neighbors of a k-nearest neighbors search, same semantics as QueryOutputIsKNearest
+    struct KNearestOutput
+    {
+        limited_priority_queue<IndexSquaredDistance<IndexType, Scalar>> queue;
+
+        inline void reset()
+        {
+            queue.clear();
+            queue.push({-1, std::numeric_limits<Scalar>::max()});
+        }
+        inline Scalar threshold() const { return queue.bottom().squared_distance; }
+        inline void push(IndexType idx, Scalar d) { queue.push({idx, d}); }
+        inline void write(std::vector<IndexType>& neighbors) const
+        {
+            neighbors.clear();
+            for (const auto& n : queue)
+                if (n.index >= 0) neighbors.push_back(n.index);
+        }
+    };
+
+    /// Neighbors of a range search, same semantics as QueryOutputIsRange
+    struct RangeOutput
+    {
+        std::vector<IndexType> neighbors;
+        Scalar squared_radius {0};
+
+        inline void reset() { neighbors.clear(); }
+        inline Scalar threshold() const { return squared_radius; }
+        inline void push(IndexType idx, Scalar) { neighbors.push_back(idx); }
+        inline void write(std::vector<IndexType>& out) { out.swap(neighbors); }
+    };
+
+    /// Traversal state of a query in flight
+    struct Slot
+    {
+        enum class Phase { Descend, LeafIndices, LeafPoints };
+
+        Stack<IndexSquaredDistance<IndexType, Scalar>, 2 * Traits::MAX_DEPTH> stack;
+        VectorType point;
+        ReducedPrecisionFilter filter;
+        IndexType skip {-1};        ///< Index of the query point, -1 for position queries
+        std::size_t input {0};      ///< Position of the query in the inputs
+        IndexType leaf_start {0}, leaf_end {0};
+        Phase phase {Phase::Descend};
+        bool active {false};
+    };
+
+    template <typename InputContainer, typename OutputArray, typename NeighborFunctor>
+    inline void run(const InputContainer& inputs, OutputArray& outputs, NeighborFunctor& f)
+    {
+        using InputValue = std::decay_t<decltype(inputs[0])>;
+        static constexpr bool IS_INDEX = std::is_integral<InputValue>::value;
+
+        const std::size_t input_count = std::size(inputs);
+        if (input_count == 0) return;
+
+        const auto& points = this->m_kdtree->points();
+        const bool empty = this->m_kdtree->nodes().empty() || points.empty() || this->m_kdtree->sample_count() == 0;
+
+        std::array<Slot, GroupSize> slots;
+        std::vector<IndexType> neighbors;
+        std::size_t next = 0;
+        int active = 0;
+
+        // Start the next input in the slot `s`, and prefetch the root
+        const auto start = [&](int s) {
+            Slot& slot = slots[s];
+            slot.active = next < input_count;
+            if (!slot.active) return;
+            slot.input = next++;
+            if constexpr (IS_INDEX)
+            {
+                slot.skip  = IndexType(inputs[slot.input]);
+                slot.point = points[slot.skip].pos();
+            }
+            else
+            {
+                slot.skip  = -1;
+                slot.point = inputs[slot.input];
+            }
+            slot.stack.clear();
+            if (!empty)
+            {
+                slot.stack.push({0, 0});
+                slot.filter = ReducedPrecisionFilter(this->m_kdtree, slot.point);
+            }
+            slot.phase = Slot::Phase::Descend;
+            outputs[s].reset();
+            this->m_stats.start_query();
+            if (!empty) PONCA_PREFETCH(this->m_kdtree->nodes().data());
+            ++active;
+        };
+
+        for (int s = 0; s < GroupSize; ++s)
+            start(s);
+
+        while (active > 0)
+        {
+            for (int s = 0; s < GroupSize; ++s)
+            {
+                if (!slots[s].active || step(slots[s], outputs[s])) continue;
+
+                outputs[s].write(neighbors);
+                f(slots[s].input, neighbors);
+                --active;
+                start(s);
+            }
+        }
+    }
+
+    /// \brief Advance the traversal of `slot` by one node or leaf, and prefetch the data needed by the next step
+    /// \return false when the search is complete
+    template <typename Output>
+    inline bool step(Slot& slot, Output& output)
+    {
+        const auto& nodes   = this->m_kdtree->nodes();
+        const auto& points  = this->m_kdtree->points();
+        const auto& samples = this->m_kdtree->samples();
+
+        switch (slot.phase)
+        {
+        case Slot::Phase::LeafIndices:
+            // The samples indices are in cache, load the points
+            for (IndexType i = slot.leaf_start; i < slot.leaf_end; ++i)
+                PONCA_PREFETCH(points.data() + samples[i]);
+            slot.phase = Slot::Phase::LeafPoints;
+            return true;
+        case Slot::Phase::LeafPoints:
+        {
+            // Same leaf scan as KdTreeQuery::search_internal
+            auto threshold = [&output]() { return output.threshold(); };
+            auto skip      = [&slot](IndexType idx) { return idx == slot.skip; };
+            auto push      = [&output](IndexType idx, IndexType, Scalar d) { output.push(idx, d); return false; };
+            this->scan_leaf(slot.point, slot.leaf_start, slot.leaf_end, slot.filter, threshold, skip, push);
+            slot.phase = Slot::Phase::Descend;
+            break;
+        }
+        case Slot::Phase::Descend:
+            break;
+        }
+
+        while (!slot.stack.empty())
+        {
+            auto& qnode = slot.stack.top();
+            if (!(qnode.squared_distance < output.threshold()))
+            {
+                slot.stack.pop();
+                continue;
+            }
+
+            const auto& node = nodes[qnode.index];
+            this->m_stats.visit_node();
+            if (node.is_leaf())
+            {
+                this->m_stats.visit_leaf();
+                slot.stack.pop();
+                slot.leaf_start = node.leaf_start();
+                slot.leaf_end   = node.leaf_start() + node.leaf_size();
+                if (slot.leaf_start == slot.leaf_end) continue;
+                for (IndexType i = slot.leaf_start; i < slot.leaf_end; i += CACHE_LINE_INDICES)
+                    PONCA_PREFETCH(samples.data() + i);
+                slot.phase = Slot::Phase::LeafIndices;
+                return true;
+            }
+
+            // Same descent as KdTreeQuery::search_internal: replace the top by the farthest and push the closest
+            const Scalar newOff = slot.point[node.inner_split_dim()] - node.inner_split_value();
+            slot.stack.push();
+            if (newOff < 0)
+            {
+                slot.stack.top().index = node.inner_first_child_id();
+                qnode.index            = node.inner_first_child_id() + 1;
+            }
+            else
+            {
+                slot.stack.top().index = node.inner_first_child_id() + 1;
+                qnode.index            = node.inner_first_child_id();
+            }
+            slot.stack.top().squared_distance = qnode.squared_distance;
+            qnode.squared_distance            = newOff * newOff;
+            this->m_stats.update_stack_size(slot.stack.size());
+
+            PONCA_PREFETCH(nodes.data() + slot.stack.top().index);
+            return true;
+        }
+        return false;
+    }
+
+    static constexpr IndexType CACHE_LINE_INDICES = IndexType(64 / sizeof(IndexType)) > 0
+            ? IndexType(64 / sizeof(IndexType)) : IndexType(1);
+};
+} // namespace Ponca
@@ -0,0 +1,270 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "kdTreeKNearestQueries.h"
+#include "kdTreeRangeQueries.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace Ponca {
+template <typename Traits> class KdTreeBase;
+
+/*!
+ * \brief Path from the root of a kd-tree to the leaf containing the last query point
+ *
+ * Used by coherent queries to start a search from the deepest node of the previous path whose cell contains the
+ * query ball, instead of the root.
+ */
+template <typename Traits>
+class KdTreeQueryPath
+{
+public:
+    using DataPoint     = typename Traits::DataPoint;
+    using NodeIndexType = typename Traits::NodeIndexType;
+    using Scalar        = typename DataPoint::Scalar;
+    using VectorType    = typename DataPoint::VectorType;
+
+    /// \brief Find the node where a search for the ball of center `point` can start, and update the path
+    ///
+    /// The cells of the nodes of the previous path are computed from the split planes. The deepest node whose cell
+    /// contains the ball is selected. The path is then extended from this node down to the leaf containing `point`.
+    ///
+    /// \param squared_radius Squared radius of the ball, all the neighbors of the query must be in this ball
+    /// \return The deepest node of the path containing the ball, the root if there is no such node
+    inline NodeIndexType start(const KdTreeBase<Traits>* kdtree, const VectorType& point, Scalar squared_radius)
+    {
+        const auto& nodes = kdtree->nodes();
+        if (nodes.empty())
+        {
+            m_size = 0;
+            return 0;
+        }
+
+        // Enlarge the ball to account for the rounding errors of the distance computation
+        static constexpr Scalar eps = std::numeric_limits<Scalar>::epsilon();
+        const Scalar r2 = squared_radius * (Scalar(1) + Scalar(4 * (DataPoint::Dim + 2)) * eps);
+
+        int depth = 0;
+        if (m_size > 0 && m_path[0] == 0 && r2 < std::numeric_limits<Scalar>::max())
+        {
+            VectorType lo = VectorType::Constant(-std::numeric_limits<Scalar>::infinity());
+            VectorType hi = VectorType::Constant( std::numeric_limits<Scalar>::infinity());
+            for (int d = 0; d + 1 < m_size; ++d)
+            {
+                // Stop on paths that are not valid anymore
+                const NodeIndexType child = m_path[d + 1];
+                const auto& node = nodes[m_path[d]];
+                if (node.is_leaf() || child >= NodeIndexType(nodes.size())) break;
+
+                // Only the split dimension of the node is modified
+                const int dim = node.inner_split_dim();
+                if (child == NodeIndexType(node.inner_first_child_id()))
+                    hi[dim] = std::min(hi[dim], Scalar(node.inner_split_value()));
+                else if (child == NodeIndexType(node.inner_first_child_id() + 1))
+                    lo[dim] = std::max(lo[dim], Scalar(node.inner_split_value()));
+                else break;
+
+                const Scalar dlo = point[dim] - lo[dim];
+                const Scalar dhi = hi[dim] - point[dim];
+                if (!(dlo >= Scalar(0) && dlo * dlo >= r2 && dhi > Scalar(0) && dhi * dhi >= r2)) break;
+                depth = d + 1;
+            }
+        }
+        else
+        {
+            m_path[0] = 0;
+        }
+
+        // Extend the path down to the leaf containing the point
+        m_size = depth + 1;
+        NodeIndexType id = m_path[depth];
+        while (!nodes[id].is_leaf() && m_size < CAPACITY)
+        {
+            const auto& node = nodes[id];
+            id = node.inner_first_child_id() + (point[node.inner_split_dim()] < node.inner_split_value() ? 0 : 1);
+            m_path[m_size++] = id;
+        }
+        return m_path[depth];
+    }
+
+    /// Number of nodes of the path
+    inline int size() const { return m_size; }
+
+    /// Forget the path, the next search will start from the root
+    inline void clear() { m_size = 0; }
+
+private:
+    static constexpr int CAPACITY = Traits::MAX_DEPTH + 1;
+    std::array<NodeIndexType, CAPACITY> m_path;
+    int m_size {0};
+};
+
+/*!
+ * \brief K-nearest neighbors query optimized for spatially coherent sequences of queries
+ *
+ * The query can be reused for successive inputs with `operator()`. Each search is initialized from the previous one:
+ *  - the distance threshold is set to the distance between the new input and the k-th closest of the previous
+ *    neighbors (and of the previous query point for index queries),
+ *  - the traversal starts from the deepest node of the previous root-to-leaf path whose cell contains the ball
+ *    bounded by this threshold.
+ *
+ * Results are identical to the ones of \ref KdTreeKNearestQueryBase, the order of neighbors with equal distances may
+ * differ. When successive inputs are close to each other, e.g. when iterating over the points in a spatially coherent
+ * order, most of the root-to-leaf descents and of the visited nodes are skipped.
+ *
+ * \warning The kd-tree must not be modified between two searches of the same query object.
+ */
+template <typename Traits, typename QueryType>
+class KdTreeCoherentKNearestQueryBase : public KdTreeKNearestQueryBase<Traits, KdTreeKNearestIterator, QueryType>
+{
+public:
+    using Base           = KdTreeKNearestQueryBase<Traits, KdTreeKNearestIterator, QueryType>;
+    using DataPoint      = typename Traits::DataPoint;
+    using IndexType      = typename Traits::IndexType;
+    using Scalar         = typename DataPoint::Scalar;
+    using VectorType     = typename DataPoint::VectorType;
+    using QueryAccelType = KdTreeQuery<Traits>;
+    using Iterator       = typename Base::Iterator;
+    using InputType      = typename QueryType::InputType;
+
+    inline KdTreeCoherentKNearestQueryBase(const KdTreeBase<Traits>* kdtree, IndexType k, InputType input) :
+            Base(kdtree, k, input) { }
+
+    /// Set the input of the next search
+    inline KdTreeCoherentKNearestQueryBase& operator()(const InputType& input)
+    {
+        QueryType::editInput(input);
+        return *this;
+    }
+
+    inline Iterator begin(){
+        const auto& points = QueryAccelType::m_kdtree->points();
+        const VectorType point = QueryType::getInputPosition(points);
+        const Scalar bound = seed_bound(point);
+
+        QueryAccelType::reset(m_path.start(QueryAccelType::m_kdtree, point, bound));
+        QueryType::reset();
+        // Placeholders giving the initial threshold, all replaced by the samples found below the bound
+        if (bound < std::numeric_limits<Scalar>::max())
+            for (std::size_t i = 0; i < QueryType::m_queue.capacity(); ++i)
+                QueryType::m_queue.push({-1, bound});
+        this->search();
+
+        if constexpr (std::is_same<InputType, IndexType>::value)
+            m_previous_index = QueryType::input();
+        return Iterator(QueryType::m_queue.begin());
+    }
+    inline Iterator end(){
+        return Base::end();
+    }
+
+protected:
+    /// Upper bound of the squared distance to the k-th neighbor of `point`, computed from the previous results
+    inline Scalar seed_bound(const VectorType& point)
+    {
+        const auto& points = QueryAccelType::m_kdtree->points();
+        const std::size_t k = QueryType::m_queue.capacity();
+
+        m_distances.clear();
+        for (const auto& n : QueryType::m_queue)
+            if (n.index >= 0 && !QueryType::skipIndexFunctor(n.index))
+                m_distances.push_back((points[n.index].pos() - point).squaredNorm());
+        // The previous query point is a candidate only if it is a sample
+        if (m_previous_index >= 0 && !QueryType::skipIndexFunctor(m_previous_index) &&
+            QueryAccelType::m_kdtree->sample_count() == QueryAccelType::m_kdtree->point_count())
+            m_distances.push_back((points[m_previous_index].pos() - point).squaredNorm());
+
+        if (k == 0 || m_distances.size() < k)
+            return std::numeric_limits<Scalar>::max();
+
+        std::nth_element(m_distances.begin(), m_distances.begin() + (k - 1), m_distances.end());
+        // The k closest candidates are strictly below the bound
+        using std::nextafter;
+        return nextafter(m_distances[k - 1], std::numeric_limits<Scalar>::max());
+    }
+
+    KdTreeQueryPath<Traits> m_path;
+    std::vector<Scalar> m_distances; ///< Distances of the previous results, kept to avoid allocations
+    IndexType m_previous_index {-1};
+};
+
+/*!
+ * \brief Range query optimized for spatially coherent sequences of queries
+ *
+ * The query can be reused for successive inputs with `operator()`. Each search starts from the deepest node of the
+ * previous root-to-leaf path whose cell contains the query ball, instead of the root. Results are identical to the
+ * ones of \ref KdTreeRangeQueryBase.
+ *
+ * \warning The kd-tree must not be modified between two searches of the same query object.
+ */
+template <typename Traits, typename QueryType>
+class KdTreeCoherentRangeQueryBase : public KdTreeRangeQueryBase<Traits, KdTreeRangeIterator, QueryType>
+{
+public:
+    using Base           = KdTreeRangeQueryBase<Traits, KdTreeRangeIterator, QueryType>;
+    using DataPoint      = typename Traits::DataPoint;
+    using IndexType      = typename Traits::IndexType;
+    using Scalar         = typename DataPoint::Scalar;
+    using VectorType     = typename DataPoint::VectorType;
+    using QueryAccelType = KdTreeQuery<Traits>;
+    using Iterator       = typename Base::Iterator;
+    using InputType      = typename QueryType::InputType;
+
+    inline KdTreeCoherentRangeQueryBase(const KdTreeBase<Traits>* kdtree, Scalar radius, InputType input) :
+            Base(kdtree, radius, input) { }
+
+    /// Set the input of the next search
+    inline KdTreeCoherentRangeQueryBase& operator()(const InputType& input)
+    {
+        QueryType::editInput(input);
+        return *this;
+    }
+
+    /// Set the input and the radius of the next search
+    inline KdTreeCoherentRangeQueryBase& operator()(const InputType& input, Scalar radius)
+    {
+        QueryType::set_radius(radius);
+        return operator()(input);
+    }
+
+    inline Iterator begin(){
+        const auto& points = QueryAccelType::m_kdtree->points();
+        const VectorType point = QueryType::getInputPosition(points);
+
+        QueryAccelType::reset(m_path.start(QueryAccelType::m_kdtree, point, QueryType::squared_radius()));
+        QueryType::reset();
+        Iterator it(this);
+        this->advance(it);
+        return it;
+    }
+    inline Iterator end(){
+        return Base::end();
+    }
+
+protected:
+    KdTreeQueryPath<Traits> m_path;
+};
+
+template <typename Traits>
+using KdTreeCoherentKNearestIndexQuery = KdTreeCoherentKNearestQueryBase<Traits,
+        KNearestIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>>;
+template <typename Traits>
+using KdTreeCoherentKNearestPointQuery = KdTreeCoherentKNearestQueryBase<Traits,
+        KNearestPointQuery<typename Traits::IndexType, typename Traits::DataPoint>>;
+template <typename Traits>
+using KdTreeCoherentRangeIndexQuery = KdTreeCoherentRangeQueryBase<Traits,
+        RangeIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>>;
+template <typename Traits>
+using KdTreeCoherentRangePointQuery = KdTreeCoherentRangeQueryBase<Traits,
+        RangePointQuery<typename Traits::IndexType, typename Traits::DataPoint>>;
+} // namespace Ponca
@@ -8,6 +8,12 @@
 
 #include "../../indexSquaredDistance.h"
 #include "../../../Common/Containers/stack.h"
+#include "./kdTreeQueryStats.h"
+#include "./kdTreeBatchKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace Ponca {
 template <typename Traits> class KdTreeBase;
@@ -20,20 +26,199 @@ public:
     using IndexType  = typename Traits::IndexType;
     using Scalar     = typename DataPoint::Scalar;
     using VectorType = typename DataPoint::VectorType;
+    /// Query statistics policy given by `Traits::QueryStatsPolicy`, KdTreeNoQueryStatsPolicy if not defined
+    using QueryStatsPolicy = typename internal::KdTreeQueryStatsPolicyOf<Traits>::type;
 
     explicit inline KdTreeQuery(const KdTreeBase<Traits>* kdtree) : m_kdtree( kdtree ), m_stack() {}
 
+    /// A copy starts with empty statistics: the searches of `other` are added to the kd-tree by `other` only
+    inline KdTreeQuery(const KdTreeQuery& other) : m_kdtree( other.m_kdtree ), m_stack( other.m_stack ) {}
+
+    inline KdTreeQuery& operator=(const KdTreeQuery& other)
+    {
+        if (this != &other)
+        {
+            flush_query_stats();
+            m_kdtree = other.m_kdtree;
+            m_stack  = other.m_stack;
+        }
+        return *this;
+    }
+
+    /// Add the statistics of this query to the kd-tree
+    inline ~KdTreeQuery() { flush_query_stats(); }
+
+    /// Statistics of the searches performed by this query object
+    /// \see KdTreeBase::query_stats
+    inline KdTreeQueryStats query_stats() const { return m_stats.stats(); }
+
 protected:
     /// \brief Init stack for a new search
-    inline void reset() {
+    /// \param start_node Node from which the search starts, the root by default. All the samples that can be
+    /// neighbors of the query must be in the subtree of this node.
+    inline void reset(typename Traits::NodeIndexType start_node = 0) {
         m_stack.clear();
-        m_stack.push({0,0});
+        m_stack.push({IndexType(start_node),0});
+        m_stats.start_query();
     }
 
     /// [KdTreeQuery kdtree type]
     const KdTreeBase<Traits>* m_kdtree { nullptr };
     /// [KdTreeQuery kdtree type]
     Stack<IndexSquaredDistance<IndexType, Scalar>, 2 * Traits::MAX_DEPTH> m_stack;
+    /// Statistics of the searches, empty when statistics are disabled
+    QueryStatsPolicy m_stats;
+
+    /// Add the statistics of the searches to the kd-tree, and clear them
+    inline void flush_query_stats()
+    {
+        if constexpr (QueryStatsPolicy::ENABLED)
+            if (m_kdtree != nullptr) m_kdtree->m_query_stats.add(m_stats.stats());
+        m_stats.reset();
+    }
+
+    /// \brief Conservative rejection test using the reduced precision coordinates of the kd-tree
+    ///
+    /// A sample is rejected only if its single precision squared distance to the query exceeds an upper bound of the
+    /// single precision distance of any sample closer than the current threshold. The bound accounts for the rounding
+    /// of the coordinates and of the distance computation, so rejected samples are never part of the result.
+    /// \see KdTreeBase::set_reduced_precision
+    class ReducedPrecisionFilter
+    {
+    public:
+        using ReducedVectorType = typename KdTreeBase<Traits>::ReducedVectorType;
+
+        /// Filter that never rejects
+        inline ReducedPrecisionFilter() = default;
+
+        inline ReducedPrecisionFilter(const KdTreeBase<Traits>* kdtree, const VectorType& point)
+        {
+            const auto& reduced = kdtree->reduced_points();
+            if (reduced.empty()) return;
+
+            using std::sqrt;
+            const Scalar magnitude = std::max(kdtree->reduced_points_magnitude(), point.cwiseAbs().maxCoeff());
+            if (!(magnitude < Scalar(std::numeric_limits<float>::max() / 4))) return;
+
+            m_points = reduced.data();
+            m_point  = point.template cast<float>();
+            // Error on the difference vector due to the rounding of the coordinates
+            m_margin = Scalar(8) * sqrt(Scalar(DataPoint::Dim)) * Scalar(std::numeric_limits<float>::epsilon()) * magnitude;
+        }
+
+        /// Update the rejection bound from the current squared distance threshold
+        inline void update(Scalar threshold)
+        {
+            if (m_points == nullptr) return;
+
+            using std::sqrt;
+            static constexpr Scalar eps = Scalar(std::numeric_limits<float>::epsilon());
+            // Relative error of the single precision subtraction and squared norm
+            const Scalar b = (sqrt(threshold) + m_margin) * (Scalar(1) + Scalar(2 * (DataPoint::Dim + 2)) * eps);
+            const Scalar bound = b * b;
+            m_bound = bound < Scalar(std::numeric_limits<float>::max())
+                    ? std::nextafter(float(bound), std::numeric_limits<float>::infinity())
+                    : std::numeric_limits<float>::infinity();
+        }
+
+        /// \return true if the kd-tree stores reduced precision coordinates, i.e. if samples can be rejected
+        inline bool active() const { return m_points != nullptr; }
+
+        /// \return true if the sample at position `i` in the kd-tree samples is farther than the threshold
+        inline bool reject(IndexType i) const
+        {
+            return m_points != nullptr && (m_point - m_points[i]).squaredNorm() > m_bound;
+        }
+
+    private:
+        const ReducedVectorType* m_points {nullptr};
+        ReducedVectorType m_point;
+        Scalar m_margin {0};
+        float m_bound {std::numeric_limits<float>::infinity()};
+    };
+
+    /// Number of samples whose distances are computed at once by the leaf scans
+    static constexpr IndexType LEAF_SCAN_BLOCK_SIZE = 16;
+    /// Relative error bound of the distances of the leaf scan kernels, with respect to `squaredNorm`
+    static constexpr Scalar LEAF_SCAN_TOLERANCE = Scalar(4 * DataPoint::Dim) * std::numeric_limits<Scalar>::epsilon();
+
+    /// \brief Pass the samples of `[start, end)` closer than the threshold to `processNeighborFunctor`
+    ///
+    /// Without reduced precision coordinates, the distances are computed by blocks of #LEAF_SCAN_BLOCK_SIZE samples
+    /// with internal::squared_distances_gather, dispatched at runtime to AVX2/AVX-512. Their rounding may differ from
+    /// the one of `squaredNorm` (FMA, order of the sums): they only reject the samples farther than the threshold by
+    /// more than #LEAF_SCAN_TOLERANCE, and the distances of the other samples are computed again as before, so that
+    /// the results do not depend on the instruction set. Otherwise, the samples are first tested with `filter`, and
+    /// the distances are computed one sample at a time.
+    ///
+    /// \return true if `processNeighborFunctor` interrupted the scan
+    template<typename DescentDistanceThresholdFunctor,
+            typename SkipIndexFunctor,
+            typename ProcessNeighborFunctor>
+    inline bool scan_leaf(const VectorType& point, IndexType start, IndexType end, ReducedPrecisionFilter& filter,
+                          DescentDistanceThresholdFunctor& descentDistanceThreshold,
+                          SkipIndexFunctor& skipFunctor,
+                          ProcessNeighborFunctor& processNeighborFunctor)
+    {
+        const auto& points  = m_kdtree->points();
+        const auto& samples = m_kdtree->samples();
+
+        // Process a sample at position `i` in the samples, whose distance is `d`
+        const auto process = [&](IndexType idx, IndexType i, Scalar d) {
+            if(d < descentDistanceThreshold())
+            {
+                m_stats.accept();
+                if( processNeighborFunctor( idx, i, d )) return true;
+                filter.update(descentDistanceThreshold());
+            }
+            else
+            {
+                m_stats.reject();
+            }
+            return false;
+        };
+
+        filter.update(descentDistanceThreshold());
+        if (!filter.active())
+        {
+            Scalar distances[LEAF_SCAN_BLOCK_SIZE];
+            for(IndexType b=start; b<end; b+=LEAF_SCAN_BLOCK_SIZE)
+            {
+                const IndexType count = std::min(LEAF_SCAN_BLOCK_SIZE, end - b);
+                internal::squared_distances_gather(points.data(), samples.data() + b, std::size_t(count),
+                                                   point.data(), distances);
+                for(IndexType m=0; m<count; ++m)
+                {
+                    IndexType idx = samples[b + m];
+                    if(skipFunctor(idx)) continue;
+                    m_stats.evaluate_distance();
+                    const Scalar threshold = descentDistanceThreshold();
+                    if(!(distances[m] < threshold + threshold * LEAF_SCAN_TOLERANCE))
+                    {
+                        m_stats.reject();
+                        continue;
+                    }
+                    if(process(idx, b + m, (point - points[idx].pos()).squaredNorm())) return true;
+                }
+            }
+            return false;
+        }
+
+        for(IndexType i=start; i<end; ++i)
+        {
+            IndexType idx = samples[i];
+            if(skipFunctor(idx)) continue;
+            if(filter.reject(i))
+            {
+                m_stats.reject();
+                continue;
+            }
+
+            m_stats.evaluate_distance();
+            if(process(idx, i, (point - points[idx].pos()).squaredNorm())) return true;
+        }
+        return false;
+    }
 
     /// \return false if the kdtree is empty
     template<typename LeafPreparationFunctor,
@@ -53,6 +238,8 @@ protected:
         if (nodes.empty() || points.empty() || m_kdtree->sample_count() == 0)
             return false;
 
+        ReducedPrecisionFilter filter(m_kdtree, point);
+
         while(!m_stack.empty())
         {
             auto& qnode = m_stack.top();
@@ -60,24 +247,17 @@ protected:
 
             if(qnode.squared_distance < descentDistanceThreshold())
             {
+                m_stats.visit_node();
                 if(node.is_leaf())
                 {
+                    m_stats.visit_leaf();
                     m_stack.pop();
                     IndexType start = node.leaf_start();
                     IndexType end = node.leaf_start() + node.leaf_size();
                     prepareLeafTraversal(start, end);
-                    for(IndexType i=start; i<end; ++i)
-                    {
-                        IndexType idx = m_kdtree->pointFromSample(i);
-                        if(skipFunctor(idx)) continue;
-
-                        Scalar d = (point - points[idx].pos()).squaredNorm();
-
-                        if(d < descentDistanceThreshold())
-                        {
-                            if( processNeighborFunctor( idx, i, d )) return false;
-                        }
-                    }
+                    if (scan_leaf(point, start, end, filter,
+                                  descentDistanceThreshold, skipFunctor, processNeighborFunctor))
+                        return false;
                 }
                 else
                 {
@@ -96,6 +276,7 @@ protected:
                     }
                     m_stack.top().squared_distance = qnode.squared_distance;
                     qnode.squared_distance         = newOff*newOff;
+                    m_stats.update_stack_size(m_stack.size());
                 }
             }
             else
@@ -0,0 +1,251 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+
+namespace Ponca {
+
+/*!
+ * \brief Counters describing the traversal performed by kd-tree queries
+ *
+ * \see KdTreeCountQueryStatsPolicy
+ */
+struct KdTreeQueryStats
+{
+    std::size_t query_count {0};    ///< Number of searches
+    std::size_t node_count {0};     ///< Number of nodes visited (inner nodes and leaves)
+    std::size_t leaf_count {0};     ///< Number of leaves visited
+    std::size_t distance_count {0}; ///< Number of distances computed between the query and the samples
+    std::size_t accepted_count {0}; ///< Number of samples passed to the query as neighbors
+    std::size_t rejected_count {0}; ///< Number of samples of the visited leaves that are not neighbors
+    std::size_t max_stack_size {0}; ///< Largest size reached by the traversal stack
+
+    /// Accumulate the counters of `other`
+    inline void merge(const KdTreeQueryStats& other)
+    {
+        query_count    += other.query_count;
+        node_count     += other.node_count;
+        leaf_count     += other.leaf_count;
+        distance_count += other.distance_count;
+        accepted_count += other.accepted_count;
+        rejected_count += other.rejected_count;
+        max_stack_size  = std::max(max_stack_size, other.max_stack_size);
+    }
+
+    inline void print(std::ostream& os) const
+    {
+        os << "KdTreeQueryStats:";
+        os << "\n  QueryCount: " << query_count;
+        os << "\n  NodeCount: " << node_count;
+        os << "\n  LeafCount: " << leaf_count;
+        os << "\n  DistanceCount: " << distance_count;
+        os << "\n  AcceptedCount: " << accepted_count;
+        os << "\n  RejectedCount: " << rejected_count;
+        os << "\n  MaxStackSize: " << max_stack_size;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const KdTreeQueryStats& stats)
+    {
+        stats.print(os);
+        return os;
+    }
+};
+
+/*!
+ * \brief Default query statistics policy, that does not record anything
+ *
+ * All the functions are empty, so queries using this policy are identical to queries without instrumentation.
+ *
+ * \see KdTreeCountQueryStatsPolicy
+ */
+struct KdTreeNoQueryStatsPolicy
+{
+    static constexpr bool ENABLED = false;
+
+    inline void start_query() {}
+    inline void visit_node() {}
+    inline void visit_leaf() {}
+    inline void evaluate_distance() {}
+    inline void accept() {}
+    inline void reject() {}
+    inline void update_stack_size(int) {}
+    inline KdTreeQueryStats stats() const { return {}; }
+    inline void reset() {}
+};
+
+/*!
+ * \brief Query statistics policy counting the operations performed by each query
+ *
+ * Enabled by defining `QueryStatsPolicy` in the kd-tree traits:
+ * \code
+ * template <typename DataPoint>
+ * struct MyTraits : public KdTreeDefaultTraits<DataPoint> {
+ *     using QueryStatsPolicy = KdTreeCountQueryStatsPolicy;
+ * };
+ * \endcode
+ *
+ * Each query object counts its own operations. The counters are added to the kd-tree when the query object is
+ * destroyed, in a slot of the calling thread, and can be read with KdTreeBase::query_stats. A copy of a query object
+ * starts with empty counters, so that the operations of a query are counted once.
+ */
+struct KdTreeCountQueryStatsPolicy
+{
+    static constexpr bool ENABLED = true;
+
+    inline void start_query()       { ++m_stats.query_count; }
+    inline void visit_node()        { ++m_stats.node_count; }
+    inline void visit_leaf()        { ++m_stats.leaf_count; }
+    inline void evaluate_distance() { ++m_stats.distance_count; }
+    inline void accept()            { ++m_stats.accepted_count; }
+    inline void reject()            { ++m_stats.rejected_count; }
+    inline void update_stack_size(int size)
+    {
+        m_stats.max_stack_size = std::max(m_stats.max_stack_size, std::size_t(size));
+    }
+    inline const KdTreeQueryStats& stats() const { return m_stats; }
+    inline void reset() { m_stats = KdTreeQueryStats(); }
+
+private:
+    KdTreeQueryStats m_stats;
+};
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /// Query statistics policy given by `Traits::QueryStatsPolicy`, KdTreeNoQueryStatsPolicy if not defined
+    template <typename Traits, typename = void>
+    struct KdTreeQueryStatsPolicyOf
+    {
+        using type = KdTreeNoQueryStatsPolicy;
+    };
+
+    template <typename Traits>
+    struct KdTreeQueryStatsPolicyOf<Traits, std::void_t<typename Traits::QueryStatsPolicy>>
+    {
+        using type = typename Traits::QueryStatsPolicy;
+    };
+
+    /// Index of the calling thread, assigned at its first call and used to select its accumulation slot
+    inline std::size_t kdTreeQueryStatsThreadIndex()
+    {
+        static std::atomic<std::size_t> threadCount {0};
+        thread_local const std::size_t index = threadCount.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    /// Thread-safe accumulation of the statistics of the queries, empty when statistics are disabled
+    template <bool Enabled>
+    class KdTreeQueryStatsAccumulator
+    {
+    public:
+        inline void add(const KdTreeQueryStats&) {}
+        inline KdTreeQueryStats stats() const { return {}; }
+        inline void reset() {}
+    };
+
+    /// \brief Per-thread accumulation of the statistics of the queries
+    ///
+    /// Each thread adds its counters to its own slot, on its own cache line, so that concurrent queries do not contend
+    /// on shared counters. The slots are merged when the statistics are read. Threads beyond #SLOT_COUNT share slots,
+    /// which is why the counters are still atomic.
+    template <>
+    class KdTreeQueryStatsAccumulator<true>
+    {
+    public:
+        /// Number of accumulation slots
+        static constexpr std::size_t SLOT_COUNT = 64;
+
+        KdTreeQueryStatsAccumulator() = default;
+        KdTreeQueryStatsAccumulator(const KdTreeQueryStatsAccumulator& other) { store(other.stats()); }
+        KdTreeQueryStatsAccumulator& operator=(const KdTreeQueryStatsAccumulator& other)
+        {
+            store(other.stats());
+            return *this;
+        }
+
+        inline void add(const KdTreeQueryStats& s)
+        {
+            static constexpr auto order = std::memory_order_relaxed;
+            Slot& slot = m_slots[kdTreeQueryStatsThreadIndex() % SLOT_COUNT];
+            slot.query_count.fetch_add(s.query_count, order);
+            slot.node_count.fetch_add(s.node_count, order);
+            slot.leaf_count.fetch_add(s.leaf_count, order);
+            slot.distance_count.fetch_add(s.distance_count, order);
+            slot.accepted_count.fetch_add(s.accepted_count, order);
+            slot.rejected_count.fetch_add(s.rejected_count, order);
+            std::size_t current = slot.max_stack_size.load(order);
+            while (current < s.max_stack_size && !slot.max_stack_size.compare_exchange_weak(current, s.max_stack_size, order))
+            {}
+        }
+
+        inline KdTreeQueryStats stats() const
+        {
+            KdTreeQueryStats s;
+            for (const Slot& slot : m_slots)
+            {
+                KdTreeQueryStats t;
+                t.query_count    = slot.query_count.load();
+                t.node_count     = slot.node_count.load();
+                t.leaf_count     = slot.leaf_count.load();
+                t.distance_count = slot.distance_count.load();
+                t.accepted_count = slot.accepted_count.load();
+                t.rejected_count = slot.rejected_count.load();
+                t.max_stack_size = slot.max_stack_size.load();
+                s.merge(t);
+            }
+            return s;
+        }
+
+        inline void reset() { store(KdTreeQueryStats()); }
+
+    private:
+        /// Counters of the threads using this slot, aligned on a cache line
+        struct alignas(64) Slot
+        {
+            std::atomic<std::size_t> query_count {0};
+            std::atomic<std::size_t> node_count {0};
+            std::atomic<std::size_t> leaf_count {0};
+            std::atomic<std::size_t> distance_count {0};
+            std::atomic<std::size_t> accepted_count {0};
+            std::atomic<std::size_t> rejected_count {0};
+            std::atomic<std::size_t> max_stack_size {0};
+        };
+
+        /// Store `s` in the first slot, and clear the others
+        inline void store(const KdTreeQueryStats& s)
+        {
+            for (Slot& slot : m_slots)
+            {
+                slot.query_count    = 0;
+                slot.node_count     = 0;
+                slot.leaf_count     = 0;
+                slot.distance_count = 0;
+                slot.accepted_count = 0;
+                slot.rejected_count = 0;
+                slot.max_stack_size = 0;
+            }
+            Slot& first = m_slots[0];
+            first.query_count    = s.query_count;
+            first.node_count     = s.node_count;
+            first.leaf_count     = s.leaf_count;
+            first.distance_count = s.distance_count;
+            first.accepted_count = s.accepted_count;
+            first.rejected_count = s.rejected_count;
+            first.max_stack_size = s.max_stack_size;
+        }
+
+        std::array<Slot, SLOT_COUNT> m_slots;
+    };
+}
+#endif
+} // namespace Ponca
@@ -66,17 +66,11 @@ protected:
             return true;
         };
 
-        for(IndexType i=it.m_start; i<it.m_end; ++i)
-        {
-            IndexType idx = indices[i];
-            if(skipFunctor(idx)) continue;
-
-            Scalar d = (point - points[idx].pos()).squaredNorm();
-            if(d < descentDistanceThreshold())
-            {
-                if( processNeighborFunctor(idx, i, d) ) return;
-            }
-        }
+        // Resume the scan of the current leaf
+        typename QueryAccelType::ReducedPrecisionFilter filter(QueryAccelType::m_kdtree, point);
+        if (QueryAccelType::scan_leaf(point, it.m_start, it.m_end, filter,
+                                      descentDistanceThreshold, skipFunctor, processNeighborFunctor))
+            return;
 
         if (KdTreeQuery<Traits>::search_internal(point,
                                                  [&it](IndexType start, IndexType end)
@@ -8,7 +8,11 @@
 
 #include "./kdTreeTraits.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <numeric>
 #include <optional>
@@ -23,6 +27,9 @@
 #include "Query/kdTreeNearestQueries.h"
 #include "Query/kdTreeKNearestQueries.h"
 #include "Query/kdTreeRangeQueries.h"
+#include "Query/kdTreeCoherentQueries.h"
+#include "Query/kdTreeBatchKernels.h"
+#include "Query/kdTreeBatchedQueries.h"
 
 namespace Ponca {
 template <typename Traits> class KdTreeBase;
@@ -116,6 +123,11 @@ public:
     using VectorType = typename DataPoint::VectorType; ///< VectorType given by user via DataPoint
     using AabbType   = typename NodeType::AabbType; ///< Bounding box type given by user via NodeType
 
+    /// Single precision vector type used to store reduced precision coordinates
+    using ReducedVectorType     = Eigen::Matrix<float, DataPoint::Dim, 1>;
+    /// Container for reduced precision coordinates
+    using ReducedPointContainer = std::vector<ReducedVectorType>;
+
     /// \brief The maximum number of nodes that the kd-tree can have.
     static constexpr std::size_t MAX_NODE_COUNT = NodeType::MAX_COUNT;
     /// \brief The maximum number of points that can be stored in the kd-tree.
@@ -174,6 +186,64 @@ public:
     /// Clear tree data
     inline void clear();
 
+    /// Update the tree after the points have moved, without rebuilding it from scratch
+    ///
+    /// Bounding boxes and split values are recomputed bottom-up from the current positions of the points. As long as
+    /// the children of an inner node can still be separated along its split dimension, only the split value is
+    /// updated. Otherwise, points crossed the split plane and the subtree of the node is rebuilt locally.
+    ///
+    /// Nodes of rebuilt subtrees are appended to the node container. Unused nodes are discarded when they outnumber
+    /// the nodes in use.
+    ///
+    /// \note The sampling is left unchanged: only the positions of the points are expected to change.
+    /// \return The number of subtrees that have been rebuilt
+    inline NodeIndexType refit();
+
+    /// Rebuild the tree hierarchy from the current points and samples
+    ///
+    /// Can be used to apply a new \ref set_min_cell_size "minimal cell size" without converting the points again.
+    inline void rebuild();
+
+    /// Add points to the tree, as new samples
+    ///
+    /// Points are appended to the point container, and each of them is added to the leaf containing it. Leaves that
+    /// exceed the \ref set_min_cell_size "minimal cell size" are split locally, and bounding boxes and split values are
+    /// then updated by \ref refit. Previous samples are left unchanged, and their indices stay valid.
+    ///
+    /// \param first, last Range of DataPoint to add
+    /// \return The index of the first added point
+    template<typename PointIterator>
+    inline IndexType insert(PointIterator first, PointIterator last);
+
+    /// Permute the points, without rebuilding the tree
+    ///
+    /// The point container is reordered so that the new point `i` is the previous point `order[i]`, and the samples
+    /// are renumbered accordingly: the hierarchy and the leaves are left unchanged. Used to improve the memory
+    /// locality of the points, see \ref spatial_order.
+    ///
+    /// \param order Previous index of each point, a permutation of `[0, point_count())`
+    /// \warning Point indices held by the user (e.g. query results) are invalidated
+    inline void reorder_points(const std::vector<int>& order);
+
+    /// \brief Select the minimal cell size giving the fastest queries on the current points
+    ///
+    /// For each candidate size, the hierarchy is rebuilt from the current samples and `query` is executed `repeats`
+    /// times. The tree is finally rebuilt with the candidate giving the lowest time.
+    ///
+    /// \tparam QueryFunctor Functor called as `query(kdtree)`, running a set of representative queries on the tree
+    /// \param candidates Minimal cell sizes to evaluate
+    /// \param query Queries used to benchmark the tree, e.g. k-nearest neighbors of a subset of the samples
+    /// \param repeats Number of executions of `query` per candidate, the fastest one is kept
+    /// \return The measured time (in seconds) for each candidate, so that the selected value can be fixed in
+    /// production code
+    /// \note Timings include the execution of `query` only, not the construction of the tree.
+    template<typename QueryFunctor>
+    inline std::vector<std::pair<LeafSizeType, double>> tune_min_cell_size(const std::vector<LeafSizeType>& candidates,
+                                                                          QueryFunctor&& query, int repeats = 3)
+    {
+        return tune_min_cell_size_impl([this]() { rebuild(); }, candidates, std::forward<QueryFunctor>(query), repeats);
+    }
+
     // Accessors ---------------------------------------------------------------
 public:
     inline NodeIndexType node_count() const
@@ -216,6 +286,20 @@ public:
         return m_indices;
     }
 
+    /// Reduced precision coordinates of the samples, stored in sample order
+    /// \note Empty when the reduced precision is disabled
+    /// \see set_reduced_precision
+    inline const ReducedPointContainer& reduced_points() const
+    {
+        return m_reduced_points;
+    }
+
+    /// Largest absolute value of the samples coordinates, used to bound the error of the reduced precision coordinates
+    inline Scalar reduced_points_magnitude() const
+    {
+        return m_reduced_magnitude;
+    }
+
     // Parameters --------------------------------------------------------------
 public:
     /// Read leaf min size
@@ -231,6 +315,28 @@ public:
         m_min_cell_size = min_cell_size;
     }
 
+    /// Read if the reduced precision copy of the samples coordinates is enabled
+    inline bool reduced_precision() const
+    {
+        return m_reduced_precision;
+    }
+
+    /// Enable or disable the reduced precision copy of the samples coordinates
+    ///
+    /// When enabled, the tree stores a single precision copy of the samples coordinates, in sample order. Leaf scans
+    /// first compare candidates using these coordinates with a conservative error margin, and exact distances are
+    /// computed only for candidates that could not be rejected. Query results are not modified.
+    ///
+    /// This reduces the memory traffic of leaf scans when `Scalar` is `double`, or when DataPoint stores additional
+    /// attributes.
+    ///
+    /// \note The copy is disabled if some coordinates cannot be represented in single precision.
+    inline void set_reduced_precision(bool enable)
+    {
+        m_reduced_precision = enable;
+        update_reduced_points();
+    }
+
     // Index mapping -----------------------------------------------------------
 public:
     /// Return the point index associated with the specified sample index
@@ -286,9 +392,159 @@ public :
     {
         return KdTreeRangeIndexQuery<Traits>(this, r, index);
     }
+
+    /// \brief K-nearest neighbors query initialized from its previous search, for spatially coherent inputs
+    ///
+    /// The query is reused by changing its input:
+    /// \code
+    /// auto query = kdtree.coherent_k_nearest_neighbors(0, k);
+    /// for (int i = 0; i < kdtree.point_count(); ++i)
+    ///     for (int j : query(i)) { /* ... */ }
+    /// \endcode
+    /// \see KdTreeCoherentKNearestQueryBase
+    KdTreeCoherentKNearestPointQuery<Traits> coherent_k_nearest_neighbors(const VectorType& point, IndexType k) const
+    {
+        return KdTreeCoherentKNearestPointQuery<Traits>(this, k, point);
+    }
+
+    /// \copydoc coherent_k_nearest_neighbors
+    KdTreeCoherentKNearestIndexQuery<Traits> coherent_k_nearest_neighbors(IndexType index, IndexType k) const
+    {
+        return KdTreeCoherentKNearestIndexQuery<Traits>(this, k, index);
+    }
+
+    /// \brief Range query starting from the node reached by its previous search, for spatially coherent inputs
+    /// \see KdTreeCoherentRangeQueryBase
+    KdTreeCoherentRangePointQuery<Traits> coherent_range_neighbors(const VectorType& point, Scalar r) const
+    {
+        return KdTreeCoherentRangePointQuery<Traits>(this, r, point);
+    }
+
+    /// \copydoc coherent_range_neighbors
+    KdTreeCoherentRangeIndexQuery<Traits> coherent_range_neighbors(IndexType index, Scalar r) const
+    {
+        return KdTreeCoherentRangeIndexQuery<Traits>(this, r, index);
+    }
+
+    /// \brief Compute the range neighbors of all the samples, processing the samples leaf by leaf
+    ///
+    /// The samples of a leaf share almost the same candidates. For each leaf, the tree is traversed once to collect
+    /// the leaves whose bounding box is closer than `r` from the bounding box of the leaf. The positions of their
+    /// samples are copied in a structure of arrays, and the distances between each sample of the leaf and the
+    /// candidates are computed by a vectorized kernel, one candidate leaf at a time.
+    ///
+    /// The neighbors of each sample are the same as the ones given by `range_neighbors(pointFromSample(s), r)`, in an
+    /// unspecified order.
+    ///
+    /// \tparam NeighborFunctor Functor called as `f(point_index, neighbors)` for each sample, where `point_index` is
+    /// the index of the point associated with the sample and `neighbors` a `std::vector<IndexType>` of point indices
+    /// \warning Leaves are processed in parallel when OpenMP is enabled, so `f` can be called concurrently
+    /// \note The neighbors container is reused between calls, it must be copied to be kept
+    template<typename NeighborFunctor>
+    inline void for_each_range_neighbors(Scalar r, NeighborFunctor f) const;
+
+    /// \brief K-nearest neighbors of a batch of inputs, interleaving the traversals to hide memory latency
+    ///
+    /// Results are identical to the ones of \ref k_nearest_neighbors, and are given as soon as each search is complete:
+    /// \code
+    /// kdtree.batch_k_nearest_neighbors(indices, k, [&](std::size_t i, const std::vector<int>& neighbors) { /* ... */ });
+    /// \endcode
+    ///
+    /// \tparam GroupSize Number of queries in flight
+    /// \param inputs Random access container of point indices or of positions
+    /// \param f Functor called as `f(i, neighbors)` for each `inputs[i]`, with neighbors sorted by increasing distance
+    /// \see KdTreeBatchedQuery
+    template<int GroupSize = 8, typename InputContainer, typename NeighborFunctor>
+    inline void batch_k_nearest_neighbors(const InputContainer& inputs, IndexType k, NeighborFunctor f) const
+    {
+        KdTreeBatchedQuery<Traits, GroupSize>(this).k_nearest_neighbors(inputs, k, f);
+    }
+
+    /// \brief Range neighbors of a batch of inputs, interleaving the traversals to hide memory latency
+    ///
+    /// Results are identical to the ones of \ref range_neighbors.
+    /// \copydetails batch_k_nearest_neighbors
+    template<int GroupSize = 8, typename InputContainer, typename NeighborFunctor>
+    inline void batch_range_neighbors(const InputContainer& inputs, Scalar r, NeighborFunctor f) const
+    {
+        KdTreeBatchedQuery<Traits, GroupSize>(this).range_neighbors(inputs, r, f);
+    }
     
     // Utilities ---------------------------------------------------------------
 public:
+    /*!
+     * \brief Memory footprint and structure statistics of a kd-tree
+     *
+     * \see KdTreeBase::stats
+     */
+    struct Stats
+    {
+        std::size_t point_bytes {0};   ///< Memory used by the points
+        std::size_t node_bytes {0};    ///< Memory allocated for the nodes, including the capacity slack
+        std::size_t index_bytes {0};   ///< Memory used by the samples indices
+        std::size_t reduced_bytes {0}; ///< Memory used by the reduced precision coordinates
+
+        NodeIndexType node_count {0};           ///< Number of nodes stored in the node container
+        NodeIndexType node_capacity {0};        ///< Capacity of the node container
+        NodeIndexType reachable_node_count {0}; ///< Number of nodes reachable from the root
+        NodeIndexType leaf_count {0};           ///< Number of leaves reachable from the root
+        NodeIndexType empty_leaf_count {0};     ///< Number of leaves without samples
+        /// Number of leaves with several samples at the same position, which cannot be split
+        NodeIndexType degenerate_leaf_count {0};
+
+        /// Number of leaves at each depth, the root being at depth 0
+        std::vector<NodeIndexType> depth_histogram;
+        /// Number of leaves per size: bin 0 counts empty leaves, bin `b > 0` counts leaves with a size in
+        /// \f$[2^{b-1}, 2^b)\f$
+        std::vector<NodeIndexType> leaf_size_histogram;
+
+        Scalar average_leaf_size {0};  ///< Average number of samples per leaf
+        Scalar average_leaf_depth {0}; ///< Average depth of the leaves
+        /// \brief Estimated cost of locating a sample, averaged over the samples
+        ///
+        /// Sum of the number of inner nodes traversed to reach the leaf containing a sample and of the number of
+        /// distance computations in this leaf. Can be compared between trees built with different parameters.
+        Scalar traversal_cost {0};
+
+        /// Total memory used by the kd-tree
+        inline std::size_t total_bytes() const { return point_bytes + node_bytes + index_bytes + reduced_bytes; }
+        /// Memory allocated for nodes that are not reachable from the root
+        inline std::size_t node_slack_bytes() const
+        {
+            return std::size_t(node_capacity - reachable_node_count) * sizeof(NodeType);
+        }
+
+        inline void print(std::ostream& os) const;
+
+        friend std::ostream& operator<<(std::ostream& os, const Stats& stats)
+        {
+            stats.print(os);
+            return os;
+        }
+    };
+
+    /// \brief Statistics of the queries performed on this kd-tree
+    ///
+    /// Statistics are recorded only if the traits define `QueryStatsPolicy` as KdTreeCountQueryStatsPolicy, and are
+    /// zero otherwise. The counters of a query are added when the query object is destroyed.
+    /// \see KdTreeCountQueryStatsPolicy
+    inline KdTreeQueryStats query_stats() const
+    {
+        return m_query_stats.stats();
+    }
+
+    /// Reset the statistics of the queries performed on this kd-tree
+    inline void reset_query_stats()
+    {
+        m_query_stats.reset();
+    }
+
+    /// \brief Compute the memory footprint and structure statistics of the kd-tree
+    ///
+    /// The tree is traversed from the root, so this function is in linear time with respect to the number of samples.
+    /// It can be used to tune \ref set_min_cell_size and the traits for a given memory budget.
+    inline Stats stats() const;
+
     inline bool valid() const;
     inline void print(std::ostream& os, bool verbose = false) const;
 
@@ -301,6 +557,14 @@ protected:
     LeafSizeType m_min_cell_size {64}; ///< Minimal number of points per leaf
     NodeIndexType m_leaf_count {0}; ///< Number of leaves in the Kdtree (computed during construction)
 
+    bool m_reduced_precision {false}; ///< Use reduced precision coordinates during leaf scans
+    ReducedPointContainer m_reduced_points; ///< Reduced precision coordinates, in sample order
+    Scalar m_reduced_magnitude {0}; ///< Largest absolute value of the coordinates
+
+    /// Statistics accumulated by the queries, empty if statistics are disabled
+    mutable internal::KdTreeQueryStatsAccumulator<KdTreeQuery<Traits>::QueryStatsPolicy::ENABLED> m_query_stats;
+    friend class KdTreeQuery<Traits>;
+
     // Internal ----------------------------------------------------------------
 protected:
     inline KdTreeBase() = default;
@@ -329,9 +593,27 @@ protected:
         buildWithSampling(std::forward<PointUserContainer>(points), std::move(sampling), DefaultConverter());
     }
 
+    /// Update the reduced precision coordinates from the samples, must be called when samples are modified
+    inline void update_reduced_points();
+
+    /// Implementation of \ref tune_min_cell_size, using `rebuildFunctor` to rebuild the tree
+    template<typename RebuildFunctor, typename QueryFunctor>
+    inline std::vector<std::pair<LeafSizeType, double>> tune_min_cell_size_impl(
+        RebuildFunctor rebuildFunctor, const std::vector<LeafSizeType>& candidates, QueryFunctor&& query, int repeats);
+
 private:
     inline void build_rec(NodeIndexType node_id, IndexType start, IndexType end, int level);
     inline IndexType partition(IndexType start, IndexType end, int dim, Scalar value);
+
+    /// Refit the subtree of `node_id` covering the samples starting at `start`
+    /// \param end Set to the end of the range of samples covered by the subtree
+    /// \return The bounding box of the subtree
+    inline AabbType refit_rec(NodeIndexType node_id, IndexType start, IndexType& end, int level,
+                              NodeIndexType& rebuild_count);
+    /// Number of leaves in the subtree of `node_id`
+    inline NodeIndexType subtree_leaf_count(NodeIndexType node_id) const;
+    /// Remove the nodes that are not reachable from the root
+    inline void compact_nodes();
 };
 
 /*!
@@ -389,7 +671,7 @@ private:
     using Base = KdTreeBase<Traits>;
 
 public:
-    static constexpr bool SUPPORTS_SUBSAMPLING = false;
+    static constexpr bool SUPPORTS_SUBSAMPLING = true;
 
     /// Default constructor creating an empty tree
     /// \see build
@@ -22,6 +22,55 @@ void KdTreeBase<Traits>::clear()
     m_nodes.clear();
     m_indices.clear();
     m_leaf_count = 0;
+    m_reduced_points.clear();
+    m_reduced_magnitude = 0;
+}
+
+template<typename Traits>
+void KdTreeBase<Traits>::update_reduced_points()
+{
+    m_reduced_points.clear();
+    m_reduced_magnitude = 0;
+    if (!m_reduced_precision)
+        return;
+
+    Scalar magnitude = 0;
+    for (IndexType idx : m_indices)
+        magnitude = std::max(magnitude, m_points[idx].pos().cwiseAbs().maxCoeff());
+
+    // Coordinates (and their differences) must be representable in single precision
+    if (!(magnitude < Scalar(std::numeric_limits<float>::max() / 4)))
+        return;
+
+    const IndexType n = sample_count();
+    m_reduced_points.resize(n);
+#pragma omp parallel for
+    for (IndexType i = 0; i < n; ++i)
+        m_reduced_points[i] = pointDataFromSample(i).pos().template cast<float>();
+    m_reduced_magnitude = magnitude;
+}
+
+template<typename Traits>
+auto KdTreeBase<Traits>::refit() -> NodeIndexType
+{
+    NodeIndexType rebuild_count = 0;
+    if (m_nodes.empty())
+        return rebuild_count;
+
+    IndexType end;
+    refit_rec(0, 0, end, 1, rebuild_count);
+    PONCA_DEBUG_ASSERT(end == sample_count());
+
+    // A full binary tree with n leaves has 2n-1 nodes
+    const NodeIndexType used_count = 2 * m_leaf_count - 1;
+    if (node_count() - used_count > used_count)
+        compact_nodes();
+
+    // Local rebuilds reorder the samples
+    update_reduced_points();
+
+    PONCA_DEBUG_ASSERT(this->valid());
+    return rebuild_count;
 }
 
 template<typename Traits>
@@ -71,6 +120,104 @@ bool KdTreeBase<Traits>::valid() const
     return true;
 }
 
+template<typename Traits>
+auto KdTreeBase<Traits>::stats() const -> Stats
+{
+    Stats s;
+    s.point_bytes   = m_points.size() * sizeof(DataPoint);
+    s.node_bytes    = m_nodes.capacity() * sizeof(NodeType);
+    s.index_bytes   = m_indices.size() * sizeof(IndexType);
+    s.reduced_bytes = m_reduced_points.size() * sizeof(ReducedVectorType);
+    s.node_count    = node_count();
+    s.node_capacity = NodeIndexType(m_nodes.capacity());
+
+    if (m_nodes.empty())
+        return s;
+
+    Scalar depth_sum = 0, cost_sum = 0;
+    std::vector<std::pair<NodeIndexType, int>> stack {{0, 0}};
+    while (!stack.empty())
+    {
+        const auto [node_id, depth] = stack.back();
+        stack.pop_back();
+        ++s.reachable_node_count;
+
+        const NodeType& node = m_nodes[node_id];
+        if (!node.is_leaf())
+        {
+            stack.push_back({node.inner_first_child_id(), depth + 1});
+            stack.push_back({node.inner_first_child_id() + 1, depth + 1});
+            continue;
+        }
+
+        const IndexType size = node.leaf_size();
+        ++s.leaf_count;
+        if (size == 0) ++s.empty_leaf_count;
+
+        if (int(s.depth_histogram.size()) <= depth)
+            s.depth_histogram.resize(depth + 1, 0);
+        ++s.depth_histogram[depth];
+
+        int bin = 0;
+        while (bin < int(sizeof(IndexType) * 8) && (IndexType(1) << bin) <= size) ++bin;
+        if (int(s.leaf_size_histogram.size()) <= bin)
+            s.leaf_size_histogram.resize(bin + 1, 0);
+        ++s.leaf_size_histogram[bin];
+
+        if (size > 1)
+        {
+            AabbType aabb;
+            for (IndexType i = node.leaf_start(); i < node.leaf_start() + size; ++i)
+                aabb.extend(pointDataFromSample(i).pos());
+            if (aabb.diagonal().maxCoeff() == Scalar(0)) ++s.degenerate_leaf_count;
+        }
+
+        depth_sum += Scalar(depth);
+        cost_sum  += Scalar(size) * Scalar(depth + size);
+    }
+
+    s.average_leaf_size  = Scalar(sample_count()) / Scalar(s.leaf_count);
+    s.average_leaf_depth = depth_sum / Scalar(s.leaf_count);
+    if (sample_count() > 0)
+        s.traversal_cost = cost_sum / Scalar(sample_count());
+    return s;
+}
+
+template<typename Traits>
+void KdTreeBase<Traits>::Stats::print(std::ostream& os) const
+{
+    os << "KdTreeStats:";
+    os << "\n  PointBytes: " << point_bytes;
+    os << "\n  NodeBytes: " << node_bytes;
+    os << "\n  IndexBytes: " << index_bytes;
+    os << "\n  ReducedBytes: " << reduced_bytes;
+    os << "\n  TotalBytes: " << total_bytes();
+    os << "\n  NodeCount: " << node_count;
+    os << "\n  NodeCapacity: " << node_capacity;
+    os << "\n  ReachableNodeCount: " << reachable_node_count;
+    os << "\n  NodeSlackBytes: " << node_slack_bytes();
+    os << "\n  LeafCount: " << leaf_count;
+    os << "\n  EmptyLeafCount: " << empty_leaf_count;
+    os << "\n  DegenerateLeafCount: " << degenerate_leaf_count;
+    os << "\n  AverageLeafSize: " << average_leaf_size;
+    os << "\n  AverageLeafDepth: " << average_leaf_depth;
+    os << "\n  TraversalCost: " << traversal_cost;
+
+    os << "\n  DepthHistogram:";
+    for (std::size_t d = 0; d < depth_histogram.size(); ++d)
+        if (depth_histogram[d] > 0)
+            os << "\n    " << d << ": " << depth_histogram[d];
+
+    os << "\n  LeafSizeHistogram:";
+    for (std::size_t b = 0; b < leaf_size_histogram.size(); ++b)
+    {
+        if (leaf_size_histogram[b] == 0) continue;
+        if (b == 0) os << "\n    0: ";
+        else        os << "\n    [" << (std::size_t(1) << (b-1)) << ", " << (std::size_t(1) << b) << "): ";
+        os << leaf_size_histogram[b];
+    }
+}
+
 template<typename Traits>
 void KdTreeBase<Traits>::print(std::ostream& os, bool verbose) const
 {
@@ -128,17 +275,326 @@ inline void KdTreeBase<Traits>::buildWithSampling(PointUserContainer&& points,
     // Move, copy or convert input samples
     c(std::forward<PointUserContainer>(points), m_points);
 
+    m_indices = std::move(sampling);
+
+    this->rebuild();
+}
+
+template<typename Traits>
+void KdTreeBase<Traits>::rebuild()
+{
+    // Splits are at the center of the bounding boxes, so leaves can be arbitrarily small: the reservation is only an
+    // estimate of the node count, the container may still grow during the construction
     m_nodes = NodeContainer();
-    m_nodes.reserve(4 * point_count() / m_min_cell_size);
+    m_nodes.reserve(4 * sample_count() / m_min_cell_size + 1);
     m_nodes.emplace_back();
-
-    m_indices = std::move(sampling);
+    m_leaf_count = 0;
 
     this->build_rec(0, 0, sample_count(), 1);
+    this->update_reduced_points();
 
     PONCA_DEBUG_ASSERT(this->valid());
 }
 
+template<typename Traits>
+template<typename PointIterator>
+auto KdTreeBase<Traits>::insert(PointIterator first, PointIterator last) -> IndexType
+{
+    const IndexType first_index = point_count();
+    for (; first != last; ++first)
+        m_points.push_back(*first);
+    PONCA_DEBUG_ASSERT(m_points.size() <= MAX_POINT_COUNT);
+    const IndexType count = point_count() - first_index;
+    if (count == 0)
+        return first_index;
+
+    if (m_nodes.empty())
+    {
+        for (IndexType i = first_index; i < point_count(); ++i)
+            m_indices.push_back(i);
+        this->rebuild();
+        return first_index;
+    }
+
+    // Leaves in depth-first order, which is the order of their samples
+    std::vector<NodeIndexType> leaves;
+    std::vector<int> leaf_levels;
+    std::vector<NodeIndexType> leaf_ranks(node_count(), -1);
+    std::vector<std::pair<NodeIndexType, int>> stack {{0, 1}};
+    while (!stack.empty())
+    {
+        const auto [node_id, level] = stack.back();
+        stack.pop_back();
+        const NodeType& node = m_nodes[node_id];
+        if (node.is_leaf())
+        {
+            leaf_ranks[node_id] = NodeIndexType(leaves.size());
+            leaves.push_back(node_id);
+            leaf_levels.push_back(level);
+        }
+        else
+        {
+            stack.emplace_back(node.inner_first_child_id()+1, level+1);
+            stack.emplace_back(node.inner_first_child_id(),   level+1);
+        }
+    }
+
+    // Leaf containing each new point, following the splits as the queries do
+    std::vector<std::pair<NodeIndexType, IndexType>> added(count);
+#pragma omp parallel for
+    for (IndexType i = 0; i < count; ++i)
+    {
+        const VectorType& p = m_points[first_index + i].pos();
+        NodeIndexType node_id = 0;
+        while (!m_nodes[node_id].is_leaf())
+        {
+            const NodeType& node = m_nodes[node_id];
+            node_id = node.inner_first_child_id() + (p[node.inner_split_dim()] < node.inner_split_value() ? 0 : 1);
+        }
+        added[i] = {leaf_ranks[node_id], first_index + i};
+    }
+    std::sort(added.begin(), added.end());
+
+    // Samples of each leaf, followed by its new samples. Leaves that are too large are split afterward.
+    struct Range { NodeIndexType node_id; IndexType start, end; int level; };
+    std::vector<Range> split_leaves;
+    IndexContainer indices;
+    indices.reserve(sample_count() + count);
+    auto it = added.begin();
+    for (NodeIndexType r = 0; r < NodeIndexType(leaves.size()); ++r)
+    {
+        NodeType& node = m_nodes[leaves[r]];
+        const IndexType start = indices.size();
+        indices.insert(indices.end(), m_indices.begin() + node.leaf_start(),
+                       m_indices.begin() + node.leaf_start() + node.leaf_size());
+        for (; it != added.end() && it->first == r; ++it)
+            indices.push_back(it->second);
+        const IndexType end = indices.size();
+
+        if (end - start > m_min_cell_size)
+            split_leaves.push_back({leaves[r], start, end, leaf_levels[r]});
+        else
+            node.configure_range(start, end - start, AabbType());
+    }
+    m_indices = std::move(indices);
+
+    for (const Range& leaf : split_leaves)
+    {
+        --m_leaf_count;
+        this->build_rec(leaf.node_id, leaf.start, leaf.end, leaf.level);
+    }
+
+    // Bounding boxes and split values of the ancestors of the modified leaves
+    this->refit();
+    return first_index;
+}
+
+template<typename Traits>
+void KdTreeBase<Traits>::reorder_points(const std::vector<int>& order)
+{
+    const IndexType n = point_count();
+    PONCA_DEBUG_ASSERT(IndexType(order.size()) == n);
+
+    std::vector<IndexType> new_index(n, -1);
+    PointContainer points;
+    points.reserve(n);
+    for (IndexType i = 0; i < n; ++i)
+    {
+        PONCA_DEBUG_ASSERT(order[i] >= 0 && order[i] < n && new_index[order[i]] < 0);
+        new_index[order[i]] = i;
+        points.push_back(m_points[order[i]]);
+    }
+    // Assign to the existing container, which may be referenced (e.g. by a KnnGraph)
+    m_points = std::move(points);
+
+    const IndexType samples = sample_count();
+#pragma omp parallel for
+    for (IndexType s = 0; s < samples; ++s)
+        m_indices[s] = new_index[m_indices[s]];
+}
+
+template<typename Traits>
+template<typename RebuildFunctor, typename QueryFunctor>
+auto KdTreeBase<Traits>::tune_min_cell_size_impl(RebuildFunctor rebuildFunctor,
+                                                 const std::vector<LeafSizeType>& candidates,
+                                                 QueryFunctor&& query, int repeats)
+    -> std::vector<std::pair<LeafSizeType, double>>
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::pair<LeafSizeType, double>> timings;
+    if (candidates.empty())
+        return timings;
+    timings.reserve(candidates.size());
+
+    LeafSizeType best_size = m_min_cell_size;
+    double best_time = std::numeric_limits<double>::infinity();
+    for (LeafSizeType size : candidates)
+    {
+        set_min_cell_size(size);
+        rebuildFunctor();
+
+        double time = std::numeric_limits<double>::infinity();
+        for (int r = 0; r < std::max(repeats, 1); ++r)
+        {
+            const auto start = Clock::now();
+            query(*this);
+            time = std::min(time, std::chrono::duration<double>(Clock::now() - start).count());
+        }
+        timings.emplace_back(size, time);
+
+        if (time < best_time)
+        {
+            best_time = time;
+            best_size = size;
+        }
+    }
+
+    if (best_size != m_min_cell_size)
+    {
+        set_min_cell_size(best_size);
+        rebuildFunctor();
+    }
+    return timings;
+}
+
+template<typename Traits>
+template<typename NeighborFunctor>
+void KdTreeBase<Traits>::for_each_range_neighbors(Scalar r, NeighborFunctor f) const
+{
+    static constexpr int Dim = DataPoint::Dim;
+    // Enlarge the bounds to account for the rounding errors of the distance computations
+    static constexpr Scalar margin = Scalar(1) + Scalar(4 * (Dim + 2)) * std::numeric_limits<Scalar>::epsilon();
+
+    if (m_nodes.empty() || sample_count() == 0)
+        return;
+
+    // Leaves reachable from the root, and their index in this list
+    std::vector<NodeIndexType> leaves;
+    std::vector<int> leaf_slots(m_nodes.size(), -1);
+    std::vector<NodeIndexType> stack {0};
+    while (!stack.empty())
+    {
+        const NodeIndexType node_id = stack.back();
+        stack.pop_back();
+        const NodeType& node = m_nodes[node_id];
+        if (node.is_leaf())
+        {
+            leaf_slots[node_id] = int(leaves.size());
+            leaves.push_back(node_id);
+            continue;
+        }
+        stack.push_back(node.inner_first_child_id() + 1);
+        stack.push_back(node.inner_first_child_id());
+    }
+
+    // Bounding box of the samples of each leaf, empty for empty leaves
+    const int leaf_count = int(leaves.size());
+    std::vector<AabbType> boxes(leaf_count);
+#pragma omp parallel for
+    for (int l = 0; l < leaf_count; ++l)
+    {
+        const NodeType& node = m_nodes[leaves[l]];
+        for (IndexType i = node.leaf_start(); i < node.leaf_start() + node.leaf_size(); ++i)
+            boxes[l].extend(pointDataFromSample(i).pos());
+    }
+
+    // Squared distance between two boxes, or between a point and a box
+    const auto squared_box_distance = [](const VectorType& min, const VectorType& max, const AabbType& box) {
+        return ((box.min() - max).cwiseMax(min - box.max())).cwiseMax(Scalar(0)).squaredNorm();
+    };
+
+    const Scalar squared_radius = r * r;
+    const Scalar squared_reach  = squared_radius * margin;
+    // Distances of the kernel between these bounds may be rounded differently from squaredNorm
+    const Scalar tolerance = Scalar(4 * Dim) * std::numeric_limits<Scalar>::epsilon();
+    const Scalar squared_inner_bound = squared_radius - squared_radius * tolerance;
+    const Scalar squared_bound       = squared_radius + squared_radius * tolerance;
+#pragma omp parallel
+    {
+        std::vector<std::pair<NodeIndexType, Scalar>> node_stack;
+        std::vector<int> candidate_leaves;
+        std::vector<std::size_t> offsets;
+        std::vector<IndexType> candidates, neighbors;
+        std::vector<Scalar> coords, distances;
+
+#pragma omp for schedule(dynamic)
+        for (int l = 0; l < leaf_count; ++l)
+        {
+            const NodeType& leaf = m_nodes[leaves[l]];
+            if (leaf.leaf_size() == 0) continue;
+            const AabbType& box = boxes[l];
+
+            // Leaves whose box is closer than r from the box of the leaf, the split planes bound the cells
+            candidate_leaves.clear();
+            offsets.assign(1, 0);
+            candidates.clear();
+            node_stack.assign(1, {0, Scalar(0)});
+            while (!node_stack.empty())
+            {
+                const auto [node_id, squared_distance] = node_stack.back();
+                node_stack.pop_back();
+                if (squared_distance >= squared_reach) continue;
+
+                const NodeType& node = m_nodes[node_id];
+                if (node.is_leaf())
+                {
+                    const int slot = leaf_slots[node_id];
+                    if (node.leaf_size() == 0 ||
+                        squared_box_distance(box.min(), box.max(), boxes[slot]) >= squared_reach) continue;
+                    candidate_leaves.push_back(slot);
+                    for (IndexType i = node.leaf_start(); i < node.leaf_start() + node.leaf_size(); ++i)
+                        candidates.push_back(pointFromSample(i));
+                    offsets.push_back(candidates.size());
+                    continue;
+                }
+
+                const int dim = node.inner_split_dim();
+                const Scalar split = Scalar(node.inner_split_value());
+                const Scalar left_gap  = std::max(box.min()[dim] - split, Scalar(0));
+                const Scalar right_gap = std::max(split - box.max()[dim], Scalar(0));
+                const NodeIndexType first = node.inner_first_child_id();
+                node_stack.push_back({first + 1, std::max(squared_distance, right_gap * right_gap)});
+                node_stack.push_back({first, std::max(squared_distance, left_gap * left_gap)});
+            }
+
+            // Structure of arrays: coordinates of the candidates, one array per dimension
+            const std::size_t count = candidates.size();
+            coords.resize(std::size_t(Dim) * count);
+            distances.resize(count);
+            for (std::size_t m = 0; m < count; ++m)
+            {
+                const VectorType& p = m_points[candidates[m]].pos();
+                for (int d = 0; d < Dim; ++d)
+                    coords[std::size_t(d) * count + m] = p[d];
+            }
+
+            for (IndexType s = leaf.leaf_start(); s < leaf.leaf_start() + leaf.leaf_size(); ++s)
+            {
+                const IndexType point_index = pointFromSample(s);
+                const VectorType query = m_points[point_index].pos();
+
+                // Candidates are processed by blocks of samples of the same leaf, skipping the leaves that are too far
+                neighbors.clear();
+                for (std::size_t c = 0; c < candidate_leaves.size(); ++c)
+                {
+                    if (squared_box_distance(query, query, boxes[candidate_leaves[c]]) >= squared_reach) continue;
+
+                    const std::size_t b = offsets[c], block = offsets[c + 1] - b;
+                    internal::squared_distances_soa<Dim>(coords.data() + b, count, block, query.data(), distances.data() + b);
+                    // Distances close to the radius are computed again, as by range_neighbors
+                    for (std::size_t m = b; m < b + block; ++m)
+                        if (distances[m] < squared_bound && candidates[m] != point_index &&
+                            (distances[m] < squared_inner_bound ||
+                             (query - m_points[candidates[m]].pos()).squaredNorm() < squared_radius))
+                            neighbors.push_back(candidates[m]);
+                }
+                f(point_index, neighbors);
+            }
+        }
+    }
+}
+
 template<typename Traits>
 void KdTreeBase<Traits>::build_rec(NodeIndexType node_id, IndexType start, IndexType end, int level)
 {
@@ -163,14 +619,106 @@ void KdTreeBase<Traits>::build_rec(NodeIndexType node_id, IndexType start, Index
     {
         int split_dim = 0;
         (Scalar(0.5) * aabb.diagonal()).maxCoeff(&split_dim);
-        node.configure_inner(aabb.center()[split_dim], m_nodes.size(), split_dim);
+        const Scalar split_value = aabb.center()[split_dim];
+        const NodeIndexType first_child_id = m_nodes.size();
+        node.configure_inner(split_value, first_child_id, split_dim);
+        // `node` is invalidated if the container is reallocated
         m_nodes.emplace_back();
         m_nodes.emplace_back();
 
-        IndexType mid_id = this->partition(start, end, split_dim, node.inner_split_value());
-        build_rec(node.inner_first_child_id(), start, mid_id, level+1);
-        build_rec(node.inner_first_child_id()+1, mid_id, end, level+1);
+        IndexType mid_id = this->partition(start, end, split_dim, split_value);
+        build_rec(first_child_id, start, mid_id, level+1);
+        build_rec(first_child_id+1, mid_id, end, level+1);
+    }
+}
+
+template<typename Traits>
+auto KdTreeBase<Traits>::refit_rec(NodeIndexType node_id, IndexType start, IndexType& end, int level,
+                                   NodeIndexType& rebuild_count) -> AabbType
+{
+    AabbType aabb;
+    if (m_nodes[node_id].is_leaf())
+    {
+        NodeType& node = m_nodes[node_id];
+        PONCA_DEBUG_ASSERT(node.leaf_start() == start);
+        end = start + node.leaf_size();
+        for(IndexType i=start; i<end; ++i)
+            aabb.extend(m_points[m_indices[i]].pos());
+        node.configure_range(start, end-start, aabb);
+        return aabb;
+    }
+
+    // Copy node data: rebuilding subtrees may reallocate the node container
+    const NodeIndexType first_child_id = m_nodes[node_id].inner_first_child_id();
+    const int split_dim = m_nodes[node_id].inner_split_dim();
+    Scalar split_value = m_nodes[node_id].inner_split_value();
+
+    IndexType mid;
+    const AabbType left  = refit_rec(first_child_id,   start, mid, level+1, rebuild_count);
+    const AabbType right = refit_rec(first_child_id+1, mid,   end, level+1, rebuild_count);
+    aabb = left.merged(right);
+
+    // Points on the left must lie strictly below the split value, and points on the right above or on it
+    bool separable = true;
+    if (!left.isEmpty() && !right.isEmpty())
+    {
+        const Scalar lo = left.max()[split_dim];
+        const Scalar hi = right.min()[split_dim];
+        separable = lo < hi;
+        if (separable)
+        {
+            split_value = Scalar(0.5) * (lo + hi);
+            if (!(lo < split_value)) split_value = hi;
+        }
+    }
+    else if (!right.isEmpty())
+        split_value = std::min(split_value, right.min()[split_dim]);
+    else if (!left.isEmpty() && !(left.max()[split_dim] < split_value))
+        separable = false;
+
+    if (separable)
+    {
+        NodeType& node = m_nodes[node_id];
+        node.configure_range(start, end-start, aabb);
+        node.configure_inner(split_value, first_child_id, split_dim);
+    }
+    else
+    {
+        // Children nodes are left unused, and new nodes are appended to the container
+        m_leaf_count -= subtree_leaf_count(node_id);
+        build_rec(node_id, start, end, level);
+        ++rebuild_count;
+    }
+    return aabb;
+}
+
+template<typename Traits>
+auto KdTreeBase<Traits>::subtree_leaf_count(NodeIndexType node_id) const -> NodeIndexType
+{
+    const NodeType& node = m_nodes[node_id];
+    if (node.is_leaf())
+        return 1;
+    return subtree_leaf_count(node.inner_first_child_id()) + subtree_leaf_count(node.inner_first_child_id()+1);
+}
+
+template<typename Traits>
+void KdTreeBase<Traits>::compact_nodes()
+{
+    // Breadth-first copy of the reachable nodes, keeping siblings next to each other
+    NodeContainer nodes;
+    nodes.reserve(2 * m_leaf_count - 1);
+    nodes.push_back(m_nodes[0]);
+    for (NodeIndexType n = 0; n < (NodeIndexType)nodes.size(); ++n)
+    {
+        if (nodes[n].is_leaf()) continue;
+
+        const NodeIndexType first_child_id = nodes[n].inner_first_child_id();
+        const NodeIndexType new_first_child_id = nodes.size();
+        nodes[n].configure_inner(nodes[n].inner_split_value(), new_first_child_id, nodes[n].inner_split_dim());
+        nodes.push_back(m_nodes[first_child_id]);
+        nodes.push_back(m_nodes[first_child_id+1]);
     }
+    m_nodes = std::move(nodes);
 }
 
 template<typename Traits>
@@ -0,0 +1,176 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./kdTree.h"
+#include "../mortonCode.h"
+
+#include <cstdint>
+
+namespace Ponca {
+template <typename Traits, typename CodeType> class KdTreeMortonBase;
+
+/*!
+ * \brief Public interface for KdTree datastructure built from Morton codes.
+ *
+ * Provides default implementation of the Morton KdTree, using 64 bits codes (i.e., 21 bits per coordinate in 3D).
+ *
+ * \see KdTreeDefaultTraits for the default trait interface documentation.
+ * \see KdTreeMortonBase for complete API
+ */
+#ifdef PARSED_WITH_DOXYGEN
+/// [KdTreeMorton type definition]
+template <typename DataPoint>
+struct KdTreeMorton : public Ponca::KdTreeMortonBase<KdTreeDefaultTraits<DataPoint>, std::uint64_t>{};
+/// [KdTreeMorton type definition]
+#else
+template <typename DataPoint>
+using KdTreeMorton = KdTreeMortonBase<KdTreeDefaultTraits<DataPoint>, std::uint64_t>;
+#endif
+
+/*!
+ * \brief Customizable base class for KdTree datastructure built from Morton codes
+ *
+ * This KdTree is built as a linear BVH: samples are sorted along the Morton (Z-order) curve using a parallel LSD
+ * radix sort, and the hierarchy is derived from the sorted codes: each inner node splits its range at the most
+ * significant bit differing between its first and last codes. This bit corresponds to an axis-aligned cell boundary of
+ * the quantization grid, which is stored as the split plane of the node.
+ *
+ * The resulting tree shares the node layout of \ref KdTreeBase, so all the queries defined in \ref query.h
+ * (k-nearest neighbors, nearest neighbor, range neighbors) are available and return exact results. The construction
+ * cost is dominated by the code computation and the radix sort, both in linear time, instead of the
+ * \f$O(n \log n)\f$ recursive partitioning used by \ref KdTreeDenseBase. The resulting tree is usually a bit less
+ * balanced, as split planes are restricted to the quantization grid.
+ *
+ * Subsampling is supported, as for \ref KdTreeSparseBase.
+ *
+ * \warning `build` functions are not virtual: calling them through a pointer to KdTreeBase performs the standard
+ * recursive construction.
+ *
+ * \tparam Traits Traits type providing the types and constants used by the kd-tree. Must have the
+ * same interface as the default traits type.
+ * \tparam CodeType Unsigned integer type used to store the Morton codes (e.g. 30 bits codes in 3D with
+ * `std::uint32_t`, 63 bits codes in 3D with `std::uint64_t`).
+ *
+ * \see KdTreeDefaultTraits for the trait interface documentation.
+ */
+template <typename Traits, typename CodeType = std::uint64_t>
+class KdTreeMortonBase : public KdTreeBase<Traits>
+{
+private:
+    using Base = KdTreeBase<Traits>;
+
+public:
+    using DataPoint      = typename Base::DataPoint;
+    using IndexType      = typename Base::IndexType;
+    using NodeIndexType  = typename Base::NodeIndexType;
+    using NodeType       = typename Base::NodeType;
+    using NodeContainer  = typename Base::NodeContainer;
+    using IndexContainer = typename Base::IndexContainer;
+    using Scalar         = typename Base::Scalar;
+    using VectorType     = typename Base::VectorType;
+    using AabbType       = typename Base::AabbType;
+    using DefaultConverter = typename Base::DefaultConverter;
+
+    /// Helper type used to compute and manipulate Morton codes
+    using MortonCode = internal::MortonCode<CodeType, DataPoint::Dim>;
+
+    static constexpr bool SUPPORTS_SUBSAMPLING = true;
+
+    /// Default constructor creating an empty tree
+    /// \see build
+    KdTreeMortonBase() = default;
+
+    /// Constructor generating a tree from a custom contained type converted using a \ref KdTreeBase::DefaultConverter
+    template<typename PointUserContainer>
+    inline explicit KdTreeMortonBase(PointUserContainer&& points)
+        : Base()
+    {
+        this->build(std::forward<PointUserContainer>(points));
+    }
+
+    /// Constructor generating a tree sampled from a custom contained type converted using a \ref KdTreeBase::DefaultConverter
+    /// \tparam PointUserContainer Input points, transformed to PointContainer
+    /// \tparam IndexUserContainer Input sampling, transformed to IndexContainer
+    /// \param point Input points
+    /// \param sampling Samples used in the tree
+    template<typename PointUserContainer, typename IndexUserContainer>
+    inline KdTreeMortonBase(PointUserContainer&& points, IndexUserContainer sampling)
+        : Base()
+    {
+        this->buildWithSampling(std::forward<PointUserContainer>(points), std::move(sampling));
+    }
+
+    /// Generate a tree from a custom contained type converted using the specified converter
+    /// \tparam PointUserContainer Input point container, transformed to PointContainer
+    /// \param points Input points
+    /// \param c Cast/Convert input point type to DataType
+    template<typename PointUserContainer, typename Converter>
+    inline void build(PointUserContainer&& points, Converter c)
+    {
+        IndexContainer ids(points.size());
+        std::iota(ids.begin(), ids.end(), 0);
+        this->buildWithSampling(std::forward<PointUserContainer>(points), std::move(ids), std::move(c));
+    }
+
+    /// Generate a tree from a custom contained type converted using DefaultConverter
+    /// \tparam PointUserContainer Input point container, transformed to PointContainer
+    /// \param points Input points
+    template<typename PointUserContainer>
+    inline void build(PointUserContainer&& points)
+    {
+        build(std::forward<PointUserContainer>(points), DefaultConverter());
+    }
+
+    /// Generate a tree sampled from a custom contained type converted using a `Converter`
+    /// \tparam PointUserContainer Input point, transformed to PointContainer
+    /// \tparam IndexUserContainer Input sampling, transformed to IndexContainer
+    /// \tparam Converter
+    /// \param points Input points
+    /// \param sampling Indices of points used in the tree
+    /// \param c Cast/Convert input point type to DataType
+    template<typename PointUserContainer, typename IndexUserContainer, typename Converter>
+    inline void buildWithSampling(PointUserContainer&& points,
+                                  IndexUserContainer sampling,
+                                  Converter c);
+
+    /// Generate a tree sampled from a custom contained type converted using a \ref KdTreeBase::DefaultConverter
+    /// \tparam PointUserContainer Input points, transformed to PointContainer
+    /// \tparam IndexUserContainer Input sampling, transformed to IndexContainer
+    /// \param points Input points
+    /// \param sampling Samples used in the tree
+    template<typename PointUserContainer, typename IndexUserContainer>
+    inline void buildWithSampling(PointUserContainer&& points,
+                                  IndexUserContainer sampling)
+    {
+        buildWithSampling(std::forward<PointUserContainer>(points), std::move(sampling), DefaultConverter());
+    }
+
+    /// Rebuild the tree hierarchy from the current points and samples, sorting them again along the Morton curve
+    /// \see KdTreeBase::rebuild
+    inline void rebuild();
+
+    /// Select the minimal cell size giving the fastest queries, rebuilding the tree from Morton codes
+    /// \see KdTreeBase::tune_min_cell_size
+    template<typename QueryFunctor>
+    inline auto tune_min_cell_size(const std::vector<typename Base::LeafSizeType>& candidates,
+                                   QueryFunctor&& query, int repeats = 3)
+    {
+        return this->tune_min_cell_size_impl([this]() { rebuild(); }, candidates,
+                                             std::forward<QueryFunctor>(query), repeats);
+    }
+
+private:
+    using Grid = internal::MortonGrid<Scalar, VectorType, CodeType, DataPoint::Dim>;
+
+    /// Build the subtree of `node_id` from the sorted codes in [start, end), and return its bounding box
+    inline AabbType build_rec(NodeIndexType node_id, IndexType start, IndexType end, int level,
+                              const std::vector<CodeType>& codes, const Grid& grid);
+};
+
+#include "./kdTreeMorton.hpp"
+} // namespace Ponca
@@ -0,0 +1,115 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+// KdTreeMorton ----------------------------------------------------------------
+
+template<typename Traits, typename CodeType>
+template<typename PointUserContainer, typename IndexUserContainer, typename Converter>
+inline void KdTreeMortonBase<Traits, CodeType>::buildWithSampling(PointUserContainer&& points,
+                                                                  IndexUserContainer sampling,
+                                                                  Converter c)
+{
+    PONCA_DEBUG_ASSERT(points.size() <= Base::MAX_POINT_COUNT);
+    this->clear();
+
+    // Move, copy or convert input samples
+    c(std::forward<PointUserContainer>(points), this->m_points);
+
+    this->m_indices = std::move(sampling);
+
+    rebuild();
+}
+
+template<typename Traits, typename CodeType>
+inline void KdTreeMortonBase<Traits, CodeType>::rebuild()
+{
+    this->m_nodes = NodeContainer();
+    this->m_nodes.reserve(4 * this->sample_count() / this->m_min_cell_size + 1);
+    this->m_nodes.emplace_back();
+    this->m_leaf_count = 0;
+
+    const IndexType n = this->sample_count();
+    const auto& pts = this->m_points;
+    auto& ids = this->m_indices;
+
+    // Quantization grid covering the samples
+    AabbType aabb;
+    for (IndexType i = 0; i < n; ++i)
+        aabb.extend(pts[ids[i]].pos());
+
+    Grid grid;
+    if (n > 0) grid.setBounds(aabb);
+
+    // Compute codes and sort samples along the Morton curve
+    std::vector<CodeType> codes(n);
+#pragma omp parallel for
+    for (IndexType i = 0; i < n; ++i)
+        codes[i] = grid.encode(pts[ids[i]].pos());
+
+    internal::radixSortByKey(codes, ids, MortonCode::CODE_BITS);
+
+    build_rec(0, 0, n, 1, codes, grid);
+    this->update_reduced_points();
+
+    PONCA_DEBUG_ASSERT(this->valid());
+}
+
+template<typename Traits, typename CodeType>
+auto KdTreeMortonBase<Traits, CodeType>::build_rec(NodeIndexType node_id, IndexType start, IndexType end, int level,
+                                                   const std::vector<CodeType>& codes, const Grid& grid)
+    -> AabbType
+{
+    const auto& pts = this->m_points;
+    const auto& ids = this->m_indices;
+
+    // Samples sharing the same code cannot be separated
+    const bool is_leaf =
+        end-start <= this->m_min_cell_size ||
+        level >= Traits::MAX_DEPTH ||
+        codes[start] == codes[end-1] ||
+        // Since we add 2 nodes per inner node we need to stop if we can't add
+        // them both
+        (NodeIndexType)this->m_nodes.size() > Base::MAX_NODE_COUNT - 2;
+
+    this->m_nodes[node_id].set_is_leaf(is_leaf);
+
+    AabbType aabb;
+    if (is_leaf)
+    {
+        for (IndexType i = start; i < end; ++i)
+            aabb.extend(pts[ids[i]].pos());
+        this->m_nodes[node_id].configure_range(start, end-start, aabb);
+        ++this->m_leaf_count;
+        return aabb;
+    }
+
+    // Split at the most significant bit differing in the range. Codes share the same prefix above this bit, so the
+    // samples with this bit set form the end of the range.
+    const int bit = MortonCode::highestBit(codes[start] ^ codes[end-1]);
+    const CodeType mask = CodeType(1) << bit;
+    const IndexType mid = IndexType(std::partition_point(codes.begin() + start, codes.begin() + end,
+                                                         [mask](CodeType code) { return (code & mask) == 0; })
+                                    - codes.begin());
+
+    // Cell boundary corresponding to the split bit: samples on the right side have a quantized coordinate greater or
+    // equal than the boundary, which is equivalent to having a position greater or equal than the split value.
+    const int split_dim = MortonCode::bitDim(bit);
+    const int split_level = MortonCode::bitLevel(bit);
+    const CodeType q = grid.quantize(split_dim, pts[ids[mid]].pos()[split_dim]);
+    const Scalar split_value = grid.boundary(split_dim, (q >> split_level) << split_level);
+
+    const NodeIndexType first_child_id = this->m_nodes.size();
+    this->m_nodes.emplace_back();
+    this->m_nodes.emplace_back();
+
+    aabb.extend(build_rec(first_child_id, start, mid, level+1, codes, grid));
+    aabb.extend(build_rec(first_child_id+1, mid, end, level+1, codes, grid));
+
+    NodeType& node = this->m_nodes[node_id];
+    node.configure_range(start, end-start, aabb);
+    node.configure_inner(split_value, first_child_id, split_dim);
+    return aabb;
+}
@@ -10,6 +10,7 @@
 #include "../../Common/Macro.h"
 
 #include <cstddef>
+#include <new>
 
 #include <Eigen/Geometry>
 
@@ -130,6 +131,21 @@ public:
      * `DataPoint::VectorType`.
      */
     using AabbType = Eigen::AlignedBox<Scalar, DataPoint::Dim>;
+
+    KdTreeCustomizableNode() = default;
+
+    /// Copy the active member of the node data, according to the node type
+    KdTreeCustomizableNode(const KdTreeCustomizableNode& other) : m_is_leaf(other.m_is_leaf)
+    {
+        copy_data(other);
+    }
+
+    KdTreeCustomizableNode& operator=(const KdTreeCustomizableNode& other)
+    {
+        m_is_leaf = other.m_is_leaf;
+        copy_data(other);
+        return *this;
+    }
     
     [[nodiscard]] bool is_leaf() const { return m_is_leaf; }
     void set_is_leaf(bool is_leaf) { m_is_leaf = is_leaf; }
@@ -211,6 +227,14 @@ protected:
     [[nodiscard]] inline const InnerType& getAsInner() const { return data.m_inner; }
 
 private:
+    inline void copy_data(const KdTreeCustomizableNode& other)
+    {
+        if (other.m_is_leaf)
+            new (&data.m_leaf) LeafType(other.data.m_leaf);
+        else
+            new (&data.m_inner) InnerType(other.data.m_inner);
+    }
+
     bool m_is_leaf{true};
     union Data
     {
@@ -279,5 +303,7 @@ struct KdTreeDefaultTraits
     using NodeIndexType = std::size_t;
     using NodeType      = _NodeType<IndexType, NodeIndexType, DataPoint, LeafSizeType>;
     using NodeContainer = std::vector<NodeType>;
+
+    // Traits can optionally define `QueryStatsPolicy` to record query statistics, see KdTreeCountQueryStatsPolicy
 };
 } // namespace Ponca
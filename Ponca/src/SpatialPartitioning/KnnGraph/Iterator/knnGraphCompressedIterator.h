@@ -0,0 +1,124 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace Ponca {
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /// Map signed integers to unsigned integers, small magnitudes giving small values: 0, -1, 1, -2, 2...
+    inline std::uint32_t zigzag_encode(std::int32_t value)
+    {
+        return (std::uint32_t(value) << 1) ^ std::uint32_t(value >> 31);
+    }
+    inline std::int32_t zigzag_decode(std::uint32_t value)
+    {
+        return std::int32_t(value >> 1) ^ -std::int32_t(value & 1);
+    }
+
+    /// Number of bytes of the variable-byte encoding of `value`, 7 bits per byte
+    inline int varint_size(std::uint32_t value)
+    {
+        int size = 1;
+        while (value >= 0x80) { value >>= 7; ++size; }
+        return size;
+    }
+    /// Write the variable-byte encoding of `value` at `out`, and return the end of the written bytes
+    inline std::uint8_t* varint_encode(std::uint32_t value, std::uint8_t* out)
+    {
+        while (value >= 0x80)
+        {
+            *out++ = std::uint8_t(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = std::uint8_t(value);
+        return out;
+    }
+    /// Read a variable-byte encoded value at `in`, and advance `in` after it
+    inline std::uint32_t varint_decode(const std::uint8_t*& in)
+    {
+        std::uint32_t value = *in & 0x7f;
+        int shift = 7;
+        while (*in++ & 0x80)
+        {
+            value |= std::uint32_t(*in & 0x7f) << shift;
+            shift += 7;
+        }
+        return value;
+    }
+}
+#endif
+
+/*!
+ * \brief Iterator over the neighbors of a vertex in a KnnGraphCompressedBase, decoded on the fly
+ *
+ * Each neighbor is stored as the difference between its vertex index and the index of the row vertex, zigzag and
+ * variable-byte encoded. Dereferencing gives the point index of the neighbor.
+ */
+template <typename IndexType>
+class KnnGraphCompressedIterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = IndexType;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const IndexType*;
+    using reference         = IndexType;
+
+    inline KnnGraphCompressedIterator() = default;
+
+    /// \param data Encoded row
+    /// \param count Number of neighbors to decode, 0 for the end iterator
+    /// \param vertex Vertex of the row
+    /// \param vertexPoints Point index of each vertex, nullptr if vertex and point indices are equal
+    inline KnnGraphCompressedIterator(const std::uint8_t* data, int count, IndexType vertex,
+                                      const IndexType* vertexPoints)
+        : m_data(data), m_remaining(count), m_vertex(vertex), m_vertexPoints(vertexPoints)
+    {
+        decode();
+    }
+
+    inline reference operator*() const { return m_value; }
+
+    inline KnnGraphCompressedIterator& operator++()
+    {
+        --m_remaining;
+        decode();
+        return *this;
+    }
+    inline KnnGraphCompressedIterator operator++(int)
+    {
+        KnnGraphCompressedIterator it = *this;
+        ++(*this);
+        return it;
+    }
+
+    /// Iterators of the same row are compared by the number of remaining neighbors
+    inline bool operator==(const KnnGraphCompressedIterator& other) const { return m_remaining == other.m_remaining; }
+    inline bool operator!=(const KnnGraphCompressedIterator& other) const { return m_remaining != other.m_remaining; }
+
+private:
+    inline void decode()
+    {
+        if (m_remaining <= 0) return;
+        const IndexType vertex = IndexType(m_vertex + internal::zigzag_decode(internal::varint_decode(m_data)));
+        m_value = m_vertexPoints ? m_vertexPoints[vertex] : vertex;
+    }
+
+    const std::uint8_t* m_data {nullptr};
+    int m_remaining {0};
+    IndexType m_vertex {0};
+    IndexType m_value {-1};
+    const IndexType* m_vertexPoints {nullptr};
+};
+
+} // namespace Ponca
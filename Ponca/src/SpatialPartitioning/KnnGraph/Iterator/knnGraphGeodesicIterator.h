@@ -0,0 +1,49 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+namespace Ponca {
+
+template <typename Traits>
+class KnnGraphGeodesicQuery;
+
+template <typename Traits>
+class KnnGraphGeodesicIterator
+{
+protected:
+    friend class KnnGraphGeodesicQuery<Traits>;
+
+public:
+    using Scalar = typename Traits::DataPoint::Scalar;
+
+    inline KnnGraphGeodesicIterator(KnnGraphGeodesicQuery<Traits>* query, int index = -1) : m_query(query), m_index(index) {}
+
+public:
+    bool operator != (const KnnGraphGeodesicIterator& other) const{
+        return m_index != other.m_index;
+    }
+
+    void operator ++ (){
+        m_query->advance(*this);
+    }
+
+    int  operator *  () const{
+        return m_index;
+    }
+
+    /// \brief Geodesic distance between the query point and the current point
+    Scalar distance() const{
+        return m_distance;
+    }
+
+protected:
+    KnnGraphGeodesicQuery<Traits>* m_query {nullptr};
+    int m_index {-1};
+    Scalar m_distance {0};
+};
+
+} // namespace Ponca
@@ -9,16 +9,19 @@
 namespace Ponca {
 
 template <typename Traits>
+class KnnGraphBase;
+
+template <typename Traits, typename Graph>
 class KnnGraphRangeQuery;
 
-template <typename Traits>
+template <typename Traits, typename Graph = KnnGraphBase<Traits>>
 class KnnGraphRangeIterator
 {
 protected:
-    friend class KnnGraphRangeQuery<Traits>;
+    friend class KnnGraphRangeQuery<Traits, Graph>;
 
 public:
-    inline KnnGraphRangeIterator(KnnGraphRangeQuery<Traits>* query, int index = -1) : m_query(query), m_index(index) {}
+    inline KnnGraphRangeIterator(KnnGraphRangeQuery<Traits, Graph>* query, int index = -1) : m_query(query), m_index(index) {}
 
 public:
     bool operator != (const KnnGraphRangeIterator& other) const{
@@ -34,7 +37,7 @@ public:
     }
 
 protected:
-    KnnGraphRangeQuery<Traits>* m_query {nullptr};
+    KnnGraphRangeQuery<Traits, Graph>* m_query {nullptr};
     int m_index {-1};
 };
 
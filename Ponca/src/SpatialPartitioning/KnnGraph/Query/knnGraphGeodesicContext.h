@@ -0,0 +1,214 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "../../../Common/Macro.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Ponca {
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /*!
+     * \brief Monotone priority queue of points sorted by non-negative distances (Ahuja et al. 1990)
+     *
+     * Distances are compared through the bits of their double precision representation, which are ordered as the
+     * distances when they are non-negative. An element is stored in the bucket given by the highest bit that differs
+     * from the last extracted key, so that it is moved at most 64 times before being extracted. Pushed distances must
+     * not be smaller than the last extracted one, which holds for Dijkstra's algorithm.
+     */
+    class RadixHeap
+    {
+    public:
+        using Key = std::uint64_t;
+
+        inline bool empty() const { return m_size == 0; }
+        inline std::size_t size() const { return m_size; }
+
+        /// Remove all the elements, keeping the memory of the buckets
+        inline void clear()
+        {
+            for (auto& bucket : m_buckets)
+                bucket.clear();
+            m_size = 0;
+            m_last = 0;
+        }
+
+        inline void push(double distance, int value)
+        {
+            const Key k = key(distance);
+            PONCA_DEBUG_ASSERT(distance >= 0 && k >= m_last);
+            m_buckets[bucket(k)].emplace_back(k, value);
+            ++m_size;
+        }
+
+        /// Remove an element with the smallest distance, and return its distance and its value
+        inline std::pair<double, int> pop()
+        {
+            PONCA_DEBUG_ASSERT(!empty());
+            if (m_buckets[0].empty())
+            {
+                // Redistribute the first non-empty bucket from its minimum, the elements fall in lower buckets
+                int b = 1;
+                while (m_buckets[b].empty()) ++b;
+                auto& elements = m_buckets[b];
+                m_last = std::min_element(elements.begin(), elements.end())->first;
+                for (const auto& e : elements)
+                    m_buckets[bucket(e.first)].push_back(e);
+                elements.clear();
+            }
+            const auto e = m_buckets[0].back();
+            m_buckets[0].pop_back();
+            --m_size;
+
+            double distance;
+            std::memcpy(&distance, &e.first, sizeof(distance));
+            return {distance, e.second};
+        }
+
+    private:
+        static inline Key key(double distance)
+        {
+            Key k;
+            std::memcpy(&k, &distance, sizeof(k));
+            return k;
+        }
+
+        /// 0 for the last extracted key, otherwise 1 + the highest bit differing from it
+        inline int bucket(Key k) const
+        {
+            Key x = k ^ m_last;
+            if (x == 0) return 0;
+#if PONCA_HAS_BUILTIN_CLZ
+            return 64 - __builtin_clzll(x);
+#else
+            int b = 0;
+            for (; x != 0; x >>= 1) ++b;
+            return b;
+#endif
+        }
+
+        std::array<std::vector<std::pair<Key, int>>, 65> m_buckets;
+        std::size_t m_size {0};
+        Key m_last {0};
+    };
+}
+#endif
+
+/*!
+ * \brief Reusable memory of the KnnGraph geodesic traversals
+ *
+ * Stores the tentative geodesic distance of each point and the priority queue of Dijkstra's algorithm. As with
+ * KnnGraphTraversalContext, the points reached and settled by the current traversal are marked with its epoch, so
+ * that the arrays are never cleared and the queries do not allocate once they reached the size of the point cloud.
+ *
+ * A context can only be used by one traversal at a time. By default, KnnGraphGeodesicQuery takes a context from a
+ * pool owned by the current thread for the duration of its iteration, as KnnGraphRangeQuery does.
+ *
+ * \see KnnGraphBase::geodesic_neighbors
+ */
+class KnnGraphGeodesicContext
+{
+public:
+    using Stamp = std::uint32_t;
+
+    /// \brief Context owned by the calling thread and not in use, used by default by the geodesic queries
+    static inline KnnGraphGeodesicContext& thread_context()
+    {
+        thread_local std::vector<std::unique_ptr<KnnGraphGeodesicContext>> pool;
+        for (const auto& context : pool)
+            if (!context->busy()) return *context;
+        pool.push_back(std::make_unique<KnnGraphGeodesicContext>());
+        return *pool.back();
+    }
+
+    /// \brief Is a traversal currently using this context
+    inline bool busy() const { return m_busy; }
+
+    /// \brief Number of points that can be visited without reallocation
+    inline std::size_t capacity() const { return m_reached.size(); }
+
+    /// \brief Release the memory of the context
+    inline void clear()
+    {
+        PONCA_DEBUG_ASSERT(!m_busy);
+        m_reached   = std::vector<Stamp>();
+        m_settled   = std::vector<Stamp>();
+        m_distances = std::vector<double>();
+        m_heap      = internal::RadixHeap();
+        m_epoch     = 0;
+    }
+
+#ifndef PARSED_WITH_DOXYGEN
+    inline void acquire()
+    {
+        PONCA_DEBUG_ASSERT(!m_busy);
+        m_busy = true;
+    }
+    inline void release() { m_busy = false; }
+
+    /// \brief Start a new traversal on a point cloud of `pointCount` points: no point is reached, the queue is empty
+    inline void start(int pointCount)
+    {
+        if (m_reached.size() < std::size_t(pointCount))
+        {
+            m_reached.resize(pointCount, 0);
+            m_settled.resize(pointCount, 0);
+            m_distances.resize(pointCount, 0);
+        }
+        if (++m_epoch == 0)
+        {
+            std::fill(m_reached.begin(), m_reached.end(), 0);
+            std::fill(m_settled.begin(), m_settled.end(), 0);
+            m_epoch = 1;
+        }
+        m_heap.clear();
+    }
+
+    /// \brief Set the distance of the point `index` to `distance` if it is smaller than its current distance
+    /// \return false if the point was already reached with a smaller or equal distance
+    inline bool relax(int index, double distance)
+    {
+        PONCA_DEBUG_ASSERT(index >= 0 && std::size_t(index) < m_reached.size());
+        if (m_reached[index] == m_epoch && m_distances[index] <= distance) return false;
+        m_reached[index]   = m_epoch;
+        m_distances[index] = distance;
+        m_heap.push(distance, index);
+        return true;
+    }
+
+    /// \brief Mark the point `index` as settled: its distance is final
+    /// \return false if the point was already settled by the current traversal
+    inline bool settle(int index)
+    {
+        if (m_settled[index] == m_epoch) return false;
+        m_settled[index] = m_epoch;
+        return true;
+    }
+
+    inline internal::RadixHeap& heap() { return m_heap; }
+#endif
+
+private:
+    std::vector<Stamp>  m_reached;   ///< Epoch of the last traversal that reached each point
+    std::vector<Stamp>  m_settled;   ///< Epoch of the last traversal that settled each point
+    std::vector<double> m_distances; ///< Tentative distance of the points reached by the current traversal
+    internal::RadixHeap m_heap;      ///< Reached points that are not settled, by increasing distance
+    Stamp m_epoch {0};
+    bool  m_busy {false};
+};
+
+} // namespace Ponca
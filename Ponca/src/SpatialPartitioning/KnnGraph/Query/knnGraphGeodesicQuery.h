@@ -0,0 +1,137 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "../../query.h"
+#include "../Iterator/knnGraphGeodesicIterator.h"
+#include "./knnGraphGeodesicContext.h"
+
+namespace Ponca {
+
+template <typename Traits>
+class KnnGraphBase;
+
+/*!
+ * \brief Geodesic range query in a KnnGraph, from a vertex of the graph
+ *
+ * Points are reached by Dijkstra's algorithm along the rows of the graph, each edge being as long as the Euclidean
+ * distance between its points. They are returned by increasing geodesic distance, which is given by
+ * KnnGraphGeodesicIterator::distance, up to the radius of the query. The tentative distances and the priority queue
+ * are stored in a KnnGraphGeodesicContext, taken by \ref begin and given back when the iteration reaches \ref end or
+ * when the query is destroyed. An iteration must happen on a single thread.
+ */
+template <typename Traits>
+class KnnGraphGeodesicQuery : public RangeIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>
+{
+protected:
+    using QueryType = RangeIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>;
+    friend class KnnGraphGeodesicIterator<Traits>; // This type must be equal to KnnGraphGeodesicQuery::Iterator
+
+public:
+    using DataPoint  = typename Traits::DataPoint;
+    using IndexType  = typename Traits::IndexType;
+    using Scalar     = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+    using Iterator   = KnnGraphGeodesicIterator<Traits>;
+    using Graph      = KnnGraphBase<Traits>;
+
+public:
+    inline KnnGraphGeodesicQuery(const Graph* graph, Scalar radius, int index):
+            QueryType(radius, index),
+            m_graph(graph) { }
+
+    inline KnnGraphGeodesicQuery(const Graph* graph, Scalar radius, int index,
+                                 KnnGraphGeodesicContext& context):
+            QueryType(radius, index),
+            m_graph(graph),
+            m_explicitContext(&context) { }
+
+    /// Copies use a context of the calling thread, and are iterated independently from the original
+    inline KnnGraphGeodesicQuery(const KnnGraphGeodesicQuery& other):
+            QueryType(other),
+            m_graph(other.m_graph) { }
+
+    inline KnnGraphGeodesicQuery(KnnGraphGeodesicQuery&& other) noexcept:
+            QueryType(other),
+            m_graph(other.m_graph),
+            m_explicitContext(other.m_explicitContext),
+            m_context(other.m_context) { other.m_context = nullptr; }
+
+    KnnGraphGeodesicQuery& operator=(const KnnGraphGeodesicQuery&) = delete;
+    KnnGraphGeodesicQuery& operator=(KnnGraphGeodesicQuery&&) = delete;
+
+    inline ~KnnGraphGeodesicQuery() { release_context(); }
+
+public:
+    inline Iterator begin(){
+        Iterator it(this);
+        this->initialize(it);
+        this->advance(it);
+        return it;
+    }
+
+    inline Iterator end(){
+        return Iterator(this, m_graph->point_count());
+    }
+
+protected:
+    /// Take the context of the traversal, kept when the traversal is restarted before its end
+    inline void acquire_context(){
+        if (m_context) return;
+        m_context = m_explicitContext ? m_explicitContext : &KnnGraphGeodesicContext::thread_context();
+        m_context->acquire();
+    }
+
+    inline void release_context(){
+        if (m_context) m_context->release();
+        m_context = nullptr;
+    }
+
+    inline void initialize(Iterator& iterator){
+        acquire_context();
+        m_context->start(m_graph->point_count());
+        m_context->relax(QueryType::input(), 0.);
+
+        iterator.m_index = -1;
+    }
+
+    inline void advance(Iterator& iterator){
+        const auto& points = m_graph->m_kdTreePoints;
+        const double radius = double(QueryType::radius());
+
+        if(! (iterator != end())) return;
+
+        auto& heap = m_context->heap();
+        while(!heap.empty())
+        {
+            const auto [distance, idx_current] = heap.pop();
+            if(!m_context->settle(idx_current)) continue; // already settled with a smaller distance
+
+            const auto& point = points[idx_current].pos();
+            for(int idx_nei : m_graph->k_nearest_neighbors(idx_current))
+            {
+                PONCA_DEBUG_ASSERT(idx_nei>=0);
+                const double d = distance + double((point - points[idx_nei].pos()).norm());
+                if(d < radius) m_context->relax(idx_nei, d);
+            }
+
+            if(idx_current == QueryType::input()) continue; // query is not included in returned set
+            iterator.m_index    = idx_current;
+            iterator.m_distance = Scalar(distance);
+            return;
+        }
+        iterator = end();
+        release_context();
+    }
+
+protected:
+    const Graph*             m_graph {nullptr};
+    KnnGraphGeodesicContext* m_explicitContext {nullptr}; ///< context given at construction, if any
+    KnnGraphGeodesicContext* m_context {nullptr}; ///< distances and priority queue, in use during the iteration
+};
+
+} // namespace Ponca
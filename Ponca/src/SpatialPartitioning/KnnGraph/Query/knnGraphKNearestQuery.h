@@ -20,7 +20,12 @@ struct KnnGraphQueryOutputType : public QueryOutputBase{
 };
 #endif
 
-template <typename Traits>class KnnGraphKNearestQuery
+/*!
+ * \brief K-nearest neighbors query in a KnnGraph, iterating over the row of the query vertex
+ *
+ * \tparam Graph Type of the graph, KnnGraphBase or KnnGraphCompressedBase, which provides the iterators over its rows
+ */
+template <typename Traits, typename Graph = KnnGraphBase<Traits>>class KnnGraphKNearestQuery
 #ifdef PARSED_WITH_DOXYGEN
 : public KNearestIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>
 #else
@@ -29,7 +34,7 @@ template <typename Traits>class KnnGraphKNearestQuery
 #endif
 {
 public:
-    using Iterator = typename Traits::IndexContainer::const_iterator;
+    using Iterator = typename Graph::NeighborIterator;
 #ifdef PARSED_WITH_DOXYGEN
     using QueryType = KNearestIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>;
 #else
@@ -37,18 +42,18 @@ public:
 #endif
 
 public:
-    inline KnnGraphKNearestQuery(const KnnGraphBase<Traits>* graph, int index)
+    inline KnnGraphKNearestQuery(const Graph* graph, int index)
         : m_graph(graph), QueryType(index){}
 
     inline Iterator begin() const{
-        return m_graph->index_data().begin() + QueryType::input() * m_graph->k();
+        return m_graph->row_begin(m_graph->vertexFromPoint(QueryType::input()));
     }
     inline Iterator end() const{
-        return m_graph->index_data().begin() + (QueryType::input()+1) * m_graph->k();
+        return m_graph->row_end(m_graph->vertexFromPoint(QueryType::input()));
     }
 
 protected:
-    const KnnGraphBase<Traits>* m_graph {nullptr};
+    const Graph* m_graph {nullptr};
 };
 
 } // namespace Ponca
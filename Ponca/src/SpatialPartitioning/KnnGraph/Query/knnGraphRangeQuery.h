@@ -8,34 +8,62 @@
 
 #include "../../query.h"
 #include "../Iterator/knnGraphRangeIterator.h"
+#include "./knnGraphTraversalContext.h"
 
 #include <vector>
-#include <stack>
-#include <set>
 
 namespace Ponca {
-template <typename Traits> class KnnGraphBase;
 
-template <typename Traits>
+/*!
+ * \brief Range query by region growing in a KnnGraph, from a vertex of the graph
+ *
+ * The visited points and the pending points are stored in a KnnGraphTraversalContext, which is reused from one query
+ * to the other: the query does not allocate once the context has grown to the size of the point cloud. The context is
+ * taken by \ref begin, and given back when the iteration reaches \ref end or when the query is destroyed: queries that
+ * are not being iterated do not hold a context. An iteration must happen on a single thread.
+ *
+ * \tparam Graph Type of the graph, KnnGraphBase or KnnGraphCompressedBase
+ */
+template <typename Traits, typename Graph = KnnGraphBase<Traits>>
 class KnnGraphRangeQuery : public RangeIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>
 {
 protected:
     using QueryType = RangeIndexQuery<typename Traits::IndexType, typename Traits::DataPoint::Scalar>;
-    friend class KnnGraphRangeIterator<Traits>; // This type must be equal to KnnGraphRangeQuery::Iterator
+    friend class KnnGraphRangeIterator<Traits, Graph>; // This type must be equal to KnnGraphRangeQuery::Iterator
 
 public:
     using DataPoint  = typename Traits::DataPoint;
     using IndexType  = typename Traits::IndexType;
     using Scalar     = typename DataPoint::Scalar;
     using VectorType = typename DataPoint::VectorType;
-    using Iterator   = KnnGraphRangeIterator<Traits>;
+    using Iterator   = KnnGraphRangeIterator<Traits, Graph>;
 
 public:
-    inline KnnGraphRangeQuery(const KnnGraphBase<Traits>* graph, Scalar radius, int index):
+    inline KnnGraphRangeQuery(const Graph* graph, Scalar radius, int index):
+            QueryType(radius, index),
+            m_graph(graph) { }
+
+    inline KnnGraphRangeQuery(const Graph* graph, Scalar radius, int index,
+                              KnnGraphTraversalContext& context):
             QueryType(radius, index),
             m_graph(graph),
-            m_flag(),
-            m_stack() {}
+            m_explicitContext(&context) { }
+
+    /// Copies use a context of the calling thread, and are iterated independently from the original
+    inline KnnGraphRangeQuery(const KnnGraphRangeQuery& other):
+            QueryType(other),
+            m_graph(other.m_graph) { }
+
+    inline KnnGraphRangeQuery(KnnGraphRangeQuery&& other) noexcept:
+            QueryType(other),
+            m_graph(other.m_graph),
+            m_explicitContext(other.m_explicitContext),
+            m_context(other.m_context) { other.m_context = nullptr; }
+
+    KnnGraphRangeQuery& operator=(const KnnGraphRangeQuery&) = delete;
+    KnnGraphRangeQuery& operator=(KnnGraphRangeQuery&&) = delete;
+
+    inline ~KnnGraphRangeQuery() { release_context(); }
 
 public:
     inline Iterator begin(){
@@ -46,16 +74,27 @@ public:
     }
 
     inline Iterator end(){
-        return Iterator(this, m_graph->size());
+        return Iterator(this, m_graph->point_count());
     }
 
 protected:
-    inline void initialize(Iterator& iterator){
-        m_flag.clear();
-        m_flag.insert(QueryType::input());
+    /// Take the context of the traversal, kept when the traversal is restarted before its end
+    inline void acquire_context(){
+        if (m_context) return;
+        m_context = m_explicitContext ? m_explicitContext : &KnnGraphTraversalContext::thread_context();
+        m_context->acquire();
+    }
 
-        PONCA_DEBUG_ASSERT(m_stack.empty());
-        m_stack.push(QueryType::input());
+    inline void release_context(){
+        if (m_context) m_context->release();
+        m_context = nullptr;
+    }
+
+    inline void initialize(Iterator& iterator){
+        acquire_context();
+        m_context->start(m_graph->point_count());
+        m_context->visit(QueryType::input());
+        m_context->stack().push_back(QueryType::input());
 
         iterator.m_index = -1;
     }
@@ -66,14 +105,16 @@ protected:
 
         if(! (iterator != end())) return;
 
-        if(m_stack.empty())
+        auto& stack = m_context->stack();
+        if(stack.empty())
         {
             iterator = end();
+            release_context();
         }
         else
         {
-            int idx_current = m_stack.top();
-            m_stack.pop();
+            int idx_current = stack.back();
+            stack.pop_back();
 
             PONCA_DEBUG_ASSERT((point - points[idx_current].pos()).squaredNorm() < QueryType::squared_radius());
 
@@ -82,11 +123,9 @@ protected:
             for(int idx_nei : m_graph->k_nearest_neighbors(idx_current))
             {
                 PONCA_DEBUG_ASSERT(idx_nei>=0);
-                Scalar d  = (point - points[idx_nei].pos()).squaredNorm();
-                Scalar th = QueryType::descentDistanceThreshold();
-                if((point - points[idx_nei].pos()).squaredNorm() < QueryType::descentDistanceThreshold() && m_flag.insert(idx_nei).second)
+                if((point - points[idx_nei].pos()).squaredNorm() < QueryType::descentDistanceThreshold() && m_context->visit(idx_nei))
                 {
-                    m_stack.push(idx_nei);
+                    stack.push_back(idx_nei);
                 }
             }
             if (iterator.m_index == QueryType::input()) advance(iterator); // query is not included in returned set
@@ -94,9 +133,9 @@ protected:
     }
 
 protected:
-    const KnnGraphBase<Traits>*   m_graph {nullptr};
-    std::set<int> m_flag;       ///< store visited ids
-    std::stack<int>   m_stack;  ///< hold ids (ids range from 0 to point cloud size)
+    const Graph*                  m_graph {nullptr};
+    KnnGraphTraversalContext*     m_explicitContext {nullptr}; ///< context given at construction, if any
+    KnnGraphTraversalContext*     m_context {nullptr}; ///< visited and pending ids, in use during the iteration
 };
 
 } // namespace Ponca
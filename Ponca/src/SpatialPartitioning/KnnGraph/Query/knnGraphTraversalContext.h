@@ -0,0 +1,104 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "../../../Common/Macro.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Ponca {
+
+/*!
+ * \brief Reusable memory of the KnnGraph region growing traversals
+ *
+ * Visited vertices are marked by writing the identifier of the current traversal (its epoch) in a flat array indexed
+ * by point. Starting a new traversal only increments the epoch, so that the array is never cleared (except once every
+ * 2^32 traversals), and the pending vertices are stored in a flat stack. Once both arrays reached the size of the
+ * point cloud, range queries do not allocate anymore.
+ *
+ * A context can only be used by one traversal at a time. By default, KnnGraphRangeQuery takes a context from a pool
+ * owned by the current thread when its iteration starts, and gives it back when the iteration ends. The pool then
+ * grows with the number of iterations in progress at the same time, i.e. the depth of nested queries, and not with the
+ * number of query objects. A context can also be given explicitly, e.g. to release its memory after use.
+ *
+ * \see KnnGraphBase::range_neighbors
+ */
+class KnnGraphTraversalContext
+{
+public:
+    using Stamp = std::uint32_t;
+
+    /// \brief Context owned by the calling thread and not in use, used by default by the range queries
+    static inline KnnGraphTraversalContext& thread_context()
+    {
+        thread_local std::vector<std::unique_ptr<KnnGraphTraversalContext>> pool;
+        for (const auto& context : pool)
+            if (!context->busy()) return *context;
+        pool.push_back(std::make_unique<KnnGraphTraversalContext>());
+        return *pool.back();
+    }
+
+    /// \brief Is a traversal currently using this context
+    inline bool busy() const { return m_busy; }
+
+    /// \brief Number of points that can be visited without reallocation
+    inline std::size_t capacity() const { return m_stamps.size(); }
+
+    /// \brief Release the memory of the context
+    inline void clear()
+    {
+        PONCA_DEBUG_ASSERT(!m_busy);
+        m_stamps = std::vector<Stamp>();
+        m_stack  = std::vector<int>();
+        m_epoch  = 0;
+    }
+
+#ifndef PARSED_WITH_DOXYGEN
+    inline void acquire()
+    {
+        PONCA_DEBUG_ASSERT(!m_busy);
+        m_busy = true;
+    }
+    inline void release() { m_busy = false; }
+
+    /// \brief Start a new traversal on a point cloud of `pointCount` points: no point is visited, the stack is empty
+    inline void start(int pointCount)
+    {
+        if (m_stamps.size() < std::size_t(pointCount))
+            m_stamps.resize(pointCount, 0);
+        if (++m_epoch == 0)
+        {
+            std::fill(m_stamps.begin(), m_stamps.end(), 0);
+            m_epoch = 1;
+        }
+        m_stack.clear();
+    }
+
+    /// \brief Mark the point `index` as visited
+    /// \return false if the point was already visited by the current traversal
+    inline bool visit(int index)
+    {
+        PONCA_DEBUG_ASSERT(index >= 0 && std::size_t(index) < m_stamps.size());
+        if (m_stamps[index] == m_epoch) return false;
+        m_stamps[index] = m_epoch;
+        return true;
+    }
+
+    inline std::vector<int>& stack() { return m_stack; }
+#endif
+
+private:
+    std::vector<Stamp> m_stamps; ///< Epoch of the last traversal that visited each point
+    std::vector<int>   m_stack;  ///< Points visited but not yet expanded
+    Stamp m_epoch {0};
+    bool  m_busy {false};
+};
+
+} // namespace Ponca
@@ -7,13 +7,23 @@
 #pragma once
 
 #include "./knnGraphTraits.h"
+#include "./knnGraphVertexMapping.h"
+#include "./knnGraphNNDescent.h"
+#include "./knnGraphSerialization.h"
+#include "./knnGraphLaplacian.h"
 
 #include "Query/knnGraphKNearestQuery.h"
 #include "Query/knnGraphRangeQuery.h"
+#include "Query/knnGraphGeodesicQuery.h"
 
 #include "../KdTree/kdTree.h"
 
+#include <limits>
 #include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace Ponca {
 
@@ -54,13 +64,21 @@ public:
 
     using KNearestIndexQuery = KnnGraphKNearestQuery<Traits>;
     using RangeIndexQuery    = KnnGraphRangeQuery<Traits>;
+    using GeodesicIndexQuery = KnnGraphGeodesicQuery<Traits>;
+    using NeighborIterator   = const IndexType*; ///< Iterator over the neighbors of a vertex
 
     friend class KnnGraphKNearestQuery<Traits>; // This type must be equal to KnnGraphBase::KNearestIndexQuery
     friend class KnnGraphRangeQuery<Traits>;    // This type must be equal to KnnGraphBase::RangeIndexQuery
+    friend class KnnGraphGeodesicQuery<Traits>; // This type must be equal to KnnGraphBase::GeodesicIndexQuery
+    friend class KnnGraphLaplacian<Traits>;
 
     // knnGraph ----------------------------------------------------------------
 public:
-    /// \brief Build a KnnGraph from a KdTreeDense
+    /// \brief Build a KnnGraph from a KdTreeDense or a KdTreeSparse
+    ///
+    /// The vertices of the graph are the samples of the kd-tree, ordered by increasing point index. With a
+    /// KdTreeDense, vertices and points have the same indices. With a KdTreeSparse, the graph only connects the
+    /// samples, and \ref pointFromVertex and \ref vertexFromPoint give the correspondence between both indices.
     ///
     /// \param k Number of requested neighbors. Might be reduced if k is larger than the kdtree size - 1
     ///          (query point is not included in query output, thus -1)
@@ -69,7 +87,41 @@ public:
     /// \warning KdTreeTraits compatibility is checked with static assertion
     template<typename KdTreeTraits>
     inline KnnGraphBase(const KdTreeBase<KdTreeTraits>& kdtree, int k = 6)
-            : m_k(std::min(k,kdtree.sample_count()-1)),
+            : m_k(std::max(0, std::min(k,kdtree.sample_count()-1))),
+              m_kdTreePoints(kdtree.points())
+    {
+        static_assert( std::is_same<typename Traits::DataPoint, typename KdTreeTraits::DataPoint>::value,
+                       "KdTreeTraits::DataPoint is not equal to Traits::DataPoint" );
+        static_assert( std::is_same<typename Traits::PointContainer, typename KdTreeTraits::PointContainer>::value,
+                       "KdTreeTraits::PointContainer is not equal to Traits::PointContainer" );
+        static_assert( std::is_same<typename Traits::IndexContainer, typename KdTreeTraits::IndexContainer>::value,
+                       "KdTreeTraits::IndexContainer is not equal to Traits::IndexContainer" );
+
+        // Neighbors are stored as point indices, as returned by the kdtree, in one row of m_k indices per vertex.
+        m_vertices.build(kdtree);
+        m_indices.resize(m_vertices.size() * m_k, -1);
+
+        const int vertexCount = m_vertices.size();
+#pragma omp parallel for shared(kdtree, vertexCount) default(none)
+        for(int v=0; v<vertexCount; ++v)
+            query_row(kdtree, v);
+    }
+
+    /// \brief Build a KnnGraph from a KdTreeDense or a KdTreeSparse, leaf by leaf, with NN-Descent refinement
+    ///
+    /// The vertices are the same as with the other constructor. The rows are computed for all the samples of a leaf
+    /// at once, from the leaves around it, and the rows that this search does not guarantee are refined by local
+    /// joins in parallel (see KnnGraphNNDescentParameters). Rows are sorted by increasing distance. With the default
+    /// parameters they are exact, otherwise they may miss some neighbors: use \ref recall to measure the quality of
+    /// the graph. Much faster than one kd-tree query per vertex on large point clouds.
+    ///
+    /// \param k Number of requested neighbors. Might be reduced if k is larger than the kdtree size - 1
+    /// \param parameters Extent of the leaf search, iterations and stopping criterion of the local joins
+    ///
+    /// \warning Stores a const reference to kdtree.point_data()
+    template<typename KdTreeTraits>
+    inline KnnGraphBase(const KdTreeBase<KdTreeTraits>& kdtree, int k, const KnnGraphNNDescentParameters& parameters)
+            : m_k(std::max(0, std::min(k,kdtree.sample_count()-1))),
               m_kdTreePoints(kdtree.points())
     {
         static_assert( std::is_same<typename Traits::DataPoint, typename KdTreeTraits::DataPoint>::value,
@@ -79,55 +131,218 @@ public:
         static_assert( std::is_same<typename Traits::IndexContainer, typename KdTreeTraits::IndexContainer>::value,
                        "KdTreeTraits::IndexContainer is not equal to Traits::IndexContainer" );
 
-        // We need to account for the entire point set, irrespectively of the sampling. This is because the kdtree
-        // (k_nearest_neighbors) return ids of the entire point set, not it sub-sampled list of ids.
-        // \fixme Update API to properly handle kdtree subsampling
-        const int cloudSize   = kdtree.point_count();
-        {
-            const int samplesSize = kdtree.sample_count();
-            eigen_assert(cloudSize == samplesSize);
-        }
-
-        m_indices.resize(cloudSize * m_k, -1);
-
-#pragma omp parallel for shared(kdtree, cloudSize) default(none)
-        for(int i=0; i<cloudSize; ++i)
-        {
-            int j = 0;
-            for(auto n : kdtree.k_nearest_neighbors(typename KdTreeTraits::IndexType(i),
-                                                   typename KdTreeTraits::IndexType(m_k)))
-            {
-                m_indices[i * m_k + j] = n;
-                ++j;
-            }
-        }
+        m_vertices.build(kdtree);
+        m_indices.resize(m_vertices.size() * m_k, -1);
+        if (m_k > 0)
+            build_nn_descent(kdtree, parameters);
     }
 
+    // Update ------------------------------------------------------------------
+public:
+    /// \brief Add the points inserted in the kd-tree (see KdTreeBase::insert) as vertices of the graph
+    ///
+    /// The rows of the new vertices are computed by k-nearest neighbors queries. The existing vertices that are
+    /// closer to a new point than to their k-th neighbor are found by a traversal of the kd-tree bounded by the k-th
+    /// neighbor distances, and only their rows are modified. The graph is then equal to a graph built from scratch.
+    ///
+    /// \param kdtree The kd-tree given at construction, after the insertion of the points
+    /// \return The number of rows of existing vertices that have been modified
+    /// \note The number of neighbors \ref k is not changed, even if it was reduced at construction
+    template<typename KdTreeTraits>
+    inline int insert(const KdTreeBase<KdTreeTraits>& kdtree);
+
+    /// \brief Update the graph after some points have moved, and the kd-tree has been updated (see KdTreeBase::refit)
+    ///
+    /// Only the rows that may have changed are updated: the rows of the moved vertices and of the vertices having a
+    /// moved neighbor are queried again, and the moved vertices are inserted in the rows of the other vertices they
+    /// got closer to than their k-th neighbor. The graph is then equal to a graph built from scratch.
+    ///
+    /// \param kdtree The kd-tree given at construction, updated after the motion of the points
+    /// \param moved Indices of the points that have moved
+    /// \param rebuild_ratio When more than this fraction of the rows must be queried again, all the rows are
+    /// recomputed instead
+    /// \return The number of rows that have been modified
+    template<typename KdTreeTraits>
+    inline int update(const KdTreeBase<KdTreeTraits>& kdtree, const std::vector<int>& moved,
+                      double rebuild_ratio = 0.5);
+
+    /// \brief Renumber the points after a permutation of the points of the kd-tree (see KdTreeBase::reorder_points)
+    ///
+    /// The neighbors are renumbered, and the vertices are ordered by increasing point index again, so that the rows
+    /// follow the order of the points in memory.
+    ///
+    /// \param order Previous index of each point, as given to KdTreeBase::reorder_points
+    inline void reorder_points(const std::vector<int>& order);
+
+    // Serialization -----------------------------------------------------------
+public:
+    /// \brief Save the graph in a binary file
+    ///
+    /// The file stores \ref k, the neighbors and the vertex mappings, but not the points, which are given again by
+    /// \ref load. Values are stored with the byte order and index size of the machine.
+    /// \return false if the file cannot be written
+    inline bool save(const std::string& filename) const;
+
+    /// \brief Load a graph saved by \ref save, bound to the container `points`
+    ///
+    /// By default, the file is mapped in memory (`mmap`) and the neighbors are read in place: loading does not copy
+    /// the neighbors, and processes mapping the same file share its pages. Otherwise, or when the file cannot be
+    /// mapped, the file is read in memory. The vertex mappings of graphs built from a KdTreeSparse are copied.
+    ///
+    /// \param points Points of the kd-tree the graph was built from, which must stay valid during the lifetime of
+    /// the graph. Their number is checked, not their positions.
+    /// \param map Map the file in memory instead of reading it
+    /// \param trusted Skip the check of the neighbors. By default, the neighbors are checked to be indices of
+    /// `points`, which reads the whole array once. Files written by \ref save and not modified since can be trusted,
+    /// so that the pages of a mapped file are only loaded when they are queried
+    /// \return The graph, or nothing if the file cannot be read, is not a KnnGraph file, was written with a
+    /// different index size or byte order, does not have as many points as `points`, or, if not `trusted`, has
+    /// neighbors that are not indices of `points`
+    /// \note A mapped graph is copied in memory before being modified by \ref insert or \ref update
+    static inline std::optional<KnnGraphBase> load(const std::string& filename, const PointContainer& points,
+                                                   bool map = true, bool trusted = false);
+
+    /// \brief Read if the neighbors are read in place from a file mapped in memory, see \ref load
+    inline bool is_mapped() const { return m_file && m_file->mapped(); }
+
     // Query -------------------------------------------------------------------
 public:
+    /// \brief Neighbors of the point `index`, which must be a vertex of the graph
     inline KNearestIndexQuery k_nearest_neighbors(int index) const{
+        PONCA_DEBUG_ASSERT(vertexFromPoint(index) >= 0);
         return KNearestIndexQuery(this, index);
     }
 
+    /// \brief Points reached by region growing from the point `index` and in the ball of radius `r`
+    ///
+    /// The traversal uses a KnnGraphTraversalContext of the calling thread, which is reused by the next queries.
     inline RangeIndexQuery    range_neighbors(int index, Scalar r) const{
         return RangeIndexQuery(this, r, index);
     }
 
+    /// \copybrief range_neighbors(int,Scalar)const
+    ///
+    /// The traversal uses `context`, which must not be used by another query while this one is iterated.
+    inline RangeIndexQuery    range_neighbors(int index, Scalar r, KnnGraphTraversalContext& context) const{
+        return RangeIndexQuery(this, r, index, context);
+    }
+
+    /// \brief Points closer than `r` to the point `index` along the edges of the graph, by increasing geodesic
+    /// distance
+    ///
+    /// Unlike \ref range_neighbors, which returns the points of the Euclidean ball connected to `index`, the distance
+    /// is measured along the rows of the graph: on thin structures, points across a gap are reached only through the
+    /// structure. Edges go from a vertex to its neighbors, and are as long as the Euclidean distance between their
+    /// points. The geodesic distance of each point is given by the iterator (KnnGraphGeodesicIterator::distance).
+    /// The traversal uses a KnnGraphGeodesicContext of the calling thread, which is reused by the next queries.
+    inline GeodesicIndexQuery geodesic_neighbors(int index, Scalar r) const{
+        return GeodesicIndexQuery(this, r, index);
+    }
+
+    /// \copybrief geodesic_neighbors(int,Scalar)const
+    ///
+    /// The traversal uses `context`, which must not be used by another query while this one is iterated.
+    inline GeodesicIndexQuery geodesic_neighbors(int index, Scalar r, KnnGraphGeodesicContext& context) const{
+        return GeodesicIndexQuery(this, r, index, context);
+    }
+
+    /// \brief Geodesic distance of each point to the closest of the points `sources`, along the edges of the graph
+    ///
+    /// Computed by a single Dijkstra traversal started from all the sources, with the same edges as
+    /// \ref geodesic_neighbors.
+    ///
+    /// \param sources Indices of the source points, which must be vertices of the graph
+    /// \param max_distance The traversal stops at this distance
+    /// \return The distance of each point, infinite for the points that are not reached before `max_distance` or
+    /// are not vertices
+    inline std::vector<Scalar> geodesic_distances(
+            const std::vector<int>& sources, Scalar max_distance = std::numeric_limits<Scalar>::infinity()) const;
+
+    // Diffusion ---------------------------------------------------------------
+public:
+    /// \brief Diffusion operator of per-vertex attributes over the edges of the graph, see KnnGraphLaplacian
+    ///
+    /// \param weight Functor giving the weight of an edge from the squared distance between its points, e.g.
+    /// KnnGraphGaussianWeight or KnnGraphKernelWeight
+    /// \param symmetric Add the reversed edges, so that `i` and `j` are connected if either is a neighbor of the other
+    template <typename WeightFunctor>
+    inline KnnGraphLaplacian<Traits> laplacian(WeightFunctor&& weight, bool symmetric = true) const {
+        return KnnGraphLaplacian<Traits>(*this, std::forward<WeightFunctor>(weight), symmetric);
+    }
+
     // Accessors ---------------------------------------------------------------
 public:
     /// \brief Number of neighbor per vertex
     inline int k() const { return m_k; }
     /// \brief Number of vertices in the neighborhood graph
-    inline int size() const { return m_indices.size()/m_k; }
+    inline int size() const { return m_vertices.size(); }
+    /// \brief Number of points of the point cloud, including the points that are not vertices
+    inline int point_count() const { return int(m_kdTreePoints.size()); }
+
+    /// \brief Index of the point associated with the vertex `vertex_index`
+    inline int pointFromVertex(int vertex_index) const { return m_vertices.pointFromVertex(vertex_index); }
+    /// \brief Index of the vertex associated with the point `point_index`, -1 if the point is not a vertex
+    inline int vertexFromPoint(int point_index) const { return m_vertices.vertexFromPoint(point_index); }
+
+    /// \brief Fraction of the neighbors of `reference` that are also neighbors in this graph
+    ///
+    /// Both graphs must have the same vertices and the same \ref k, e.g. an approximate graph and the exact graph built
+    /// from the same kd-tree.
+    inline double recall(const KnnGraphBase& reference) const;
+
+    /// \brief Memory used by the neighbor indices and the vertex mappings, in bytes
+    inline std::size_t index_bytes() const {
+        return std::size_t(size()) * m_k * sizeof(IndexType) + m_vertices.index_bytes();
+    }
 
     // Data --------------------------------------------------------------------
 private:
     const int m_k;
-    IndexContainer m_indices; ///< \brief Stores neighborhood relations
+    IndexContainer m_indices; ///< \brief Stores neighborhood relations, as point indices, m_k per vertex
+    internal::KnnGraphVertexMapping<IndexContainer> m_vertices; ///< \brief Vertices of the graph
+    std::shared_ptr<const internal::KnnGraphFile> m_file; ///< \brief File storing the neighbors, instead of m_indices
+    const IndexType* m_fileIndices {nullptr};             ///< \brief Neighbors in m_file
 
 protected: // for friends relations
     const PointContainer& m_kdTreePoints;
-    inline const IndexContainer& index_data() const { return m_indices; };
+    inline const IndexType* index_data() const { return m_file ? m_fileIndices : m_indices.data(); }
+    inline NeighborIterator row_begin(int vertex_index) const { return index_data() + std::size_t(vertex_index) * m_k; }
+    inline NeighborIterator row_end(int vertex_index) const { return index_data() + std::size_t(vertex_index + 1) * m_k; }
+
+private:
+    /// \brief Empty graph bound to `points`, filled by \ref load
+    inline KnnGraphBase(const PointContainer& points, int k) : m_k(k), m_kdTreePoints(points) { }
+
+    /// \brief Copy the neighbors read from a file, before modifying them
+    inline void detach() {
+        if (!m_file) return;
+        m_indices.assign(m_fileIndices, m_fileIndices + std::size_t(size()) * m_k);
+        m_file.reset();
+        m_fileIndices = nullptr;
+    }
+
+    /// \brief Compute the row of the vertex `vertex_index` by a k-nearest neighbors query
+    template<typename KdTreeTraits>
+    inline void query_row(const KdTreeBase<KdTreeTraits>& kdtree, int vertex_index);
+
+    /// \brief Compute all the rows by NN-Descent
+    template<typename KdTreeTraits>
+    inline void build_nn_descent(const KdTreeBase<KdTreeTraits>& kdtree,
+                                 const KnnGraphNNDescentParameters& parameters);
+
+    /// \brief Squared distance between a vertex and its k-th neighbor
+    inline Scalar kth_squared_distance(int vertex_index) const {
+        const auto& p = m_kdTreePoints[pointFromVertex(vertex_index)].pos();
+        return (p - m_kdTreePoints[index_data()[(vertex_index + 1) * m_k - 1]].pos()).squaredNorm();
+    }
+
+    /// \brief Insert the points `points` in the rows of the vertices that are closer to them than to their k-th
+    /// neighbor, except in the rows marked in `skip`
+    /// \return The number of modified rows
+    template<typename KdTreeTraits>
+    inline int insert_in_rows(const KdTreeBase<KdTreeTraits>& kdtree, const std::vector<int>& points,
+                              const std::vector<char>& skip);
 };
 
+#include "./knnGraph.hpp"
 } // namespace Ponca
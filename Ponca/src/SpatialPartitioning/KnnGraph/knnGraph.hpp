@@ -0,0 +1,402 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+// KnnGraph --------------------------------------------------------------------
+
+template<typename Traits>
+template<typename KdTreeTraits>
+void KnnGraphBase<Traits>::query_row(const KdTreeBase<KdTreeTraits>& kdtree, int vertex_index)
+{
+    int j = 0;
+    for(auto n : kdtree.k_nearest_neighbors(typename KdTreeTraits::IndexType(pointFromVertex(vertex_index)),
+                                           typename KdTreeTraits::IndexType(m_k)))
+    {
+        m_indices[vertex_index * m_k + j] = n;
+        ++j;
+    }
+}
+
+template<typename Traits>
+template<typename KdTreeTraits>
+void KnnGraphBase<Traits>::build_nn_descent(const KdTreeBase<KdTreeTraits>& kdtree,
+                                            const KnnGraphNNDescentParameters& parameters)
+{
+    // NN-Descent works on the samples in the kd-tree order, where leaves are ranges of consecutive samples
+    const auto& samples = kdtree.samples();
+    const int sampleCount = int(kdtree.sample_count());
+    std::vector<VectorType> positions(sampleCount);
+#pragma omp parallel for
+    for (int s = 0; s < sampleCount; ++s)
+        positions[s] = m_kdTreePoints[samples[s]].pos();
+
+    const auto& nodes = kdtree.nodes();
+    const int nodeCount = int(kdtree.node_count());
+    std::vector<int> firstChild(nodeCount, -1);
+    std::vector<std::pair<int, int>> ranges(nodeCount, {0, 0});
+    for (int n = 0; n < nodeCount; ++n)
+    {
+        if (nodes[n].is_leaf())
+            ranges[n] = {int(nodes[n].leaf_start()), int(nodes[n].leaf_start() + nodes[n].leaf_size())};
+        else
+            firstChild[n] = int(nodes[n].inner_first_child_id());
+    }
+
+    internal::NNDescent<Scalar, VectorType> descent(std::move(positions), m_k);
+    descent.initialize(firstChild, ranges, Scalar(parameters.reach));
+    descent.refine(parameters);
+
+#pragma omp parallel for
+    for (int s = 0; s < sampleCount; ++s)
+    {
+        const int* row = descent.row(s);
+        const int v = vertexFromPoint(int(samples[s]));
+        for (int j = 0; j < m_k; ++j)
+            m_indices[v * m_k + j] = samples[row[j]];
+    }
+}
+
+template<typename Traits>
+double KnnGraphBase<Traits>::recall(const KnnGraphBase& reference) const
+{
+    PONCA_DEBUG_ASSERT(reference.size() == size() && reference.k() == m_k);
+    if (m_k == 0 || size() == 0)
+        return 1.;
+
+    long long found = 0;
+    const int vertexCount = size();
+#pragma omp parallel for reduction(+:found)
+    for (int v = 0; v < vertexCount; ++v)
+    {
+        std::vector<IndexType> row(row_begin(v), row_end(v));
+        std::vector<IndexType> expected(reference.row_begin(v), reference.row_end(v));
+        std::sort(row.begin(), row.end());
+        std::sort(expected.begin(), expected.end());
+        std::vector<IndexType> common;
+        std::set_intersection(row.begin(), row.end(), expected.begin(), expected.end(), std::back_inserter(common));
+        found += (long long)(common.size());
+    }
+    return double(found) / (double(vertexCount) * m_k);
+}
+
+template<typename Traits>
+auto KnnGraphBase<Traits>::geodesic_distances(const std::vector<int>& sources, Scalar max_distance) const
+    -> std::vector<Scalar>
+{
+    const int pointCount = point_count();
+    std::vector<Scalar> distances(pointCount, std::numeric_limits<Scalar>::infinity());
+    std::vector<char> settled(pointCount, 0);
+    internal::RadixHeap heap;
+    for (int i : sources)
+    {
+        PONCA_DEBUG_ASSERT(vertexFromPoint(i) >= 0);
+        distances[i] = Scalar(0);
+        heap.push(0., i);
+    }
+
+    while (!heap.empty())
+    {
+        const int i = heap.pop().second;
+        if (settled[i]) continue;
+        settled[i] = 1;
+        const auto& point = m_kdTreePoints[i].pos();
+        const int v = vertexFromPoint(i);
+        for (NeighborIterator it = row_begin(v); it != row_end(v); ++it)
+        {
+            const int j = *it;
+            const Scalar d = distances[i] + (point - m_kdTreePoints[j].pos()).norm();
+            if (d < distances[j] && d <= max_distance)
+            {
+                distances[j] = d;
+                heap.push(double(d), j);
+            }
+        }
+    }
+    return distances;
+}
+
+template<typename Traits>
+template<typename KdTreeTraits>
+int KnnGraphBase<Traits>::insert(const KdTreeBase<KdTreeTraits>& kdtree)
+{
+    PONCA_DEBUG_ASSERT(&kdtree.points() == &m_kdTreePoints);
+    detach();
+
+    // Added points have the largest indices: previous vertices keep their indices
+    const int previousCount = size();
+    m_vertices.build(kdtree);
+    const int vertexCount = size();
+    if (m_k == 0 || vertexCount == previousCount)
+        return 0;
+
+    m_indices.resize(vertexCount * m_k, -1);
+#pragma omp parallel for
+    for (int v = previousCount; v < vertexCount; ++v)
+        query_row(kdtree, v);
+
+    std::vector<char> skip(vertexCount, 0);
+    std::vector<int> points;
+    points.reserve(vertexCount - previousCount);
+    for (int v = previousCount; v < vertexCount; ++v)
+    {
+        skip[v] = 1;
+        points.push_back(pointFromVertex(v));
+    }
+    return insert_in_rows(kdtree, points, skip);
+}
+
+template<typename Traits>
+template<typename KdTreeTraits>
+int KnnGraphBase<Traits>::update(const KdTreeBase<KdTreeTraits>& kdtree, const std::vector<int>& moved,
+                                 double rebuild_ratio)
+{
+    PONCA_DEBUG_ASSERT(&kdtree.points() == &m_kdTreePoints);
+    detach();
+
+    const int vertexCount = size();
+    if (m_k == 0 || moved.empty())
+        return 0;
+
+    std::vector<char> isMoved(point_count(), 0);
+    for (int i : moved)
+        isMoved[i] = 1;
+
+    // Rows of the moved vertices, and rows with a moved neighbor, whose distances changed
+    std::vector<char> requery(vertexCount, 0);
+    int requeryCount = 0;
+#pragma omp parallel for reduction(+: requeryCount)
+    for (int v = 0; v < vertexCount; ++v)
+    {
+        bool changed = isMoved[pointFromVertex(v)];
+        for (int j = 0; j < m_k && !changed; ++j)
+            changed = isMoved[m_indices[v * m_k + j]];
+        requery[v] = changed;
+        requeryCount += changed;
+    }
+
+    if (requeryCount > rebuild_ratio * vertexCount)
+    {
+#pragma omp parallel for
+        for (int v = 0; v < vertexCount; ++v)
+            query_row(kdtree, v);
+        return vertexCount;
+    }
+
+#pragma omp parallel for
+    for (int v = 0; v < vertexCount; ++v)
+        if (requery[v]) query_row(kdtree, v);
+
+    // The other rows are still valid, but moved vertices may have got closer than their k-th neighbor
+    std::vector<int> points;
+    for (int i : moved)
+        if (vertexFromPoint(i) >= 0) points.push_back(i);
+    return requeryCount + insert_in_rows(kdtree, points, requery);
+}
+
+template<typename Traits>
+void KnnGraphBase<Traits>::reorder_points(const std::vector<int>& order)
+{
+    const int pointCount = point_count();
+    PONCA_DEBUG_ASSERT(int(order.size()) == pointCount);
+    detach();
+
+    std::vector<int> newIndex(pointCount);
+    for (int i = 0; i < pointCount; ++i)
+        newIndex[order[i]] = i;
+
+    // Vertices by increasing new point index, and their previous vertex index
+    const bool identity = m_vertices.vertex_point_data() == nullptr;
+    const int vertexCount = size();
+    std::vector<IndexType> vertexPoints;
+    std::vector<int> previous;
+    vertexPoints.reserve(vertexCount);
+    previous.reserve(vertexCount);
+    for (int i = 0; i < pointCount; ++i)
+    {
+        const int v = vertexFromPoint(order[i]);
+        if (v < 0) continue;
+        vertexPoints.push_back(i);
+        previous.push_back(v);
+    }
+
+    IndexContainer indices(m_indices.size());
+#pragma omp parallel for
+    for (int v = 0; v < vertexCount; ++v)
+        for (int j = 0; j < m_k; ++j)
+            indices[v * m_k + j] = newIndex[m_indices[previous[v] * m_k + j]];
+    m_indices = std::move(indices);
+    m_vertices.assign(vertexCount, identity ? nullptr : vertexPoints.data(), pointCount);
+}
+
+template<typename Traits>
+template<typename KdTreeTraits>
+int KnnGraphBase<Traits>::insert_in_rows(const KdTreeBase<KdTreeTraits>& kdtree, const std::vector<int>& points,
+                                         const std::vector<char>& skip)
+{
+    using NodeIndexType = typename KdTreeTraits::NodeIndexType;
+    const auto& nodes   = kdtree.nodes();
+    const auto& samples = kdtree.samples();
+    const int vertexCount = size();
+    if (nodes.empty() || points.empty())
+        return 0;
+
+    std::vector<Scalar> kth(vertexCount);
+#pragma omp parallel for
+    for (int v = 0; v < vertexCount; ++v)
+        kth[v] = kth_squared_distance(v);
+
+    // Largest k-th neighbor distance below each node, computed bottom-up: children are stored after their parent
+    std::vector<Scalar> bounds(nodes.size(), Scalar(0));
+    std::vector<NodeIndexType> order {0};
+    for (std::size_t i = 0; i < order.size(); ++i)
+        if (!nodes[order[i]].is_leaf())
+        {
+            order.push_back(nodes[order[i]].inner_first_child_id());
+            order.push_back(nodes[order[i]].inner_first_child_id() + 1);
+        }
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        const auto& node = nodes[*it];
+        Scalar& bound = bounds[*it];
+        if (node.is_leaf())
+        {
+            for (auto i = node.leaf_start(); i < node.leaf_start() + node.leaf_size(); ++i)
+                bound = std::max(bound, kth[vertexFromPoint(int(samples[i]))]);
+        }
+        else
+            bound = std::max(bounds[node.inner_first_child_id()], bounds[node.inner_first_child_id() + 1]);
+    }
+
+    // Vertices closer to a point than to their k-th neighbor, as (vertex, squared distance, point)
+    struct Candidate { int vertex; Scalar squared_distance; int point; };
+    std::vector<std::vector<Candidate>> found(points.size());
+#pragma omp parallel
+    {
+        std::vector<std::pair<NodeIndexType, Scalar>> stack;
+#pragma omp for
+        for (int p = 0; p < int(points.size()); ++p)
+        {
+            const VectorType& x = m_kdTreePoints[points[p]].pos();
+            stack.assign(1, {NodeIndexType(0), Scalar(0)});
+            while (!stack.empty())
+            {
+                const auto [node_id, lower_bound] = stack.back();
+                stack.pop_back();
+                if (!(lower_bound < bounds[node_id])) continue;
+
+                const auto& node = nodes[node_id];
+                if (node.is_leaf())
+                {
+                    for (auto i = node.leaf_start(); i < node.leaf_start() + node.leaf_size(); ++i)
+                    {
+                        const int idx = int(samples[i]);
+                        const int w   = vertexFromPoint(idx);
+                        if (idx == points[p] || skip[w]) continue;
+                        const Scalar d = (x - m_kdTreePoints[idx].pos()).squaredNorm();
+                        if (d < kth[w])
+                            found[p].push_back({w, d, points[p]});
+                    }
+                    continue;
+                }
+                const Scalar offset = x[node.inner_split_dim()] - node.inner_split_value();
+                const NodeIndexType near = node.inner_first_child_id() + (offset < 0 ? 0 : 1);
+                const NodeIndexType far  = node.inner_first_child_id() + (offset < 0 ? 1 : 0);
+                stack.emplace_back(far, std::max(lower_bound, offset * offset));
+                stack.emplace_back(near, lower_bound);
+            }
+        }
+    }
+
+    std::vector<Candidate> candidates;
+    for (const auto& f : found)
+        candidates.insert(candidates.end(), f.begin(), f.end());
+    if (candidates.empty())
+        return 0;
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.vertex < b.vertex || (a.vertex == b.vertex && (a.squared_distance < b.squared_distance ||
+               (a.squared_distance == b.squared_distance && a.point < b.point)));
+    });
+    std::vector<std::size_t> groups;
+    for (std::size_t c = 0; c < candidates.size(); ++c)
+        if (c == 0 || candidates[c].vertex != candidates[c-1].vertex) groups.push_back(c);
+    groups.push_back(candidates.size());
+
+    // Insert the candidates of each row by increasing distance, dropping the farthest neighbors
+    const int groupCount = int(groups.size()) - 1;
+#pragma omp parallel for
+    for (int g = 0; g < groupCount; ++g)
+    {
+        const int w = candidates[groups[g]].vertex;
+        const VectorType& y = m_kdTreePoints[pointFromVertex(w)].pos();
+        auto row = m_indices.begin() + w * m_k;
+        for (std::size_t c = groups[g]; c < groups[g+1]; ++c)
+        {
+            const Scalar d = candidates[c].squared_distance;
+            if (!(d < kth_squared_distance(w))) break;
+            int j = m_k - 1;
+            while (j > 0 && d < (y - m_kdTreePoints[row[j-1]].pos()).squaredNorm())
+            {
+                row[j] = row[j-1];
+                --j;
+            }
+            row[j] = candidates[c].point;
+        }
+    }
+    return groupCount;
+}
+
+template<typename Traits>
+bool KnnGraphBase<Traits>::save(const std::string& filename) const
+{
+    internal::KnnGraphFileHeader header;
+    header.kind           = internal::KnnGraphFileKind::KNearest;
+    header.index_bytes    = sizeof(IndexType);
+    header.scalar_bytes   = sizeof(Scalar);
+    header.flags          = m_vertices.vertex_point_data() ? internal::KnnGraphFileHeader::HAS_VERTEX_POINTS : 0;
+    header.vertex_count   = size();
+    header.point_count    = point_count();
+    header.neighbor_count = std::int64_t(size()) * m_k;
+    header.k              = m_k;
+
+    internal::KnnGraphFileWriter writer(filename);
+    writer.write(&header, sizeof(header));
+    writer.write(index_data(), std::size_t(header.neighbor_count) * sizeof(IndexType));
+    if (m_vertices.vertex_point_data())
+        writer.write(m_vertices.vertex_point_data(), std::size_t(size()) * sizeof(IndexType));
+    return writer.close();
+}
+
+template<typename Traits>
+std::optional<KnnGraphBase<Traits>> KnnGraphBase<Traits>::load(const std::string& filename,
+                                                               const PointContainer& points, bool map,
+                                                               bool trusted)
+{
+    auto file = internal::KnnGraphFile::open(filename, map);
+    if (!file) return std::nullopt;
+    const internal::KnnGraphFileHeader& header = file->header();
+    if (header.kind != internal::KnnGraphFileKind::KNearest || header.index_bytes != sizeof(IndexType) ||
+        header.point_count != std::int64_t(points.size()) || header.k < 0 ||
+        header.vertex_count < 0 || header.vertex_count > header.point_count ||
+        header.neighbor_count != header.vertex_count * header.k)
+        return std::nullopt;
+
+    std::size_t offset = internal::knngraph_file_next(0, sizeof(header));
+    const IndexType* indices = file->template next<IndexType>(offset, std::size_t(header.neighbor_count));
+    const IndexType* vertexPoints = nullptr;
+    if (header.flags & internal::KnnGraphFileHeader::HAS_VERTEX_POINTS)
+        vertexPoints = file->template next<IndexType>(offset, std::size_t(header.vertex_count));
+    if (!indices || (!vertexPoints && (header.flags & internal::KnnGraphFileHeader::HAS_VERTEX_POINTS)))
+        return std::nullopt;
+    if (!trusted &&
+        !internal::knngraph_valid_indices(indices, std::size_t(header.neighbor_count), header.point_count))
+        return std::nullopt;
+
+    KnnGraphBase graph(points, header.k);
+    if (!graph.m_vertices.assign(int(header.vertex_count), vertexPoints, int(header.point_count)))
+        return std::nullopt;
+    graph.m_file        = file;
+    graph.m_fileIndices = indices;
+    return std::optional<KnnGraphBase>(std::move(graph));
+}
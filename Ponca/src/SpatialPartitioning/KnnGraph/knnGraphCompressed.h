@@ -0,0 +1,215 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./knnGraphTraits.h"
+#include "./knnGraphVertexMapping.h"
+
+#include "Iterator/knnGraphCompressedIterator.h"
+#include "Query/knnGraphKNearestQuery.h"
+#include "Query/knnGraphRangeQuery.h"
+
+#include "../KdTree/kdTree.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace Ponca {
+
+template <typename Traits> class KnnGraphCompressedBase;
+
+/*!
+ * \brief Public interface for compressed KnnGraph datastructure
+ *
+ * \see KnnGraphCompressedBase for complete API
+ */
+template <typename DataPoint>
+using KnnGraphCompressed = KnnGraphCompressedBase<KnnGraphDefaultTraits<DataPoint>>;
+
+/*!
+ * \brief KnnGraph storing its neighbors with a variable-byte encoding, for graphs that do not fit in memory otherwise
+ *
+ * KnnGraphBase stores `k` indices per vertex, i.e. 64 bytes per vertex for `k=16`. This class gives the same neighbors
+ * and the same queries, but stores each neighbor as the difference between its vertex index and the index of the row
+ * vertex, zigzag and variable-byte encoded. Vertices are ordered as the samples of the kd-tree, so that close points
+ * have close vertex indices and most differences are stored in one or two bytes. Rows are decoded on the fly by
+ * KnnGraphCompressedIterator.
+ *
+ * Rows are located by a 64 bits offset per block of vertices, and a 16 bits offset per vertex in its block. With the
+ * vertex mappings, the footprint is about 10 bytes per vertex plus 1 to 2 bytes per neighbor.
+ *
+ * \note Vertex indices follow the spatial order of the kd-tree: pointFromVertex and vertexFromPoint give the
+ * correspondence with point indices, which are the indices taken and returned by the queries.
+ * \see KnnGraphBase
+ */
+template <typename Traits> class KnnGraphCompressedBase
+{
+public:
+    using DataPoint  = typename Traits::DataPoint; ///< DataPoint given by user via Traits
+    using Scalar     = typename DataPoint::Scalar; ///< Scalar given by user via DataPoint
+    using VectorType = typename DataPoint::VectorType; ///< VectorType given by user via DataPoint
+
+    using IndexType      = typename Traits::IndexType;
+    using PointContainer = typename Traits::PointContainer; ///< Container for DataPoint used inside the KdTree
+    using IndexContainer = typename Traits::IndexContainer; ///< Container for indices used inside the KdTree
+
+    using KNearestIndexQuery = KnnGraphKNearestQuery<Traits, KnnGraphCompressedBase>;
+    using RangeIndexQuery    = KnnGraphRangeQuery<Traits, KnnGraphCompressedBase>;
+    using NeighborIterator   = KnnGraphCompressedIterator<IndexType>; ///< Iterator over the neighbors of a vertex
+
+    friend class KnnGraphKNearestQuery<Traits, KnnGraphCompressedBase>;
+    friend class KnnGraphRangeQuery<Traits, KnnGraphCompressedBase>;
+
+    // knnGraph ----------------------------------------------------------------
+public:
+    /// \brief Build a compressed KnnGraph from a KdTreeDense or a KdTreeSparse
+    ///
+    /// Rows are computed and encoded in parallel, by chunks of vertices, so that the uncompressed neighbors are never
+    /// stored for the whole graph.
+    ///
+    /// \param k Number of requested neighbors. Might be reduced if k is larger than the kdtree size - 1
+    /// \param spatialOrder Order the vertices as the samples of the kd-tree (default), or by increasing point index.
+    /// The latter avoids storing the vertex mappings when the points are already spatially sorted.
+    ///
+    /// \warning Stores a const reference to kdtree.point_data()
+    template<typename KdTreeTraits>
+    inline KnnGraphCompressedBase(const KdTreeBase<KdTreeTraits>& kdtree, int k = 6, bool spatialOrder = true)
+            : m_k(std::max(0, std::min(k,kdtree.sample_count()-1))),
+              m_kdTreePoints(kdtree.points())
+    {
+        static_assert( std::is_same<typename Traits::DataPoint, typename KdTreeTraits::DataPoint>::value,
+                       "KdTreeTraits::DataPoint is not equal to Traits::DataPoint" );
+        static_assert( std::is_same<typename Traits::PointContainer, typename KdTreeTraits::PointContainer>::value,
+                       "KdTreeTraits::PointContainer is not equal to Traits::PointContainer" );
+        static_assert( std::is_same<typename Traits::IndexContainer, typename KdTreeTraits::IndexContainer>::value,
+                       "KdTreeTraits::IndexContainer is not equal to Traits::IndexContainer" );
+
+        m_vertices.build(kdtree, spatialOrder);
+        const int vertexCount = m_vertices.size();
+
+        // The offset of the last row of a block must fit in 16 bits
+        m_blockSize = MAX_BLOCK_SIZE;
+        while (m_blockSize > 1 && std::size_t(m_blockSize - 1) * m_k * MAX_VARINT_SIZE > 0xffff)
+            m_blockSize /= 2;
+        const int blockCount = (vertexCount + m_blockSize - 1) / m_blockSize;
+        m_blockOffsets.assign(blockCount + 1, 0);
+        m_rowOffsets.resize(vertexCount);
+
+        const int chunkSize = m_blockSize * CHUNK_BLOCKS;
+        std::vector<IndexType> rows;
+        std::vector<int> rowBytes;
+        for (int first = 0; first < vertexCount; first += chunkSize)
+        {
+            const int count = std::min(chunkSize, vertexCount - first);
+            rows.assign(std::size_t(count) * m_k, -1);
+            rowBytes.assign(count, 0);
+
+            // Neighbors as vertex indices, and size of the encoded rows
+#pragma omp parallel for
+            for (int c = 0; c < count; ++c)
+            {
+                const int v = first + c;
+                int j = 0;
+                for (auto n : kdtree.k_nearest_neighbors(typename KdTreeTraits::IndexType(pointFromVertex(v)),
+                                                       typename KdTreeTraits::IndexType(m_k)))
+                {
+                    const IndexType w = IndexType(vertexFromPoint(int(n)));
+                    rows[std::size_t(c) * m_k + j] = w;
+                    rowBytes[c] += internal::varint_size(internal::zigzag_encode(std::int32_t(w - v)));
+                    ++j;
+                }
+                PONCA_DEBUG_ASSERT(j == m_k);
+            }
+
+            std::size_t end = m_data.size();
+            for (int c = 0; c < count; ++c)
+            {
+                const int v = first + c;
+                if (v % m_blockSize == 0) m_blockOffsets[v / m_blockSize] = end;
+                m_rowOffsets[v] = std::uint16_t(end - m_blockOffsets[v / m_blockSize]);
+                end += rowBytes[c];
+            }
+            m_data.resize(end);
+
+#pragma omp parallel for shared(rows, first, count) default(none)
+            for (int c = 0; c < count; ++c)
+            {
+                const int v = first + c;
+                std::uint8_t* out = m_data.data() + m_blockOffsets[v / m_blockSize] + m_rowOffsets[v];
+                for (int j = 0; j < m_k; ++j)
+                    out = internal::varint_encode(
+                            internal::zigzag_encode(std::int32_t(rows[std::size_t(c) * m_k + j] - v)), out);
+            }
+        }
+        m_blockOffsets[blockCount] = m_data.size();
+        m_data.shrink_to_fit();
+    }
+
+    // Query -------------------------------------------------------------------
+public:
+    /// \brief Neighbors of the point `index`, which must be a vertex of the graph
+    inline KNearestIndexQuery k_nearest_neighbors(int index) const{
+        PONCA_DEBUG_ASSERT(vertexFromPoint(index) >= 0);
+        return KNearestIndexQuery(this, index);
+    }
+
+    /// \brief Points reached by region growing from the point `index` and in the ball of radius `r`
+    /// \see KnnGraphBase::range_neighbors
+    inline RangeIndexQuery    range_neighbors(int index, Scalar r) const{
+        return RangeIndexQuery(this, r, index);
+    }
+
+    /// \copydoc KnnGraphBase::range_neighbors(int,Scalar,KnnGraphTraversalContext&)const
+    inline RangeIndexQuery    range_neighbors(int index, Scalar r, KnnGraphTraversalContext& context) const{
+        return RangeIndexQuery(this, r, index, context);
+    }
+
+    // Accessors ---------------------------------------------------------------
+public:
+    /// \brief Number of neighbor per vertex
+    inline int k() const { return m_k; }
+    /// \brief Number of vertices in the neighborhood graph
+    inline int size() const { return m_vertices.size(); }
+    /// \brief Number of points of the point cloud, including the points that are not vertices
+    inline int point_count() const { return int(m_kdTreePoints.size()); }
+
+    /// \brief Index of the point associated with the vertex `vertex_index`
+    inline int pointFromVertex(int vertex_index) const { return m_vertices.pointFromVertex(vertex_index); }
+    /// \brief Index of the vertex associated with the point `point_index`, -1 if the point is not a vertex
+    inline int vertexFromPoint(int point_index) const { return m_vertices.vertexFromPoint(point_index); }
+
+    /// \brief Memory used by the encoded neighbors, the row offsets and the vertex mappings, in bytes
+    inline std::size_t index_bytes() const {
+        return m_data.size() + m_blockOffsets.size() * sizeof(std::uint64_t)
+             + m_rowOffsets.size() * sizeof(std::uint16_t) + m_vertices.index_bytes();
+    }
+
+    // Data --------------------------------------------------------------------
+private:
+    static constexpr int MAX_BLOCK_SIZE  = 64; ///< Maximum number of vertices per block
+    static constexpr int MAX_VARINT_SIZE = 5;  ///< Maximum size of an encoded neighbor, in bytes
+    static constexpr int CHUNK_BLOCKS    = 1024; ///< Number of blocks computed at once during the construction
+
+    const int m_k;
+    int m_blockSize {MAX_BLOCK_SIZE};
+    std::vector<std::uint8_t>  m_data;         ///< \brief Encoded neighbors, row by row
+    std::vector<std::uint64_t> m_blockOffsets; ///< \brief Offset of the first row of each block in m_data
+    std::vector<std::uint16_t> m_rowOffsets;   ///< \brief Offset of each row from the first row of its block
+    internal::KnnGraphVertexMapping<IndexContainer> m_vertices; ///< \brief Vertices of the graph
+
+protected: // for friends relations
+    const PointContainer& m_kdTreePoints;
+    inline NeighborIterator row_begin(int vertex_index) const {
+        const std::uint8_t* row = m_data.data() + m_blockOffsets[vertex_index / m_blockSize] + m_rowOffsets[vertex_index];
+        return NeighborIterator(row, m_k, IndexType(vertex_index), m_vertices.vertex_point_data());
+    }
+    inline NeighborIterator row_end(int) const { return NeighborIterator(); }
+};
+
+} // namespace Ponca
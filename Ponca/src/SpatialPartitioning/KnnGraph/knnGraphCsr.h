@@ -0,0 +1,460 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./knnGraphTraits.h"
+#include "./knnGraphVertexMapping.h"
+#include "./knnGraphSerialization.h"
+
+#include "../indexSquaredDistance.h"
+#include "../KdTree/kdTree.h"
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Ponca {
+
+template <typename Traits> class KnnGraphCsrBase;
+
+/*!
+ * \brief Public interface for variable-degree neighbor graphs stored in compressed sparse rows
+ *
+ * \see KnnGraphCsrBase for complete API
+ */
+template <typename DataPoint>
+using KnnGraphCsr = KnnGraphCsrBase<KnnGraphDefaultTraits<DataPoint>>;
+
+/// \brief Edges of a KnnGraphCsrBase
+enum class KnnGraphCsrMode
+{
+    SymmetricKNearest, ///< `i` and `j` are connected if `j` is a k-nearest neighbor of `i`, or `i` of `j`
+    MutualKNearest,    ///< `i` and `j` are connected if `j` is a k-nearest neighbor of `i`, and `i` of `j`
+    Radius             ///< `i` and `j` are connected if their distance is lower than a radius
+};
+
+/*!
+ * \brief Neighbor graph with a variable number of neighbors per vertex, stored in compressed sparse rows (CSR)
+ *
+ * The neighbors of all the vertices are stored in a single array, the neighbors of the vertex `v` being between
+ * `offsets()[v]` and `offsets()[v+1]`. In each row, neighbors are sorted by increasing distance (ties by increasing
+ * index). Squared distances can optionally be stored along the neighbors.
+ *
+ * All the build modes give undirected graphs: if `j` is a neighbor of `i`, `i` is a neighbor of `j`. They are built
+ * in parallel from a single search per vertex in the kd-tree.
+ *
+ * As for KnnGraphBase, the vertices of the graph are the samples of the kd-tree, ordered by increasing point index.
+ * Accessors take and return point indices.
+ *
+ * \see KnnGraphCsrMode
+ */
+template <typename Traits> class KnnGraphCsrBase
+{
+public:
+    using DataPoint  = typename Traits::DataPoint; ///< DataPoint given by user via Traits
+    using Scalar     = typename DataPoint::Scalar; ///< Scalar given by user via DataPoint
+    using VectorType = typename DataPoint::VectorType; ///< VectorType given by user via DataPoint
+
+    using IndexType      = typename Traits::IndexType;
+    using PointContainer = typename Traits::PointContainer; ///< Container for DataPoint used inside the KdTree
+    using IndexContainer = typename Traits::IndexContainer; ///< Container for indices used inside the KdTree
+    using ScalarContainer = std::vector<Scalar>; ///< Container for the squared distances
+
+    /// \brief Contiguous range of values of a row
+    template <typename Iterator>
+    struct Range
+    {
+        Iterator first, last;
+        inline Iterator begin() const { return first; }
+        inline Iterator end() const { return last; }
+        inline int size() const { return int(last - first); }
+        inline bool empty() const { return first == last; }
+    };
+    using IndexRange  = Range<typename IndexContainer::const_iterator>;
+    using ScalarRange = Range<typename ScalarContainer::const_iterator>;
+
+    // knnGraphCsr -------------------------------------------------------------
+public:
+    /// \brief Build a symmetric or mutual k-nearest neighbors graph
+    ///
+    /// \param mode KnnGraphCsrMode::SymmetricKNearest or KnnGraphCsrMode::MutualKNearest
+    /// \param k Number of nearest neighbors of each vertex, reduced if larger than the kdtree size - 1
+    /// \param storeDistances Store the squared distances to the neighbors
+    ///
+    /// \warning Stores a const reference to kdtree.point_data()
+    template<typename KdTreeTraits>
+    inline KnnGraphCsrBase(const KdTreeBase<KdTreeTraits>& kdtree, KnnGraphCsrMode mode, int k,
+                           bool storeDistances = false)
+        : m_mode(mode), m_k(std::max(0, std::min(k, kdtree.sample_count() - 1))), m_kdTreePoints(kdtree.points())
+    {
+        checkTraits<KdTreeTraits>();
+        PONCA_DEBUG_ASSERT(mode != KnnGraphCsrMode::Radius);
+        m_storeDistances = storeDistances;
+        m_vertices.build(kdtree);
+        buildKNearest(kdtree, storeDistances);
+    }
+
+    /// \brief Build a graph connecting the vertices closer than `radius`
+    ///
+    /// \param storeDistances Store the squared distances to the neighbors
+    ///
+    /// \warning Stores a const reference to kdtree.point_data()
+    template<typename KdTreeTraits>
+    inline KnnGraphCsrBase(const KdTreeBase<KdTreeTraits>& kdtree, Scalar radius, bool storeDistances = false)
+        : m_mode(KnnGraphCsrMode::Radius), m_radius(radius), m_kdTreePoints(kdtree.points())
+    {
+        checkTraits<KdTreeTraits>();
+        m_storeDistances = storeDistances;
+        m_vertices.build(kdtree);
+        buildRadius(kdtree, storeDistances);
+    }
+
+    // Serialization -----------------------------------------------------------
+public:
+    /// \brief Save the graph in a binary file, with its offsets, neighbors, distances and vertex mappings
+    /// \see KnnGraphBase::save
+    inline bool save(const std::string& filename) const
+    {
+        internal::KnnGraphFileHeader header;
+        header.kind           = internal::KnnGraphFileKind::Csr;
+        header.index_bytes    = sizeof(IndexType);
+        header.scalar_bytes   = sizeof(Scalar);
+        header.flags          = (m_vertices.vertex_point_data() ? internal::KnnGraphFileHeader::HAS_VERTEX_POINTS : 0)
+                              | (m_storeDistances ? internal::KnnGraphFileHeader::HAS_DISTANCES : 0);
+        header.vertex_count   = size();
+        header.point_count    = point_count();
+        header.neighbor_count = edge_count();
+        header.k              = m_k;
+        header.mode           = std::int32_t(m_mode);
+        header.radius         = double(m_radius);
+
+        internal::KnnGraphFileWriter writer(filename);
+        writer.write(&header, sizeof(header));
+        writer.write(m_offsets.data(), m_offsets.size() * sizeof(IndexType));
+        writer.write(m_indices.data(), m_indices.size() * sizeof(IndexType));
+        if (m_storeDistances)
+            writer.write(m_squaredDistances.data(), m_squaredDistances.size() * sizeof(Scalar));
+        if (m_vertices.vertex_point_data())
+            writer.write(m_vertices.vertex_point_data(), std::size_t(size()) * sizeof(IndexType));
+        return writer.close();
+    }
+
+    /// \brief Load a graph saved by \ref save, bound to the container `points`
+    ///
+    /// Rows are exposed as container iterators: the arrays are copied from the file, mapped in memory when possible.
+    /// The copied offsets and neighbors are checked: nothing is returned if the offsets do not describe consecutive
+    /// rows of the neighbors array, or if a neighbor is not an index of `points`.
+    /// \see KnnGraphBase::load
+    static inline std::optional<KnnGraphCsrBase> load(const std::string& filename, const PointContainer& points)
+    {
+        auto file = internal::KnnGraphFile::open(filename);
+        if (!file) return std::nullopt;
+        const internal::KnnGraphFileHeader& header = file->header();
+        const bool distances = header.flags & internal::KnnGraphFileHeader::HAS_DISTANCES;
+        const bool mapping   = header.flags & internal::KnnGraphFileHeader::HAS_VERTEX_POINTS;
+        if (header.kind != internal::KnnGraphFileKind::Csr || header.index_bytes != sizeof(IndexType) ||
+            (distances && header.scalar_bytes != sizeof(Scalar)) ||
+            header.point_count != std::int64_t(points.size()) || header.vertex_count < 0 ||
+            header.vertex_count > header.point_count || header.neighbor_count < 0)
+            return std::nullopt;
+
+        std::size_t offset = internal::knngraph_file_next(0, sizeof(header));
+        const IndexType* offsets = file->template next<IndexType>(offset, std::size_t(header.vertex_count) + 1);
+        const IndexType* indices = file->template next<IndexType>(offset, std::size_t(header.neighbor_count));
+        const Scalar* squaredDistances = distances
+                ? file->template next<Scalar>(offset, std::size_t(header.neighbor_count)) : nullptr;
+        const IndexType* vertexPoints = mapping
+                ? file->template next<IndexType>(offset, std::size_t(header.vertex_count)) : nullptr;
+        if (!offsets || !indices || (distances && !squaredDistances) || (mapping && !vertexPoints) ||
+            !internal::knngraph_valid_offsets(offsets, header.vertex_count, header.neighbor_count) ||
+            !internal::knngraph_valid_indices(indices, std::size_t(header.neighbor_count), header.point_count))
+            return std::nullopt;
+
+        KnnGraphCsrBase graph(points, KnnGraphCsrMode(header.mode), header.k, Scalar(header.radius));
+        if (!graph.m_vertices.assign(int(header.vertex_count), vertexPoints, int(header.point_count)))
+            return std::nullopt;
+        graph.m_storeDistances = distances;
+        graph.m_offsets.assign(offsets, offsets + header.vertex_count + 1);
+        graph.m_indices.assign(indices, indices + header.neighbor_count);
+        if (distances)
+            graph.m_squaredDistances.assign(squaredDistances, squaredDistances + header.neighbor_count);
+        return std::optional<KnnGraphCsrBase>(std::move(graph));
+    }
+
+    // Query -------------------------------------------------------------------
+public:
+    /// \brief Neighbors of the point `index`, which must be a vertex of the graph, sorted by increasing distance
+    inline IndexRange neighbors(int index) const
+    {
+        const int v = row(index);
+        return {m_indices.begin() + m_offsets[v], m_indices.begin() + m_offsets[v + 1]};
+    }
+
+    /// \brief Squared distances between the point `index` and its \ref neighbors
+    /// \warning Requires the distances to be stored, see \ref has_distances
+    inline ScalarRange squared_distances(int index) const
+    {
+        PONCA_DEBUG_ASSERT(has_distances());
+        const int v = row(index);
+        return {m_squaredDistances.begin() + m_offsets[v], m_squaredDistances.begin() + m_offsets[v + 1]};
+    }
+
+    /// \brief Number of neighbors of the point `index`
+    inline int degree(int index) const
+    {
+        const int v = row(index);
+        return int(m_offsets[v + 1] - m_offsets[v]);
+    }
+
+    // Accessors ---------------------------------------------------------------
+public:
+    /// \brief Edges of the graph
+    inline KnnGraphCsrMode mode() const { return m_mode; }
+    /// \brief Number of nearest neighbors used to build the graph, 0 for KnnGraphCsrMode::Radius
+    inline int k() const { return m_k; }
+    /// \brief Radius used to build the graph, 0 for k-nearest neighbors modes
+    inline Scalar radius() const { return m_radius; }
+    /// \brief Number of vertices in the neighborhood graph
+    inline int size() const { return m_vertices.size(); }
+    /// \brief Number of points of the point cloud, including the points that are not vertices
+    inline int point_count() const { return int(m_kdTreePoints.size()); }
+    /// \brief Number of stored neighbors, each undirected edge being stored twice
+    inline int edge_count() const { return int(m_indices.size()); }
+    /// \brief Read if the squared distances to the neighbors are stored
+    inline bool has_distances() const { return m_storeDistances; }
+
+    /// \brief Start of the row of each vertex in \ref index_data, of size \ref size + 1
+    inline const IndexContainer& offsets() const { return m_offsets; }
+    /// \brief Neighbors of all the vertices, as point indices
+    inline const IndexContainer& index_data() const { return m_indices; }
+    /// \brief Squared distances to the neighbors of all the vertices, empty if not stored
+    inline const ScalarContainer& squared_distance_data() const { return m_squaredDistances; }
+    /// \brief Points of the kd-tree used to build the graph
+    inline const PointContainer& points() const { return m_kdTreePoints; }
+
+    /// \brief Index of the point associated with the vertex `vertex_index`
+    inline int pointFromVertex(int vertex_index) const { return m_vertices.pointFromVertex(vertex_index); }
+    /// \brief Index of the vertex associated with the point `point_index`, -1 if the point is not a vertex
+    inline int vertexFromPoint(int point_index) const { return m_vertices.vertexFromPoint(point_index); }
+
+    // Build -------------------------------------------------------------------
+protected:
+    using Neighbor = IndexSquaredDistance<IndexType, Scalar>;
+
+    /// Empty graph bound to `points`, filled by \ref load
+    inline KnnGraphCsrBase(const PointContainer& points, KnnGraphCsrMode mode, int k, Scalar radius)
+        : m_mode(mode), m_k(k), m_radius(radius), m_kdTreePoints(points)
+    { }
+
+    template<typename KdTreeTraits>
+    static inline void checkTraits()
+    {
+        static_assert( std::is_same<typename Traits::DataPoint, typename KdTreeTraits::DataPoint>::value,
+                       "KdTreeTraits::DataPoint is not equal to Traits::DataPoint" );
+        static_assert( std::is_same<typename Traits::PointContainer, typename KdTreeTraits::PointContainer>::value,
+                       "KdTreeTraits::PointContainer is not equal to Traits::PointContainer" );
+        static_assert( std::is_same<typename Traits::IndexContainer, typename KdTreeTraits::IndexContainer>::value,
+                       "KdTreeTraits::IndexContainer is not equal to Traits::IndexContainer" );
+    }
+
+    inline int row(int index) const
+    {
+        const int v = vertexFromPoint(index);
+        PONCA_DEBUG_ASSERT(v >= 0);
+        return v;
+    }
+
+    /// Neighbors sorted by distance, ties by index, so that rows do not depend on the build order
+    static inline bool closer(const Neighbor& a, const Neighbor& b)
+    {
+        return a.squared_distance < b.squared_distance ||
+               (a.squared_distance == b.squared_distance && a.index < b.index);
+    }
+
+    /// Exclusive prefix sum of the degrees, stored in m_offsets
+    inline void computeOffsets(const IndexContainer& degrees)
+    {
+        m_offsets.assign(degrees.size() + 1, 0);
+        for (std::size_t v = 0; v < degrees.size(); ++v)
+            m_offsets[v + 1] = m_offsets[v] + degrees[v];
+    }
+
+    /// Copy the neighbors of row `v`, given by `get(j)` for j in [0, degree)
+    template <typename Getter>
+    inline void writeRow(int v, Getter get, bool storeDistances)
+    {
+        for (IndexType e = m_offsets[v], j = 0; e < m_offsets[v + 1]; ++e, ++j)
+        {
+            const Neighbor n = get(j);
+            m_indices[e] = n.index;
+            if (storeDistances) m_squaredDistances[e] = n.squared_distance;
+        }
+    }
+
+    template<typename KdTreeTraits>
+    inline void buildKNearest(const KdTreeBase<KdTreeTraits>& kdtree, bool storeDistances)
+    {
+        const int vertexCount = size();
+        const int k = m_k;
+        const auto& points = m_kdTreePoints;
+
+        // k-nearest neighbors of each vertex, sorted by distance
+        std::vector<Neighbor> knn(std::size_t(vertexCount) * k);
+#pragma omp parallel for
+        for (int v = 0; v < vertexCount; ++v)
+        {
+            const int i = pointFromVertex(v);
+            int j = 0;
+            for (int n : kdtree.k_nearest_neighbors(typename KdTreeTraits::IndexType(i),
+                                                    typename KdTreeTraits::IndexType(k)))
+            {
+                knn[std::size_t(v) * k + j] = {n, (points[i].pos() - points[n].pos()).squaredNorm()};
+                ++j;
+            }
+            std::sort(knn.begin() + std::size_t(v) * k, knn.begin() + std::size_t(v + 1) * k, closer);
+        }
+
+        // Edges i -> j that are also j -> i
+        const auto isReciprocal = [&](int v, int j) {
+            const int i = pointFromVertex(v);
+            const std::size_t w = std::size_t(vertexFromPoint(knn[std::size_t(v) * k + j].index));
+            for (int l = 0; l < k; ++l)
+                if (knn[w * k + l].index == i) return true;
+            return false;
+        };
+        std::vector<char> reciprocal(knn.size());
+        IndexContainer degrees(vertexCount, 0);
+#pragma omp parallel for
+        for (int v = 0; v < vertexCount; ++v)
+        {
+            for (int j = 0; j < k; ++j)
+            {
+                reciprocal[std::size_t(v) * k + j] = isReciprocal(v, j);
+                if (reciprocal[std::size_t(v) * k + j])
+                {
+#pragma omp atomic
+                    ++degrees[v];
+                }
+                else if (m_mode == KnnGraphCsrMode::SymmetricKNearest)
+                {
+                    // Both directions are added: j -> i is stored in the row of j
+                    const int w = vertexFromPoint(knn[std::size_t(v) * k + j].index);
+#pragma omp atomic
+                    ++degrees[v];
+#pragma omp atomic
+                    ++degrees[w];
+                }
+            }
+        }
+
+        computeOffsets(degrees);
+        m_indices.resize(m_offsets.back());
+        if (storeDistances) m_squaredDistances.resize(m_offsets.back());
+
+        // Rows start with the k-nearest neighbors, already sorted, followed by the reverse edges
+        IndexContainer cursors(vertexCount);
+#pragma omp parallel for
+        for (int v = 0; v < vertexCount; ++v)
+        {
+            IndexType e = m_offsets[v];
+            for (int j = 0; j < k; ++j)
+            {
+                const Neighbor& n = knn[std::size_t(v) * k + j];
+                if (m_mode == KnnGraphCsrMode::MutualKNearest && !reciprocal[std::size_t(v) * k + j]) continue;
+                m_indices[e] = n.index;
+                if (storeDistances) m_squaredDistances[e] = n.squared_distance;
+                ++e;
+            }
+            cursors[v] = e;
+        }
+
+        if (m_mode == KnnGraphCsrMode::SymmetricKNearest)
+        {
+            std::vector<char> unsorted(vertexCount, 0);
+#pragma omp parallel for
+            for (int v = 0; v < vertexCount; ++v)
+            {
+                for (int j = 0; j < k; ++j)
+                {
+                    if (reciprocal[std::size_t(v) * k + j]) continue;
+                    const Neighbor& n = knn[std::size_t(v) * k + j];
+                    const int w = vertexFromPoint(n.index);
+                    IndexType e;
+#pragma omp atomic capture
+                    e = cursors[w]++;
+                    m_indices[e] = pointFromVertex(v);
+                    if (storeDistances) m_squaredDistances[e] = n.squared_distance;
+                    unsorted[w] = 1;
+                }
+            }
+
+            // Merge the reverse edges in the sorted rows
+            std::vector<Neighbor> rowNeighbors;
+#pragma omp parallel for private(rowNeighbors)
+            for (int v = 0; v < vertexCount; ++v)
+            {
+                if (!unsorted[v]) continue;
+                const int i = pointFromVertex(v);
+                rowNeighbors.clear();
+                for (IndexType e = m_offsets[v]; e < m_offsets[v + 1]; ++e)
+                    rowNeighbors.push_back({m_indices[e], storeDistances
+                                                          ? m_squaredDistances[e]
+                                                          : (points[i].pos() - points[m_indices[e]].pos()).squaredNorm()});
+                std::sort(rowNeighbors.begin(), rowNeighbors.end(), closer);
+                writeRow(v, [&](IndexType j) { return rowNeighbors[j]; }, storeDistances);
+            }
+        }
+    }
+
+    template<typename KdTreeTraits>
+    inline void buildRadius(const KdTreeBase<KdTreeTraits>& kdtree, bool storeDistances)
+    {
+        const int vertexCount = size();
+        const auto& points = m_kdTreePoints;
+
+        // The range neighbors of all the samples are computed leaf by leaf, in parallel
+        std::vector<std::vector<Neighbor>> rows(vertexCount);
+        kdtree.for_each_range_neighbors(m_radius, [&](int i, const std::vector<typename KdTreeTraits::IndexType>& neighbors) {
+            auto& r = rows[vertexFromPoint(i)];
+            r.reserve(neighbors.size());
+            for (auto n : neighbors)
+                r.push_back({IndexType(n), (points[i].pos() - points[n].pos()).squaredNorm()});
+            std::sort(r.begin(), r.end(), closer);
+        });
+
+        IndexContainer degrees(vertexCount);
+        for (int v = 0; v < vertexCount; ++v)
+            degrees[v] = IndexType(rows[v].size());
+        computeOffsets(degrees);
+        m_indices.resize(m_offsets.back());
+        if (storeDistances) m_squaredDistances.resize(m_offsets.back());
+
+#pragma omp parallel for
+        for (int v = 0; v < vertexCount; ++v)
+        {
+            writeRow(v, [&](IndexType j) { return rows[v][j]; }, storeDistances);
+            std::vector<Neighbor>().swap(rows[v]);
+        }
+    }
+
+    // Data --------------------------------------------------------------------
+private:
+    const KnnGraphCsrMode m_mode;
+    const int m_k {0};
+    const Scalar m_radius {0};
+    bool m_storeDistances {false};
+    IndexContainer m_offsets;           ///< \brief Start of the row of each vertex, and total size
+    IndexContainer m_indices;           ///< \brief Neighbors of all the vertices, as point indices
+    ScalarContainer m_squaredDistances; ///< \brief Squared distances to the neighbors, empty if not stored
+    internal::KnnGraphVertexMapping<IndexContainer> m_vertices; ///< \brief Vertices of the graph
+
+    const PointContainer& m_kdTreePoints;
+};
+
+} // namespace Ponca
@@ -0,0 +1,240 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "../../Common/Macro.h"
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Ponca {
+
+template <typename Traits> class KnnGraphBase;
+
+/// \brief Gaussian edge weights of a KnnGraphLaplacian, \f$ w = \exp(-d^2 / (2 \sigma^2)) \f$
+template <typename Scalar>
+struct KnnGraphGaussianWeight
+{
+    Scalar sigma {1};
+
+    inline Scalar operator()(Scalar squaredDistance) const
+    {
+        using std::exp;
+        return exp(-squaredDistance / (Scalar(2) * sigma * sigma));
+    }
+};
+
+/// \brief Edge weights of a KnnGraphLaplacian given by a weight kernel (e.g. SmoothWeightKernel) of support `t`,
+/// \f$ w = k(d / t) \f$ if \f$ d < t \f$, 0 otherwise
+template <typename WeightKernel>
+struct KnnGraphKernelWeight
+{
+    using Scalar = typename WeightKernel::Scalar;
+
+    Scalar t {1};
+    WeightKernel kernel {};
+
+    inline Scalar operator()(Scalar squaredDistance) const
+    {
+        using std::sqrt;
+        const Scalar d = sqrt(squaredDistance);
+        return d < t ? kernel.f(d / t) : Scalar(0);
+    }
+};
+
+/*!
+ * \brief Diffusion operator of per-vertex attributes over the edges of a KnnGraph
+ *
+ * Stores the normalized weights \f$ w_{ij} / \sum_j w_{ij} \f$ of the edges of the graph in compressed sparse rows,
+ * the weight of an edge being given by a functor of the squared distance between its points (see
+ * KnnGraphGaussianWeight and KnnGraphKernelWeight). By default, the edges are made symmetric: `j` is connected to `i`
+ * if `j` is a neighbor of `i`, or `i` of `j`.
+ *
+ * Attributes are stored as structures of arrays in AttributeMatrix, with one row per vertex and one column per
+ * channel (e.g. 3 columns for normals). Matrices are column major, so that each channel is contiguous. Products
+ * are computed by blocks of rows in parallel, all the channels of a block being processed while its weights are in
+ * cache.
+ *
+ * \see KnnGraphBase::laplacian
+ */
+template <typename Traits>
+class KnnGraphLaplacian
+{
+public:
+    using DataPoint       = typename Traits::DataPoint;
+    using Scalar          = typename DataPoint::Scalar;
+    using AttributeMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>; ///< One row per vertex
+
+    /// \brief Compute the normalized weights of the edges of `graph`
+    /// \param weight Functor giving the weight of an edge from the squared distance between its points
+    /// \param symmetric Add the reversed edges
+    template <typename WeightFunctor>
+    inline KnnGraphLaplacian(const KnnGraphBase<Traits>& graph, WeightFunctor&& weight, bool symmetric = true);
+
+    /// \brief Number of vertices, i.e. number of rows of the attribute matrices
+    inline int size() const { return int(m_offsets.size()) - 1; }
+    /// \brief Number of stored edges
+    inline int edge_count() const { return int(m_columns.size()); }
+
+    /// \brief Weighted average of the neighbors of each vertex: \f$ y_i = \sum_j w_{ij} x_j \f$
+    ///
+    /// Vertices without neighbor, or whose neighbors all have a zero weight, keep their value.
+    /// \param out Resized to the size of `in` if needed, must not be `in`
+    inline void smooth(const AttributeMatrix& in, AttributeMatrix& out) const;
+
+    /// \brief Random walk graph Laplacian: \f$ y_i = x_i - \sum_j w_{ij} x_j \f$
+    /// \param out Resized to the size of `in` if needed, must not be `in`
+    inline void laplacian(const AttributeMatrix& in, AttributeMatrix& out) const;
+
+    /// \brief Explicit diffusion steps, in place: \f$ x_i \leftarrow (1 - \lambda) x_i + \lambda \sum_j w_{ij} x_j \f$
+    ///
+    /// The previous values are kept in a buffer owned by the operator, so that the iterations, and the next calls with
+    /// as many channels, do not allocate.
+    /// \param lambda Step, in \f$ [0, 1] \f$. 1 replaces each value by the average of its neighbors
+    inline void diffuse(AttributeMatrix& attributes, int iterations = 1, Scalar lambda = Scalar(0.5));
+
+    /// \brief Offsets of the rows in \ref columns and \ref weights, of size \ref size + 1
+    inline const std::vector<int>& offsets() const { return m_offsets; }
+    /// \brief Vertex index of each edge
+    inline const std::vector<int>& columns() const { return m_columns; }
+    /// \brief Normalized weight of each edge
+    inline const std::vector<Scalar>& weights() const { return m_weights; }
+
+private:
+    /// \brief `out = alpha * in + beta * W in`, by blocks of rows
+    inline void multiply(const AttributeMatrix& in, AttributeMatrix& out, Scalar alpha, Scalar beta) const;
+
+    static constexpr int BLOCK_SIZE = 256; ///< Number of rows processed for all channels at once
+
+    std::vector<int> m_offsets;
+    std::vector<int> m_columns;
+    std::vector<Scalar> m_weights;
+    std::vector<char> m_isolated; ///< Rows without neighbor or with a zero total weight
+    AttributeMatrix m_buffer;     ///< Previous values during \ref diffuse
+};
+
+template <typename Traits>
+template <typename WeightFunctor>
+KnnGraphLaplacian<Traits>::KnnGraphLaplacian(const KnnGraphBase<Traits>& graph, WeightFunctor&& weight,
+                                             bool symmetric)
+{
+    const int vertexCount = graph.size();
+    const auto& points = graph.m_kdTreePoints;
+
+    // Degree of each vertex, then edges in compressed sparse rows
+    std::vector<int> degree(vertexCount, graph.k());
+    if (symmetric)
+        for (int v = 0; v < vertexCount; ++v)
+            for (int j : graph.k_nearest_neighbors(graph.pointFromVertex(v)))
+                ++degree[graph.vertexFromPoint(j)];
+    m_offsets.assign(vertexCount + 1, 0);
+    for (int v = 0; v < vertexCount; ++v)
+        m_offsets[v + 1] = m_offsets[v] + degree[v];
+    m_columns.resize(m_offsets[vertexCount]);
+
+    std::vector<int> fill(m_offsets.begin(), m_offsets.end() - 1);
+    for (int v = 0; v < vertexCount; ++v)
+        for (int j : graph.k_nearest_neighbors(graph.pointFromVertex(v)))
+        {
+            const int u = graph.vertexFromPoint(j);
+            m_columns[fill[v]++] = u;
+            if (symmetric) m_columns[fill[u]++] = v;
+        }
+
+    // Sort the rows, remove the edges stored twice, and normalize the weights
+    std::vector<int> sizes(vertexCount);
+#pragma omp parallel for
+    for (int v = 0; v < vertexCount; ++v)
+    {
+        const auto first = m_columns.begin() + m_offsets[v], last = m_columns.begin() + m_offsets[v + 1];
+        std::sort(first, last);
+        sizes[v] = int(std::unique(first, last) - first);
+    }
+    int count = 0;
+    for (int v = 0; v < vertexCount; ++v)
+    {
+        const int start = m_offsets[v];
+        m_offsets[v] = count;
+        for (int e = 0; e < sizes[v]; ++e)
+            m_columns[count++] = m_columns[start + e];
+    }
+    m_offsets[vertexCount] = count;
+    m_columns.resize(count);
+    m_weights.resize(count);
+    m_isolated.resize(vertexCount);
+
+#pragma omp parallel for
+    for (int v = 0; v < vertexCount; ++v)
+    {
+        const auto& p = points[graph.pointFromVertex(v)].pos();
+        Scalar sum = 0;
+        for (int e = m_offsets[v]; e < m_offsets[v + 1]; ++e)
+        {
+            m_weights[e] = weight((p - points[graph.pointFromVertex(m_columns[e])].pos()).squaredNorm());
+            sum += m_weights[e];
+        }
+        m_isolated[v] = !(sum > Scalar(0));
+        for (int e = m_offsets[v]; e < m_offsets[v + 1]; ++e)
+            m_weights[e] = m_isolated[v] ? Scalar(0) : m_weights[e] / sum;
+    }
+}
+
+template <typename Traits>
+void KnnGraphLaplacian<Traits>::multiply(const AttributeMatrix& in, AttributeMatrix& out, Scalar alpha,
+                                         Scalar beta) const
+{
+    PONCA_DEBUG_ASSERT(in.rows() == size() && &in != &out);
+    out.resize(in.rows(), in.cols());
+    const int channels = int(in.cols());
+    const int blockCount = (size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < blockCount; ++b)
+    {
+        const int first = b * BLOCK_SIZE, last = std::min(size(), first + BLOCK_SIZE);
+        for (int c = 0; c < channels; ++c)
+        {
+            const Scalar* x = in.col(c).data();
+            Scalar* y = out.col(c).data();
+            for (int v = first; v < last; ++v)
+            {
+                Scalar sum = 0;
+                for (int e = m_offsets[v]; e < m_offsets[v + 1]; ++e)
+                    sum += m_weights[e] * x[m_columns[e]];
+                // Isolated vertices are their own average
+                y[v] = m_isolated[v] ? (alpha + beta) * x[v] : alpha * x[v] + beta * sum;
+            }
+        }
+    }
+}
+
+template <typename Traits>
+void KnnGraphLaplacian<Traits>::smooth(const AttributeMatrix& in, AttributeMatrix& out) const
+{
+    multiply(in, out, Scalar(0), Scalar(1));
+}
+
+template <typename Traits>
+void KnnGraphLaplacian<Traits>::laplacian(const AttributeMatrix& in, AttributeMatrix& out) const
+{
+    multiply(in, out, Scalar(1), Scalar(-1));
+}
+
+template <typename Traits>
+void KnnGraphLaplacian<Traits>::diffuse(AttributeMatrix& attributes, int iterations, Scalar lambda)
+{
+    for (int i = 0; i < iterations; ++i)
+    {
+        // Swapping exchanges the storage of the matrices, without copy nor allocation
+        attributes.swap(m_buffer);
+        multiply(m_buffer, attributes, Scalar(1) - lambda, lambda);
+    }
+}
+
+} // namespace Ponca
@@ -0,0 +1,343 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace Ponca {
+
+/*!
+ * \brief Parameters of the construction of a KnnGraph from the kd-tree leaves, refined by NN-Descent
+ *
+ * The rows are initialized from the kd-tree leaves: the samples of each leaf are compared with each other, and with
+ * the samples of the leaves around it, up to a fraction (\ref reach) of the k-th neighbor distances in the leaf.
+ * The rows of the samples whose k-th neighbor is within this distance are exact. The other rows are refined by local
+ * joins, the neighbors of a neighbor being likely to be neighbors, until few rows are improved by an iteration. As
+ * in NN-Descent, the neighbors of a sample include a sample of its reverse neighbors, the samples whose row contains
+ * it.
+ *
+ * With the default \ref reach, all the rows are exact and the local joins have nothing to do. On low dimensional
+ * point clouds, searching the leaves around each leaf is cheap and gives a better recall than the local joins for
+ * the same time: lower values are mostly useful to bound the construction time on very irregular samplings.
+ *
+ * \see KnnGraphBase::KnnGraphBase(const KdTreeBase<KdTreeTraits>&,int,const KnnGraphNNDescentParameters&)
+ */
+struct KnnGraphNNDescentParameters
+{
+    /// \brief Fraction of the largest k-th neighbor distance of a leaf up to which the leaves around it are searched
+    /// by the initialization. With 1, the initialization gives the exact neighbors. With 0, only the samples of the
+    /// same leaf are compared, which the local joins cannot connect to the other leaves
+    float reach {1.f};
+    /// \brief Maximum number of local join iterations. With 0, the rows are given by the initialization
+    int max_iterations {10};
+    /// \brief The iterations stop when fewer than `termination * k * size()` neighbors are updated by an iteration
+    float termination {0.0001f};
+};
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /*!
+     * \brief k-nearest neighbors of a set of positions, from the leaves of a kd-tree and by NN-Descent local joins
+     * (Dong et al. 2011)
+     *
+     * Works on the samples of a kd-tree, in the kd-tree order: positions are copied by sample index, and the
+     * leaves are ranges of consecutive samples, so that each leaf is processed on contiguous memory. Each row is kept
+     * sorted by increasing distance.
+     */
+    template <typename Scalar, typename VectorType>
+    class NNDescent
+    {
+    public:
+        inline NNDescent(std::vector<VectorType>&& positions, int k)
+            : m_positions(std::move(positions)), m_n(int(m_positions.size())), m_k(k),
+              m_ids(std::size_t(m_n) * k, -1), m_distances(std::size_t(m_n) * k, std::numeric_limits<Scalar>::max()),
+              m_isNew(std::size_t(m_n) * k, 0), m_certified(m_n, 0)
+        { }
+
+        /// Initialize the rows from the nodes of a kd-tree over the samples
+        ///
+        /// The samples of each leaf are compared with each other, then with the samples of the other leaves that are
+        /// closer than `reach` times the largest k-th neighbor distance in the leaf. With `reach >= 1`, the rows are
+        /// exact.
+        ///
+        /// \param firstChild Index of the first child of each node, the second child being the next one, -1 for leaves
+        /// \param ranges Range of samples of each leaf node
+        inline void initialize(const std::vector<int>& firstChild, const std::vector<std::pair<int, int>>& ranges,
+                               Scalar reach)
+        {
+            // Children have larger indices than their parent: bounding boxes are computed bottom-up
+            const int nodeCount = int(firstChild.size());
+            std::vector<Box> boxes(nodeCount);
+            std::vector<int> leaves;
+            for (int node = nodeCount - 1; node >= 0; --node)
+            {
+                if (firstChild[node] < 0)
+                {
+                    for (int s = ranges[node].first; s < ranges[node].second; ++s)
+                        boxes[node].extend(m_positions[s]);
+                    leaves.push_back(node);
+                }
+                else
+                    boxes[node] = boxes[firstChild[node]].merged(boxes[firstChild[node] + 1]);
+            }
+
+            const Scalar reach2 = reach * reach;
+            const int leafCount = int(leaves.size());
+#pragma omp parallel for schedule(dynamic, 16)
+            for (int l = 0; l < leafCount; ++l)
+            {
+                std::vector<int>& stack = thread_buffer();
+                std::vector<std::pair<Scalar, int>>& candidates = thread_candidates();
+                const int leaf = leaves[l];
+                const int start = ranges[leaf].first, end = ranges[leaf].second;
+
+                // Rows of the leaf, completed by the next samples for small leaves
+                int first = start, last = end;
+                if (last - first < m_k + 1)
+                {
+                    last  = std::min(m_n, first + m_k + 1);
+                    first = std::max(0, last - m_k - 1);
+                }
+                for (int s = start; s < end; ++s)
+                {
+                    candidates.clear();
+                    for (int t = first; t < last; ++t)
+                        if (t != s) candidates.emplace_back(distance(s, t), t);
+                    std::nth_element(candidates.begin(), candidates.begin() + m_k - 1, candidates.end());
+                    std::sort(candidates.begin(), candidates.begin() + m_k);
+                    for (int j = 0; j < m_k; ++j)
+                    {
+                        m_distances[std::size_t(s) * m_k + j] = candidates[j].first;
+                        m_ids[std::size_t(s) * m_k + j]       = candidates[j].second;
+                        m_isNew[std::size_t(s) * m_k + j]     = 1;
+                    }
+                }
+                Scalar radius2 = leaf_radius(start, end) * reach2;
+
+                // Leaves around the leaf, closest first. The radius decreases with the k-th neighbor distances
+                stack.assign(1, 0);
+                while (!stack.empty())
+                {
+                    const int node = stack.back();
+                    stack.pop_back();
+                    if (node == leaf || !(boxes[node].squaredExteriorDistance(boxes[leaf]) < radius2)) continue;
+                    if (firstChild[node] >= 0)
+                    {
+                        const int a = firstChild[node], b = a + 1;
+                        const bool aFirst = boxes[a].squaredExteriorDistance(boxes[leaf])
+                                          < boxes[b].squaredExteriorDistance(boxes[leaf]);
+                        stack.push_back(aFirst ? b : a);
+                        stack.push_back(aFirst ? a : b);
+                        continue;
+                    }
+                    bool changed = false;
+                    for (int s = start; s < end; ++s)
+                    {
+                        const Scalar bound = std::min(radius2, m_distances[std::size_t(s + 1) * m_k - 1]);
+                        if (!(boxes[node].squaredExteriorDistance(m_positions[s]) < bound)) continue;
+                        for (int t = ranges[node].first; t < ranges[node].second; ++t)
+                            changed |= push(s, t, distance(s, t)) > 0;
+                    }
+                    if (changed) radius2 = std::min(radius2, leaf_radius(start, end) * reach2);
+                }
+
+                // All the samples closer than radius2 have been compared
+                for (int s = start; s < end; ++s)
+                    m_certified[s] = !(radius2 < m_distances[std::size_t(s + 1) * m_k - 1]);
+            }
+        }
+
+        /// Local join iterations on the rows that are not certified by the initialization, return the number of
+        /// iterations
+        ///
+        /// Each row is compared with the rows of its neighbors: with the neighbors of its new neighbors, and of its
+        /// neighbors whose row changed during the previous iteration. Neighbors are taken in both directions: the
+        /// neighbors of a sample are its row and up to k of its reverse neighbors, sampled at each iteration. Rows are
+        /// updated in a copy and committed after each iteration, and the reverse neighbors are sampled with a fixed
+        /// seed, so that the result does not depend on the scheduling of the threads.
+        inline int refine(const KnnGraphNNDescentParameters& parameters)
+        {
+            std::vector<int> rows;
+            for (int s = 0; s < m_n; ++s)
+                if (!m_certified[s]) rows.push_back(s);
+            const int rowCount = int(rows.size());
+            const long long threshold = (long long)(double(parameters.termination) * m_k * m_n);
+
+            std::vector<int> ids(std::size_t(rowCount) * m_k);
+            std::vector<Scalar> distances(std::size_t(rowCount) * m_k);
+            std::vector<char> isNew(std::size_t(rowCount) * m_k);
+            std::vector<char> changed(m_n, 1), rowChanged(rowCount, 0);
+            ReverseNeighbors reverse(m_n, m_k);
+            std::minstd_rand random(0);
+
+            int iteration = 0;
+            while (iteration < parameters.max_iterations && rowCount > 0)
+            {
+                reverse.sample(m_ids, m_isNew, random);
+                long long updates = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:updates)
+                for (int r = 0; r < rowCount; ++r)
+                {
+                    const int s = rows[r];
+                    const std::size_t first = std::size_t(s) * m_k, copy = std::size_t(r) * m_k;
+                    std::copy(m_ids.begin() + first, m_ids.begin() + first + m_k, ids.begin() + copy);
+                    std::copy(m_distances.begin() + first, m_distances.begin() + first + m_k, distances.begin() + copy);
+                    std::fill(isNew.begin() + copy, isNew.begin() + copy + m_k, 0);
+
+                    int rowUpdates = 0;
+                    const auto compare = [&](int t) {
+                        if (t != s)
+                            rowUpdates += insert(ids.data() + copy, distances.data() + copy, isNew.data() + copy,
+                                                 t, distance(s, t));
+                    };
+                    // Compare the row with the neighbors, direct and reverse, of the neighbor `w`
+                    const auto join = [&](int w) {
+                        for (int i = 0; i < m_k; ++i)
+                            compare(m_ids[std::size_t(w) * m_k + i]);
+                        for (int i = 0; i < reverse.count(w); ++i)
+                            compare(reverse.id(w, i));
+                    };
+                    for (int j = 0; j < m_k; ++j)
+                    {
+                        const int w = m_ids[first + j];
+                        if (m_isNew[first + j] || changed[w]) join(w);
+                    }
+                    for (int i = 0; i < reverse.count(s); ++i)
+                    {
+                        const int w = reverse.id(s, i);
+                        if (reverse.isNew(s, i) || changed[w]) join(w);
+                    }
+                    rowChanged[r] = rowUpdates > 0;
+                    updates += rowUpdates;
+                }
+
+                // Commit the rows, the flags giving the neighbors to explore at the next iteration
+                std::fill(changed.begin(), changed.end(), 0);
+#pragma omp parallel for
+                for (int r = 0; r < rowCount; ++r)
+                {
+                    const std::size_t first = std::size_t(rows[r]) * m_k, copy = std::size_t(r) * m_k;
+                    std::copy(ids.begin() + copy, ids.begin() + copy + m_k, m_ids.begin() + first);
+                    std::copy(distances.begin() + copy, distances.begin() + copy + m_k, m_distances.begin() + first);
+                    std::copy(isNew.begin() + copy, isNew.begin() + copy + m_k, m_isNew.begin() + first);
+                    changed[rows[r]] = rowChanged[r];
+                }
+                ++iteration;
+                if (updates <= threshold) break;
+            }
+            return iteration;
+        }
+
+        /// Neighbors of the sample `s`, as sample indices sorted by increasing distance
+        inline const int* row(int s) const { return m_ids.data() + std::size_t(s) * m_k; }
+
+    private:
+        /// Up to k reverse neighbors of each sample, chosen uniformly among the samples whose row contains it
+        class ReverseNeighbors
+        {
+        public:
+            inline ReverseNeighbors(int n, int k)
+                : m_k(k), m_ids(std::size_t(n) * k), m_isNew(std::size_t(n) * k), m_seen(n) { }
+
+            /// Sample the reverse neighbors of the rows `ids`, by reservoir sampling
+            inline void sample(const std::vector<int>& ids, const std::vector<char>& isNew, std::minstd_rand& random)
+            {
+                std::fill(m_seen.begin(), m_seen.end(), 0);
+                const int n = int(m_seen.size());
+                for (int t = 0; t < n; ++t)
+                    for (int j = 0; j < m_k; ++j)
+                    {
+                        const std::size_t e = std::size_t(t) * m_k + j;
+                        const int s = ids[e];
+                        const int seen = m_seen[s]++;
+                        const int slot = seen < m_k ? seen : int(random() % unsigned(seen + 1));
+                        if (slot >= m_k) continue;
+                        m_ids[std::size_t(s) * m_k + slot]   = t;
+                        m_isNew[std::size_t(s) * m_k + slot] = isNew[e];
+                    }
+            }
+
+            inline int count(int s) const { return std::min(m_seen[s], m_k); }
+            inline int id(int s, int i) const { return m_ids[std::size_t(s) * m_k + i]; }
+            /// Read if `s` was added to the row of id(s, i) since the last iteration
+            inline bool isNew(int s, int i) const { return m_isNew[std::size_t(s) * m_k + i]; }
+
+        private:
+            int m_k;
+            std::vector<int> m_ids;
+            std::vector<char> m_isNew;
+            std::vector<int> m_seen; ///< Number of rows containing each sample
+        };
+
+        inline Scalar distance(int s, int t) const { return (m_positions[s] - m_positions[t]).squaredNorm(); }
+
+        /// Insert `t` in a row sorted by increasing distance if it is closer than the last neighbor, return 1 if the
+        /// row changed
+        inline int insert(int* ids, Scalar* distances, char* isNew, int t, Scalar d) const
+        {
+            if (!(d < distances[m_k - 1])) return 0;
+            // A duplicate has the same distance, and is before the insertion position
+            for (int i = 0; i < m_k && distances[i] <= d; ++i)
+                if (ids[i] == t) return 0;
+            int j = m_k - 1;
+            for (; j > 0 && distances[j - 1] > d; --j)
+            {
+                ids[j]       = ids[j - 1];
+                distances[j] = distances[j - 1];
+                isNew[j]     = isNew[j - 1];
+            }
+            ids[j]       = t;
+            distances[j] = d;
+            isNew[j]     = 1;
+            return 1;
+        }
+        inline int push(int s, int t, Scalar d)
+        {
+            const std::size_t first = std::size_t(s) * m_k;
+            return insert(m_ids.data() + first, m_distances.data() + first, m_isNew.data() + first, t, d);
+        }
+
+        /// Largest k-th neighbor squared distance of the samples `[start, end)`
+        inline Scalar leaf_radius(int start, int end) const
+        {
+            Scalar radius2 = 0;
+            for (int s = start; s < end; ++s)
+                radius2 = std::max(radius2, m_distances[std::size_t(s + 1) * m_k - 1]);
+            return radius2;
+        }
+
+        static inline std::vector<int>& thread_buffer()
+        {
+            thread_local std::vector<int> buffer;
+            return buffer;
+        }
+        static inline std::vector<std::pair<Scalar, int>>& thread_candidates()
+        {
+            thread_local std::vector<std::pair<Scalar, int>> candidates;
+            return candidates;
+        }
+
+        using Box = Eigen::AlignedBox<Scalar, VectorType::RowsAtCompileTime>;
+
+        std::vector<VectorType> m_positions;
+        int m_n;
+        int m_k;
+        std::vector<int> m_ids;
+        std::vector<Scalar> m_distances;
+        std::vector<char> m_isNew;     ///< Neighbors added since the last iteration
+        std::vector<char> m_certified; ///< Rows known to be exact after the initialization
+    };
+}
+#endif
+
+} // namespace Ponca
@@ -0,0 +1,229 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define PONCA_KNNGRAPH_MMAP
+#endif
+
+namespace Ponca {
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /// Kind of graph stored in a file
+    enum class KnnGraphFileKind : std::uint32_t { KNearest = 0, Csr = 1 };
+
+    /*!
+     * \brief Header of the binary files of neighbor graphs
+     *
+     * The header is followed by the arrays of the graph, each starting at a multiple of
+     * KnnGraphFileHeader::ALIGNMENT bytes, so that they can be used in place from a mapped file. Values are stored
+     * with the byte order and the index and scalar sizes of the writer, which are checked by the reader.
+     */
+    struct KnnGraphFileHeader
+    {
+        static constexpr std::uint32_t VERSION    = 1;
+        static constexpr std::uint32_t ORDER_MARK = 0x01020304;
+        static constexpr std::size_t   ALIGNMENT  = 64;
+
+        static constexpr std::uint32_t HAS_VERTEX_POINTS = 1; ///< Some points are not vertices
+        static constexpr std::uint32_t HAS_DISTANCES     = 2; ///< Squared distances are stored along the neighbors
+
+        char          magic[8] {'P', 'O', 'N', 'C', 'A', 'K', 'N', 'N'};
+        std::uint32_t version {VERSION};
+        std::uint32_t byte_order {ORDER_MARK};
+        KnnGraphFileKind kind {KnnGraphFileKind::KNearest};
+        std::uint32_t index_bytes {0};    ///< Size of an index, in bytes
+        std::uint32_t scalar_bytes {0};   ///< Size of a scalar, in bytes
+        std::uint32_t flags {0};
+        std::int64_t  vertex_count {0};
+        std::int64_t  point_count {0};    ///< Size of the point container the graph must be bound to
+        std::int64_t  neighbor_count {0}; ///< Size of the array of neighbors
+        std::int32_t  k {0};
+        std::int32_t  mode {0};           ///< KnnGraphCsrMode
+        double        radius {0};
+
+        inline bool valid() const
+        {
+            return std::memcmp(magic, KnnGraphFileHeader().magic, sizeof(magic)) == 0 && version == VERSION
+                && byte_order == ORDER_MARK;
+        }
+    };
+
+    /// Offset of the end of an array of `bytes` bytes starting at `offset`, padded to the next array
+    inline std::size_t knngraph_file_next(std::size_t offset, std::size_t bytes)
+    {
+        const std::size_t end = offset + bytes;
+        return (end + KnnGraphFileHeader::ALIGNMENT - 1) / KnnGraphFileHeader::ALIGNMENT * KnnGraphFileHeader::ALIGNMENT;
+    }
+
+    /// Read if the `count` neighbors `indices` are point indices, in `[0, pointCount)`
+    template <typename IndexType>
+    inline bool knngraph_valid_indices(const IndexType* indices, std::size_t count, std::int64_t pointCount)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            if (indices[i] < 0 || std::int64_t(indices[i]) >= pointCount) return false;
+        return true;
+    }
+
+    /// Read if the `vertexCount + 1` row `offsets` start at 0, do not decrease, and end at `neighborCount`
+    template <typename IndexType>
+    inline bool knngraph_valid_offsets(const IndexType* offsets, std::int64_t vertexCount, std::int64_t neighborCount)
+    {
+        if (offsets[0] != 0 || std::int64_t(offsets[vertexCount]) != neighborCount) return false;
+        for (std::int64_t v = 0; v < vertexCount; ++v)
+            if (offsets[v + 1] < offsets[v]) return false;
+        return true;
+    }
+
+    /// \brief Sequential writer of the header and the aligned arrays of a graph file
+    class KnnGraphFileWriter
+    {
+    public:
+        inline explicit KnnGraphFileWriter(const std::string& filename) : m_file(std::fopen(filename.c_str(), "wb")) { }
+        inline ~KnnGraphFileWriter() { if (m_file) std::fclose(m_file); }
+        KnnGraphFileWriter(const KnnGraphFileWriter&) = delete;
+        KnnGraphFileWriter& operator=(const KnnGraphFileWriter&) = delete;
+
+        /// Write `bytes` bytes and the padding to the next array, return false if the writing failed
+        inline bool write(const void* data, std::size_t bytes)
+        {
+            if (!m_file) return false;
+            static const char padding[KnnGraphFileHeader::ALIGNMENT] {};
+            const std::size_t next = knngraph_file_next(m_offset, bytes);
+            m_ok = m_ok && (bytes == 0 || std::fwrite(data, 1, bytes, m_file) == bytes)
+                        && (next == m_offset + bytes || std::fwrite(padding, 1, next - m_offset - bytes, m_file)
+                                                        == next - m_offset - bytes);
+            m_offset = next;
+            return m_ok;
+        }
+
+        /// Flush and close the file, return false if any writing failed
+        inline bool close()
+        {
+            if (!m_file) return false;
+            m_ok = std::fclose(m_file) == 0 && m_ok;
+            m_file = nullptr;
+            return m_ok;
+        }
+
+    private:
+        std::FILE* m_file;
+        std::size_t m_offset {0};
+        bool m_ok {true};
+    };
+
+    /*!
+     * \brief Read-only content of a graph file, mapped in memory when possible
+     *
+     * With `mmap`, the pages are loaded on demand and shared by all the processes mapping the same file. Otherwise,
+     * or if the mapping fails, the file is read in an aligned buffer.
+     */
+    class KnnGraphFile
+    {
+    public:
+        /// Open `filename`, return nullptr if the file cannot be read or does not start with a valid header
+        static inline std::shared_ptr<const KnnGraphFile> open(const std::string& filename, bool map = true)
+        {
+            std::shared_ptr<KnnGraphFile> file(new KnnGraphFile());
+            if (!(map && file->map(filename)) && !file->read(filename))
+                return nullptr;
+            if (file->m_size < sizeof(KnnGraphFileHeader) || !file->header().valid())
+                return nullptr;
+            return file;
+        }
+
+        inline ~KnnGraphFile()
+        {
+#ifdef PONCA_KNNGRAPH_MMAP
+            if (m_mapped) munmap(const_cast<char*>(m_data), m_size);
+#endif
+        }
+        KnnGraphFile(const KnnGraphFile&) = delete;
+        KnnGraphFile& operator=(const KnnGraphFile&) = delete;
+
+        inline const KnnGraphFileHeader& header() const { return *reinterpret_cast<const KnnGraphFileHeader*>(m_data); }
+        inline std::size_t size() const { return m_size; }
+        /// Read if the file is mapped in memory, instead of copied
+        inline bool mapped() const { return m_mapped; }
+
+        /// Next array of `count` values of type T, nullptr if the file is too small
+        template <typename T>
+        inline const T* next(std::size_t& offset, std::size_t count) const
+        {
+            const std::size_t start = offset;
+            offset = knngraph_file_next(start, count * sizeof(T));
+            return start + count * sizeof(T) <= m_size ? reinterpret_cast<const T*>(m_data + start) : nullptr;
+        }
+
+    private:
+        KnnGraphFile() = default;
+
+        inline bool map(const std::string& filename)
+        {
+#ifdef PONCA_KNNGRAPH_MMAP
+            const int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size <= 0)
+            {
+                ::close(fd);
+                return false;
+            }
+            void* data = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) return false;
+            m_data   = static_cast<const char*>(data);
+            m_size   = std::size_t(st.st_size);
+            m_mapped = true;
+            return true;
+#else
+            (void)filename;
+            return false;
+#endif
+        }
+
+        inline bool read(const std::string& filename)
+        {
+            std::FILE* file = std::fopen(filename.c_str(), "rb");
+            if (!file) return false;
+            bool ok = std::fseek(file, 0, SEEK_END) == 0;
+            const long size = ok ? std::ftell(file) : -1;
+            ok = ok && size > 0 && std::fseek(file, 0, SEEK_SET) == 0;
+            if (ok)
+            {
+                // 64 bits words, so that the arrays are aligned
+                m_buffer.resize((std::size_t(size) + 7) / 8);
+                ok = std::fread(m_buffer.data(), 1, std::size_t(size), file) == std::size_t(size);
+                m_data = reinterpret_cast<const char*>(m_buffer.data());
+                m_size = std::size_t(size);
+            }
+            std::fclose(file);
+            return ok;
+        }
+
+        const char* m_data {nullptr};
+        std::size_t m_size {0};
+        bool m_mapped {false};
+        std::vector<std::uint64_t> m_buffer; ///< Content of the file when it is not mapped
+    };
+}
+#endif
+
+} // namespace Ponca
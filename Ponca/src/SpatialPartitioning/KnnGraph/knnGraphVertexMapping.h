@@ -0,0 +1,113 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace Ponca {
+
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /// \brief Correspondence between the vertices of a neighbor graph and the points of a kd-tree
+    ///
+    /// Vertices are the samples of the kd-tree, ordered by increasing point index, or in the order of the kd-tree
+    /// leaves. The mappings are only stored if vertex and point indices differ.
+    template <typename IndexContainer>
+    class KnnGraphVertexMapping
+    {
+    public:
+        using IndexType = typename IndexContainer::value_type;
+
+        /// \param spatialOrder Order the vertices as the samples of the kd-tree, so that close vertices have close
+        /// indices, instead of by increasing point index
+        template <typename KdTreeType>
+        inline void build(const KdTreeType& kdtree, bool spatialOrder = false)
+        {
+            m_vertexCount = kdtree.sample_count();
+            m_vertexPoints.clear();
+            m_pointVertices.clear();
+            if (m_vertexCount == kdtree.point_count() && !spatialOrder)
+                return;
+
+            m_vertexPoints.resize(m_vertexCount);
+            bool identity = m_vertexCount == kdtree.point_count();
+            for (int v = 0; v < m_vertexCount; ++v)
+            {
+                m_vertexPoints[v] = kdtree.pointFromSample(v);
+                identity = identity && m_vertexPoints[v] == v;
+            }
+            if (identity)
+            {
+                m_vertexPoints.clear();
+                return;
+            }
+            if (!spatialOrder)
+                std::sort(m_vertexPoints.begin(), m_vertexPoints.end());
+
+            m_pointVertices.resize(kdtree.point_count(), -1);
+            for (int v = 0; v < m_vertexCount; ++v)
+                m_pointVertices[m_vertexPoints[v]] = v;
+        }
+
+        /// Set the mappings from the point index of each vertex
+        /// \param vertexPoints Point index of each vertex, nullptr if vertex and point indices are equal
+        /// \return false if a point index is out of range or used twice, in which case the mappings are left empty
+        inline bool assign(int vertexCount, const IndexType* vertexPoints, int pointCount)
+        {
+            m_vertexCount = vertexCount;
+            m_vertexPoints.clear();
+            m_pointVertices.clear();
+            if (!vertexPoints)
+                return vertexCount == pointCount;
+
+            m_vertexPoints.assign(vertexPoints, vertexPoints + vertexCount);
+            m_pointVertices.resize(pointCount, -1);
+            for (int v = 0; v < m_vertexCount; ++v)
+            {
+                const IndexType i = m_vertexPoints[v];
+                if (i < 0 || i >= pointCount || m_pointVertices[i] >= 0)
+                {
+                    m_vertexCount = 0;
+                    m_vertexPoints.clear();
+                    m_pointVertices.clear();
+                    return false;
+                }
+                m_pointVertices[i] = v;
+            }
+            return true;
+        }
+
+        /// Number of vertices
+        inline int size() const { return m_vertexCount; }
+
+        inline int pointFromVertex(int vertex_index) const {
+            return m_vertexPoints.empty() ? vertex_index : m_vertexPoints[vertex_index];
+        }
+        inline int vertexFromPoint(int point_index) const {
+            return m_vertexPoints.empty() ? point_index : m_pointVertices[point_index];
+        }
+
+        /// Point index of each vertex, nullptr if vertex and point indices are equal
+        inline const IndexType* vertex_point_data() const {
+            return m_vertexPoints.empty() ? nullptr : m_vertexPoints.data();
+        }
+
+        /// Memory used by the mappings, in bytes
+        inline std::size_t index_bytes() const {
+            return (m_vertexPoints.size() + m_pointVertices.size()) * sizeof(IndexType);
+        }
+
+    private:
+        int m_vertexCount {0};
+        IndexContainer m_vertexPoints;  ///< Point index of each vertex, empty if all the points are vertices
+        IndexContainer m_pointVertices; ///< Vertex index of each point, empty if all the points are vertices
+    };
+}
+#endif
+} // namespace Ponca
@@ -0,0 +1,322 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./defines.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace Ponca {
+#ifndef PARSED_WITH_DOXYGEN
+namespace internal
+{
+    /*!
+     * \brief Interleave quantized coordinates into Morton (Z-order) codes.
+     *
+     * Each coordinate is quantized on \ref BITS_PER_DIM bits, i.e. 10 bits (30 bits codes) for 32 bits codes in 3D and
+     * 21 bits (63 bits codes) for 64 bits codes in 3D. Bit `level` of the coordinate along dimension `d` is stored at
+     * bit `level * Dim + d` of the code.
+     *
+     * \tparam CodeType Unsigned integer type used to store the codes
+     * \tparam Dim Number of dimensions
+     */
+    template <typename CodeType, int Dim>
+    struct MortonCode
+    {
+        static_assert(std::is_unsigned<CodeType>::value, "Morton codes must be stored as unsigned integers");
+        static_assert(Dim > 0, "Morton codes require a positive dimension");
+
+        /// Number of bits used to quantize each coordinate
+        static constexpr int BITS_PER_DIM = int(sizeof(CodeType) * 8) / Dim;
+        /// Number of meaningful bits in a code
+        static constexpr int CODE_BITS = BITS_PER_DIM * Dim;
+        /// Largest quantized coordinate
+        static constexpr CodeType MAX_COORD = (CodeType(1) << (BITS_PER_DIM - 1) << 1) - CodeType(1);
+
+        /// Spread the BITS_PER_DIM lowest bits of `x` so that they are separated by `Dim-1` zeros
+        static inline CodeType spread(CodeType x)
+        {
+            x &= MAX_COORD;
+            if constexpr (Dim == 1)
+            {
+                return x;
+            }
+            else if constexpr (Dim == 3 && sizeof(CodeType) == 8)
+            {
+                std::uint64_t v = x;
+                v = (v | v << 32) & 0x1f00000000ffffull;
+                v = (v | v << 16) & 0x1f0000ff0000ffull;
+                v = (v | v <<  8) & 0x100f00f00f00f00full;
+                v = (v | v <<  4) & 0x10c30c30c30c30c3ull;
+                v = (v | v <<  2) & 0x1249249249249249ull;
+                return CodeType(v);
+            }
+            else if constexpr (Dim == 3 && sizeof(CodeType) == 4)
+            {
+                std::uint32_t v = x;
+                v = (v | v << 16) & 0x030000ffu;
+                v = (v | v <<  8) & 0x0300f00fu;
+                v = (v | v <<  4) & 0x030c30c3u;
+                v = (v | v <<  2) & 0x09249249u;
+                return CodeType(v);
+            }
+            else if constexpr (Dim == 2 && sizeof(CodeType) == 8)
+            {
+                std::uint64_t v = x;
+                v = (v | v << 16) & 0x0000ffff0000ffffull;
+                v = (v | v <<  8) & 0x00ff00ff00ff00ffull;
+                v = (v | v <<  4) & 0x0f0f0f0f0f0f0f0full;
+                v = (v | v <<  2) & 0x3333333333333333ull;
+                v = (v | v <<  1) & 0x5555555555555555ull;
+                return CodeType(v);
+            }
+            else
+            {
+                CodeType res = 0;
+                for (int level = 0; level < BITS_PER_DIM; ++level)
+                    res |= ((x >> level) & CodeType(1)) << (level * Dim);
+                return res;
+            }
+        }
+
+        /// Build the code of a point from its quantized coordinates
+        static inline CodeType encode(const std::array<CodeType, Dim>& q)
+        {
+            CodeType code = 0;
+            for (int d = 0; d < Dim; ++d)
+                code |= spread(q[d]) << d;
+            return code;
+        }
+
+        /// Dimension associated to a given bit of the code
+        static constexpr int bitDim(int bit) { return bit % Dim; }
+        /// Quantization level associated to a given bit of the code
+        static constexpr int bitLevel(int bit) { return bit / Dim; }
+
+        /// Index of the most significant bit set in `x`, -1 if `x == 0`
+        static inline int highestBit(CodeType x)
+        {
+            int bit = -1;
+            while (x != 0)
+            {
+                x >>= 1;
+                ++bit;
+            }
+            return bit;
+        }
+    };
+
+    /*!
+     * \brief Position of quantized coordinates along the Hilbert curve.
+     *
+     * Unlike the Morton curve, two consecutive cells along the Hilbert curve are adjacent, at all quantization levels.
+     * Coordinates are transformed with the algorithm of Skilling (2004), and their bits are interleaved as for
+     * Morton codes, the first transformed coordinate being the most significant at each level.
+     *
+     * \tparam CodeType Unsigned integer type used to store the codes
+     * \tparam Dim Number of dimensions
+     */
+    template <typename CodeType, int Dim>
+    struct HilbertCode
+    {
+        using Morton = MortonCode<CodeType, Dim>;
+
+        /// Build the code of a point from its quantized coordinates
+        static inline CodeType encode(std::array<CodeType, Dim> q)
+        {
+            constexpr CodeType highest = CodeType(1) << (Morton::BITS_PER_DIM - 1);
+            for (int d = 0; d < Dim; ++d)
+                q[d] &= Morton::MAX_COORD;
+
+            // Inverse undo
+            for (CodeType b = highest; b > 1; b >>= 1)
+            {
+                const CodeType lower = b - 1;
+                for (int d = 0; d < Dim; ++d)
+                {
+                    if (q[d] & b)
+                        q[0] ^= lower;
+                    else
+                    {
+                        const CodeType t = (q[0] ^ q[d]) & lower;
+                        q[0] ^= t;
+                        q[d] ^= t;
+                    }
+                }
+            }
+
+            // Gray encode
+            for (int d = 1; d < Dim; ++d)
+                q[d] ^= q[d - 1];
+            CodeType t = 0;
+            for (CodeType b = highest; b > 1; b >>= 1)
+                if (q[Dim - 1] & b) t ^= b - 1;
+
+            std::array<CodeType, Dim> transposed;
+            for (int d = 0; d < Dim; ++d)
+                transposed[d] = q[Dim - 1 - d] ^ t;
+            return Morton::encode(transposed);
+        }
+    };
+
+    /*!
+     * \brief Regular grid used to quantize positions before computing Morton codes.
+     *
+     * The grid uses cubic cells covering a given bounding box. The quantization is consistent with the cell boundaries
+     * returned by \ref boundary, i.e. a coordinate `x` is quantized to `q` iff `boundary(q) <= x < boundary(q+1)`
+     * (ignoring the first and last cells, which are extended to infinity). This property is required to derive exact
+     * split planes from the codes.
+     */
+    template <typename Scalar, typename VectorType, typename CodeType, int Dim>
+    struct MortonGrid
+    {
+        using Code = MortonCode<CodeType, Dim>;
+
+        VectorType origin;
+        Scalar cellSize {1};
+
+        template <typename AabbType>
+        inline void setBounds(const AabbType& aabb)
+        {
+            origin = aabb.min();
+            const Scalar extent = aabb.diagonal().maxCoeff();
+            cellSize = extent > Scalar(0) ? extent / (Scalar(Code::MAX_COORD) + Scalar(1)) : Scalar(1);
+            // Guard against denormalized cell sizes
+            if (!(cellSize > Scalar(0))) cellSize = Scalar(1);
+        }
+
+        /// Position of the lower boundary of the `q`-th cell along dimension `d`
+        inline Scalar boundary(int d, CodeType q) const
+        {
+            return origin[d] + Scalar(q) * cellSize;
+        }
+
+        /// Quantized coordinate of `x` along dimension `d`
+        inline CodeType quantize(int d, Scalar x) const
+        {
+            using std::floor;
+            Scalar f = floor((x - origin[d]) / cellSize);
+            if (!(f > Scalar(0))) f = Scalar(0); // also catches NaN
+            if (f > Scalar(Code::MAX_COORD)) f = Scalar(Code::MAX_COORD);
+            CodeType q = CodeType(f);
+            // Fix rounding errors so that quantization matches the cell boundaries
+            while (q > 0 && x < boundary(d, q)) --q;
+            while (q < Code::MAX_COORD && !(x < boundary(d, q + 1))) ++q;
+            return q;
+        }
+
+        inline CodeType encode(const VectorType& p) const
+        {
+            std::array<CodeType, Dim> q;
+            for (int d = 0; d < Dim; ++d)
+                q[d] = quantize(d, p[d]);
+            return Code::encode(q);
+        }
+    };
+
+    /*!
+     * \brief Stable LSD radix sort of a set of keys, applying the same permutation to a set of values.
+     *
+     * Keys are sorted by digits of 8 bits. Passes where all keys share the same digit are skipped. Histograms and
+     * scatter steps are computed by blocks processed in parallel (if OpenMP is enabled), the result does not depend
+     * on the number of threads.
+     *
+     * \param keys Keys to sort, sorted in place
+     * \param values Values to reorder, of same size than `keys`
+     * \param nbBits Number of meaningful bits in the keys
+     */
+    template <typename KeyType, typename ValueContainer>
+    inline void radixSortByKey(std::vector<KeyType>& keys, ValueContainer& values, int nbBits = int(sizeof(KeyType) * 8))
+    {
+        using ValueType = typename ValueContainer::value_type;
+        static constexpr int DIGIT_BITS  = 8;
+        static constexpr int DIGIT_COUNT = 1 << DIGIT_BITS;
+        static constexpr std::size_t MIN_BLOCK_SIZE = 1 << 14;
+        static constexpr std::size_t MAX_BLOCK_COUNT = 64;
+
+        const std::size_t n = keys.size();
+        if (n < 2) return;
+
+        const int blockCount = int(std::min(MAX_BLOCK_COUNT, (n + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE));
+        const std::size_t blockSize = (n + blockCount - 1) / blockCount;
+
+        std::vector<KeyType> keysTmp(n);
+        std::vector<ValueType> valuesTmp(n);
+        std::vector<std::size_t> offsets(std::size_t(blockCount) * DIGIT_COUNT);
+
+        KeyType*   keysIn    = keys.data();
+        KeyType*   keysOut   = keysTmp.data();
+        ValueType* valuesIn  = &values[0];
+        ValueType* valuesOut = valuesTmp.data();
+
+        for (int shift = 0; shift < nbBits; shift += DIGIT_BITS)
+        {
+            std::fill(offsets.begin(), offsets.end(), 0);
+#pragma omp parallel for
+            for (int b = 0; b < blockCount; ++b)
+            {
+                std::size_t* histogram = &offsets[std::size_t(b) * DIGIT_COUNT];
+                const std::size_t end = std::min(n, (b + 1) * blockSize);
+                for (std::size_t i = b * blockSize; i < end; ++i)
+                    ++histogram[(keysIn[i] >> shift) & (DIGIT_COUNT - 1)];
+            }
+
+            // Skip the pass if all the keys have the same digit
+            bool trivial = false;
+            for (int digit = 0; digit < DIGIT_COUNT && !trivial; ++digit)
+            {
+                std::size_t count = 0;
+                for (int b = 0; b < blockCount; ++b)
+                    count += offsets[std::size_t(b) * DIGIT_COUNT + digit];
+                trivial = count == n;
+            }
+            if (trivial) continue;
+
+            // Exclusive prefix sum, ordered by digit then by block to keep the sort stable
+            std::size_t sum = 0;
+            for (int digit = 0; digit < DIGIT_COUNT; ++digit)
+            {
+                for (int b = 0; b < blockCount; ++b)
+                {
+                    std::size_t& o = offsets[std::size_t(b) * DIGIT_COUNT + digit];
+                    const std::size_t count = o;
+                    o = sum;
+                    sum += count;
+                }
+            }
+
+#pragma omp parallel for
+            for (int b = 0; b < blockCount; ++b)
+            {
+                std::size_t* offset = &offsets[std::size_t(b) * DIGIT_COUNT];
+                const std::size_t end = std::min(n, (b + 1) * blockSize);
+                for (std::size_t i = b * blockSize; i < end; ++i)
+                {
+                    const std::size_t o = offset[(keysIn[i] >> shift) & (DIGIT_COUNT - 1)]++;
+                    keysOut[o]   = keysIn[i];
+                    valuesOut[o] = valuesIn[i];
+                }
+            }
+
+            std::swap(keysIn, keysOut);
+            std::swap(valuesIn, valuesOut);
+        }
+
+        if (keysIn != keys.data())
+        {
+            std::copy(keysIn, keysIn + n, keys.data());
+            std::copy(valuesIn, valuesIn + n, &values[0]);
+        }
+    }
+}
+#endif
+} // namespace Ponca
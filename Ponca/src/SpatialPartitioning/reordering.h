@@ -0,0 +1,213 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#pragma once
+
+#include "./defines.h"
+#include "./mortonCode.h"
+#include "./KdTree/kdTree.h"
+#include "./KnnGraph/knnGraph.h"
+
+#include <Eigen/Geometry>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace Ponca {
+
+/// \brief Space filling curves used by \ref spatial_order
+enum class SpatialOrder
+{
+    Morton,  ///< Z-order curve, which jumps between distant cells at the boundaries of the octree cells
+    Hilbert, ///< Hilbert curve, along which consecutive cells are adjacent
+};
+
+/// \brief Graph traversals used by \ref graph_order
+enum class GraphOrder
+{
+    BreadthFirst,       ///< Breadth-first traversal, visiting the neighbors of each vertex by increasing distance
+    ReverseCuthillMcKee ///< Breadth-first traversal from the lowest degree vertices, visiting the neighbors by
+                        ///< increasing degree, in reverse order
+};
+
+/*!
+ * \brief Order of a set of points along a space filling curve
+ *
+ * Positions are quantized on a regular grid covering their bounding box (21 bits per coordinate in 3D), and sorted
+ * by radix sort of their codes along the curve. Points that are close in space get close indices, which improves the
+ * cache hit rate of the algorithms processing the neighbors of the points.
+ *
+ * \param points Container of DataPoint
+ * \param curve Space filling curve
+ * \return The index of the points, in the order of the curve: `order[i]` is the index of the `i`-th point along the
+ * curve, to be given to \ref reorder_points
+ */
+template <typename PointContainer>
+inline std::vector<int> spatial_order(const PointContainer& points, SpatialOrder curve = SpatialOrder::Hilbert)
+{
+    using DataPoint  = typename PointContainer::value_type;
+    using Scalar     = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+    using CodeType   = std::uint64_t;
+    using Grid       = internal::MortonGrid<Scalar, VectorType, CodeType, DataPoint::Dim>;
+
+    const int n = int(points.size());
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    if (n < 2)
+        return order;
+
+    Eigen::AlignedBox<Scalar, DataPoint::Dim> aabb;
+    for (const auto& p : points)
+        aabb.extend(p.pos());
+    Grid grid;
+    grid.setBounds(aabb);
+
+    std::vector<CodeType> codes(n);
+#pragma omp parallel for
+    for (int i = 0; i < n; ++i)
+    {
+        if (curve == SpatialOrder::Morton)
+        {
+            codes[i] = grid.encode(points[i].pos());
+            continue;
+        }
+        std::array<CodeType, DataPoint::Dim> q;
+        for (int d = 0; d < DataPoint::Dim; ++d)
+            q[d] = grid.quantize(d, points[i].pos()[d]);
+        codes[i] = internal::HilbertCode<CodeType, DataPoint::Dim>::encode(q);
+    }
+    internal::radixSortByKey(codes, order, Grid::Code::CODE_BITS);
+    return order;
+}
+
+/*!
+ * \brief Order of the points of a KnnGraph given by a traversal of the graph
+ *
+ * The traversals follow the neighbors stored in the rows of the vertices, and start again from an unvisited vertex
+ * for each connected component. Vertices that are neighbors in the graph get close indices. The reverse Cuthill-McKee
+ * order reduces the largest difference between the indices of two neighbors, the degree of a vertex being the number
+ * of rows it belongs to plus \ref KnnGraphBase::k.
+ *
+ * \param graph Graph to traverse
+ * \param traversal Order of the traversal
+ * \return The index of the points, in the order of the traversal: `order[i]` is the index of the `i`-th point, to be
+ * given to \ref reorder_points. The points that are not vertices of the graph are placed after the vertices, in their
+ * initial order.
+ */
+template <typename Traits>
+inline std::vector<int> graph_order(const KnnGraphBase<Traits>& graph,
+                                    GraphOrder traversal = GraphOrder::ReverseCuthillMcKee)
+{
+    const int vertexCount = graph.size();
+    const bool rcm = traversal == GraphOrder::ReverseCuthillMcKee;
+
+    std::vector<int> degree(vertexCount, graph.k());
+    std::vector<int> starts(vertexCount);
+    std::iota(starts.begin(), starts.end(), 0);
+    if (rcm)
+    {
+        for (int v = 0; v < vertexCount; ++v)
+            for (int j : graph.k_nearest_neighbors(graph.pointFromVertex(v)))
+                ++degree[graph.vertexFromPoint(j)];
+        std::stable_sort(starts.begin(), starts.end(), [&degree](int a, int b) { return degree[a] < degree[b]; });
+    }
+
+    std::vector<int> vertices;
+    vertices.reserve(vertexCount);
+    std::vector<char> visited(vertexCount, 0);
+    std::vector<int> neighbors;
+    for (int start : starts)
+    {
+        if (visited[start]) continue;
+        visited[start] = 1;
+        std::size_t head = vertices.size();
+        vertices.push_back(start);
+        while (head < vertices.size())
+        {
+            const int v = vertices[head++];
+            neighbors.clear();
+            for (int j : graph.k_nearest_neighbors(graph.pointFromVertex(v)))
+            {
+                const int w = graph.vertexFromPoint(j);
+                if (visited[w]) continue;
+                visited[w] = 1;
+                neighbors.push_back(w);
+            }
+            if (rcm)
+                std::stable_sort(neighbors.begin(), neighbors.end(),
+                                 [&degree](int a, int b) { return degree[a] < degree[b]; });
+            vertices.insert(vertices.end(), neighbors.begin(), neighbors.end());
+        }
+    }
+    if (rcm)
+        std::reverse(vertices.begin(), vertices.end());
+
+    std::vector<int> order;
+    order.reserve(graph.point_count());
+    for (int v : vertices)
+        order.push_back(graph.pointFromVertex(v));
+    if (vertexCount < graph.point_count())
+        for (int i = 0; i < graph.point_count(); ++i)
+            if (graph.vertexFromPoint(i) < 0) order.push_back(i);
+    return order;
+}
+
+/*!
+ * \brief Permute the points of a kd-tree and of a KnnGraph built from it, consistently
+ *
+ * Equivalent to KdTreeBase::reorder_points followed by KnnGraphBase::reorder_points: the kd-tree and the graph stay
+ * valid, and give the same neighbors as before, with the new point indices.
+ *
+ * \param order Previous index of each point, e.g. given by \ref spatial_order or \ref graph_order
+ */
+template <typename KdTreeTraits, typename GraphTraits>
+inline void reorder_points(KdTreeBase<KdTreeTraits>& kdtree, KnnGraphBase<GraphTraits>& graph,
+                           const std::vector<int>& order)
+{
+    PONCA_DEBUG_ASSERT(graph.point_count() == int(kdtree.point_count()));
+    kdtree.reorder_points(order);
+    graph.reorder_points(order);
+}
+
+/// \brief Sort the points of a kd-tree along a space filling curve, see \ref spatial_order
+/// \return The permutation applied to the points: `order[i]` is the previous index of the point `i`
+template <typename KdTreeTraits>
+inline std::vector<int> reorder_spatially(KdTreeBase<KdTreeTraits>& kdtree, SpatialOrder curve = SpatialOrder::Hilbert)
+{
+    std::vector<int> order = spatial_order(kdtree.points(), curve);
+    kdtree.reorder_points(order);
+    return order;
+}
+
+/// \brief Sort the points of a kd-tree and of a KnnGraph built from it along a space filling curve, see
+/// \ref spatial_order
+/// \return The permutation applied to the points: `order[i]` is the previous index of the point `i`
+template <typename KdTreeTraits, typename GraphTraits>
+inline std::vector<int> reorder_spatially(KdTreeBase<KdTreeTraits>& kdtree, KnnGraphBase<GraphTraits>& graph,
+                                          SpatialOrder curve = SpatialOrder::Hilbert)
+{
+    std::vector<int> order = spatial_order(kdtree.points(), curve);
+    reorder_points(kdtree, graph, order);
+    return order;
+}
+
+/// \brief Sort the points of a kd-tree and of a KnnGraph built from it by a traversal of the graph, see
+/// \ref graph_order
+/// \return The permutation applied to the points: `order[i]` is the previous index of the point `i`
+template <typename KdTreeTraits, typename GraphTraits>
+inline std::vector<int> reorder_by_graph(KdTreeBase<KdTreeTraits>& kdtree, KnnGraphBase<GraphTraits>& graph,
+                                         GraphOrder traversal = GraphOrder::ReverseCuthillMcKee)
+{
+    std::vector<int> order = graph_order(graph, traversal);
+    reorder_points(kdtree, graph, order);
+    return order;
+}
+
+} // namespace Ponca
@@ -15,8 +15,12 @@ set(ponca_Fitting_INCLUDE
     "${PONCA_src_ROOT}/Ponca/src/Fitting/curvature.hpp"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/dryFit.h"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/enums.h"
+    "${PONCA_src_ROOT}/Ponca/src/Fitting/fitBatch.h"
+    "${PONCA_src_ROOT}/Ponca/src/Fitting/fitBatch.hpp"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/gls.h"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/gls.hpp"
+    "${PONCA_src_ROOT}/Ponca/src/Fitting/incrementalFit.h"
+    "${PONCA_src_ROOT}/Ponca/src/Fitting/incrementalFit.hpp"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/mean.h"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/mean.hpp"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/meanPlaneFit.h"
@@ -24,6 +28,9 @@ set(ponca_Fitting_INCLUDE
     "${PONCA_src_ROOT}/Ponca/src/Fitting/mlsSphereFitDer.hpp"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/mongePatch.h"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/mongePatch.hpp"
+    "${PONCA_src_ROOT}/Ponca/src/Fitting/multiScaleFit.h"
+    "${PONCA_src_ROOT}/Ponca/src/Fitting/multiScaleFit.hpp"
+    "${PONCA_src_ROOT}/Ponca/src/Fitting/neighborCache.h"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/orientedSphereFit.h"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/orientedSphereFit.hpp"
     "${PONCA_src_ROOT}/Ponca/src/Fitting/plane.h"
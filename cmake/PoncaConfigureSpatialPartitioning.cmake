@@ -3,17 +3,38 @@ set(ponca_SpatialPartitioning_INCLUDE
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/defines.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/query.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/indexSquaredDistance.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/mortonCode.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/reordering.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/kdTree.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/kdTree.hpp"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.hpp"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/kdTreeTraits.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeQuery.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeQueryStats.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeKNearestQueries.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeNearestQueries.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeRangeQueries.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeCoherentQueries.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeBatchKernels.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeBatchedQueries.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KdTree/Query/kdTreeBatchKernels.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.hpp"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraphCompressed.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraphCsr.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraphNNDescent.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraphSerialization.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraphLaplacian.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/knnGraphVertexMapping.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Query/knnGraphKNearestQuery.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Query/knnGraphRangeQuery.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Query/knnGraphTraversalContext.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Query/knnGraphGeodesicQuery.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Query/knnGraphGeodesicContext.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Iterator/knnGraphCompressedIterator.h"
     "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Iterator/knnGraphRangeIterator.h"
+    "${PONCA_src_ROOT}/Ponca/src/SpatialPartitioning/KnnGraph/Iterator/knnGraphGeodesicIterator.h"
     )
 
 add_library(SpatialPartitioning INTERFACE)
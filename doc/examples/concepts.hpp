@@ -61,6 +61,10 @@ namespace Ponca {
             // Add a neighbor to perform the fit
             // \return false if param nei is not a valid neighbour (weight = 0)
             PONCA_MULTIARCH inline bool addLocalNeighbor(Scalar, const VectorType &, const DataPoint &);
+            // Remove a neighbor added during the current pass (optional, see \ref fitting_incremental)
+            PONCA_MULTIARCH inline void removeLocalNeighbor(Scalar, const VectorType &, const DataPoint &);
+            // Add the neighbors accumulated by another fit during the same pass (optional, see \ref fitting_merge)
+            PONCA_MULTIARCH inline void merge(const ComputationalObjectConcept& other);
             // Finalize the fitting procedure.
             // \return State of fitting
             // \warning Must be called be for any use of the fitting output
@@ -108,6 +112,13 @@ namespace Ponca {
                                                          const VectorType &localQ,
                                                          const DataPoint &attributes,
                                                          ScalarArray &dw);
+            // Remove a neighbor added during the current pass (optional, see \ref fitting_incremental)
+            PONCA_MULTIARCH inline void removeLocalNeighbor(Scalar w,
+                                                            const VectorType &localQ,
+                                                            const DataPoint &attributes,
+                                                            ScalarArray &dw);
+            // Add the neighbors accumulated by another fit during the same pass (optional, see \ref fitting_merge)
+            PONCA_MULTIARCH inline void merge(const ComputationalDerivativesConcept& other);
             // Finalize the fitting procedure.
             // \return State of fitting
             // \warning Must be called be for any use of the fitting output
@@ -0,0 +1,112 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*!
+  \file test/common/fit_comparison.h
+  \brief Comparison of the results of two fits of the same neighborhood, computed in different ways
+
+  Each comparison checks the results of `f1` against the reference `f2` with the tolerance testEpsilon, and fails
+  with VERIFY. They are passed to the tests as function pointers, e.g. `isSamePlane<Plane>`.
+*/
+
+#pragma once
+
+#include "./testing.h"
+#include "./testUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// Relative difference, used for the values that are not bounded (e.g. curvatures)
+template<typename Scalar>
+bool isClose(Scalar a, Scalar b, Scalar epsilon)
+{
+    return std::abs(a - b) <= epsilon * std::max(Scalar(1), std::max(std::abs(a), std::abs(b)));
+}
+
+/// Same normal direction, the orientation of the fits being arbitrary (e.g. covariance planes)
+template<typename Fit>
+void isSameNormal(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    VERIFY(Scalar(1) - std::abs(f1.primitiveGradient().dot(f2.primitiveGradient())) < testEpsilon<Scalar>());
+}
+
+/// Same derivatives of the normal, up to the orientation of the fits
+template<typename Fit>
+void isSameDNormal(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    const Scalar sign = f1.primitiveGradient().dot(f2.primitiveGradient()) < Scalar(0) ? Scalar(-1) : Scalar(1);
+    VERIFY((f1.dNormal() - sign * f2.dNormal()).norm() <
+           testEpsilon<Scalar>() * std::max(Scalar(1), f2.dNormal().norm()));
+}
+
+/// Same plane, up to its orientation
+template<typename Fit>
+void isSamePlane(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    isSameNormal(f1, f2);
+    VERIFY(std::abs(std::abs(f1.potential()) - std::abs(f2.potential())) < testEpsilon<Scalar>());
+}
+
+template<typename Fit>
+void isSamePlaneDer(const Fit& f1, const Fit& f2)
+{
+    isSamePlane(f1, f2);
+    isSameDNormal(f1, f2);
+}
+
+/// Same height function, whose sign depends on the orientation of the plane
+template<typename Fit>
+void isSameMonge(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    const Scalar epsilon = testEpsilon<Scalar>();
+    isSameNormal(f1, f2);
+    VERIFY(isClose(std::abs(f1.kMean()), std::abs(f2.kMean()), epsilon));
+    VERIFY(isClose(f1.GaussianCurvature(), f2.GaussianCurvature(), epsilon));
+}
+
+/// Same principal curvatures
+template<typename Fit>
+void isSameCurvature(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    const Scalar epsilon = testEpsilon<Scalar>();
+    VERIFY(isClose(f1.kmin(), f2.kmin(), epsilon));
+    VERIFY(isClose(f1.kmax(), f2.kmax(), epsilon));
+}
+
+template<typename Fit>
+void isSameSphere(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    const Scalar epsilon = testEpsilon<Scalar>();
+    VERIFY(isClose(f1.radius(), f2.radius(), epsilon));
+    VERIFY((f1.center() - f2.center()).norm() < epsilon * std::max(Scalar(1), f2.center().norm()));
+}
+
+template<typename Fit>
+void isSameGLS(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    const Scalar epsilon = testEpsilon<Scalar>();
+    VERIFY(std::abs(f1.tau() - f2.tau()) < epsilon);
+    VERIFY((f1.eta() - f2.eta()).norm() < epsilon);
+    VERIFY(isClose(f1.kappa(), f2.kappa(), epsilon));
+}
+
+template<typename Fit>
+void isSameSphereDer(const Fit& f1, const Fit& f2)
+{
+    using Scalar = typename Fit::Scalar;
+    const Scalar epsilon = testEpsilon<Scalar>();
+    isSameGLS(f1, f2);
+    VERIFY((f1.dtau() - f2.dtau()).norm() < epsilon * std::max(Scalar(1), f2.dtau().norm()));
+    VERIFY((f1.dkappa() - f2.dkappa()).norm() < epsilon * std::max(Scalar(1), f2.dkappa().norm()));
+}
@@ -218,14 +218,14 @@ bool check_k_nearest_neighbors(const VectorContainer& points, const std::vector<
 
 	Scalar max_dist = 0;
 	for (int idx : neighbors)
-		max_dist = std::max(max_dist, (points[idx] - points[index]).norm());
+		max_dist = std::max(max_dist, (points[idx].pos() - points[index].pos()).norm());
 
 	for (int i = 0; i<int(sampling.size()); ++i)
 	{
 		int idx = sampling[i];
 		if (idx == index) continue;
 
-		Scalar dist = (points[idx] - points[index]).norm();
+		Scalar dist = (points[idx].pos() - points[index].pos()).norm();
 		auto it = std::find(neighbors.begin(), neighbors.end(), idx);
 		bool is_neighbor = it != neighbors.end();
 
@@ -264,12 +264,12 @@ bool check_k_nearest_neighbors(const VectorContainer& points, const std::vector<
 
 	Scalar max_dist = 0;
 	for (int idx : neighbors)
-		max_dist = std::max(max_dist, (points[idx] - point).norm());
+		max_dist = std::max(max_dist, (points[idx].pos() - point).norm());
 
 	for (int i = 0; i<int(sampling.size()); ++i)
 	{
 		int idx = sampling[i];
-		Scalar dist = (points[idx] - point).norm();
+		Scalar dist = (points[idx].pos() - point).norm();
 		auto it = std::find(neighbors.begin(), neighbors.end(), idx);
 		bool is_neighbor = it != neighbors.end();
 
@@ -336,11 +336,11 @@ bool check_nearest_neighbor(const VectorContainer& points, const VectorType& poi
 template<typename Scalar, typename VectorType, typename VectorContainer>
 bool check_nearest_neighbor(const VectorContainer& points, const std::vector<int>& sampling, const VectorType& point, int nearest)
 {
-    return check_k_nearest_neighbors<Scalar, VectorContainer>(points, sampling, point, 1, { nearest });
+    return check_k_nearest_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, 1, { nearest });
 }
 
 template<typename Scalar, typename VectorType, typename VectorContainer>
 bool check_nearest_neighbor(const VectorContainer& points, const std::vector<int>& sampling, int index, int nearest)
 {
-    return check_k_nearest_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, index, 1, { nearest });
+    return check_k_nearest_neighbors<Scalar, VectorContainer>(points, sampling, index, 1, { nearest });
 }
\ No newline at end of file
@@ -0,0 +1,217 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*!
+    \file test/fit_batch.cpp
+    \brief Test parallel fitting at many evaluation positions
+ */
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+
+#include <Ponca/src/Fitting/basket.h>
+#include <Ponca/src/Fitting/covariancePlaneFit.h>
+#include <Ponca/src/Fitting/orientedSphereFit.h>
+#include <Ponca/src/Fitting/gls.h>
+#include <Ponca/src/Fitting/curvature.h>
+#include <Ponca/src/Fitting/curvatureEstimation.h>
+#include <Ponca/src/Fitting/fitBatch.h>
+#include <Ponca/src/Fitting/weightFunc.h>
+#include <Ponca/src/Fitting/weightKernel.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+
+#include <vector>
+
+using namespace std;
+using namespace Ponca;
+
+/// Equal values, or both NaN
+template<typename Scalar>
+bool isSame(Scalar a, Scalar b)
+{
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+/// Compare FitBatch with a sequential loop over the evaluation positions
+template<typename Fit, bool hasCurvature>
+void testFitBatch(const KdTree<typename Fit::DataPoint>& tree, const vector<typename Fit::VectorType>& positions,
+                  typename Fit::Scalar analysisScale)
+{
+    using Scalar = typename Fit::Scalar;
+    using VectorType = typename Fit::VectorType;
+    using WeightFunc = typename Fit::WFunctor;
+    constexpr int Dim = VectorType::SizeAtCompileTime;
+    const int n = int(positions.size());
+
+    vector<FIT_RESULT> states(n);
+    vector<Scalar> potentials(n), normals(Dim * n), kmin(n), kmax(n);
+    vector<int> neighbors(n);
+    vector<int> progress;
+
+    FitBatch<Fit> batch;
+    batch.setProgressCallback([&progress, n](int done, int total) {
+        VERIFY(total == n);
+        progress.push_back(done);
+    });
+    auto countNeighbors = makeFitOutput([&neighbors](const Fit& fit, int i) { neighbors[i] = fit.getNumNeighbors(); });
+    int stable = 0;
+    if constexpr (hasCurvature)
+        stable = batch.compute(tree, positions, analysisScale, FitStateOutput{states.data()},
+                               FitPotentialOutput<Scalar>{potentials.data()}, FitNormalOutput<Scalar>{normals.data()},
+                               FitCurvatureOutput<Scalar>{kmin.data(), kmax.data()}, countNeighbors);
+    else
+        stable = batch.compute(tree, positions, analysisScale, FitStateOutput{states.data()},
+                               FitPotentialOutput<Scalar>{potentials.data()}, FitNormalOutput<Scalar>{normals.data()},
+                               countNeighbors);
+
+    // Progress reports are increasing, and end with all the positions
+    VERIFY(!progress.empty());
+    VERIFY(std::is_sorted(progress.begin(), progress.end()));
+    VERIFY(progress.back() == n);
+
+    // Same results as the sequential loop
+    int expectedStable = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const VectorType& pos = positions[i];
+        Fit fit;
+        fit.setWeightFunc(WeightFunc(analysisScale));
+        fit.init(pos);
+        const FIT_RESULT res = fit.computeWithIds(tree.range_neighbors(pos, analysisScale), tree.points());
+        if (res == STABLE) ++expectedStable;
+
+        VERIFY(states[i] == res);
+        VERIFY(neighbors[i] == fit.getNumNeighbors());
+        if (!fit.isReady())
+        {
+            VERIFY(std::isnan(potentials[i]));
+            continue;
+        }
+        VERIFY(isSame(potentials[i], fit.potential(pos)));
+        const VectorType normal = fit.primitiveGradient(pos).normalized();
+        for (int d = 0; d < Dim; ++d)
+            VERIFY(isSame(normals[d * n + i], normal[d]));
+        if constexpr (hasCurvature)
+        {
+            VERIFY(isSame(kmin[i], fit.kmin()));
+            VERIFY(isSame(kmax[i], fit.kmax()));
+        }
+    }
+    VERIFY(stable == expectedStable);
+    VERIFY(stable > n / 2);
+
+    // Results do not depend on the scheduling
+    vector<Scalar> potentials2(n);
+    VERIFY(batch.compute(tree, positions, analysisScale, FitPotentialOutput<Scalar>{potentials2.data()}) == stable);
+    for (int i = 0; i < n; ++i)
+        VERIFY(isSame(potentials[i], potentials2[i]));
+}
+
+/// Compare FitBatch::computeAtSamples with FitBatch::compute at the positions of the samples
+template<typename Fit>
+void testFitBatchAtSamples(const KdTree<typename Fit::DataPoint>& tree, typename Fit::Scalar analysisScale)
+{
+    using Scalar = typename Fit::Scalar;
+    using VectorType = typename Fit::VectorType;
+    constexpr int Dim = VectorType::SizeAtCompileTime;
+    const int n = int(tree.points().size());
+    const Scalar epsilon = testEpsilon<Scalar>();
+
+    vector<VectorType> positions(n);
+    for (int i = 0; i < n; ++i)
+        positions[i] = tree.points()[i].pos();
+
+    vector<FIT_RESULT> states(n), expectedStates(n);
+    vector<Scalar> potentials(n), expectedPotentials(n), normals(Dim * n), expectedNormals(Dim * n);
+    vector<int> progress;
+
+    FitBatch<Fit> batch;
+    const int expectedStable = batch.compute(tree, positions, analysisScale, FitStateOutput{expectedStates.data()},
+                                             FitPotentialOutput<Scalar>{expectedPotentials.data()},
+                                             FitNormalOutput<Scalar>{expectedNormals.data()});
+    batch.setProgressCallback([&progress, &tree](int done, int total) {
+        VERIFY(total == int(tree.sample_count()));
+        progress.push_back(done);
+    });
+    const int stable = batch.computeAtSamples(tree, analysisScale, FitStateOutput{states.data()},
+                                              FitPotentialOutput<Scalar>{potentials.data()},
+                                              FitNormalOutput<Scalar>{normals.data()});
+
+    VERIFY(!progress.empty());
+    VERIFY(std::is_sorted(progress.begin(), progress.end()));
+    VERIFY(progress.back() == int(tree.sample_count()));
+
+    // Same neighbors in another order: same results up to rounding errors, and to the orientation of the planes
+    VERIFY(stable == expectedStable);
+    for (int i = 0; i < n; ++i)
+    {
+        VERIFY(states[i] == expectedStates[i]);
+        if (states[i] != STABLE) continue;
+        VERIFY(std::abs(std::abs(potentials[i]) - std::abs(expectedPotentials[i])) < epsilon * analysisScale);
+        Scalar dot = 0;
+        for (int d = 0; d < Dim; ++d)
+            dot += normals[d * n + i] * expectedNormals[d * n + i];
+        VERIFY(Scalar(1) - std::abs(dot) < epsilon);
+    }
+}
+
+template<typename Scalar>
+void callSubTests(bool quick)
+{
+    using Point = PointPositionNormal<Scalar, 3>;
+    using VectorType = typename Point::VectorType;
+    using WeightFunc = DistWeightFunc<Point, SmoothWeightKernel<Scalar>>;
+    using Plane = Basket<Point, WeightFunc, CovariancePlaneFit>;
+    using Sphere = Basket<Point, WeightFunc, OrientedSphereFit, GLSParam>;
+    using SphereCurvature = BasketDiff<Sphere, FitSpaceDer, OrientedSphereDer,
+                                       CurvatureEstimatorBase, NormalDerivativesCurvatureEstimator>;
+
+    const int nbPoints = quick ? 1000 : 10000;
+    const Scalar radius = Eigen::internal::random<Scalar>(1, 10);
+    const VectorType center = VectorType::Random() * Scalar(100);
+    const Scalar analysisScale = Scalar(10.) * std::sqrt(Scalar(4. * M_PI) * radius * radius / nbPoints);
+
+    vector<Point> points(nbPoints);
+    for (auto& p : points)
+        p = getPointOnSphere<Point>(radius, center, false, false, false);
+    KdTreeDense<Point> tree(points);
+
+    // Evaluation positions near the surface, and a few positions without neighbors
+    vector<VectorType> positions(nbPoints / 2);
+    for (int i = 0; i < int(positions.size()); ++i)
+        positions[i] = points[i].pos() + VectorType::Random() * analysisScale / Scalar(4);
+    for (int i = 0; i < 10; ++i)
+        positions.push_back(center + VectorType::Random() * radius / Scalar(4));
+
+    for (int i = 0; i < g_repeat; ++i)
+    {
+        CALL_SUBTEST((testFitBatch<Plane, false>(tree, positions, analysisScale)));
+        CALL_SUBTEST((testFitBatch<Sphere, false>(tree, positions, analysisScale)));
+        CALL_SUBTEST((testFitBatch<SphereCurvature, true>(tree, positions, analysisScale)));
+        CALL_SUBTEST((testFitBatchAtSamples<Plane>(tree, analysisScale)));
+        CALL_SUBTEST((testFitBatchAtSamples<Sphere>(tree, analysisScale)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test FitBatch in 3 dimensions: float" << flush;
+    callSubTests<float>(quick);
+    cout << " (ok), double" << flush;
+    callSubTests<double>(quick);
+    cout << " (ok)" << endl;
+}
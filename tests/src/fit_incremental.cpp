@@ -0,0 +1,203 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*!
+    \file test/fit_incremental.cpp
+    \brief Test neighbor removal and incremental fits along a sliding window
+ */
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/fit_comparison.h"
+
+#include <Ponca/src/Fitting/basket.h>
+#include <Ponca/src/Fitting/covariancePlaneFit.h>
+#include <Ponca/src/Fitting/orientedSphereFit.h>
+#include <Ponca/src/Fitting/mongePatch.h>
+#include <Ponca/src/Fitting/curvature.h>
+#include <Ponca/src/Fitting/curvatureEstimation.h>
+#include <Ponca/src/Fitting/gls.h>
+#include <Ponca/src/Fitting/incrementalFit.h>
+#include <Ponca/src/Fitting/weightFunc.h>
+#include <Ponca/src/Fitting/weightKernel.h>
+
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+using namespace Ponca;
+
+/// Removing neighbors gives the fit of the remaining ones
+template<typename Fit, typename Functor>
+void testRemoveNeighbor(const vector<typename Fit::DataPoint>& points, typename Fit::Scalar scale, Functor isSame)
+{
+    using Scalar = typename Fit::Scalar;
+    using WeightFunc = typename Fit::WFunctor;
+    const auto& center = points[0].pos();
+    // Remove one neighbor out of three
+    auto isRemoved = [](int i) { return i % 3 == 0; };
+
+    Fit fit, ref;
+    fit.setWeightFunc(WeightFunc(scale));
+    fit.init(center);
+    ref.setWeightFunc(WeightFunc(scale));
+    ref.init(center);
+
+    // Neighbors are removed at each pass of multi-pass fits
+    FIT_RESULT res;
+    do {
+        fit.startNewPass();
+        ref.startNewPass();
+        for (const auto& p : points)
+            fit.addNeighbor(p);
+        for (int i = 0; i < int(points.size()); ++i)
+            if (isRemoved(i)) fit.removeNeighbor(points[i]);
+        for (int i = 0; i < int(points.size()); ++i)
+            if (! isRemoved(i)) ref.addNeighbor(points[i]);
+
+        VERIFY(fit.getNumNeighbors() == ref.getNumNeighbors());
+        VERIFY(isClose(fit.getWeightSum(), ref.getWeightSum(), testEpsilon<Scalar>()));
+        res = ref.finalize();
+        VERIFY(fit.finalize() == res);
+    } while (res == NEED_OTHER_PASS);
+    if (res == STABLE) isSame(fit, ref);
+}
+
+/// Slide a window along the points, and compare the incremental fit with a fit of each window
+template<typename Fit, typename Functor>
+void testSlidingWindow(const vector<typename Fit::DataPoint>& points, typename Fit::Scalar scale, Functor isSame)
+{
+    using WeightFunc = typename Fit::WFunctor;
+    const int n = int(points.size());
+    const int windowSize = n / 10;
+    const int recomputePeriod = windowSize;
+    const auto& center = points[n / 2].pos();
+
+    IncrementalFit<Fit> inc;
+    inc.setRecomputePeriod(recomputePeriod);
+    inc.setWeightFunc(WeightFunc(scale));
+    inc.init(center);
+
+    vector<int> window(windowSize);
+    std::iota(window.begin(), window.end(), 0);
+    inc.computeWithIds(window, points);
+    VERIFY(inc.removalsSinceRecompute() == 0);
+
+    int removals = 0;
+    for (int begin = 0; begin + windowSize < n;)
+    {
+        const int step = std::min(Eigen::internal::random<int>(1, 5), n - windowSize - begin);
+        vector<int> leaving(step), entering(step);
+        std::iota(leaving.begin(), leaving.end(), begin);
+        std::iota(entering.begin(), entering.end(), begin + windowSize);
+        const FIT_RESULT res = inc.update(entering, leaving, points);
+        begin += step;
+
+        // Drift safeguard
+        removals += step;
+        if (removals >= recomputePeriod) removals = 0;
+        VERIFY(inc.removalsSinceRecompute() == removals);
+        VERIFY(int(inc.neighbors().size()) == windowSize);
+
+        Fit ref;
+        ref.setWeightFunc(WeightFunc(scale));
+        ref.init(center);
+        std::iota(window.begin(), window.end(), begin);
+        VERIFY(ref.computeWithIds(window, points) == res);
+        VERIFY(inc.fit().getCurrentState() == res);
+        VERIFY(inc.fit().getNumNeighbors() == ref.getNumNeighbors());
+        if (res == STABLE) isSame(inc.fit(), ref);
+    }
+
+    // Emptying the neighborhood resets the sums
+    inc.update(vector<int>(), vector<int>(inc.neighbors()), points);
+    VERIFY(inc.neighbors().empty());
+    VERIFY(inc.removalsSinceRecompute() == 0);
+    VERIFY(inc.fit().getNumNeighbors() == 0);
+    VERIFY(inc.fit().getWeightSum() == 0);
+}
+
+template<typename Scalar>
+void callSubTests(bool quick)
+{
+    using Point = PointPositionNormal<Scalar, 3>;
+    using VectorType = typename Point::VectorType;
+    using SmoothWeight = DistWeightFunc<Point, SmoothWeightKernel<Scalar>>;
+    using ConstantWeight = DistWeightFunc<Point, ConstantWeightKernel<Scalar>>;
+
+    using Plane = Basket<Point, ConstantWeight, CovariancePlaneFit>;
+    using PlaneDer = BasketDiff<Plane, FitScaleSpaceDer, CovariancePlaneDer>;
+    using Monge = Basket<Point, ConstantWeight, CovariancePlaneFit, MongePatch>;
+    using Sphere = Basket<Point, ConstantWeight, OrientedSphereFit, GLSParam>;
+    using SmoothSphere = Basket<Point, SmoothWeight, OrientedSphereFit, GLSParam>;
+    using SphereDer = BasketDiff<Sphere, FitScaleSpaceDer, OrientedSphereDer, GLSDer>;
+    using SmoothPlane = Basket<Point, SmoothWeight, CovariancePlaneFit>;
+    using ProjectedNormalCurvature = BasketDiff<SmoothPlane, FitSpaceDer, CovariancePlaneDer,
+                                                CurvatureEstimatorBase, ProjectedNormalCovarianceCurvatureEstimator>;
+
+    const int nbPoints = quick ? 1000 : 5000;
+    const Scalar radius = Eigen::internal::random<Scalar>(1, 10);
+    const VectorType center = VectorType::Random() * Scalar(100);
+
+    // Scan strip: band around the equator of half a sphere, sorted by longitude
+    vector<Point> points(nbPoints);
+    for (auto& p : points)
+    {
+        const Scalar theta = Eigen::internal::random<Scalar>(0, Scalar(M_PI));
+        const Scalar h = Eigen::internal::random<Scalar>(Scalar(-0.3), Scalar(0.3)) * radius;
+        const Scalar rh = std::sqrt(radius * radius - h * h);
+        const VectorType n = VectorType(rh * std::cos(theta), rh * std::sin(theta), h) / radius;
+        p = Point(center + radius * n, n);
+    }
+    std::sort(points.begin(), points.end(), [&center](const Point& a, const Point& b) {
+        return std::atan2(a.pos().y() - center.y(), a.pos().x() - center.x()) <
+               std::atan2(b.pos().y() - center.y(), b.pos().x() - center.x());
+    });
+    const Scalar scale = Scalar(4) * radius; // covers all the points, smooth weights do not vanish
+
+    // The curvatures of the height function amplify the rounding errors of the plane updated incrementally: they are
+    // only compared in double precision
+    const auto isSameMongeIncremental = std::is_same<Scalar, double>::value ? isSameMonge<Monge> : isSameNormal<Monge>;
+
+    for (int i = 0; i < g_repeat; ++i)
+    {
+        CALL_SUBTEST((testRemoveNeighbor<Plane>(points, scale, isSamePlane<Plane>)));
+        CALL_SUBTEST((testRemoveNeighbor<PlaneDer>(points, scale, isSamePlaneDer<PlaneDer>)));
+        CALL_SUBTEST((testRemoveNeighbor<Sphere>(points, scale, isSameGLS<Sphere>)));
+        CALL_SUBTEST((testRemoveNeighbor<SmoothSphere>(points, radius, isSameGLS<SmoothSphere>)));
+        CALL_SUBTEST((testRemoveNeighbor<SphereDer>(points, scale, isSameSphereDer<SphereDer>)));
+        CALL_SUBTEST((testRemoveNeighbor<ProjectedNormalCurvature>(points, scale, isSameCurvature<ProjectedNormalCurvature>)));
+
+        CALL_SUBTEST((testSlidingWindow<Plane>(points, scale, isSamePlane<Plane>)));
+        CALL_SUBTEST((testSlidingWindow<PlaneDer>(points, scale, isSamePlaneDer<PlaneDer>)));
+        CALL_SUBTEST((testSlidingWindow<Monge>(points, scale, isSameMongeIncremental)));
+        CALL_SUBTEST((testSlidingWindow<Sphere>(points, scale, isSameGLS<Sphere>)));
+        CALL_SUBTEST((testSlidingWindow<SmoothSphere>(points, scale, isSameGLS<SmoothSphere>)));
+        CALL_SUBTEST((testSlidingWindow<SphereDer>(points, scale, isSameSphereDer<SphereDer>)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test incremental fits in 3 dimensions: float" << flush;
+    callSubTests<float>(quick);
+    cout << " (ok), double" << flush;
+    callSubTests<double>(quick);
+    cout << " (ok)" << endl;
+}
@@ -0,0 +1,213 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*!
+    \file test/fit_merge.cpp
+    \brief Test the reduction of partial fits with merge
+ */
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/fit_comparison.h"
+
+#include <Ponca/src/Fitting/basket.h>
+#include <Ponca/src/Fitting/covariancePlaneFit.h>
+#include <Ponca/src/Fitting/orientedSphereFit.h>
+#include <Ponca/src/Fitting/unorientedSphereFit.h>
+#include <Ponca/src/Fitting/sphereFit.h>
+#include <Ponca/src/Fitting/mlsSphereFitDer.h>
+#include <Ponca/src/Fitting/mongePatch.h>
+#include <Ponca/src/Fitting/gls.h>
+#include <Ponca/src/Fitting/curvature.h>
+#include <Ponca/src/Fitting/curvatureEstimation.h>
+#include <Ponca/src/Fitting/weightFunc.h>
+#include <Ponca/src/Fitting/weightKernel.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+
+#include <vector>
+
+using namespace std;
+using namespace Ponca;
+
+/// Fit the neighbors distributed between several partial fits, reduced with merge
+template<typename Fit, typename PointContainer>
+FIT_RESULT computeMerged(Fit& fit, const vector<int>& ids, const PointContainer& points, int nbParts)
+{
+    FIT_RESULT res = UNDEFINED;
+    do {
+        fit.startNewPass();
+        const Fit empty = fit;
+        vector<Fit> parts(nbParts - 1, empty);
+        // fit itself accumulates the first part
+        for (int k = 0; k < int(ids.size()); ++k)
+        {
+            const int part = k % nbParts;
+            if (part == 0) fit.addNeighbor(points[ids[k]]);
+            else           parts[part - 1].addNeighbor(points[ids[k]]);
+        }
+        for (const auto& p : parts)
+            fit.merge(p);
+        res = fit.finalize();
+    } while (res == NEED_OTHER_PASS);
+    return res;
+}
+
+/// Compare the merged fits with sequential fits of the same neighborhoods
+template<typename Fit, typename Functor>
+void testMerge(const KdTree<typename Fit::DataPoint>& tree, typename Fit::Scalar analysisScale, Functor isSame)
+{
+    using Scalar = typename Fit::Scalar;
+    using WeightFunc = typename Fit::WFunctor;
+    const auto& points = tree.points();
+    const Scalar epsilon = testEpsilon<Scalar>();
+
+#ifdef NDEBUG
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < int(points.size()); ++i)
+    {
+        const auto& pos = points[i].pos();
+        vector<int> ids;
+        for (int j : tree.range_neighbors(pos, analysisScale))
+            ids.push_back(j);
+
+        Fit ref;
+        ref.setWeightFunc(WeightFunc(analysisScale));
+        ref.init(pos);
+        const FIT_RESULT res = ref.computeWithIds(ids, points);
+
+        // A single part is the sequential fit
+        for (int nbParts : {1, 2, 5})
+        {
+            Fit fit;
+            fit.setWeightFunc(WeightFunc(analysisScale));
+            fit.init(pos);
+            VERIFY(computeMerged(fit, ids, points, nbParts) == res);
+            VERIFY(fit.getNumNeighbors() == ref.getNumNeighbors());
+            VERIFY(isClose(fit.getWeightSum(), ref.getWeightSum(), epsilon));
+            if (res == STABLE) isSame(fit, ref);
+        }
+    }
+}
+
+/// Reduce partial fits computed in parallel on a large neighborhood, as in the documentation
+template<typename Fit, typename Functor>
+void testParallelMerge(const KdTree<typename Fit::DataPoint>& tree, typename Fit::Scalar analysisScale, Functor isSame)
+{
+    using WeightFunc = typename Fit::WFunctor;
+    const auto& points = tree.points();
+    const auto& pos = points[0].pos();
+    vector<int> neighbors;
+    for (int j : tree.range_neighbors(pos, analysisScale))
+        neighbors.push_back(j);
+
+    Fit ref;
+    ref.setWeightFunc(WeightFunc(analysisScale));
+    ref.init(pos);
+    const FIT_RESULT res = ref.computeWithIds(neighbors, points);
+
+    Fit fit;
+    fit.setWeightFunc(WeightFunc(analysisScale));
+    fit.init(pos);
+    do {
+        fit.startNewPass();
+        const Fit empty = fit;
+#pragma omp parallel
+        {
+            Fit partial = empty;
+#pragma omp for nowait
+            for (int i = 0; i < int(neighbors.size()); ++i)
+                partial.addNeighbor(points[neighbors[i]]);
+#pragma omp critical
+            fit.merge(partial);
+        }
+    } while (fit.finalize() == NEED_OTHER_PASS);
+
+    VERIFY(fit.getCurrentState() == res);
+    VERIFY(fit.getNumNeighbors() == ref.getNumNeighbors());
+    if (res == STABLE) isSame(fit, ref);
+}
+
+template<typename Scalar>
+void callSubTests(bool quick)
+{
+    using Point = PointPositionNormal<Scalar, 3>;
+    using VectorType = typename Point::VectorType;
+    using WeightFunc = DistWeightFunc<Point, SmoothWeightKernel<Scalar>>;
+
+    using Plane = Basket<Point, WeightFunc, CovariancePlaneFit>;
+    using PlaneDer = BasketDiff<Plane, FitScaleSpaceDer, CovariancePlaneDer>;
+    using Monge = Basket<Point, WeightFunc, CovariancePlaneFit, MongePatch>;
+    using ProjectedNormalCurvature = BasketDiff<Plane, FitSpaceDer, CovariancePlaneDer,
+                                                CurvatureEstimatorBase, ProjectedNormalCovarianceCurvatureEstimator>;
+    using Sphere = Basket<Point, WeightFunc, OrientedSphereFit, GLSParam>;
+    using SphereDer = BasketDiff<Sphere, FitScaleSpaceDer, OrientedSphereDer, GLSDer>;
+    using SphereMls = BasketDiff<Sphere, FitSpaceDer, OrientedSphereDer, MlsSphereFitDer,
+                                 CurvatureEstimatorBase, NormalDerivativesCurvatureEstimator>;
+    using AlgebraicSphereFit = Basket<Point, WeightFunc, SphereFit>;
+    using Unoriented = Basket<Point, WeightFunc, UnorientedSphereFit>;
+    using UnorientedDer = BasketDiff<Unoriented, FitScaleSpaceDer, UnorientedSphereDer>;
+
+    const int nbPoints = quick ? 1000 : 5000;
+    const Scalar radius = Eigen::internal::random<Scalar>(1, 10);
+    const VectorType center = VectorType::Random() * Scalar(100);
+    const Scalar analysisScale = Scalar(10.) * std::sqrt(Scalar(4. * M_PI) * radius * radius / nbPoints);
+
+    // Noise on positions: without residual, the smallest eigenvalue of SphereFit is zero and its sign depends on the
+    // summation order
+    vector<Point> points(nbPoints);
+    for (auto& p : points)
+        p = getPointOnSphere<Point>(radius, center, true, false, false);
+    KdTreeDense<Point> tree(points);
+
+    auto isSameSphereMls = [](const SphereMls& f1, const SphereMls& f2) {
+        isSameGLS(f1, f2);
+        isSameCurvature(f1, f2);
+    };
+    // The orientation of the unoriented sphere is arbitrary
+    auto isSameUnorientedDer = [](const UnorientedDer& f1, const UnorientedDer& f2) {
+        isSameSphere(f1, f2);
+        isSameDNormal(f1, f2);
+    };
+
+    for (int i = 0; i < g_repeat; ++i)
+    {
+        CALL_SUBTEST((testMerge<Plane>(tree, analysisScale, isSamePlane<Plane>)));
+        CALL_SUBTEST((testMerge<PlaneDer>(tree, analysisScale, isSamePlaneDer<PlaneDer>)));
+        CALL_SUBTEST((testMerge<Monge>(tree, analysisScale, isSameMonge<Monge>)));
+        CALL_SUBTEST((testMerge<ProjectedNormalCurvature>(tree, analysisScale, isSameCurvature<ProjectedNormalCurvature>)));
+        CALL_SUBTEST((testMerge<Sphere>(tree, analysisScale, isSameGLS<Sphere>)));
+        CALL_SUBTEST((testMerge<SphereDer>(tree, analysisScale, isSameSphereDer<SphereDer>)));
+        CALL_SUBTEST((testMerge<SphereMls>(tree, analysisScale, isSameSphereMls)));
+        CALL_SUBTEST((testMerge<AlgebraicSphereFit>(tree, analysisScale, isSameSphere<AlgebraicSphereFit>)));
+        CALL_SUBTEST((testMerge<Unoriented>(tree, analysisScale, isSameSphere<Unoriented>)));
+        CALL_SUBTEST((testMerge<UnorientedDer>(tree, analysisScale, isSameUnorientedDer)));
+
+        // Neighborhood covering a large part of the point cloud
+        CALL_SUBTEST((testParallelMerge<Sphere>(tree, radius, isSameGLS<Sphere>)));
+        CALL_SUBTEST((testParallelMerge<Monge>(tree, radius, isSameMonge<Monge>)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test merge of partial fits in 3 dimensions: float" << flush;
+    callSubTests<float>(quick);
+    cout << " (ok), double" << flush;
+    callSubTests<double>(quick);
+    cout << " (ok)" << endl;
+}
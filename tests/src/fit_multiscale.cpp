@@ -0,0 +1,154 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*!
+    \file test/fit_multiscale.cpp
+    \brief Test multi-scale fitting from a single neighborhood query
+ */
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+
+#include <Ponca/src/Fitting/basket.h>
+#include <Ponca/src/Fitting/covariancePlaneFit.h>
+#include <Ponca/src/Fitting/orientedSphereFit.h>
+#include <Ponca/src/Fitting/gls.h>
+#include <Ponca/src/Fitting/fitBatch.h>
+#include <Ponca/src/Fitting/multiScaleFit.h>
+#include <Ponca/src/Fitting/weightFunc.h>
+#include <Ponca/src/Fitting/weightKernel.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+
+#include <vector>
+
+using namespace std;
+using namespace Ponca;
+
+/// Compare the multi-scale fits with independent fits at each scale
+template<typename Fit, typename Functor>
+void testMultiScaleFit(const KdTree<typename Fit::DataPoint>& tree, const vector<typename Fit::VectorType>& positions,
+                       const vector<typename Fit::Scalar>& scales, Functor isSame)
+{
+    using Scalar = typename Fit::Scalar;
+    using WeightFunc = typename Fit::WFunctor;
+    const int n = int(positions.size());
+    const int scaleCount = int(scales.size());
+
+#pragma omp parallel for
+    for (int i = 0; i < n; ++i)
+    {
+        MultiScaleFit<Fit> msf;
+        // Reuse the same object, as a thread processing several positions
+        for (int repeat = 0; repeat < 2; ++repeat)
+        {
+            int stable = msf.compute(tree, positions[i], scales);
+            VERIFY(msf.size() == scaleCount);
+
+            int expectedStable = 0;
+            for (int s = 0; s < scaleCount; ++s)
+            {
+                Fit fit;
+                fit.setWeightFunc(WeightFunc(scales[s]));
+                fit.init(positions[i]);
+                const FIT_RESULT res = fit.computeWithIds(tree.range_neighbors(positions[i], scales[s]), tree.points());
+                if (res == STABLE) ++expectedStable;
+
+                VERIFY(msf[s].getCurrentState() == res);
+                VERIFY(msf[s].getNumNeighbors() == fit.getNumNeighbors());
+                if (s > 0) VERIFY(msf[s - 1].getNumNeighbors() <= msf[s].getNumNeighbors());
+                if (res == STABLE) isSame(msf[s], fit);
+            }
+            VERIFY(stable == expectedStable);
+            VERIFY(msf.neighborCount() >= msf[scaleCount - 1].getNumNeighbors());
+        }
+    }
+
+    // Batch evaluation, stored by scale
+    vector<FIT_RESULT> states(n * scaleCount);
+    vector<Scalar> potentials(n * scaleCount);
+    FitBatch<Fit> batch;
+    const int stable = batch.computeMultiScale(tree, positions, scales, FitStateOutput{states.data()},
+                                               FitPotentialOutput<Scalar>{potentials.data()});
+    int expectedStable = 0;
+    MultiScaleFit<Fit> msf;
+    for (int i = 0; i < n; ++i)
+    {
+        expectedStable += msf.compute(tree, positions[i], scales);
+        for (int s = 0; s < scaleCount; ++s)
+        {
+            VERIFY(states[s * n + i] == msf[s].getCurrentState());
+            if (msf[s].isReady())
+                VERIFY(potentials[s * n + i] == msf[s].potential(positions[i]));
+            else
+                VERIFY(std::isnan(potentials[s * n + i]));
+        }
+    }
+    VERIFY(stable == expectedStable);
+    VERIFY(stable > n);
+}
+
+template<typename Scalar>
+void callSubTests(bool quick)
+{
+    using Point = PointPositionNormal<Scalar, 3>;
+    using VectorType = typename Point::VectorType;
+    using WeightFunc = DistWeightFunc<Point, SmoothWeightKernel<Scalar>>;
+    using Plane = Basket<Point, WeightFunc, CovariancePlaneFit>;
+    using Sphere = Basket<Point, WeightFunc, OrientedSphereFit, GLSParam>;
+
+    const int nbPoints = quick ? 1000 : 10000;
+    const Scalar radius = Eigen::internal::random<Scalar>(1, 10);
+    const VectorType center = VectorType::Random() * Scalar(100);
+    const Scalar analysisScale = Scalar(10.) * std::sqrt(Scalar(4. * M_PI) * radius * radius / nbPoints);
+    const Scalar epsilon = testEpsilon<Scalar>() * Scalar(10);
+
+    vector<Point> points(nbPoints);
+    for (auto& p : points)
+        p = getPointOnSphere<Point>(radius, center, false, false, false);
+    KdTreeDense<Point> tree(points);
+
+    vector<VectorType> positions(quick ? 100 : 1000);
+    for (int i = 0; i < int(positions.size()); ++i)
+        positions[i] = points[i].pos() + VectorType::Random() * analysisScale / Scalar(4);
+    const vector<Scalar> scales {analysisScale / 2, analysisScale, analysisScale * Scalar(1.5), analysisScale * 3};
+
+    // The orientation of the covariance plane is arbitrary
+    auto isSamePlane = [epsilon](const Plane& f1, const Plane& f2) {
+        VERIFY(Scalar(1) - std::abs(f1.primitiveGradient().dot(f2.primitiveGradient())) < epsilon);
+        VERIFY(std::abs(std::abs(f1.potential()) - std::abs(f2.potential())) < epsilon);
+    };
+    auto isSameSphere = [epsilon](const Sphere& f1, const Sphere& f2) {
+        VERIFY(std::abs(f1.tau() - f2.tau()) < epsilon);
+        VERIFY((f1.eta() - f2.eta()).norm() < epsilon);
+        VERIFY(std::abs(f1.kappa() - f2.kappa()) < epsilon * std::max(Scalar(1), std::abs(f2.kappa())));
+    };
+
+    for (int i = 0; i < g_repeat; ++i)
+    {
+        CALL_SUBTEST((testMultiScaleFit<Plane>(tree, positions, scales, isSamePlane)));
+        CALL_SUBTEST((testMultiScaleFit<Sphere>(tree, positions, scales, isSameSphere)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test MultiScaleFit in 3 dimensions: float" << flush;
+    callSubTests<float>(quick);
+    cout << " (ok), double" << flush;
+    callSubTests<double>(quick);
+    cout << " (ok)" << endl;
+}
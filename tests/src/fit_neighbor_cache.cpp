@@ -0,0 +1,174 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*!
+    \file test/fit_neighbor_cache.cpp
+    \brief Test the neighbors cache of computeWithIds, replayed by the passes following the first one
+ */
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/fit_comparison.h"
+
+#include <Ponca/src/Fitting/basket.h>
+#include <Ponca/src/Fitting/covariancePlaneFit.h>
+#include <Ponca/src/Fitting/orientedSphereFit.h>
+#include <Ponca/src/Fitting/mongePatch.h>
+#include <Ponca/src/Fitting/gls.h>
+#include <Ponca/src/Fitting/curvature.h>
+#include <Ponca/src/Fitting/curvatureEstimation.h>
+#include <Ponca/src/Fitting/weightFunc.h>
+#include <Ponca/src/Fitting/weightKernel.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+
+#include <numeric>
+#include <vector>
+
+using namespace std;
+using namespace Ponca;
+
+/// Range of indices counting how many times it is iterated
+struct CountingRange
+{
+    const vector<int>* ids;
+    int* nbTraversals;
+
+    vector<int>::const_iterator begin() const { ++(*nbTraversals); return ids->begin(); }
+    vector<int>::const_iterator end() const { return ids->end(); }
+};
+
+/// Compare the fits computed with and without the neighbors cache
+template<typename Fit, typename Functor>
+void testNeighborCache(const KdTree<typename Fit::DataPoint>& tree, typename Fit::Scalar analysisScale,
+                       int nbPasses, Functor isSame)
+{
+    using WeightFunc = typename Fit::WFunctor;
+    const auto& points = tree.points();
+    const int n = int(points.size());
+
+#ifdef NDEBUG
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < n; ++i)
+    {
+        const auto& pos = points[i].pos();
+        vector<int> ids;
+        for (int j : tree.range_neighbors(pos, analysisScale))
+            ids.push_back(j);
+        // Points outside of the support of the weighting function are not cached
+        for (int j = 0; j < n; ++j)
+            if ((points[j].pos() - pos).norm() > analysisScale) { ids.push_back(j); break; }
+
+        Fit ref;
+        ref.setWeightFunc(WeightFunc(analysisScale));
+        ref.init(pos);
+        int refTraversals = 0;
+        const FIT_RESULT res = ref.computeWithIds(CountingRange{&ids, &refTraversals}, points);
+        VERIFY(res != STABLE || refTraversals == nbPasses);
+
+        for (NeighborCache cache : {NO_CACHE, CACHE_INDICES, CACHE_WEIGHTS})
+        {
+            Fit fit;
+            fit.setWeightFunc(WeightFunc(analysisScale));
+            fit.init(pos);
+            int traversals = 0;
+            VERIFY(fit.computeWithIds(CountingRange{&ids, &traversals}, points, cache) == res);
+            VERIFY(traversals == (cache == NO_CACHE ? refTraversals : 1));
+            VERIFY(fit.getNumNeighbors() == ref.getNumNeighbors());
+            // Same neighbors in the same order, with the same weights up to the rounding errors of the weights
+            // kernel, which may use FMA instructions (see neighbor_weights): the orientation of the planes may differ
+            if (res == STABLE) isSame(fit, ref);
+        }
+    }
+}
+
+/// Compare the versions of the weights kernel, selected at runtime, with the weighting function
+template<typename WeightFunc, typename PointContainer>
+void testNeighborWeightsKernel(const PointContainer& points, typename WeightFunc::Scalar analysisScale)
+{
+    using Scalar = typename WeightFunc::Scalar;
+    using VectorType = typename WeightFunc::VectorType;
+    using Kernel = internal::SimdDispatch<internal::NeighborWeightsKernel<WeightFunc, PointContainer>>;
+    const Scalar epsilon = testEpsilon<Scalar>();
+
+    WeightFunc w(analysisScale);
+    w.init(points[0].pos());
+    vector<int> ids(points.size());
+    std::iota(ids.rbegin(), ids.rend(), 0);
+
+    vector<SimdLevel> levels {SimdLevel::Default};
+    if (cpuSimdLevel() >= SimdLevel::AVX2)   levels.push_back(SimdLevel::AVX2);
+    if (cpuSimdLevel() >= SimdLevel::AVX512) levels.push_back(SimdLevel::AVX512);
+    for (SimdLevel level : levels)
+    {
+        vector<Scalar> weights(ids.size());
+        vector<VectorType> localQs(ids.size());
+        Kernel::template version<const WeightFunc*, const PointContainer*, const int*, std::size_t, Scalar*, VectorType*>(level)(
+                &w, &points, ids.data(), ids.size(), weights.data(), localQs.data());
+        for (std::size_t k = 0; k < ids.size(); ++k)
+        {
+            const auto res = w.w(points[ids[k]].pos(), points[ids[k]]);
+            VERIFY(std::abs(weights[k] - res.first) < epsilon);
+            VERIFY((localQs[k] - res.second).norm() < epsilon * std::max(Scalar(1), res.second.norm()));
+        }
+    }
+}
+
+template<typename Scalar>
+void callSubTests(bool quick)
+{
+    using Point = PointPositionNormal<Scalar, 3>;
+    using VectorType = typename Point::VectorType;
+    using WeightFunc = DistWeightFunc<Point, SmoothWeightKernel<Scalar>>;
+
+    using Plane = Basket<Point, WeightFunc, CovariancePlaneFit>;
+    using PlaneDer = BasketDiff<Plane, FitSpaceDer, CovariancePlaneDer>;
+    using Monge = Basket<Point, WeightFunc, CovariancePlaneFit, MongePatch>;
+    using ProjectedNormalCurvature = BasketDiff<Plane, FitSpaceDer, CovariancePlaneDer,
+                                                CurvatureEstimatorBase, ProjectedNormalCovarianceCurvatureEstimator>;
+    using Sphere = Basket<Point, WeightFunc, OrientedSphereFit, GLSParam>;
+    using SphereDer = BasketDiff<Sphere, FitScaleSpaceDer, OrientedSphereDer, GLSDer>;
+
+    const int nbPoints = quick ? 1000 : 5000;
+    const Scalar radius = Eigen::internal::random<Scalar>(1, 10);
+    const VectorType center = VectorType::Random() * Scalar(100);
+    const Scalar analysisScale = Scalar(10.) * std::sqrt(Scalar(4. * M_PI) * radius * radius / nbPoints);
+    vector<Point> points(nbPoints);
+    for (auto& p : points)
+        p = getPointOnSphere<Point>(radius, center, true, false, false);
+    KdTreeDense<Point> tree(points);
+
+    for (int i = 0; i < g_repeat; ++i)
+    {
+        CALL_SUBTEST((testNeighborWeightsKernel<WeightFunc>(points, analysisScale)));
+        // Multi-pass fits
+        CALL_SUBTEST((testNeighborCache<Monge>(tree, analysisScale, 2, isSameMonge<Monge>)));
+        CALL_SUBTEST((testNeighborCache<ProjectedNormalCurvature>(tree, analysisScale, 2, isSameCurvature<ProjectedNormalCurvature>)));
+        // Single pass fits
+        CALL_SUBTEST((testNeighborCache<PlaneDer>(tree, analysisScale, 1, isSamePlaneDer<PlaneDer>)));
+        CALL_SUBTEST((testNeighborCache<SphereDer>(tree, analysisScale, 1, isSameSphereDer<SphereDer>)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test neighbors cache in 3 dimensions: float" << flush;
+    callSubTests<float>(quick);
+    cout << " (ok), double" << flush;
+    callSubTests<double>(quick);
+    cout << " (ok)" << endl;
+}
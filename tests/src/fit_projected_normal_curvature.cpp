@@ -0,0 +1,138 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*!
+    \file test/fit_projected_normal_curvature.cpp
+    \brief Test the second pass of ProjectedNormalCovarianceCurvatureEstimator
+ */
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+
+#include <Ponca/src/Fitting/basket.h>
+#include <Ponca/src/Fitting/covariancePlaneFit.h>
+#include <Ponca/src/Fitting/curvature.h>
+#include <Ponca/src/Fitting/curvatureEstimation.h>
+#include <Ponca/src/Fitting/weightFunc.h>
+#include <Ponca/src/Fitting/weightKernel.h>
+
+#include <vector>
+
+using namespace std;
+using namespace Ponca;
+
+/// Compare the curvatures with the weighted covariance of the normals projected on the fitted plane
+template<typename Fit>
+void testProjectedNormalCovariance(const vector<typename Fit::DataPoint>& points, typename Fit::Scalar analysisScale)
+{
+    using Scalar = typename Fit::Scalar;
+    using VectorType = typename Fit::VectorType;
+    using MatrixType = typename Fit::DataPoint::MatrixType;
+    using WeightFunc = typename Fit::WFunctor;
+    const Scalar epsilon = testEpsilon<Scalar>();
+
+#ifdef NDEBUG
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < int(points.size()); i += 10)
+    {
+        const VectorType& pos = points[i].pos();
+        Fit fit;
+        fit.setWeightFunc(WeightFunc(analysisScale));
+        fit.init(pos);
+        if (fit.compute(points) != STABLE) continue;
+
+        // Weighted covariance of the projected normals, computed in the ambient space
+        const VectorType n = fit.primitiveGradient(pos).normalized();
+        const MatrixType proj = MatrixType::Identity() - n * n.transpose();
+        Scalar sumW = 0;
+        VectorType sumP = VectorType::Zero();
+        MatrixType sumPP = MatrixType::Zero();
+        for (const auto& q : points)
+        {
+            const Scalar w = fit.getWeightFunc().w(q.pos(), q).first;
+            if (w <= Scalar(0)) continue;
+            const VectorType p = proj * q.normal();
+            sumW += w;
+            sumP += w * p;
+            sumPP += w * p * p.transpose();
+        }
+        const VectorType mean = sumP / sumW;
+        const MatrixType cov = sumPP / sumW - mean * mean.transpose();
+        // The third eigenvalue, along the normal of the plane, is 0
+        Eigen::SelfAdjointEigenSolver<MatrixType> solver(cov);
+        Scalar kmin = solver.eigenvalues()(1), kmax = solver.eigenvalues()(2);
+        if (kmin < Scalar(1e-3) && kmax < Scalar(1e-3))
+            kmin = kmax = Scalar(0);
+
+        VERIFY(std::abs(fit.kmin() - kmin) < epsilon);
+        VERIFY(std::abs(fit.kmax() - kmax) < epsilon);
+        VERIFY(fit.kmin() <= fit.kmax());
+
+        // Orthonormal principal directions, in the fitted plane
+        VERIFY(std::abs(fit.kminDirection().norm() - Scalar(1)) < epsilon);
+        VERIFY(std::abs(fit.kmaxDirection().norm() - Scalar(1)) < epsilon);
+        VERIFY(std::abs(fit.kminDirection().dot(n)) < epsilon);
+        VERIFY(std::abs(fit.kmaxDirection().dot(n)) < epsilon);
+        VERIFY(std::abs(fit.kminDirection().dot(fit.kmaxDirection())) < epsilon);
+        if (kmax > Scalar(0))
+            VERIFY((cov * fit.kmaxDirection() - kmax * fit.kmaxDirection()).norm() < epsilon);
+    }
+}
+
+template<typename Scalar>
+void callSubTests(bool quick)
+{
+    using Point = PointPositionNormal<Scalar, 3>;
+    using VectorType = typename Point::VectorType;
+    using SmoothWeight = DistWeightFunc<Point, SmoothWeightKernel<Scalar>>;
+    using ConstantWeight = DistWeightFunc<Point, ConstantWeightKernel<Scalar>>;
+
+    using SmoothPlane = Basket<Point, SmoothWeight, CovariancePlaneFit>;
+    using ConstantPlane = Basket<Point, ConstantWeight, CovariancePlaneFit>;
+    using SmoothCurvature = BasketDiff<SmoothPlane, FitSpaceDer, CovariancePlaneDer,
+                                       CurvatureEstimatorBase, ProjectedNormalCovarianceCurvatureEstimator>;
+    using ConstantCurvature = BasketDiff<ConstantPlane, FitSpaceDer, CovariancePlaneDer,
+                                         CurvatureEstimatorBase, ProjectedNormalCovarianceCurvatureEstimator>;
+
+    const int nbPoints = quick ? 1000 : 5000;
+    const Scalar radius = Eigen::internal::random<Scalar>(1, 10);
+    const VectorType center = VectorType::Random() * Scalar(100);
+
+    vector<Point> sphere(nbPoints), plane(nbPoints);
+    for (auto& p : sphere)
+        p = getPointOnSphere<Point>(radius, center, false, false, false);
+    const VectorType direction = VectorType::Random().normalized();
+    for (auto& p : plane)
+        p = getPointOnPlane<Point>(center, direction, radius, false, false, false);
+
+    for (int i = 0; i < g_repeat; ++i)
+    {
+        CALL_SUBTEST((testProjectedNormalCovariance<SmoothCurvature>(sphere, radius / Scalar(2))));
+        CALL_SUBTEST((testProjectedNormalCovariance<ConstantCurvature>(sphere, radius / Scalar(2))));
+        CALL_SUBTEST((testProjectedNormalCovariance<SmoothCurvature>(plane, radius / Scalar(2))));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test projected normal covariance curvatures in 3 dimensions: float" << flush;
+    callSubTests<float>(quick);
+    cout << " (ok), double" << flush;
+    callSubTests<double>(quick);
+    cout << " (ok)" << endl;
+}
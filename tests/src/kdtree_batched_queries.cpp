@@ -0,0 +1,200 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+using namespace Ponca;
+
+template <typename DataPoint>
+struct QueryStatsTraits : public KdTreeDefaultTraits<DataPoint>
+{
+    using QueryStatsPolicy = KdTreeCountQueryStatsPolicy;
+};
+
+/// Compare the statistics of the queries
+inline bool isSameQueryStats(const KdTreeQueryStats& a, const KdTreeQueryStats& b)
+{
+    return a.query_count    == b.query_count    &&
+           a.node_count     == b.node_count     &&
+           a.leaf_count     == b.leaf_count     &&
+           a.distance_count == b.distance_count &&
+           a.accepted_count == b.accepted_count &&
+           a.rejected_count == b.rejected_count &&
+           a.max_stack_size == b.max_stack_size;
+}
+
+/// Compare batched queries with standard queries, for index and position inputs
+template<typename KdTreeType, bool SampleKdTree, int GroupSize>
+void testKdTreeBatchedQueries(bool quick, bool reducedPrecision = false)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 300 : 5000;
+    const int k = quick ? 5 : 12;
+    const Scalar r = Scalar(0.1);
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    kdtree.set_reduced_precision(reducedPrecision);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+
+    // Inputs in random order, with a size that is not a multiple of the group size
+    std::vector<int> indices(N - 1);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::shuffle(indices.begin(), indices.end(), std::mt19937(1));
+    std::vector<VectorType> positions(N - 1);
+    std::generate(positions.begin(), positions.end(), []() { return VectorType(VectorType::Random()); });
+
+    std::vector<int> callCount(N, 0);
+    kdtree.template batch_k_nearest_neighbors<GroupSize>(indices, k, [&](std::size_t i, const std::vector<int>& neighbors) {
+        ++callCount[i];
+        std::vector<int> expected;
+        for (int j : kdtree.k_nearest_neighbors(indices[i], k))
+            if (j >= 0) expected.push_back(j);
+        VERIFY(neighbors == expected);
+    });
+    VERIFY(std::all_of(callCount.begin(), callCount.end() - 1, [](int c) { return c == 1; }));
+    VERIFY(callCount.back() == 0);
+
+    kdtree.template batch_k_nearest_neighbors<GroupSize>(positions, k, [&](std::size_t i, const std::vector<int>& neighbors) {
+        std::vector<int> expected;
+        for (int j : kdtree.k_nearest_neighbors(positions[i], k))
+            if (j >= 0) expected.push_back(j);
+        VERIFY(neighbors == expected);
+    });
+
+    kdtree.template batch_range_neighbors<GroupSize>(indices, r, [&](std::size_t i, const std::vector<int>& neighbors) {
+        std::vector<int> expected;
+        for (int j : kdtree.range_neighbors(indices[i], r))
+            expected.push_back(j);
+        VERIFY(neighbors == expected);
+    });
+
+    kdtree.template batch_range_neighbors<GroupSize>(positions, r, [&](std::size_t i, const std::vector<int>& neighbors) {
+        std::vector<int> expected;
+        for (int j : kdtree.range_neighbors(positions[i], r))
+            expected.push_back(j);
+        VERIFY(neighbors == expected);
+    });
+
+    // Empty inputs
+    int emptyCalls = 0;
+    kdtree.template batch_k_nearest_neighbors<GroupSize>(std::vector<int>(), k, [&](std::size_t, const std::vector<int>&) { ++emptyCalls; });
+    VERIFY(emptyCalls == 0);
+}
+
+/// Batched queries perform the same leaf scans as standard queries, and record the same statistics
+template<typename KdTreeType, int GroupSize>
+void testKdTreeBatchedQueriesStats(bool quick, bool reducedPrecision)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 300 : 5000;
+    const int k = quick ? 5 : 12;
+    const Scalar r = Scalar(0.1);
+    auto points = typename KdTreeType::PointContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    kdtree.set_reduced_precision(reducedPrecision);
+    kdtree.build(points);
+
+    std::vector<int> indices(N);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    for (int i : indices)
+        for (int j : kdtree.k_nearest_neighbors(i, k)) VERIFY(j != i);
+    const KdTreeQueryStats standardKNearest = kdtree.query_stats();
+    kdtree.reset_query_stats();
+    kdtree.template batch_k_nearest_neighbors<GroupSize>(indices, k, [](std::size_t, const std::vector<int>&) {});
+    VERIFY(isSameQueryStats(kdtree.query_stats(), standardKNearest));
+
+    kdtree.reset_query_stats();
+    for (int i : indices)
+        for (int j : kdtree.range_neighbors(i, r)) VERIFY(j != i);
+    const KdTreeQueryStats standardRange = kdtree.query_stats();
+    kdtree.reset_query_stats();
+    kdtree.template batch_range_neighbors<GroupSize>(indices, r, [](std::size_t, const std::vector<int>&) {});
+    VERIFY(isSameQueryStats(kdtree.query_stats(), standardRange));
+    // The reduced precision filter rejects samples before computing their distance
+    if (reducedPrecision)
+        VERIFY(standardRange.distance_count < standardRange.accepted_count + standardRange.rejected_count);
+}
+
+/// Batched queries on a tree that is not built give empty results
+template<typename DataPoint>
+void testKdTreeBatchedQueriesEmptyTree()
+{
+    using VectorType = typename DataPoint::VectorType;
+
+    KdTreeDense<DataPoint> kdtree;
+    std::vector<VectorType> positions(10, VectorType::Zero());
+    int calls = 0;
+    kdtree.batch_k_nearest_neighbors(positions, 3, [&](std::size_t, const std::vector<int>& neighbors) {
+        VERIFY(neighbors.empty());
+        ++calls;
+    });
+    kdtree.batch_range_neighbors(positions, 1, [&](std::size_t, const std::vector<int>& neighbors) {
+        VERIFY(neighbors.empty());
+        ++calls;
+    });
+    VERIFY(calls == 20);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test batched queries..." << endl;
+    testKdTreeBatchedQueries<KdTreeDense<TestPoint<float, 3>>, false, 8>(quick);
+    testKdTreeBatchedQueries<KdTreeSparse<TestPoint<double, 3>>, true, 16>(quick);
+    testKdTreeBatchedQueries<KdTreeMorton<TestPoint<double, 3>>, false, 1>(quick);
+    testKdTreeBatchedQueries<KdTreeDense<TestPoint<long double, 4>>, false, 5>(quick);
+    testKdTreeBatchedQueries<KdTreeDense<TestPoint<double, 3>>, false, 8>(quick, true);
+    testKdTreeBatchedQueries<KdTreeSparse<TestPoint<double, 3>>, true, 8>(quick, true);
+
+    cout << "Test batched queries statistics..." << endl;
+    testKdTreeBatchedQueriesStats<KdTreeDenseBase<QueryStatsTraits<TestPoint<double, 3>>>, 8>(quick, false);
+    testKdTreeBatchedQueriesStats<KdTreeDenseBase<QueryStatsTraits<TestPoint<double, 3>>>, 8>(quick, true);
+
+    cout << "Test batched queries on a tree that is not built..." << endl;
+    testKdTreeBatchedQueriesEmptyTree<TestPoint<double, 3>>();
+}
@@ -0,0 +1,181 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+#include <atomic>
+
+using namespace Ponca;
+
+/// Compare the leaf-batched range neighbors of all the samples with standard range queries
+template<typename KdTreeType, bool SampleKdTree>
+void testKdTreeBatchedRange(bool quick, bool duplicates)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 500 : 5000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+    if (duplicates)
+        for (int i = 0; i < N; i += 3)
+            points[i] = points[(i * 7) % N];
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(duplicates ? 4 : 16);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+
+    for (Scalar r : {Scalar(0), Scalar(0.05), Scalar(0.2), Scalar(0.5)})
+    {
+        std::vector<std::vector<int>> results(N);
+        std::vector<int> callCount(N, 0);
+        std::atomic<int> totalCalls {0};
+        kdtree.for_each_range_neighbors(r, [&](int i, const std::vector<int>& neighbors) {
+            results[i] = neighbors;
+            ++callCount[i];
+            ++totalCalls;
+        });
+
+        // Each sample is processed exactly once
+        VERIFY(totalCalls == kdtree.sample_count());
+        for (int s = 0; s < kdtree.sample_count(); ++s)
+            VERIFY(callCount[kdtree.pointFromSample(s)] == 1);
+
+#pragma omp parallel for
+        for (int s = 0; s < kdtree.sample_count(); ++s)
+        {
+            const int i = kdtree.pointFromSample(s);
+            std::vector<int> expected;
+            for (int j : kdtree.range_neighbors(i, r))
+                expected.push_back(j);
+            std::vector<int> neighbors = results[i];
+            std::sort(expected.begin(), expected.end());
+            std::sort(neighbors.begin(), neighbors.end());
+            VERIFY(neighbors == expected);
+        }
+    }
+}
+
+/// Versions of the kernels that can run on this CPU
+inline std::vector<SimdLevel> simdLevels()
+{
+    std::vector<SimdLevel> levels {SimdLevel::Default};
+    if (cpuSimdLevel() >= SimdLevel::AVX2)   levels.push_back(SimdLevel::AVX2);
+    if (cpuSimdLevel() >= SimdLevel::AVX512) levels.push_back(SimdLevel::AVX512);
+    return levels;
+}
+
+/// Compare the distance kernels, for each version selected at runtime, with Eigen
+template<typename Scalar, int Dim>
+void testSquaredDistancesKernel()
+{
+    using VectorType = Eigen::Matrix<Scalar, Dim, 1>;
+    using DataPoint = TestPoint<Scalar, Dim>;
+    using SoaKernel = Ponca::internal::SimdDispatch<Ponca::internal::SquaredDistancesSoaKernel<Dim, Scalar>>;
+    using GatherKernel = Ponca::internal::SimdDispatch<Ponca::internal::SquaredDistancesGatherKernel<DataPoint, int>>;
+
+    // Distances of the versions using FMA can differ in the last bits
+    const auto isClose = [](Scalar d, Scalar expected) {
+        return std::abs(d - expected) <= Scalar(8) * std::numeric_limits<Scalar>::epsilon() * (expected + Scalar(1));
+    };
+
+    // Block sizes that are not multiples of the vector registers sizes
+    for (std::size_t count : {std::size_t(0), std::size_t(1), std::size_t(7), std::size_t(67)})
+    {
+        const std::size_t stride = count + 3;
+        std::vector<VectorType> candidates(count);
+        std::generate(candidates.begin(), candidates.end(), []() { return VectorType(VectorType::Random()); });
+        std::vector<Scalar> coords(Dim * stride, Scalar(0));
+        for (std::size_t m = 0; m < count; ++m)
+            for (int d = 0; d < Dim; ++d)
+                coords[d * stride + m] = candidates[m][d];
+        // Gathered in reverse order
+        std::vector<DataPoint> points(candidates.begin(), candidates.end());
+        std::vector<int> indices(count);
+        for (std::size_t m = 0; m < count; ++m)
+            indices[m] = int(count - 1 - m);
+
+        const VectorType query = VectorType::Random();
+        for (SimdLevel level : simdLevels())
+        {
+            std::vector<Scalar> distances(count + 1, Scalar(-1));
+            SoaKernel::template version<const Scalar*, std::size_t, std::size_t, const Scalar*, Scalar*>(level)(
+                    coords.data(), stride, count, query.data(), distances.data());
+            for (std::size_t m = 0; m < count; ++m)
+                VERIFY(isClose(distances[m], (candidates[m] - query).squaredNorm()));
+            // Values after the block are not modified
+            VERIFY(distances[count] == Scalar(-1));
+
+            std::fill(distances.begin(), distances.end(), Scalar(-1));
+            GatherKernel::template version<const DataPoint*, const int*, std::size_t, const Scalar*, Scalar*>(level)(
+                    points.data(), indices.data(), count, query.data(), distances.data());
+            for (std::size_t m = 0; m < count; ++m)
+                VERIFY(isClose(distances[m], (candidates[indices[m]] - query).squaredNorm()));
+            VERIFY(distances[count] == Scalar(-1));
+        }
+
+        // Dispatched version
+        std::vector<Scalar> distances(count + 1, Scalar(-1));
+        Ponca::internal::squared_distances_soa<Dim>(coords.data(), stride, count, query.data(), distances.data());
+        for (std::size_t m = 0; m < count; ++m)
+            VERIFY(isClose(distances[m], (candidates[m] - query).squaredNorm()));
+        Ponca::internal::squared_distances_gather(points.data(), indices.data(), count, query.data(), distances.data());
+        for (std::size_t m = 0; m < count; ++m)
+            VERIFY(isClose(distances[m], (candidates[indices[m]] - query).squaredNorm()));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test distance kernels, up to " << (cpuSimdLevel() == SimdLevel::AVX512 ? "AVX-512" :
+                                                 cpuSimdLevel() == SimdLevel::AVX2   ? "AVX2" : "default") << "..." << endl;
+    testSquaredDistancesKernel<float, 3>();
+    testSquaredDistancesKernel<double, 3>();
+    testSquaredDistancesKernel<double, 5>();
+    testSquaredDistancesKernel<long double, 2>();
+
+    cout << "Test leaf-batched range neighbors..." << endl;
+    testKdTreeBatchedRange<KdTreeDense<TestPoint<float, 3>>, false>(quick, false);
+    testKdTreeBatchedRange<KdTreeSparse<TestPoint<double, 3>>, true>(quick, false);
+    testKdTreeBatchedRange<KdTreeMorton<TestPoint<double, 3>>, false>(quick, false);
+    testKdTreeBatchedRange<KdTreeDense<TestPoint<long double, 4>>, false>(quick, false);
+    testKdTreeBatchedRange<KdTreeDense<TestPoint<double, 2>>, false>(quick, false);
+
+    cout << "Test leaf-batched range neighbors with duplicated points..." << endl;
+    testKdTreeBatchedRange<KdTreeDense<TestPoint<double, 3>>, false>(quick, true);
+    testKdTreeBatchedRange<KdTreeMorton<TestPoint<float, 3>>, true>(quick, true);
+}
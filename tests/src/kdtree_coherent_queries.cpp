@@ -0,0 +1,183 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+using namespace Ponca;
+
+template <typename DataPoint>
+struct QueryStatsTraits : public KdTreeDefaultTraits<DataPoint>
+{
+    using QueryStatsPolicy = KdTreeCountQueryStatsPolicy;
+};
+
+/// Squared distances from `point` to `neighbors`, sorted
+template<typename Scalar, typename VectorType, typename VectorContainer>
+std::vector<Scalar> sortedDistances(const VectorContainer& points, const VectorType& point, const std::vector<int>& neighbors)
+{
+    std::vector<Scalar> distances;
+    for (int j : neighbors)
+        distances.push_back((points[j].pos() - point).squaredNorm());
+    std::sort(distances.begin(), distances.end());
+    return distances;
+}
+
+/// Compare coherent queries with standard queries, for inputs visited in a spatially coherent or random order
+template<typename KdTreeType, bool SampleKdTree>
+void testKdTreeCoherentQueries(bool quick, bool coherentOrder)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 300 : 5000;
+    const int k = quick ? 5 : 12;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+
+    // Samples are sorted along the tree leaves, which gives a spatially coherent order
+    std::vector<int> order;
+    for (int s = 0; s < kdtree.sample_count(); ++s)
+        order.push_back(kdtree.pointFromSample(s));
+    // Also query points that are not samples
+    for (int i = 0; i < N; ++i)
+        if (std::find(sampling.begin(), sampling.end(), i) == sampling.end())
+            order.push_back(i);
+    if (!coherentOrder)
+        std::shuffle(order.begin(), order.end(), std::mt19937(1));
+
+    auto knnIndex   = kdtree.coherent_k_nearest_neighbors(order.front(), k);
+    auto knnPoint   = kdtree.coherent_k_nearest_neighbors(VectorType(VectorType::Zero()), k);
+    auto rangeIndex = kdtree.coherent_range_neighbors(order.front(), Scalar(0.1));
+    auto rangePoint = kdtree.coherent_range_neighbors(VectorType(VectorType::Zero()), Scalar(0.1));
+
+    for (int i : order)
+    {
+        const VectorType point = points[i].pos() + Scalar(0.01) * VectorType::Random();
+        const Scalar r = Eigen::internal::random<Scalar>(0.01, 0.2);
+
+        // k-nearest neighbors of an index
+        std::vector<int> expected, results;
+        for (int j : kdtree.k_nearest_neighbors(i, k))
+            expected.push_back(j);
+        for (int j : knnIndex(i))
+            results.push_back(j);
+        VERIFY(!has_duplicate(results));
+        VERIFY((sortedDistances<Scalar>(points, points[i].pos(), expected) == sortedDistances<Scalar>(points, points[i].pos(), results)));
+
+        // k-nearest neighbors of a position
+        expected.clear(); results.clear();
+        for (int j : kdtree.k_nearest_neighbors(point, k))
+            expected.push_back(j);
+        for (int j : knnPoint(point))
+            results.push_back(j);
+        VERIFY(!has_duplicate(results));
+        VERIFY((sortedDistances<Scalar>(points, point, expected) == sortedDistances<Scalar>(points, point, results)));
+
+        // Range neighbors of an index
+        expected.clear(); results.clear();
+        for (int j : kdtree.range_neighbors(i, r))
+            expected.push_back(j);
+        for (int j : rangeIndex(i, r))
+            results.push_back(j);
+        std::sort(expected.begin(), expected.end());
+        std::sort(results.begin(), results.end());
+        VERIFY(expected == results);
+
+        // Range neighbors of a position
+        expected.clear(); results.clear();
+        for (int j : kdtree.range_neighbors(point, r))
+            expected.push_back(j);
+        for (int j : rangePoint(point, r))
+            results.push_back(j);
+        std::sort(expected.begin(), expected.end());
+        std::sort(results.begin(), results.end());
+        VERIFY(expected == results);
+    }
+}
+
+/// Coherent queries visit fewer nodes than standard queries for coherent inputs
+template<typename DataPoint>
+void testKdTreeCoherentQueriesNodeCount()
+{
+    using VectorType = typename DataPoint::VectorType;
+    using KdTreeType = KdTreeDenseBase<QueryStatsTraits<DataPoint>>;
+
+    const int N = 5000;
+    const int k = 10;
+    auto points = std::vector<DataPoint>(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    kdtree.build(points);
+
+    for (int s = 0; s < kdtree.sample_count(); ++s)
+        for (int j : kdtree.k_nearest_neighbors(kdtree.pointFromSample(s), k)) VERIFY(j >= 0);
+    const auto standard = kdtree.query_stats();
+
+    kdtree.reset_query_stats();
+    {
+        auto query = kdtree.coherent_k_nearest_neighbors(0, k);
+        for (int s = 0; s < kdtree.sample_count(); ++s)
+            for (int j : query(kdtree.pointFromSample(s))) VERIFY(j >= 0);
+    }
+    const auto coherent = kdtree.query_stats();
+
+    VERIFY(coherent.query_count == standard.query_count);
+    VERIFY(coherent.node_count < standard.node_count);
+    VERIFY(coherent.distance_count < standard.distance_count);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test coherent queries with coherent inputs..." << endl;
+    testKdTreeCoherentQueries<KdTreeDense<TestPoint<float, 3>>, false>(quick, true);
+    testKdTreeCoherentQueries<KdTreeSparse<TestPoint<double, 3>>, true>(quick, true);
+    testKdTreeCoherentQueries<KdTreeMorton<TestPoint<double, 3>>, false>(quick, true);
+    testKdTreeCoherentQueries<KdTreeDense<TestPoint<long double, 4>>, false>(quick, true);
+
+    cout << "Test coherent queries with random inputs..." << endl;
+    testKdTreeCoherentQueries<KdTreeDense<TestPoint<double, 3>>, false>(quick, false);
+    testKdTreeCoherentQueries<KdTreeMorton<TestPoint<float, 3>>, true>(quick, false);
+
+    cout << "Test coherent queries node count..." << endl;
+    testKdTreeCoherentQueriesNodeCount<TestPoint<double, 3>>();
+}
@@ -0,0 +1,156 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+using namespace Ponca;
+
+template<typename DataPoint, typename CodeType, bool SampleKdTree>
+void testKdTreeMortonQueries(bool quick = true, bool duplicates = false)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+    using MortonTree = KdTreeMortonBase<KdTreeDefaultTraits<DataPoint>, CodeType>;
+
+    const int N = quick ? 100 : 3000;
+    const int k = quick ? 5 : 15;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), [duplicates]() {
+        VectorType p = VectorType::Random();
+        // snap points on a coarse grid to generate many identical Morton codes
+        if (duplicates) p = (p * Scalar(4)).array().round() / Scalar(4);
+        return DataPoint(p);
+    });
+
+    std::vector<int> sampling;
+    MortonTree kdtree;
+    kdtree.set_min_cell_size(8);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices(N);
+        std::iota(indices.begin(), indices.end(), 0);
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+        kdtree.buildWithSampling(points, sampling);
+    }
+    else
+    {
+        sampling.resize(N);
+        std::iota(sampling.begin(), sampling.end(), 0);
+        kdtree.build(points);
+    }
+    VERIFY(kdtree.valid());
+    VERIFY(kdtree.sample_count() == int(sampling.size()));
+
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+    {
+        const VectorType point = VectorType::Random();
+        const Scalar r = Eigen::internal::random<Scalar>(0., 0.5);
+
+        std::vector<int> results;
+        for (int j : kdtree.range_neighbors(point, r))
+            results.push_back(j);
+        VERIFY((check_range_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, r, results)));
+
+        results.clear();
+        for (int j : kdtree.k_nearest_neighbors(point, k))
+            results.push_back(j);
+        VERIFY((check_k_nearest_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, k, results)));
+
+        for (int j : kdtree.nearest_neighbor(point))
+            VERIFY((check_nearest_neighbor<Scalar, VectorType, VectorContainer>(points, sampling, point, j)));
+    }
+
+#pragma omp parallel for
+    for (int s = 0; s < int(sampling.size()); ++s)
+    {
+        const int i = sampling[s];
+        const Scalar r = Eigen::internal::random<Scalar>(0., 0.5);
+
+        std::vector<int> results;
+        for (int j : kdtree.range_neighbors(i, r))
+            results.push_back(j);
+        VERIFY((check_range_neighbors<Scalar, VectorContainer>(points, sampling, i, r, results)));
+
+        // Duplicated points break the strict ordering assumed by the kNN check
+        if (duplicates) continue;
+        results.clear();
+        for (int j : kdtree.k_nearest_neighbors(i, k))
+            results.push_back(j);
+        VERIFY((check_k_nearest_neighbors<Scalar, VectorContainer>(points, sampling, i, k, results)));
+    }
+}
+
+template<typename DataPoint>
+void testKdTreeMortonOrder()
+{
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+    using Code = Ponca::internal::MortonCode<std::uint64_t, DataPoint::Dim>;
+
+    const int N = 1000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    KdTreeMorton<DataPoint> kdtree(points);
+
+    // Samples must be sorted along the Morton curve
+    Ponca::internal::MortonGrid<typename DataPoint::Scalar, VectorType, std::uint64_t, DataPoint::Dim> grid;
+    typename KdTree<DataPoint>::AabbType aabb;
+    for (const auto& p : points) aabb.extend(p.pos());
+    grid.setBounds(aabb);
+    for (int i = 1; i < kdtree.sample_count(); ++i)
+        VERIFY(grid.encode(kdtree.pointDataFromSample(i-1).pos()) <= grid.encode(kdtree.pointDataFromSample(i).pos()));
+
+    // Check bit interleaving
+    VERIFY(Code::encode({}) == 0);
+    std::array<std::uint64_t, DataPoint::Dim> q {};
+    q[0] = 1;
+    VERIFY(Code::encode(q) == 1);
+    q[0] = 0; q[DataPoint::Dim - 1] = 2;
+    VERIFY(Code::encode(q) == (std::uint64_t(1) << (DataPoint::Dim + DataPoint::Dim - 1)));
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test Morton codes and ordering..." << endl;
+    testKdTreeMortonOrder<TestPoint<float, 3>>();
+    testKdTreeMortonOrder<TestPoint<double, 2>>();
+    testKdTreeMortonOrder<TestPoint<double, 4>>();
+
+    cout << "Test Morton KdTree queries in 3D..." << endl;
+    testKdTreeMortonQueries<TestPoint<float, 3>, std::uint64_t, false>(quick);
+    testKdTreeMortonQueries<TestPoint<double, 3>, std::uint64_t, false>(quick);
+    testKdTreeMortonQueries<TestPoint<double, 3>, std::uint32_t, false>(quick);
+    testKdTreeMortonQueries<TestPoint<long double, 3>, std::uint64_t, true>(quick);
+    testKdTreeMortonQueries<TestPoint<double, 3>, std::uint64_t, true>(quick);
+
+    cout << "Test Morton KdTree queries in 4D..." << endl;
+    testKdTreeMortonQueries<TestPoint<float, 4>, std::uint64_t, false>(quick);
+    testKdTreeMortonQueries<TestPoint<double, 4>, std::uint32_t, true>(quick);
+
+    cout << "Test Morton KdTree queries with duplicated points..." << endl;
+    testKdTreeMortonQueries<TestPoint<double, 3>, std::uint64_t, false>(quick, true);
+    testKdTreeMortonQueries<TestPoint<float, 3>, std::uint32_t, true>(quick, true);
+}
@@ -0,0 +1,151 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+#include <sstream>
+
+using namespace Ponca;
+
+/// [QueryStatsTraits definition]
+template <typename DataPoint>
+struct QueryStatsTraits : public KdTreeDefaultTraits<DataPoint>
+{
+    using QueryStatsPolicy = KdTreeCountQueryStatsPolicy;
+};
+/// [QueryStatsTraits definition]
+
+template<typename KdTreeType>
+void testKdTreeQueryStats(bool quick, bool reducedPrecision)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 200 : 5000;
+    const int k = quick ? 5 : 10;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    kdtree.set_reduced_precision(reducedPrecision);
+    kdtree.build(points);
+    VERIFY(kdtree.query_stats().query_count == 0);
+
+    // Range queries: each neighbor is accepted once
+    std::size_t neighborCount = 0;
+#pragma omp parallel for reduction(+:neighborCount)
+    for (int i = 0; i < N; ++i)
+    {
+        const Scalar r = Eigen::internal::random<Scalar>(0., 0.5);
+        auto query = kdtree.range_neighbors(VectorType(VectorType::Random()), r);
+        std::size_t count = 0;
+        for (int j : query)
+        {
+            VERIFY(j >= 0);
+            ++count;
+        }
+        VERIFY(query.query_stats().query_count == 1);
+        VERIFY(query.query_stats().accepted_count == count);
+        neighborCount += count;
+    }
+
+    auto stats = kdtree.query_stats();
+    VERIFY(stats.query_count == std::size_t(N));
+    VERIFY(stats.accepted_count == neighborCount);
+    VERIFY(stats.leaf_count > 0);
+    VERIFY(stats.node_count >= stats.leaf_count);
+    VERIFY(stats.max_stack_size <= std::size_t(2 * KdTreeType::MAX_DEPTH));
+    // Samples are either accepted or rejected, possibly before computing the exact distance
+    VERIFY(stats.accepted_count + stats.rejected_count >= stats.distance_count);
+    if (!reducedPrecision)
+        VERIFY(stats.accepted_count + stats.rejected_count == stats.distance_count);
+
+    // kNN queries, iterating several times over the same query object
+    kdtree.reset_query_stats();
+    VERIFY(kdtree.query_stats().query_count == 0);
+    {
+        auto query = kdtree.k_nearest_neighbors(0, k);
+        for (int i = 0; i < N; ++i)
+            for (int j : query) VERIFY(j != 0);
+        // Counters are added to the tree when the query is destroyed
+        VERIFY(kdtree.query_stats().query_count == 0);
+        VERIFY(query.query_stats().query_count == std::size_t(N));
+    }
+    stats = kdtree.query_stats();
+    VERIFY(stats.query_count == std::size_t(N));
+    VERIFY(stats.accepted_count >= std::size_t(N * k));
+    VERIFY(stats.max_stack_size > 0);
+
+    std::ostringstream os;
+    os << stats;
+    VERIFY(os.str().find("DistanceCount") != std::string::npos);
+
+    // Statistics are copied with the tree
+    KdTreeType copy = kdtree;
+    VERIFY(copy.query_stats().accepted_count == stats.accepted_count);
+
+    // A copy of a query object starts with empty statistics, so each search is counted once
+    kdtree.reset_query_stats();
+    {
+        auto query = kdtree.k_nearest_neighbors(0, k);
+        for (int j : query) VERIFY(j != 0);
+        auto queryCopy = query;
+        VERIFY(queryCopy.query_stats().query_count == 0);
+        queryCopy = query;
+        VERIFY(queryCopy.query_stats().query_count == 0);
+    }
+    VERIFY(kdtree.query_stats().query_count == 1);
+}
+
+template<typename DataPoint>
+void testKdTreeNoQueryStats()
+{
+    using VectorType = typename DataPoint::VectorType;
+
+    // Statistics are disabled by default and do not use any storage
+    static_assert(!KdTreeQuery<KdTreeDefaultTraits<DataPoint>>::QueryStatsPolicy::ENABLED);
+    static_assert(std::is_empty<KdTreeNoQueryStatsPolicy>::value);
+    static_assert(std::is_empty<Ponca::internal::KdTreeQueryStatsAccumulator<false>>::value);
+
+    auto points = std::vector<DataPoint>(100);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+    KdTreeDense<DataPoint> kdtree(points);
+    for (int i = 0; i < 100; ++i)
+        for (int j : kdtree.k_nearest_neighbors(i, 5)) VERIFY(j != i);
+    VERIFY(kdtree.query_stats().query_count == 0);
+    VERIFY(kdtree.query_stats().node_count == 0);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KdTree query statistics..." << endl;
+    testKdTreeQueryStats<KdTreeDenseBase<QueryStatsTraits<TestPoint<float, 3>>>>(quick, false);
+    testKdTreeQueryStats<KdTreeSparseBase<QueryStatsTraits<TestPoint<double, 3>>>>(quick, true);
+    testKdTreeQueryStats<KdTreeMortonBase<QueryStatsTraits<TestPoint<double, 4>>>>(quick, false);
+
+    cout << "Test KdTree without query statistics..." << endl;
+    testKdTreeNoQueryStats<TestPoint<float, 3>>();
+}
@@ -0,0 +1,163 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+using namespace Ponca;
+
+/// Squared distances from `point` to `neighbors`, sorted
+template<typename Scalar, typename VectorType, typename VectorContainer>
+std::vector<Scalar> sortedDistances(const VectorContainer& points, const VectorType& point, const std::vector<int>& neighbors)
+{
+    std::vector<Scalar> distances;
+    for (int j : neighbors)
+        distances.push_back((points[j].pos() - point).squaredNorm());
+    std::sort(distances.begin(), distances.end());
+    return distances;
+}
+
+/// Compare the queries of a tree using reduced precision coordinates with the ones of the exact tree.
+/// \param offset Translation of the point cloud, increasing the rounding errors of the reduced precision coordinates
+/// \param scale Extent of the point cloud, spacing below single precision make the reduced coordinates ambiguous
+template<typename KdTreeType, bool SampleKdTree>
+void testKdTreeReducedPrecision(bool quick, typename KdTreeType::Scalar offset, typename KdTreeType::Scalar scale)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 200 : 5000;
+    const int k = quick ? 5 : 15;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), [offset, scale]() {
+        return DataPoint(VectorType::Constant(offset) + scale * VectorType::Random());
+    });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    KdTreeType exact, reduced;
+    exact.set_min_cell_size(16);
+    reduced.set_min_cell_size(16);
+    reduced.set_reduced_precision(true);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+    {
+        exact.buildWithSampling(points, sampling);
+        reduced.buildWithSampling(points, sampling);
+    }
+    else
+    {
+        exact.build(points);
+        reduced.build(points);
+    }
+    VERIFY(reduced.reduced_precision());
+    VERIFY(int(reduced.reduced_points().size()) == reduced.sample_count());
+    VERIFY(exact.reduced_points().empty());
+
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+    {
+        // Query points close to the samples, so that many candidates lie near the threshold
+        const VectorType point = points[i].pos() + Scalar(0.01) * scale * VectorType::Random();
+        const Scalar r = Eigen::internal::random<Scalar>(0., 0.2) * scale;
+
+        std::vector<int> resultsExact, resultsReduced;
+        for (int j : exact.range_neighbors(point, r))
+            resultsExact.push_back(j);
+        for (int j : reduced.range_neighbors(point, r))
+            resultsReduced.push_back(j);
+        std::sort(resultsExact.begin(), resultsExact.end());
+        std::sort(resultsReduced.begin(), resultsReduced.end());
+        VERIFY(resultsExact == resultsReduced);
+
+        resultsExact.clear(); resultsReduced.clear();
+        for (int j : exact.k_nearest_neighbors(point, k))
+            resultsExact.push_back(j);
+        for (int j : reduced.k_nearest_neighbors(point, k))
+            resultsReduced.push_back(j);
+        VERIFY((sortedDistances<Scalar>(points, point, resultsExact) == sortedDistances<Scalar>(points, point, resultsReduced)));
+
+        resultsExact.clear(); resultsReduced.clear();
+        for (int j : exact.nearest_neighbor(point))
+            resultsExact.push_back(j);
+        for (int j : reduced.nearest_neighbor(point))
+            resultsReduced.push_back(j);
+        VERIFY((sortedDistances<Scalar>(points, point, resultsExact) == sortedDistances<Scalar>(points, point, resultsReduced)));
+    }
+
+    // Disabling the option releases the reduced coordinates
+    reduced.set_reduced_precision(false);
+    VERIFY(reduced.reduced_points().empty());
+}
+
+template<typename DataPoint>
+void testKdTreeReducedPrecisionOverflow()
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    // Coordinates that cannot be represented in single precision disable the reduced coordinates
+    auto points = VectorContainer(100);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+    points[0].pos()[0] = Scalar(1e300);
+
+    KdTreeDense<DataPoint> kdtree;
+    kdtree.set_reduced_precision(true);
+    kdtree.build(points);
+    VERIFY(kdtree.reduced_points().empty());
+
+    std::vector<int> results;
+    for (int j : kdtree.range_neighbors(VectorType::Zero(), Scalar(0.5)))
+        results.push_back(j);
+    std::vector<int> sampling(points.size());
+    std::iota(sampling.begin(), sampling.end(), 0);
+    VERIFY((check_range_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, VectorType::Zero(), Scalar(0.5), results)));
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KdTree queries with reduced precision coordinates in 3D..." << endl;
+    testKdTreeReducedPrecision<KdTreeDense<TestPoint<double, 3>>, false>(quick, 0, 1);
+    testKdTreeReducedPrecision<KdTreeSparse<TestPoint<double, 3>>, true>(quick, 0, 1);
+    testKdTreeReducedPrecision<KdTreeMorton<TestPoint<double, 3>>, true>(quick, 0, 1);
+    testKdTreeReducedPrecision<KdTreeDense<TestPoint<float, 3>>, false>(quick, 0, 1);
+
+    cout << "Test KdTree queries with reduced precision coordinates on large coordinates..." << endl;
+    testKdTreeReducedPrecision<KdTreeDense<TestPoint<double, 3>>, false>(quick, 1e4, 1);
+    testKdTreeReducedPrecision<KdTreeDense<TestPoint<double, 3>>, false>(quick, 1e3, 1e-6);
+
+    cout << "Test KdTree queries with reduced precision coordinates in 4D..." << endl;
+    testKdTreeReducedPrecision<KdTreeDense<TestPoint<long double, 4>>, false>(quick, 0, 1);
+    testKdTreeReducedPrecision<KdTreeMorton<TestPoint<double, 4>>, true>(quick, 1, 1e-3);
+
+    cout << "Test KdTree reduced precision fallback..." << endl;
+    testKdTreeReducedPrecisionOverflow<TestPoint<double, 3>>();
+}
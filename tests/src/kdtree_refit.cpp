@@ -0,0 +1,194 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+using namespace Ponca;
+
+template<typename KdTreeType, typename VectorContainer>
+void checkQueries(const KdTreeType& kdtree, const VectorContainer& points, const std::vector<int>& sampling, int k)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = int(points.size());
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+    {
+        const VectorType point = VectorType::Random();
+        const Scalar r = Eigen::internal::random<Scalar>(0., 0.5);
+
+        std::vector<int> results;
+        for (int j : kdtree.range_neighbors(point, r))
+            results.push_back(j);
+        VERIFY((check_range_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, r, results)));
+
+        results.clear();
+        for (int j : kdtree.k_nearest_neighbors(point, k))
+            results.push_back(j);
+        VERIFY((check_k_nearest_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, k, results)));
+    }
+}
+
+template<typename KdTreeType, bool SampleKdTree>
+void testKdTreeRefit(bool quick = true)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 100 : 3000;
+    const int k = quick ? 5 : 10;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+
+    // Small motions: split values are updated, the structure is kept
+    const auto nodeCount = kdtree.node_count();
+    for (int frame = 0; frame < 5; ++frame)
+    {
+        for (auto& p : kdtree.points())
+            p.pos() += Scalar(1e-4) * VectorType::Random();
+        kdtree.refit();
+        VERIFY(kdtree.valid());
+        checkQueries(kdtree, kdtree.points(), sampling, k);
+    }
+    VERIFY(kdtree.node_count() >= nodeCount);
+
+    // Large motions: points cross the split planes and subtrees are rebuilt
+    typename KdTreeType::NodeIndexType rebuildCount = 0;
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        for (auto& p : kdtree.points())
+            p.pos() = (p.pos() + Scalar(0.2) * VectorType::Random()).cwiseMax(Scalar(-1)).cwiseMin(Scalar(1));
+        rebuildCount += kdtree.refit();
+        VERIFY(kdtree.valid());
+        // Unused nodes are discarded when they outnumber the used ones
+        VERIFY(kdtree.node_count() <= 2 * (2 * kdtree.leaf_count() - 1));
+        checkQueries(kdtree, kdtree.points(), sampling, k);
+    }
+    VERIFY(rebuildCount > 0);
+
+    // Refit of a static cloud does not change the tree
+    const auto nodeCountStatic = kdtree.node_count();
+    VERIFY(kdtree.refit() == 0);
+    VERIFY(kdtree.node_count() == nodeCountStatic);
+}
+
+template<typename KdTreeType, bool SampleKdTree>
+void testKdTreeInsert(bool quick = true)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 100 : 1000;
+    const int k = quick ? 5 : 10;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+
+    // Batches of various sizes, the last ones being concentrated in a corner to split leaves repeatedly
+    for (int batch : {1, 7, N / 4, N, N / 2})
+    {
+        auto added = VectorContainer(batch);
+        const bool corner = batch == N / 2;
+        std::generate(added.begin(), added.end(), [corner]() {
+            return DataPoint(corner ? VectorType(VectorType::Random() * 0.05 + VectorType::Ones() * 0.5)
+                                    : VectorType(VectorType::Random())); });
+
+        const int first = kdtree.insert(added.begin(), added.end());
+        VERIFY(first == int(points.size()));
+        for (int i = 0; i < batch; ++i)
+        {
+            points.push_back(added[i]);
+            sampling.push_back(first + i);
+        }
+        VERIFY(kdtree.point_count() == int(points.size()));
+        VERIFY(kdtree.sample_count() == int(sampling.size()));
+        VERIFY(kdtree.valid());
+        for (int l = 0; l < kdtree.node_count(); ++l)
+            VERIFY(!kdtree.nodes()[l].is_leaf() || kdtree.nodes()[l].leaf_size() <= kdtree.min_cell_size());
+        checkQueries(kdtree, points, sampling, k);
+    }
+
+    // Insertion in an empty tree builds it
+    KdTreeType empty;
+    const int first = empty.insert(points.begin(), points.begin() + N);
+    VERIFY(first == 0);
+    VERIFY(empty.valid());
+    std::vector<int> all(N);
+    std::iota(all.begin(), all.end(), 0);
+    checkQueries(empty, VectorContainer(points.begin(), points.begin() + N), all, k);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KdTree refit in 3D..." << endl;
+    testKdTreeRefit<KdTreeDense<TestPoint<float, 3>>, false>(quick);
+    testKdTreeRefit<KdTreeDense<TestPoint<double, 3>>, false>(quick);
+    testKdTreeRefit<KdTreeSparse<TestPoint<double, 3>>, false>(quick);
+    testKdTreeRefit<KdTreeMorton<TestPoint<double, 3>>, true>(quick);
+
+    cout << "Test KdTree refit in 4D..." << endl;
+    testKdTreeRefit<KdTreeDense<TestPoint<long double, 4>>, false>(quick);
+    testKdTreeRefit<KdTreeMorton<TestPoint<float, 4>>, true>(quick);
+
+    cout << "Test KdTree insertion..." << endl;
+    testKdTreeInsert<KdTreeDense<TestPoint<float, 3>>, false>(quick);
+    testKdTreeInsert<KdTreeSparse<TestPoint<double, 3>>, true>(quick);
+    testKdTreeInsert<KdTreeMorton<TestPoint<double, 3>>, false>(quick);
+    testKdTreeInsert<KdTreeDense<TestPoint<long double, 4>>, false>(quick);
+}
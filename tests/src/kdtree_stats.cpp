@@ -0,0 +1,145 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+#include <sstream>
+
+using namespace Ponca;
+
+template<typename KdTreeType>
+void checkStats(const KdTreeType& kdtree)
+{
+    using Scalar = typename KdTreeType::Scalar;
+    using NodeIndexType = typename KdTreeType::NodeIndexType;
+
+    const auto stats = kdtree.stats();
+
+    VERIFY(stats.point_bytes == kdtree.points().size() * sizeof(typename KdTreeType::DataPoint));
+    VERIFY(stats.index_bytes == kdtree.samples().size() * sizeof(typename KdTreeType::IndexType));
+    VERIFY(stats.node_bytes >= kdtree.node_count() * sizeof(typename KdTreeType::NodeType));
+    VERIFY(stats.total_bytes() >= stats.point_bytes + stats.node_bytes + stats.index_bytes);
+    VERIFY(stats.node_count == kdtree.node_count());
+    VERIFY(stats.node_capacity >= stats.node_count);
+    VERIFY(stats.reachable_node_count <= stats.node_count);
+    VERIFY(stats.leaf_count == kdtree.leaf_count());
+    // Full binary tree
+    VERIFY(stats.reachable_node_count == 2 * stats.leaf_count - 1);
+
+    NodeIndexType depthSum = 0, sizeSum = 0;
+    for (auto c : stats.depth_histogram) depthSum += c;
+    for (auto c : stats.leaf_size_histogram) sizeSum += c;
+    VERIFY(depthSum == stats.leaf_count);
+    VERIFY(sizeSum == stats.leaf_count);
+    VERIFY(stats.leaf_size_histogram.empty() || stats.leaf_size_histogram[0] == stats.empty_leaf_count);
+    VERIFY(stats.depth_histogram.size() <= std::size_t(KdTreeType::MAX_DEPTH));
+
+    // Leaves hold at most m_min_cell_size samples, unless they could not be split
+    const std::size_t maxBin = stats.leaf_size_histogram.size() - 1;
+    if (stats.degenerate_leaf_count == 0)
+        VERIFY((std::size_t(1) << (maxBin - 1)) <= std::size_t(kdtree.min_cell_size()));
+
+    VERIFY(std::abs(stats.average_leaf_size * Scalar(stats.leaf_count) - Scalar(kdtree.sample_count())) < Scalar(1e-3) * Scalar(kdtree.sample_count()));
+    VERIFY(stats.traversal_cost >= stats.average_leaf_depth);
+
+    std::ostringstream os;
+    os << stats;
+    VERIFY(os.str().find("LeafSizeHistogram") != std::string::npos);
+}
+
+template<typename KdTreeType, bool SampleKdTree>
+void testKdTreeStats(bool quick, bool duplicates)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 200 : 10000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), [duplicates]() {
+        VectorType p = VectorType::Random();
+        // snap points on a coarse grid to generate leaves that cannot be split
+        if (duplicates) p = p.array().round();
+        return DataPoint(p);
+    });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 4);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 4, std::mt19937(0));
+    }
+
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(duplicates ? 2 : 8);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+    checkStats(kdtree);
+
+    const auto stats = kdtree.stats();
+    VERIFY(stats.reachable_node_count == kdtree.node_count());
+    VERIFY(stats.reduced_bytes == 0);
+    if (duplicates)
+        VERIFY(stats.degenerate_leaf_count > 0);
+
+    // Larger leaves give shallower trees
+    kdtree.set_min_cell_size(32);
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+    checkStats(kdtree);
+    VERIFY(kdtree.stats().average_leaf_depth <= stats.average_leaf_depth);
+
+    kdtree.set_reduced_precision(true);
+    VERIFY(kdtree.stats().reduced_bytes == kdtree.sample_count() * sizeof(typename KdTreeType::ReducedVectorType));
+
+    // Nodes of rebuilt subtrees are not reachable anymore
+    for (auto& p : kdtree.points())
+        p.pos() = VectorType::Random();
+    kdtree.refit();
+    checkStats(kdtree);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KdTree statistics..." << endl;
+    testKdTreeStats<KdTreeDense<TestPoint<float, 3>>, false>(quick, false);
+    testKdTreeStats<KdTreeSparse<TestPoint<double, 3>>, true>(quick, false);
+    testKdTreeStats<KdTreeMorton<TestPoint<double, 3>>, true>(quick, false);
+    testKdTreeStats<KdTreeDense<TestPoint<double, 4>>, false>(quick, false);
+
+    cout << "Test KdTree statistics with duplicated points..." << endl;
+    testKdTreeStats<KdTreeDense<TestPoint<double, 3>>, false>(quick, true);
+    testKdTreeStats<KdTreeMorton<TestPoint<float, 3>>, true>(quick, true);
+
+    cout << "Print KdTree statistics..." << endl;
+    auto points = std::vector<TestPoint<double, 3>>(1000);
+    std::generate(points.begin(), points.end(), []() {return TestPoint<double, 3>(Eigen::Vector3d::Random()); });
+    KdTreeDense<TestPoint<double, 3>> kdtree(points);
+    cout << kdtree.stats() << endl;
+}
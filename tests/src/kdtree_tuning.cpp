@@ -0,0 +1,116 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTreeMorton.h>
+
+using namespace Ponca;
+
+template<typename KdTreeType, bool SampleKdTree>
+void testKdTreeTuning(bool quick)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+    using LeafSizeType = typename KdTreeType::LeafSizeType;
+
+    const int N = quick ? 200 : 5000;
+    const int k = quick ? 5 : 10;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    KdTreeType kdtree;
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+        kdtree.build(points);
+
+    // Rebuild with another cell size, without converting the points again
+    const auto leafCount = kdtree.leaf_count();
+    kdtree.set_min_cell_size(4);
+    kdtree.rebuild();
+    VERIFY(kdtree.valid());
+    VERIFY(kdtree.leaf_count() > leafCount);
+    VERIFY(kdtree.sample_count() == int(sampling.size()));
+
+    // Representative queries: k-nearest neighbors of a subset of the samples
+    const int queryCount = std::min(100, kdtree.sample_count());
+    int callCount = 0;
+    const std::vector<LeafSizeType> candidates {2, 8, 32, 128};
+    const auto timings = kdtree.tune_min_cell_size(candidates, [&](const auto& tree) {
+        ++callCount;
+        int sum = 0;
+        for (int i = 0; i < queryCount; ++i)
+            for (int j : tree.k_nearest_neighbors(tree.pointFromSample(i), k))
+                sum += j;
+        VERIFY(sum >= 0);
+    }, 2);
+
+    VERIFY(callCount == int(candidates.size()) * 2);
+    VERIFY(timings.size() == candidates.size());
+    auto best = timings.front();
+    for (std::size_t c = 0; c < timings.size(); ++c)
+    {
+        VERIFY(timings[c].first == candidates[c]);
+        VERIFY(timings[c].second >= 0);
+        if (timings[c].second < best.second) best = timings[c];
+    }
+    VERIFY(kdtree.min_cell_size() == best.first);
+    VERIFY(kdtree.valid());
+
+    // The tuned tree gives exact results
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+    {
+        const VectorType point = VectorType::Random();
+        const Scalar r = Eigen::internal::random<Scalar>(0., 0.5);
+
+        std::vector<int> results;
+        for (int j : kdtree.range_neighbors(point, r))
+            results.push_back(j);
+        VERIFY((check_range_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, r, results)));
+
+        results.clear();
+        for (int j : kdtree.k_nearest_neighbors(point, k))
+            results.push_back(j);
+        VERIFY((check_k_nearest_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, k, results)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KdTree leaf size tuning..." << endl;
+    testKdTreeTuning<KdTreeDense<TestPoint<float, 3>>, false>(quick);
+    testKdTreeTuning<KdTreeSparse<TestPoint<double, 3>>, true>(quick);
+    testKdTreeTuning<KdTreeMorton<TestPoint<double, 3>>, true>(quick);
+    testKdTreeTuning<KdTreeDense<TestPoint<double, 4>>, false>(quick);
+}
@@ -0,0 +1,162 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraphCompressed.h>
+
+using namespace Ponca;
+
+/// Compare the variable-byte encoding helpers with the encoded values
+void testVarint()
+{
+    std::vector<std::int32_t> values {0, 1, -1, 63, -64, 64, 8191, -8192, 8192, 1 << 20,
+                                      std::numeric_limits<std::int32_t>::max(),
+                                      std::numeric_limits<std::int32_t>::min()};
+    std::vector<std::uint8_t> data(values.size() * 5);
+    std::uint8_t* out = data.data();
+    for (std::int32_t v : values)
+    {
+        const std::uint32_t z = Ponca::internal::zigzag_encode(v);
+        VERIFY(Ponca::internal::zigzag_decode(z) == v);
+        std::uint8_t* next = Ponca::internal::varint_encode(z, out);
+        VERIFY(next - out == Ponca::internal::varint_size(z));
+        out = next;
+    }
+    VERIFY(Ponca::internal::varint_size(Ponca::internal::zigzag_encode(-64)) == 1);
+    VERIFY(Ponca::internal::varint_size(Ponca::internal::zigzag_encode(64)) == 2);
+
+    const std::uint8_t* in = data.data();
+    for (std::int32_t v : values)
+        VERIFY(Ponca::internal::zigzag_decode(Ponca::internal::varint_decode(in)) == v);
+    VERIFY(in == out);
+}
+
+/// Compare the compressed graph with KnnGraph, which must give the same queries
+template<typename DataPoint>
+void testKnnGraphCompressed(bool quick, int k, bool sampleKdTree, bool spatialOrder)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 500 : 10000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (sampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+    KdTreeSparse<DataPoint> kdtree(points, sampling);
+
+    KnnGraph<DataPoint> graph(kdtree, k);
+    KnnGraphCompressed<DataPoint> compressed(kdtree, k, spatialOrder);
+    VERIFY(compressed.k() == graph.k());
+    VERIFY(compressed.size() == graph.size());
+    VERIFY(compressed.point_count() == N);
+
+    // Same vertices, possibly in a different order
+    std::vector<int> vertexPoints;
+    for (int v = 0; v < compressed.size(); ++v)
+    {
+        VERIFY(compressed.vertexFromPoint(compressed.pointFromVertex(v)) == v);
+        vertexPoints.push_back(compressed.pointFromVertex(v));
+    }
+    std::sort(vertexPoints.begin(), vertexPoints.end());
+    VERIFY(vertexPoints == sampling || sampleKdTree);
+    for (int i = 0; i < N; ++i)
+        VERIFY((compressed.vertexFromPoint(i) >= 0) == (graph.vertexFromPoint(i) >= 0));
+    if (!spatialOrder)
+        for (int v = 0; v < compressed.size(); ++v)
+            VERIFY(compressed.pointFromVertex(v) == graph.pointFromVertex(v));
+
+    const Scalar r = Scalar(0.2);
+#pragma omp parallel for
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        const int i = graph.pointFromVertex(v);
+        std::vector<int> expected, neighbors;
+        for (int j : graph.k_nearest_neighbors(i))
+            expected.push_back(j);
+        for (int j : compressed.k_nearest_neighbors(i))
+            neighbors.push_back(j);
+        VERIFY(neighbors == expected);
+
+        // Decoding iterators also work with standard algorithms
+        auto query = compressed.k_nearest_neighbors(i);
+        VERIFY(std::distance(query.begin(), query.end()) == k);
+        VERIFY(std::vector<int>(query.begin(), query.end()) == expected);
+
+        expected.clear();
+        neighbors.clear();
+        for (int j : graph.range_neighbors(i, r))
+            expected.push_back(j);
+        for (int j : compressed.range_neighbors(i, r))
+            neighbors.push_back(j);
+        VERIFY(neighbors == expected);
+    }
+}
+
+/// Memory footprint of a large graph over spatially ordered vertices
+template<typename DataPoint>
+void testKnnGraphCompressedSize(bool quick)
+{
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 5000 : 100000;
+    const int k = 16;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+    KdTreeDense<DataPoint> kdtree(points);
+
+    KnnGraph<DataPoint> graph(kdtree, k);
+    KnnGraphCompressed<DataPoint> compressed(kdtree, k);
+    KnnGraphCompressed<DataPoint> unordered(kdtree, k, false);
+    VERIFY(graph.index_bytes() == std::size_t(N) * k * sizeof(int));
+    VERIFY(compressed.index_bytes() * 3 < graph.index_bytes() * 2);
+    VERIFY(compressed.index_bytes() < unordered.index_bytes());
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test variable-byte encoding..." << endl;
+    testVarint();
+
+    cout << "Test compressed KnnGraph queries..." << endl;
+    testKnnGraphCompressed<TestPoint<float, 3>>(quick, 8, false, true);
+    testKnnGraphCompressed<TestPoint<double, 3>>(quick, 8, false, false);
+    testKnnGraphCompressed<TestPoint<double, 3>>(quick, 12, true, true);
+    testKnnGraphCompressed<TestPoint<double, 3>>(quick, 12, true, false);
+    testKnnGraphCompressed<TestPoint<long double, 2>>(quick, 6, false, true);
+
+    cout << "Test compressed KnnGraph with large k..." << endl;
+    testKnnGraphCompressed<TestPoint<double, 3>>(true, 300, false, true);
+
+    cout << "Test compressed KnnGraph memory footprint..." << endl;
+    testKnnGraphCompressedSize<TestPoint<float, 3>>(quick);
+}
@@ -0,0 +1,145 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraphCsr.h>
+
+#include <set>
+
+using namespace Ponca;
+
+/// Check the structure of a CSR graph: symmetry, rows sorted by distance, stored distances
+template<typename GraphType, typename VectorContainer>
+void checkKnnGraphCsr(const GraphType& graph, const VectorContainer& points, bool storeDistances)
+{
+    using Scalar = typename GraphType::Scalar;
+
+    VERIFY(graph.has_distances() == storeDistances);
+    VERIFY(int(graph.offsets().size()) == graph.size() + 1);
+    VERIFY(graph.offsets().back() == graph.edge_count());
+
+#pragma omp parallel for
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        const int i = graph.pointFromVertex(v);
+        std::vector<int> neighbors(graph.neighbors(i).begin(), graph.neighbors(i).end());
+        VERIFY(int(neighbors.size()) == graph.degree(i));
+        VERIFY(!has_duplicate(neighbors));
+
+        Scalar previous = 0;
+        int previousIndex = -1;
+        for (std::size_t j = 0; j < neighbors.size(); ++j)
+        {
+            const int n = neighbors[j];
+            VERIFY(n != i);
+            VERIFY(graph.vertexFromPoint(n) >= 0);
+
+            // Undirected edges
+            const auto reverse = graph.neighbors(n);
+            VERIFY(std::find(reverse.begin(), reverse.end(), i) != reverse.end());
+
+            // Sorted by distance, then by index
+            const Scalar d = (points[i].pos() - points[n].pos()).squaredNorm();
+            VERIFY(d > previous || (d == previous && n > previousIndex));
+            previous = d;
+            previousIndex = n;
+
+            if (storeDistances)
+                VERIFY(*(graph.squared_distances(i).begin() + j) == d);
+        }
+    }
+}
+
+template<typename DataPoint>
+void testKnnGraphCsr(bool quick, bool sampleKdTree, bool storeDistances)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 200 : 3000;
+    const int k = quick ? 5 : 10;
+    const Scalar r = quick ? Scalar(0.3) : Scalar(0.15);
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (sampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+    KdTreeSparse<DataPoint> kdtree(points, sampling);
+
+    // Reference k-nearest neighbors of each point
+    std::vector<std::set<int>> knn(N);
+    for (int i : sampling)
+        for (int j : kdtree.k_nearest_neighbors(i, k))
+            knn[i].insert(j);
+
+    KnnGraphCsr<DataPoint> symmetric(kdtree, KnnGraphCsrMode::SymmetricKNearest, k, storeDistances);
+    KnnGraphCsr<DataPoint> mutual(kdtree, KnnGraphCsrMode::MutualKNearest, k, storeDistances);
+    KnnGraphCsr<DataPoint> radius(kdtree, r, storeDistances);
+
+    VERIFY(symmetric.size() == int(sampling.size()));
+    VERIFY(symmetric.mode() == KnnGraphCsrMode::SymmetricKNearest && symmetric.k() == k);
+    VERIFY(radius.mode() == KnnGraphCsrMode::Radius && radius.radius() == r);
+    checkKnnGraphCsr(symmetric, points, storeDistances);
+    checkKnnGraphCsr(mutual, points, storeDistances);
+    checkKnnGraphCsr(radius, points, storeDistances);
+
+#pragma omp parallel for
+    for (int s = 0; s < int(sampling.size()); ++s)
+    {
+        const int i = sampling[s];
+        std::set<int> expectedSymmetric, expectedMutual, expectedRadius;
+        for (int j : sampling)
+        {
+            if (j == i) continue;
+            const bool ij = knn[i].count(j) > 0, ji = knn[j].count(i) > 0;
+            if (ij || ji) expectedSymmetric.insert(j);
+            if (ij && ji) expectedMutual.insert(j);
+        }
+        for (int j : kdtree.range_neighbors(i, r))
+            expectedRadius.insert(j);
+
+        VERIFY(std::set<int>(symmetric.neighbors(i).begin(), symmetric.neighbors(i).end()) == expectedSymmetric);
+        VERIFY(std::set<int>(mutual.neighbors(i).begin(), mutual.neighbors(i).end()) == expectedMutual);
+        VERIFY(std::set<int>(radius.neighbors(i).begin(), radius.neighbors(i).end()) == expectedRadius);
+        VERIFY(symmetric.degree(i) >= k);
+        VERIFY(mutual.degree(i) <= k);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test CSR neighbor graphs..." << endl;
+    testKnnGraphCsr<TestPoint<float, 3>>(quick, false, false);
+    testKnnGraphCsr<TestPoint<double, 3>>(quick, false, true);
+    testKnnGraphCsr<TestPoint<long double, 2>>(quick, false, true);
+
+    cout << "Test CSR neighbor graphs from a sampled kd-tree..." << endl;
+    testKnnGraphCsr<TestPoint<double, 3>>(quick, true, true);
+    testKnnGraphCsr<TestPoint<float, 4>>(quick, true, false);
+}
@@ -0,0 +1,247 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+
+#include <functional>
+#include <queue>
+
+using namespace Ponca;
+
+/// Dijkstra's algorithm with a binary heap, along the rows of the graph, from several sources
+template<typename GraphType, typename VectorContainer>
+std::vector<double> referenceDistances(const GraphType& graph, const VectorContainer& points,
+                                       const std::vector<int>& sources)
+{
+    std::vector<double> distances(points.size(), std::numeric_limits<double>::infinity());
+    std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>> queue;
+    for (int i : sources)
+    {
+        distances[i] = 0;
+        queue.emplace(0., i);
+    }
+    while (!queue.empty())
+    {
+        const auto [d, i] = queue.top();
+        queue.pop();
+        if (d > distances[i]) continue;
+        for (int j : graph.k_nearest_neighbors(i))
+        {
+            const double dj = d + double((points[i].pos() - points[j].pos()).norm());
+            if (dj < distances[j])
+            {
+                distances[j] = dj;
+                queue.emplace(dj, j);
+            }
+        }
+    }
+    return distances;
+}
+
+/// Extracted values are sorted, with pushes interleaved with pops as in Dijkstra's algorithm
+void testRadixHeap(bool quick)
+{
+    const int n = quick ? 1000 : 100000;
+    Ponca::internal::RadixHeap heap;
+    std::vector<double> pushed, popped;
+    double last = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const double d = last + Eigen::internal::random<double>(0., 1.);
+        heap.push(d, i);
+        pushed.push_back(d);
+        if (i % 3 == 2)
+        {
+            last = heap.pop().first;
+            popped.push_back(last);
+        }
+    }
+    heap.push(last, n); // equal to the last extracted key
+    pushed.push_back(last);
+    while (!heap.empty())
+        popped.push_back(heap.pop().first);
+    VERIFY(std::is_sorted(popped.begin(), popped.end()));
+    std::sort(pushed.begin(), pushed.end());
+    VERIFY(pushed == popped);
+    heap.clear();
+    VERIFY(heap.empty());
+}
+
+/// Compare the geodesic queries and distance fields with a reference implementation
+template<typename DataPoint>
+void testKnnGraphGeodesic(bool quick)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 300 : 3000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    KdTreeDense<DataPoint> kdtree(points);
+    KnnGraph<DataPoint> graph(kdtree, 8);
+
+    const Scalar r = Scalar(0.5);
+    const double epsilon = 1e-4;
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+    {
+        const std::vector<double> expected = referenceDistances(graph, points, {i});
+        std::vector<int> result;
+        Scalar previous = 0;
+        auto query = graph.geodesic_neighbors(i, r);
+        for (auto it = query.begin(); it != query.end(); ++it)
+        {
+            const int j = *it;
+            VERIFY(j != i);
+            VERIFY(std::abs(double(it.distance()) - expected[j]) < epsilon);
+            VERIFY(previous <= it.distance());
+            previous = it.distance();
+            result.push_back(j);
+        }
+        VERIFY(!has_duplicate(result));
+        int count = 0;
+        for (int j = 0; j < N; ++j)
+            if (j != i && expected[j] < double(r) - epsilon) ++count;
+        VERIFY(int(result.size()) >= count);
+        for (int j : result)
+            VERIFY(expected[j] < double(r) + epsilon);
+    }
+
+    // Nested queries and explicit contexts
+    KnnGraphGeodesicContext context;
+    for (int i = 0; i < N; i += 31)
+    {
+        std::vector<int> outer, inner, explicitContext;
+        for (int j : graph.geodesic_neighbors(i, r))
+        {
+            outer.push_back(j);
+            for (int l : graph.geodesic_neighbors(j, r / 2)) { (void)l; }
+        }
+        for (int j : graph.geodesic_neighbors(i, r))
+            inner.push_back(j);
+        for (int j : graph.geodesic_neighbors(i, r, context))
+            explicitContext.push_back(j);
+        VERIFY(outer == inner);
+        VERIFY(outer == explicitContext);
+    }
+    VERIFY(!context.busy());
+    VERIFY(context.capacity() == std::size_t(N));
+    context.clear();
+    VERIFY(context.capacity() == 0);
+
+    // Contexts are only held during the iterations
+    {
+        auto query = graph.geodesic_neighbors(0, r, context);
+        VERIFY(!context.busy());
+        auto it = query.begin();
+        VERIFY(context.busy());
+        for (; it != query.end(); ++it) {}
+        VERIFY(!context.busy());
+    }
+    KnnGraphGeodesicContext* threadContext = &KnnGraphGeodesicContext::thread_context();
+    std::vector<typename KnnGraph<DataPoint>::GeodesicIndexQuery> queries;
+    for (int i = 0; i < N; i += 31)
+        queries.push_back(graph.geodesic_neighbors(i, r));
+    VERIFY(&KnnGraphGeodesicContext::thread_context() == threadContext);
+
+    // Distance fields from several sources
+    const std::vector<int> sources {0, N / 3, N / 2};
+    const std::vector<double> expected = referenceDistances(graph, points, sources);
+    const std::vector<Scalar> distances = graph.geodesic_distances(sources);
+    const std::vector<Scalar> bounded = graph.geodesic_distances(sources, r);
+    VERIFY(int(distances.size()) == N);
+    for (int j = 0; j < N; ++j)
+    {
+        if (std::isinf(expected[j]))
+        {
+            VERIFY(std::isinf(double(distances[j])));
+            continue;
+        }
+        VERIFY(std::abs(double(distances[j]) - expected[j]) < epsilon);
+        if (expected[j] < double(r) - epsilon) VERIFY(std::abs(double(bounded[j]) - expected[j]) < epsilon);
+        if (expected[j] > double(r) + epsilon) VERIFY(std::isinf(double(bounded[j])));
+    }
+}
+
+/// Geodesic neighborhoods stay on a thin structure, while Euclidean balls leak across the gap
+template<typename DataPoint>
+void testKnnGraphGeodesicCables(bool quick)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    // Two parallel cables, closer to each other than the query radius, but further than the k-th neighbors
+    const int n = quick ? 200 : 2000;
+    const Scalar spacing = Scalar(1) / Scalar(n), gap = 10 * spacing;
+    VectorContainer points;
+    for (int c = 0; c < 2; ++c)
+        for (int i = 0; i < n; ++i)
+        {
+            VectorType p = VectorType::Zero();
+            p[0] = Scalar(i) * spacing;
+            p[1] = Scalar(c) * gap;
+            points.push_back(DataPoint(p));
+        }
+
+    KdTreeDense<DataPoint> kdtree(points);
+    KnnGraph<DataPoint> graph(kdtree, 4);
+
+    const int source = n / 2;
+    const Scalar r = Scalar(0.25);
+    int count = 0;
+    auto query = graph.geodesic_neighbors(source, r);
+    for (auto it = query.begin(); it != query.end(); ++it)
+    {
+        VERIFY(*it < n);
+        VERIFY(std::abs(it.distance() - std::abs(points[*it].pos()[0] - points[source].pos()[0])) < Scalar(1e-4));
+        ++count;
+    }
+    VERIFY(count >= int(2 * r / spacing) - 3);
+
+    bool leak = false;
+    for (int j : kdtree.range_neighbors(source, r))
+        leak = leak || j >= n;
+    VERIFY(leak);
+
+    const std::vector<Scalar> distances = graph.geodesic_distances({0});
+    for (int j = 0; j < 2 * n; ++j)
+        VERIFY(j < n ? std::abs(distances[j] - points[j].pos()[0]) < Scalar(1e-3) : std::isinf(double(distances[j])));
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test radix heap..." << endl;
+    testRadixHeap(quick);
+
+    cout << "Test KnnGraph geodesic queries and distance fields..." << endl;
+    testKnnGraphGeodesic<TestPoint<float, 3>>(quick);
+    testKnnGraphGeodesic<TestPoint<double, 3>>(quick);
+    testKnnGraphGeodesic<TestPoint<long double, 2>>(quick);
+
+    cout << "Test KnnGraph geodesic queries on thin structures..." << endl;
+    testKnnGraphGeodesicCables<TestPoint<float, 3>>(quick);
+    testKnnGraphGeodesicCables<TestPoint<double, 2>>(quick);
+}
@@ -0,0 +1,167 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/Fitting/weightKernel.h>
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+
+using namespace Ponca;
+
+/// Compare the operator with a direct evaluation of the weighted averages
+template<typename DataPoint, typename WeightFunctor>
+void testKnnGraphLaplacian(bool quick, bool sampleKdTree, WeightFunctor weight)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+    using Laplacian = KnnGraphLaplacian<KnnGraphDefaultTraits<DataPoint>>;
+    using AttributeMatrix = typename Laplacian::AttributeMatrix;
+
+    const int N = quick ? 500 : 5000;
+    const int k = 8;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (sampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+    KdTreeSparse<DataPoint> kdtree(points, sampling);
+    KnnGraph<DataPoint> graph(kdtree, k);
+    const int n = graph.size();
+    const Scalar epsilon = Scalar(1e-4);
+
+    for (bool symmetric : {false, true})
+    {
+        const Laplacian laplacian = graph.laplacian(weight, symmetric);
+        VERIFY(laplacian.size() == n);
+        VERIFY(symmetric ? laplacian.edge_count() >= n * k : laplacian.edge_count() == n * k);
+
+        // Rows are sorted, without duplicate, and contain the neighbors of the vertex (and the reversed edges)
+        std::vector<std::vector<int>> expected(n);
+        for (int v = 0; v < n; ++v)
+            for (int j : graph.k_nearest_neighbors(graph.pointFromVertex(v)))
+            {
+                const int u = graph.vertexFromPoint(j);
+                expected[v].push_back(u);
+                if (symmetric) expected[u].push_back(v);
+            }
+        for (int v = 0; v < n; ++v)
+        {
+            std::sort(expected[v].begin(), expected[v].end());
+            expected[v].erase(std::unique(expected[v].begin(), expected[v].end()), expected[v].end());
+            const std::vector<int> row(laplacian.columns().begin() + laplacian.offsets()[v],
+                                       laplacian.columns().begin() + laplacian.offsets()[v + 1]);
+            VERIFY(row == expected[v]);
+        }
+
+        // Products with random attributes
+        const AttributeMatrix x = AttributeMatrix::Random(n, 3);
+        AttributeMatrix smoothed, delta;
+        laplacian.smooth(x, smoothed);
+        laplacian.laplacian(x, delta);
+        VERIFY(smoothed.rows() == n && smoothed.cols() == 3);
+        for (int v = 0; v < n; ++v)
+        {
+            const VectorType p = points[graph.pointFromVertex(v)].pos();
+            Eigen::Matrix<Scalar, 1, 3> sum = Eigen::Matrix<Scalar, 1, 3>::Zero();
+            Scalar total = 0;
+            for (int u : expected[v])
+            {
+                const Scalar w = weight((p - points[graph.pointFromVertex(u)].pos()).squaredNorm());
+                sum += w * x.row(u);
+                total += w;
+            }
+            const Eigen::Matrix<Scalar, 1, 3> average = total > Scalar(0) ? Eigen::Matrix<Scalar, 1, 3>(sum / total)
+                                                                            : Eigen::Matrix<Scalar, 1, 3>(x.row(v));
+            VERIFY((smoothed.row(v) - average).norm() < epsilon);
+            VERIFY((delta.row(v) - (x.row(v) - average)).norm() < epsilon);
+        }
+
+        // Constants are preserved, and their Laplacian is zero
+        AttributeMatrix constant = AttributeMatrix::Constant(n, 2, Scalar(3));
+        laplacian.laplacian(constant, delta);
+        VERIFY(delta.cwiseAbs().maxCoeff() < epsilon);
+        Laplacian diffusion = laplacian;
+        diffusion.diffuse(constant, 10, Scalar(0.7));
+        VERIFY((constant.array() - Scalar(3)).abs().maxCoeff() < epsilon);
+
+        // Diffusion steps are successive weighted averages
+        AttributeMatrix diffused = x, reference = x, buffer;
+        diffusion.diffuse(diffused, 3, Scalar(0.5));
+        for (int i = 0; i < 3; ++i)
+        {
+            laplacian.smooth(reference, buffer);
+            reference = Scalar(0.5) * reference + Scalar(0.5) * buffer;
+        }
+        VERIFY((diffused - reference).cwiseAbs().maxCoeff() < epsilon);
+    }
+}
+
+/// Diffusion removes the noise of a smooth signal
+template<typename DataPoint>
+void testKnnGraphDenoising(bool quick)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+    using Laplacian = KnnGraphLaplacian<KnnGraphDefaultTraits<DataPoint>>;
+    using AttributeMatrix = typename Laplacian::AttributeMatrix;
+
+    const int N = quick ? 2000 : 20000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+    KdTreeDense<DataPoint> kdtree(points);
+    KnnGraph<DataPoint> graph(kdtree, 10);
+    Laplacian laplacian = graph.laplacian(KnnGraphGaussianWeight<Scalar>{Scalar(0.1)});
+
+    AttributeMatrix signal(N, 1), noisy(N, 1);
+    for (int i = 0; i < N; ++i)
+    {
+        signal(i, 0) = points[i].pos()[0];
+        noisy(i, 0) = signal(i, 0) + Eigen::internal::random<Scalar>(Scalar(-0.2), Scalar(0.2));
+    }
+    const Scalar error = (noisy - signal).norm();
+    laplacian.diffuse(noisy, 5);
+    VERIFY((noisy - signal).norm() < error / 2);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KnnGraph Laplacian with Gaussian weights..." << endl;
+    testKnnGraphLaplacian<TestPoint<float, 3>>(quick, false, KnnGraphGaussianWeight<float>{0.2f});
+    testKnnGraphLaplacian<TestPoint<double, 3>>(quick, true, KnnGraphGaussianWeight<double>{0.2});
+
+    cout << "Test KnnGraph Laplacian with weight kernels..." << endl;
+    testKnnGraphLaplacian<TestPoint<double, 3>>(quick, false,
+            KnnGraphKernelWeight<SmoothWeightKernel<double>>{0.15});
+    testKnnGraphLaplacian<TestPoint<long double, 2>>(quick, true,
+            KnnGraphKernelWeight<SmoothWeightKernel<long double>>{0.05});
+
+    cout << "Test KnnGraph diffusion..." << endl;
+    testKnnGraphDenoising<TestPoint<float, 3>>(quick);
+    testKnnGraphDenoising<TestPoint<double, 2>>(quick);
+}
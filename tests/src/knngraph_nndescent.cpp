@@ -0,0 +1,111 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+
+using namespace Ponca;
+
+/// Check that the rows contain k distinct vertices, other than the row vertex, sorted by increasing distance
+template<typename GraphType, typename VectorContainer>
+void checkRows(const GraphType& graph, const VectorContainer& points)
+{
+    using Scalar = typename GraphType::Scalar;
+#pragma omp parallel for
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        const int i = graph.pointFromVertex(v);
+        std::vector<int> neighbors;
+        Scalar previous = 0;
+        for (int j : graph.k_nearest_neighbors(i))
+        {
+            VERIFY(j != i);
+            VERIFY(graph.vertexFromPoint(j) >= 0);
+            const Scalar d = (points[i].pos() - points[j].pos()).squaredNorm();
+            VERIFY(previous <= d);
+            previous = d;
+            neighbors.push_back(j);
+        }
+        VERIFY(int(neighbors.size()) == graph.k());
+        VERIFY(!has_duplicate(neighbors));
+    }
+}
+
+/// Build graphs from the kd-tree leaves and by NN-Descent, and compare them with the exact graph
+template<typename DataPoint>
+void testKnnGraphNNDescent(bool quick, int k, bool sampleKdTree, double minRecall)
+{
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 2000 : 20000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (sampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+    KdTreeSparse<DataPoint> kdtree(points, sampling);
+
+    KnnGraph<DataPoint> exact(kdtree, k);
+    KnnGraph<DataPoint> graph(kdtree, k, KnnGraphNNDescentParameters());
+    VERIFY(graph.k() == exact.k());
+    VERIFY(graph.size() == exact.size());
+    for (int v = 0; v < exact.size(); ++v)
+        VERIFY(graph.pointFromVertex(v) == exact.pointFromVertex(v));
+    checkRows(graph, points);
+    VERIFY(exact.recall(exact) == 1.);
+    VERIFY(graph.recall(exact) == 1.);
+
+    // With a partial search of the leaves, the local joins improve the rows
+    KnnGraphNNDescentParameters parameters;
+    parameters.reach = 0.5f;
+    parameters.max_iterations = 0;
+    KnnGraph<DataPoint> initial(kdtree, k, parameters);
+    parameters.max_iterations = 10;
+    KnnGraph<DataPoint> refined(kdtree, k, parameters);
+    checkRows(initial, points);
+    checkRows(refined, points);
+
+    const double initialRecall = initial.recall(exact);
+    const double recall = refined.recall(exact);
+    cout << "  k=" << k << ", " << exact.size() << " vertices: recall " << initialRecall << " from the kd-tree leaves, "
+         << recall << " after the local joins" << endl;
+    VERIFY(initialRecall < 1.);
+    VERIFY(initialRecall < recall);
+    VERIFY(recall >= minRecall);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KnnGraph construction from the kd-tree leaves and by NN-Descent..." << endl;
+    // The minimum recalls require the reverse neighbors in the local joins
+    testKnnGraphNNDescent<TestPoint<float, 3>>(quick, 10, false, 0.999);
+    testKnnGraphNNDescent<TestPoint<double, 3>>(quick, 16, true, 0.999);
+    testKnnGraphNNDescent<TestPoint<long double, 2>>(quick, 6, false, 0.998);
+    testKnnGraphNNDescent<TestPoint<double, 3>>(quick, 40, false, 0.999);
+}
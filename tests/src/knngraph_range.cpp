@@ -0,0 +1,156 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+
+#include <set>
+
+using namespace Ponca;
+
+/// Region growing in the graph, with the same traversal order as KnnGraphRangeQuery
+template<typename GraphType, typename VectorContainer>
+std::vector<int> referenceRangeNeighbors(const GraphType& graph, const VectorContainer& points, int index,
+                                         typename GraphType::Scalar r)
+{
+    std::vector<int> result;
+    std::set<int> visited {index};
+    std::vector<int> stack {index};
+    while (!stack.empty())
+    {
+        const int current = stack.back();
+        stack.pop_back();
+        if (current != index) result.push_back(current);
+        for (int j : graph.k_nearest_neighbors(current))
+            if ((points[index].pos() - points[j].pos()).squaredNorm() < r * r && visited.insert(j).second)
+                stack.push_back(j);
+    }
+    return result;
+}
+
+template<typename Query>
+std::vector<int> collect(Query&& query)
+{
+    std::vector<int> result;
+    for (int j : query)
+        result.push_back(j);
+    return result;
+}
+
+/// Compare the KnnGraph range queries with a reference traversal, with default, nested and explicit contexts
+template<typename DataPoint>
+void testKnnGraphRange(bool quick)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 300 : 3000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    KdTreeDense<DataPoint> kdtree(points);
+    KnnGraph<DataPoint> graph(kdtree, 12);
+
+    const Scalar r = Scalar(0.3);
+    std::vector<std::vector<int>> expected(N);
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+    {
+        expected[i] = referenceRangeNeighbors(graph, points, i, r);
+        // Consecutive queries reuse the context of the thread
+        VERIFY(collect(graph.range_neighbors(i, r)) == expected[i]);
+        VERIFY(collect(graph.range_neighbors(i, r)) == expected[i]);
+    }
+
+    // Nested queries use different contexts
+#pragma omp parallel for
+    for (int i = 0; i < N; i += 17)
+    {
+        auto outer = graph.range_neighbors(i, r);
+        std::vector<int> neighbors;
+        for (int j : outer)
+        {
+            neighbors.push_back(j);
+            VERIFY(collect(graph.range_neighbors(j, r)) == expected[j]);
+        }
+        VERIFY(neighbors == expected[i]);
+
+        // A copy is traversed independently from the original query
+        auto copy = outer;
+        auto it = outer.begin();
+        VERIFY(collect(copy) == expected[i]);
+        std::vector<int> rest;
+        for (; it != outer.end(); ++it)
+            rest.push_back(*it);
+        VERIFY(rest == expected[i]);
+    }
+
+    // Explicit context, reused across graphs of different sizes and released
+    KnnGraphTraversalContext context;
+    for (int i = 0; i < N; i += 7)
+        VERIFY(collect(graph.range_neighbors(i, r, context)) == expected[i]);
+    VERIFY(!context.busy());
+    VERIFY(context.capacity() == std::size_t(N));
+
+    VectorContainer small(points.begin(), points.begin() + N / 2);
+    KdTreeDense<DataPoint> smallTree(small);
+    KnnGraph<DataPoint> smallGraph(smallTree, 12);
+    for (int i = 0; i < N / 2; i += 7)
+        VERIFY(collect(smallGraph.range_neighbors(i, r, context)) == referenceRangeNeighbors(smallGraph, small, i, r));
+    VERIFY(context.capacity() == std::size_t(N));
+
+    context.clear();
+    VERIFY(context.capacity() == 0);
+    VERIFY(collect(graph.range_neighbors(0, r, context)) == expected[0]);
+
+    // Contexts are only held during the iterations, or until the destruction of a query whose iteration is stopped
+    {
+        auto query = graph.range_neighbors(0, r, context);
+        VERIFY(!context.busy());
+        auto it = query.begin();
+        VERIFY(context.busy());
+        for (; it != query.end(); ++it) {}
+        VERIFY(!context.busy());
+        query.begin();
+        VERIFY(context.busy());
+    }
+    VERIFY(!context.busy());
+
+    // Queries that are not iterated do not take contexts from the pool of the thread
+    KnnGraphTraversalContext* threadContext = &KnnGraphTraversalContext::thread_context();
+    std::vector<typename KnnGraph<DataPoint>::RangeIndexQuery> queries;
+    for (int i = 0; i < N; i += 7)
+        queries.push_back(graph.range_neighbors(i, r));
+    VERIFY(&KnnGraphTraversalContext::thread_context() == threadContext);
+    for (std::size_t q = 0; q < queries.size(); ++q)
+        VERIFY(collect(queries[q]) == expected[q * 7]);
+    VERIFY(&KnnGraphTraversalContext::thread_context() == threadContext);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KnnGraph range queries with reusable traversal contexts..." << endl;
+    testKnnGraphRange<TestPoint<float, 3>>(quick);
+    testKnnGraphRange<TestPoint<double, 3>>(quick);
+    testKnnGraphRange<TestPoint<long double, 2>>(quick);
+}
@@ -0,0 +1,188 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/reordering.h>
+
+using namespace Ponca;
+
+/// Check that `order` is a permutation of [0, n)
+bool is_permutation(const std::vector<int>& order, int n)
+{
+    std::vector<int> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    for (int i = 0; i < int(sorted.size()); ++i)
+        if (sorted[i] != i) return false;
+    return int(sorted.size()) == n;
+}
+
+/// Consecutive cells of a coarse grid along the Hilbert curve are adjacent
+template<typename CodeType, int Dim>
+void testHilbertAdjacency(int levels)
+{
+    using Code = Ponca::internal::MortonCode<CodeType, Dim>;
+    const int side = 1 << levels;
+    int cellCount = 1;
+    for (int d = 0; d < Dim; ++d)
+        cellCount *= side;
+
+    // Lower corner of each cell, at the finest quantization level
+    std::vector<std::pair<CodeType, std::array<int, Dim>>> cells(cellCount);
+    for (int c = 0; c < cellCount; ++c)
+    {
+        std::array<int, Dim> cell;
+        std::array<CodeType, Dim> q;
+        for (int d = 0, rest = c; d < Dim; ++d, rest /= side)
+        {
+            cell[d] = rest % side;
+            q[d] = CodeType(cell[d]) << (Code::BITS_PER_DIM - levels);
+        }
+        cells[c] = {Ponca::internal::HilbertCode<CodeType, Dim>::encode(q), cell};
+    }
+    std::sort(cells.begin(), cells.end());
+    for (int c = 1; c < cellCount; ++c)
+    {
+        VERIFY(cells[c].first != cells[c - 1].first);
+        int manhattan = 0;
+        for (int d = 0; d < Dim; ++d)
+            manhattan += std::abs(cells[c].second[d] - cells[c - 1].second[d]);
+        VERIFY(manhattan == 1);
+    }
+}
+
+/// Average difference of indices between a vertex and its neighbors
+template<typename GraphType>
+double average_index_gap(const GraphType& graph)
+{
+    double gap = 0;
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        const int i = graph.pointFromVertex(v);
+        for (int j : graph.k_nearest_neighbors(i))
+            gap += std::abs(i - j);
+    }
+    return gap / (double(graph.size()) * graph.k());
+}
+
+/// Reorder the points of a kd-tree and of a graph, and compare them with the structures built on the reordered points
+template<typename DataPoint>
+void testReordering(bool quick, bool sampleKdTree)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 500 : 5000;
+    const int k = 8;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (sampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        KdTreeSparse<DataPoint> kdtree(points, sampling);
+        KnnGraph<DataPoint> graph(kdtree, k);
+        const double gap = average_index_gap(graph);
+
+        std::vector<int> order;
+        if (c < 2)
+            order = reorder_spatially(kdtree, graph, c == 0 ? SpatialOrder::Morton : SpatialOrder::Hilbert);
+        else
+            order = reorder_by_graph(kdtree, graph, c == 2 ? GraphOrder::BreadthFirst : GraphOrder::ReverseCuthillMcKee);
+        VERIFY(is_permutation(order, N));
+        VERIFY(kdtree.valid());
+        VERIFY(kdtree.sample_count() == int(sampling.size()));
+
+        // Points are permuted, and the samples follow them
+        std::vector<int> newSampling;
+        std::vector<int> newIndex(N);
+        for (int i = 0; i < N; ++i)
+        {
+            VERIFY(kdtree.points()[i].pos() == points[order[i]].pos());
+            newIndex[order[i]] = i;
+        }
+        for (int s : sampling)
+            newSampling.push_back(newIndex[s]);
+        std::sort(newSampling.begin(), newSampling.end());
+        for (int v = 0; v < graph.size(); ++v)
+            VERIFY(graph.pointFromVertex(v) == newSampling[v]);
+        if (c >= 2)
+            for (int v = 0; v < graph.size(); ++v)
+                VERIFY(graph.pointFromVertex(v) == v);
+
+        // Queries give the same neighbors as before, with the new indices
+        const auto& reordered = kdtree.points();
+        const KnnGraph<DataPoint> rebuilt(kdtree, k);
+        const Scalar r = Scalar(0.2);
+#pragma omp parallel for
+        for (int s = 0; s < int(newSampling.size()); ++s)
+        {
+            const int i = newSampling[s];
+            std::vector<int> neighbors;
+            for (int j : kdtree.k_nearest_neighbors(i, k))
+                neighbors.push_back(j);
+            VERIFY(check_k_nearest_neighbors<Scalar>(reordered, newSampling, i, k, neighbors));
+
+            std::vector<int> row;
+            for (int j : graph.k_nearest_neighbors(i))
+                row.push_back(j);
+            std::sort(row.begin(), row.end());
+            std::sort(neighbors.begin(), neighbors.end());
+            VERIFY(row == neighbors);
+
+            std::vector<int> expected;
+            for (int j : rebuilt.range_neighbors(i, r))
+                expected.push_back(j);
+            std::vector<int> range;
+            for (int j : graph.range_neighbors(i, r))
+                range.push_back(j);
+            std::sort(expected.begin(), expected.end());
+            std::sort(range.begin(), range.end());
+            VERIFY(range == expected);
+        }
+
+        // Neighbors get closer indices
+        const double reorderedGap = average_index_gap(graph);
+        cout << "  order " << c << ": average index gap " << gap << " -> " << reorderedGap << endl;
+        VERIFY(reorderedGap < gap / 4);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test Hilbert curve adjacency..." << endl;
+    testHilbertAdjacency<std::uint64_t, 3>(quick ? 3 : 5);
+    testHilbertAdjacency<std::uint32_t, 3>(quick ? 3 : 5);
+    testHilbertAdjacency<std::uint64_t, 2>(quick ? 4 : 8);
+
+    cout << "Test points, kd-tree and KnnGraph reordering..." << endl;
+    testReordering<TestPoint<float, 3>>(quick, false);
+    testReordering<TestPoint<double, 3>>(quick, true);
+    testReordering<TestPoint<long double, 2>>(quick, false);
+}
@@ -0,0 +1,111 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+
+using namespace Ponca;
+
+/// Build a KnnGraph over the samples of a kd-tree, and compare it with the kd-tree queries
+template<typename DataPoint>
+void testKnnGraphSampling(bool quick, bool sampleKdTree)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 200 : 5000;
+    const int k = quick ? 5 : 10;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (sampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 3);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 3, std::mt19937(0));
+    }
+    KdTreeSparse<DataPoint> kdtree(points, sampling);
+
+    KnnGraph<DataPoint> graph(kdtree, k);
+    VERIFY(graph.size() == int(sampling.size()));
+    VERIFY(graph.point_count() == N);
+    VERIFY(graph.k() == k);
+
+    // Vertices are ordered by point index
+    std::vector<int> vertexPoints;
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        VERIFY(graph.vertexFromPoint(graph.pointFromVertex(v)) == v);
+        vertexPoints.push_back(graph.pointFromVertex(v));
+    }
+    VERIFY(std::is_sorted(vertexPoints.begin(), vertexPoints.end()));
+    VERIFY(vertexPoints == sampling || sampleKdTree);
+    for (int i = 0; i < N; ++i)
+    {
+        const bool isSample = std::find(sampling.begin(), sampling.end(), i) != sampling.end();
+        VERIFY((graph.vertexFromPoint(i) >= 0) == isSample);
+    }
+
+    // Neighbors are the samples given by the kd-tree
+#pragma omp parallel for
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        const int i = graph.pointFromVertex(v);
+        std::vector<int> expected, neighbors;
+        for (int j : kdtree.k_nearest_neighbors(i, k))
+            expected.push_back(j);
+        for (int j : graph.k_nearest_neighbors(i))
+        {
+            VERIFY(graph.vertexFromPoint(j) >= 0);
+            neighbors.push_back(j);
+        }
+        VERIFY(neighbors == expected);
+        VERIFY((check_k_nearest_neighbors<Scalar, VectorContainer>(points, sampling, i, k, neighbors)));
+    }
+
+    // Range queries only visit the vertices of the graph
+    KnnGraph<DataPoint> largeGraph(kdtree, int(sampling.size()) / 4);
+#pragma omp parallel for
+    for (int v = 0; v < largeGraph.size(); ++v)
+    {
+        const int i = largeGraph.pointFromVertex(v);
+        const Scalar r = Eigen::internal::random<Scalar>(0., 0.3);
+        std::vector<int> neighbors;
+        for (int j : largeGraph.range_neighbors(i, r))
+            neighbors.push_back(j);
+        VERIFY((check_range_neighbors<Scalar, VectorContainer>(points, sampling, i, r, neighbors)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KnnGraph from a sampled kd-tree..." << endl;
+    testKnnGraphSampling<TestPoint<float, 3>>(quick, true);
+    testKnnGraphSampling<TestPoint<double, 3>>(quick, true);
+    testKnnGraphSampling<TestPoint<long double, 4>>(quick, true);
+
+    cout << "Test KnnGraph from a kd-tree without sampling..." << endl;
+    testKnnGraphSampling<TestPoint<double, 3>>(quick, false);
+}
@@ -0,0 +1,240 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraphCsr.h>
+
+#include <cstdio>
+#include <fstream>
+
+using namespace Ponca;
+
+template<typename Query>
+std::vector<int> collect(Query&& query)
+{
+    std::vector<int> result;
+    for (int j : query)
+        result.push_back(j);
+    return result;
+}
+
+/// Overwrite the bytes of `value` at `offset` in the file `filename`
+template<typename T>
+void overwrite(const std::string& filename, std::size_t offset, T value)
+{
+    std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(std::streamoff(offset));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/// Offset of the first array of a graph file, after the header
+inline std::size_t firstArrayOffset()
+{
+    return Ponca::internal::knngraph_file_next(0, sizeof(Ponca::internal::KnnGraphFileHeader));
+}
+
+/// Compare the vertices, the rows and the range queries of two graphs
+template<typename GraphType>
+void checkSameGraph(const GraphType& graph, const GraphType& expected, typename GraphType::Scalar r)
+{
+    VERIFY(graph.k() == expected.k());
+    VERIFY(graph.size() == expected.size());
+    VERIFY(graph.point_count() == expected.point_count());
+    VERIFY(graph.index_bytes() == expected.index_bytes());
+    for (int i = 0; i < graph.point_count(); ++i)
+        VERIFY(graph.vertexFromPoint(i) == expected.vertexFromPoint(i));
+#pragma omp parallel for
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        const int i = expected.pointFromVertex(v);
+        VERIFY(graph.pointFromVertex(v) == i);
+        VERIFY(collect(graph.k_nearest_neighbors(i)) == collect(expected.k_nearest_neighbors(i)));
+        VERIFY(collect(graph.range_neighbors(i, r)) == collect(expected.range_neighbors(i, r)));
+    }
+}
+
+/// Save and load a KnnGraph, mapped in memory or read, and modify a loaded graph
+template<typename DataPoint>
+void testKnnGraphSerialization(bool quick, bool sampleKdTree)
+{
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 500 : 5000;
+    const std::string filename = "knngraph_serialization.bin";
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (sampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+    KdTreeSparse<DataPoint> kdtree(points, sampling);
+    KnnGraph<DataPoint> graph(kdtree, 8);
+    VERIFY(!graph.is_mapped());
+    VERIFY(graph.save(filename));
+
+    // The loaded graphs are bound to the container given at load time
+    const Scalar r = Scalar(0.2);
+    for (bool map : {true, false})
+    {
+        auto loaded = KnnGraph<DataPoint>::load(filename, kdtree.points(), map);
+        VERIFY(loaded.has_value());
+#if defined(__unix__) || defined(__APPLE__)
+        VERIFY(loaded->is_mapped() == map);
+#endif
+        checkSameGraph(*loaded, graph, r);
+
+        // Copies share the file, which stays valid after the destruction of the loaded graph
+        auto copy = std::make_unique<KnnGraph<DataPoint>>(*loaded);
+        loaded.reset();
+#if defined(__unix__) || defined(__APPLE__)
+        VERIFY(copy->is_mapped() == map);
+#endif
+        checkSameGraph(*copy, graph, r);
+    }
+
+    // Invalid files and containers
+    VERIFY(!KnnGraph<DataPoint>::load("missing_file.bin", kdtree.points()).has_value());
+    VERIFY(!KnnGraph<DataPoint>::load(filename, VectorContainer(points.begin(), points.begin() + N / 2)).has_value());
+    VERIFY(!KnnGraphCsr<DataPoint>::load(filename, kdtree.points()).has_value());
+    {
+        std::ifstream in(filename, std::ios::binary);
+        std::vector<char> content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), std::streamsize(content.size() / 2));
+        out.close();
+        VERIFY(!KnnGraph<DataPoint>::load(filename, kdtree.points()).has_value());
+
+        content[0] = 'X';
+        out.open(filename, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), std::streamsize(content.size()));
+        out.close();
+        VERIFY(!KnnGraph<DataPoint>::load(filename, kdtree.points()).has_value());
+    }
+
+    // Neighbors that are not indices of the points are rejected, unless the file is trusted
+    {
+        using IndexType = typename KnnGraph<DataPoint>::IndexType;
+        VERIFY(graph.save(filename));
+        overwrite(filename, firstArrayOffset() + sizeof(IndexType), IndexType(N));
+        VERIFY(!KnnGraph<DataPoint>::load(filename, kdtree.points()).has_value());
+        VERIFY(!KnnGraph<DataPoint>::load(filename, kdtree.points(), false).has_value());
+        VERIFY(KnnGraph<DataPoint>::load(filename, kdtree.points(), true, true).has_value());
+        overwrite(filename, firstArrayOffset() + sizeof(IndexType), IndexType(-1));
+        VERIFY(!KnnGraph<DataPoint>::load(filename, kdtree.points()).has_value());
+    }
+
+    // A mapped graph is copied before being updated
+    VERIFY(graph.save(filename));
+    auto loaded = KnnGraph<DataPoint>::load(filename, kdtree.points());
+    VERIFY(loaded.has_value());
+    auto added = VectorContainer(10);
+    std::generate(added.begin(), added.end(), []() {return DataPoint(VectorType::Random()); });
+    kdtree.insert(added.begin(), added.end());
+    loaded->insert(kdtree);
+    graph.insert(kdtree);
+    VERIFY(!loaded->is_mapped());
+    checkSameGraph(*loaded, graph, r);
+
+    // The file is not modified by the update, and can be bound to another container with the same number of points
+    auto reloaded = KnnGraph<DataPoint>::load(filename, VectorContainer(points.begin(), points.end()));
+    VERIFY(reloaded.has_value());
+    VERIFY(reloaded->size() == int(sampling.size()));
+    std::remove(filename.c_str());
+}
+
+/// Save and load a KnnGraphCsr, with and without distances
+template<typename DataPoint>
+void testKnnGraphCsrSerialization(bool quick)
+{
+    using VectorContainer = typename KdTree<DataPoint>::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 500 : 5000;
+    const std::string filename = "knngraph_csr_serialization.bin";
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> indices(N), sampling(N / 2);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    KdTreeSparse<DataPoint> kdtree(points, sampling);
+
+    for (int c = 0; c < 3; ++c)
+    {
+        const bool distances = c != 1;
+        KnnGraphCsr<DataPoint> graph = c == 2 ? KnnGraphCsr<DataPoint>(kdtree, typename DataPoint::Scalar(0.1), distances)
+                                              : KnnGraphCsr<DataPoint>(kdtree, KnnGraphCsrMode::MutualKNearest, 8,
+                                                                       distances);
+        VERIFY(graph.save(filename));
+        auto loaded = KnnGraphCsr<DataPoint>::load(filename, kdtree.points());
+        VERIFY(loaded.has_value());
+        VERIFY(loaded->mode() == graph.mode());
+        VERIFY(loaded->k() == graph.k());
+        VERIFY(loaded->radius() == graph.radius());
+        VERIFY(loaded->size() == graph.size());
+        VERIFY(loaded->has_distances() == distances);
+        VERIFY(loaded->offsets() == graph.offsets());
+        VERIFY(loaded->index_data() == graph.index_data());
+        VERIFY(loaded->squared_distance_data() == graph.squared_distance_data());
+        for (int i = 0; i < N; ++i)
+            VERIFY(loaded->vertexFromPoint(i) == graph.vertexFromPoint(i));
+        VERIFY(!KnnGraph<DataPoint>::load(filename, kdtree.points()).has_value());
+
+        // Offsets that are not consecutive rows, and neighbors that are not indices of the points, are rejected
+        using IndexType = typename KnnGraphCsr<DataPoint>::IndexType;
+        VERIFY(graph.edge_count() > 0);
+        const std::size_t offsetsBytes = std::size_t(graph.size() + 1) * sizeof(IndexType);
+        const std::size_t indicesOffset = Ponca::internal::knngraph_file_next(firstArrayOffset(), offsetsBytes);
+        overwrite(filename, firstArrayOffset() + sizeof(IndexType), IndexType(graph.edge_count() + 1));
+        VERIFY(!KnnGraphCsr<DataPoint>::load(filename, kdtree.points()).has_value());
+        VERIFY(graph.save(filename));
+        overwrite(filename, firstArrayOffset(), IndexType(1));
+        VERIFY(!KnnGraphCsr<DataPoint>::load(filename, kdtree.points()).has_value());
+        VERIFY(graph.save(filename));
+        overwrite(filename, indicesOffset, IndexType(N));
+        VERIFY(!KnnGraphCsr<DataPoint>::load(filename, kdtree.points()).has_value());
+        VERIFY(graph.save(filename));
+        VERIFY(KnnGraphCsr<DataPoint>::load(filename, kdtree.points()).has_value());
+    }
+    std::remove(filename.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KnnGraph binary save and load..." << endl;
+    testKnnGraphSerialization<TestPoint<float, 3>>(quick, false);
+    testKnnGraphSerialization<TestPoint<double, 3>>(quick, true);
+    testKnnGraphSerialization<TestPoint<long double, 2>>(quick, false);
+
+    cout << "Test KnnGraphCsr binary save and load..." << endl;
+    testKnnGraphCsrSerialization<TestPoint<float, 3>>(quick);
+    testKnnGraphCsrSerialization<TestPoint<double, 3>>(quick);
+}
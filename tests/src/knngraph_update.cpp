@@ -0,0 +1,138 @@
+/*
+ This Source Code Form is subject to the terms of the Mozilla Public
+ License, v. 2.0. If a copy of the MPL was not distributed with this
+ file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "../common/testing.h"
+#include "../common/testUtils.h"
+#include "../common/has_duplicate.h"
+#include "../common/kdtree_utils.h"
+
+#include <Ponca/src/SpatialPartitioning/KdTree/kdTree.h>
+#include <Ponca/src/SpatialPartitioning/KnnGraph/knnGraph.h>
+
+using namespace Ponca;
+
+/// Compare each row of the graph with the k-nearest neighbors given by the kd-tree
+template<typename GraphType, typename KdTreeType>
+void checkRows(const GraphType& graph, const KdTreeType& kdtree, const std::vector<int>& sampling)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+
+    VERIFY(graph.size() == kdtree.sample_count());
+    VERIFY(graph.point_count() == kdtree.point_count());
+#pragma omp parallel for
+    for (int v = 0; v < graph.size(); ++v)
+    {
+        const int i = graph.pointFromVertex(v);
+        std::vector<int> expected, neighbors;
+        for (int j : kdtree.k_nearest_neighbors(i, graph.k()))
+            expected.push_back(j);
+        for (int j : graph.k_nearest_neighbors(i))
+            neighbors.push_back(j);
+        VERIFY(neighbors == expected);
+        VERIFY((check_k_nearest_neighbors<Scalar, VectorContainer>(kdtree.points(), sampling, i, graph.k(), neighbors)));
+    }
+}
+
+/// Insert points in a graph, then move some of them, and compare the graph with the kd-tree queries
+template<typename KdTreeType, bool SampleKdTree>
+void testKnnGraphUpdate(bool quick)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 300 : 5000;
+    const int k = quick ? 6 : 10;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> sampling(N);
+    std::iota(sampling.begin(), sampling.end(), 0);
+    if (SampleKdTree)
+    {
+        std::vector<int> indices = sampling;
+        sampling.resize(N / 2);
+        std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+    }
+    KdTreeType kdtree;
+    kdtree.set_min_cell_size(8);
+    kdtree.buildWithSampling(points, sampling);
+    KnnGraph<DataPoint> graph(kdtree, k);
+
+    // Insertion of small batches only modifies the rows close to the new points
+    for (int batch : {1, 10, N / 20})
+    {
+        auto added = VectorContainer(batch);
+        std::generate(added.begin(), added.end(), []() {return DataPoint(VectorType::Random()); });
+        const int first = kdtree.insert(added.begin(), added.end());
+        for (int i = 0; i < batch; ++i)
+            sampling.push_back(first + i);
+
+        const int modified = graph.insert(kdtree);
+        VERIFY(batch == 1 || modified > 0);
+        VERIFY(modified < graph.size() - batch);
+        checkRows(graph, kdtree, sampling);
+    }
+
+    // Small motions of a few points are repaired locally
+    std::vector<int> moved;
+    for (int i = 0; i < graph.size(); i += 50)
+        moved.push_back(graph.pointFromVertex(i));
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        for (int i : moved)
+            kdtree.points()[i].pos() += Scalar(0.02) * VectorType::Random();
+        kdtree.refit();
+        const int modified = graph.update(kdtree, moved);
+        VERIFY(modified < graph.size());
+        checkRows(graph, kdtree, sampling);
+    }
+
+    // Moved points that are not vertices only change the kd-tree
+    if (SampleKdTree)
+    {
+        std::vector<int> others;
+        for (int i = 0; i < kdtree.point_count(); ++i)
+            if (graph.vertexFromPoint(i) < 0) others.push_back(i);
+        VERIFY(!others.empty());
+        for (int i : others)
+            kdtree.points()[i].pos() = VectorType::Random();
+        kdtree.refit();
+        VERIFY(graph.update(kdtree, others) == 0);
+        checkRows(graph, kdtree, sampling);
+    }
+
+    // Large motions rebuild all the rows
+    std::vector<int> all(kdtree.point_count());
+    std::iota(all.begin(), all.end(), 0);
+    for (auto& p : kdtree.points())
+        p.pos() += Scalar(0.1) * VectorType::Random();
+    kdtree.refit();
+    VERIFY(graph.update(kdtree, all) == graph.size());
+    checkRows(graph, kdtree, sampling);
+}
+
+int main(int argc, char** argv)
+{
+    if (!init_testing(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+#ifdef NDEBUG
+    bool quick = false;
+#else
+    bool quick = true;
+#endif
+
+    cout << "Test KnnGraph insertion and motion updates..." << endl;
+    testKnnGraphUpdate<KdTreeSparse<TestPoint<float, 3>>, false>(quick);
+    testKnnGraphUpdate<KdTreeSparse<TestPoint<double, 3>>, true>(quick);
+    testKnnGraphUpdate<KdTreeSparse<TestPoint<long double, 2>>, false>(quick);
+}
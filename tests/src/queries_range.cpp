@@ -132,6 +132,45 @@ void testKdTreeRangePoint(bool quick = true)
 	}
 }
 
+/// Generic code building a tree from a sampling when the tree type supports it
+template<typename KdTreeType>
+void testKdTreeSubsamplingSupport(bool quick = true)
+{
+    using DataPoint = typename KdTreeType::DataPoint;
+    using Scalar = typename DataPoint::Scalar;
+    using VectorContainer = typename KdTreeType::PointContainer;
+    using VectorType = typename DataPoint::VectorType;
+
+    const int N = quick ? 100 : 5000;
+    auto points = VectorContainer(N);
+    std::generate(points.begin(), points.end(), []() {return DataPoint(VectorType::Random()); });
+
+    std::vector<int> indices(N);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::vector<int> sampling(N / 2);
+    std::sample(indices.begin(), indices.end(), sampling.begin(), N / 2, std::mt19937(0));
+
+    KdTreeType kdtree;
+    if constexpr (KdTreeType::SUPPORTS_SUBSAMPLING)
+        kdtree.buildWithSampling(points, sampling);
+    else
+    {
+        kdtree.build(points);
+        sampling = indices;
+    }
+    VERIFY(kdtree.sample_count() == int(sampling.size()));
+
+    for (int i = 0; i < N; ++i)
+    {
+        Scalar r = Eigen::internal::random<Scalar>(0., 0.5);
+        VectorType point = VectorType::Random();
+        std::vector<int> results;
+        for (int j : kdtree.range_neighbors(point, r))
+            results.push_back(j);
+        VERIFY((check_range_neighbors<Scalar, VectorType, VectorContainer>(points, sampling, point, r, results)));
+    }
+}
+
 int main(int argc, char** argv)
 {
 	if (!init_testing(argc, argv))
@@ -145,6 +184,14 @@ int main(int argc, char** argv)
     bool quick = false;
 #endif
 
+    static_assert(KdTreeSparse<TestPoint<float, 3>>::SUPPORTS_SUBSAMPLING, "KdTreeSparse supports subsampling");
+    static_assert(! KdTreeDense<TestPoint<float, 3>>::SUPPORTS_SUBSAMPLING, "KdTreeDense does not support subsampling");
+
+    cout << "Test KdTree subsampling support in 3D..." << endl;
+    testKdTreeSubsamplingSupport<KdTreeSparse<TestPoint<float, 3>>>(quick);
+    testKdTreeSubsamplingSupport<KdTreeSparse<TestPoint<double, 3>>>(quick);
+    testKdTreeSubsamplingSupport<KdTreeDense<TestPoint<double, 3>>>(quick);
+
     cout << "Test KdTreeRange (from Point) in 3D..." << endl;
 	testKdTreeRangePoint<TestPoint<float, 3>>(quick);
 	testKdTreeRangePoint<TestPoint<double, 3>>(quick);